@@ -29,6 +29,9 @@ macx:QMAKE_CXXFLAGS += -Wmacro-redefined
 
 CONFIG += c++11
 
+# build with CONFIG+=no_tracing to compile out all trace spans
+no_tracing:DEFINES += QTSESAM_NO_TRACING
+
 win32-msvc* {
     DEFINES += _SCL_SECURE_NO_WARNINGS
     QMAKE_CXXFLAGS_DEBUG += /sdl
@@ -22,6 +22,9 @@ SUBDIRS += \
     libqrencode \
     libSESAM \
     SESAM2Chrome \
+    SESAMSyncServer \
+    SESAMSyncLoadTest \
+    SESAMBreachFilter \
     Qt-SESAM \
     UnitTests
 
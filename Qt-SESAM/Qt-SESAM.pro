@@ -62,7 +62,10 @@ SOURCES += main.cpp \
     hackhelper.cpp \
     expandablegroupbox.cpp \
     logger.cpp \
-    passwordsafereader.cpp
+    passwordsafereader.cpp \
+    qrcoderenderer.cpp \
+    qrsheetwriter.cpp \
+    qrsheetexportdialog.cpp
 
 HEADERS  += \
     mainwindow.h \
@@ -80,7 +83,10 @@ HEADERS  += \
     keepass2xmlreader.h \
     expandablegroupbox.h \
     logger.h \
-    passwordsafereader.h
+    passwordsafereader.h \
+    qrcoderenderer.h \
+    qrsheetwriter.h \
+    qrsheetexportdialog.h
 
 FORMS += mainwindow.ui \
     optionsdialog.ui \
@@ -88,7 +94,8 @@ FORMS += mainwindow.ui \
     newcredentialsdialog.ui \
     masterpassworddialog.ui \
     servercertificatewidget.ui \
-    changemasterpassworddialog.ui
+    changemasterpassworddialog.ui \
+    qrsheetexportdialog.ui
 
 RESOURCES += \
     QtSESAM.qrc
@@ -22,6 +22,7 @@
 #include "changemasterpassworddialog.h"
 #include "ui_changemasterpassworddialog.h"
 #include "passwordchecker.h"
+#include "strengthestimator.h"
 #include "util.h"
 
 
@@ -30,13 +31,16 @@ class ChangeMasterPasswordDialogPrivate
 public:
   ChangeMasterPasswordDialogPrivate(void)
     : passwordChecker(Q_NULLPTR)
-  { /* ... */ }
+  {
+    estimator.addUserInputs(QStringList() << "sesam" << "ctsesam" << "qtsesam");
+  }
   ~ChangeMasterPasswordDialogPrivate()
   {
     SafeDelete(passwordChecker);
   }
 
   PasswordChecker *passwordChecker;
+  StrengthEstimator estimator;
 };
 
 
@@ -63,6 +67,8 @@ ChangeMasterPasswordDialog::~ChangeMasterPasswordDialog()
 
 void ChangeMasterPasswordDialog::invalidate(void)
 {
+  Q_D(ChangeMasterPasswordDialog);
+  d->estimator.clear();
   SecureErase(ui->currentPasswordLineEdit->text());
   SecureErase(ui->newPasswordLineEdit1->text());
   SecureErase(ui->newPasswordLineEdit2->text());
@@ -98,8 +104,9 @@ void ChangeMasterPasswordDialog::setPasswordFilename(const QString &filename)
   if (filename.isEmpty()) {
     SafeDelete(d->passwordChecker);
   }
-  else {
+  else if (d->passwordChecker == Q_NULLPTR || d->passwordChecker->passwordFilename() != filename || d->passwordChecker->isStale()) {
     SafeRenew(d->passwordChecker, new PasswordChecker(filename));
+    QObject::connect(d->passwordChecker, SIGNAL(ready(bool)), SLOT(comparePasswords()), Qt::QueuedConnection);
   }
 }
 
@@ -117,7 +124,8 @@ void ChangeMasterPasswordDialog::showEvent(QShowEvent *)
 void ChangeMasterPasswordDialog::comparePasswords(void)
 {
   Q_D(ChangeMasterPasswordDialog);
-  QString password = ui->newPasswordLineEdit1->text();
+  const QString &password = ui->newPasswordLineEdit1->text();
+  d->estimator.setPassword(password);
   if (!password.isEmpty()) {
     bool found = false;
     QString grade;
@@ -131,10 +139,13 @@ void ChangeMasterPasswordDialog::comparePasswords(void)
       }
     }
     if (!found) {
-      PasswordChecker::evaluatePasswordStrength(ui->newPasswordLineEdit1->text(), color, grade, Q_NULLPTR);
+      PasswordChecker::evaluatePasswordStrength(d->estimator, color, grade);
     }
     ui->strengthLabel->setText(tr("%1").arg(grade));
     ui->strengthLabel->setStyleSheet(QString("background-color: rgb(%1, %2, %3); font-weight: bold").arg(color.red()).arg(color.green()).arg(color.blue()));
   }
+  ui->strengthLabel->setToolTip(password.isEmpty()
+                                ? QString()
+                                : tr("About 10^%1 guesses needed; cracking would take %2.").arg(d->estimator.guessesLog10(), 0, 'f', 1).arg(d->estimator.crackTimeDisplay()));
   ui->okPushButton->setEnabled(!ui->newPasswordLineEdit1->text().isEmpty() && ui->newPasswordLineEdit1->text() == ui->newPasswordLineEdit2->text());
 }
@@ -21,6 +21,9 @@
 #include "easyselectorwidget.h"
 #include "util.h"
 #include "password.h"
+#include "domainsettings.h"
+#include "kdfbenchmark.h"
+#include "strengthestimator.h"
 #include <QDebug>
 #include <QSizePolicy>
 #include <QPainter>
@@ -30,10 +33,8 @@
 #include <QPoint>
 #include <QPixmap>
 #include <QToolTip>
-#include <QCryptographicHash>
-#include <QThread>
+#include <QStandardPaths>
 #include <QtConcurrent>
-#include <QElapsedTimer>
 #include <QTime>
 
 const int EasySelectorWidget::DefaultMinLength = 4;
@@ -51,9 +52,11 @@ public:
     , minLength(EasySelectorWidget::DefaultMinLength)
     , maxLength(EasySelectorWidget::DefaultMaxLength)
     , extraCharCount(Password::ExtraChars.count())
-    , doAbortSpeedTest(false)
-    , hashesPerSec(-1)
-  { /* ... */ }
+    , iterations(DomainSettings::DefaultIterations)
+    , iterationsPerSec(-1)
+  {
+    benchmark.setCacheFileName(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/kdfbenchmark.json");
+  }
   ~EasySelectorWidgetPrivate()
   { /* ... */ }
   bool buttonDown;
@@ -66,9 +69,10 @@ public:
   int extraCharCount;
   QString passwordTemplate;
   QPixmap bgPixmap;
-  bool doAbortSpeedTest;
+  int iterations;
+  KdfBenchmark benchmark;
   QFuture<void> speedTestFuture;
-  qreal hashesPerSec;
+  qreal iterationsPerSec;
 };
 
 
@@ -121,6 +125,28 @@ void EasySelectorWidget::setExtraCharacters(const QString &extraChars)
 }
 
 
+/*!
+ * \brief EasySelectorWidget::setIterations
+ *
+ * Sets the number of PBKDF2 iterations of the current domain, which every guess of an attacker has to compute.
+ */
+void EasySelectorWidget::setIterations(int iterations)
+{
+  Q_D(EasySelectorWidget);
+  if (iterations == d->iterations)
+    return;
+  d->iterations = qMax(1, iterations);
+  redrawBackground();
+  update();
+}
+
+
+int EasySelectorWidget::iterations(void) const
+{
+  return d_ptr->iterations;
+}
+
+
 void EasySelectorWidget::setLength(int length)
 {
   Q_D(EasySelectorWidget);
@@ -328,22 +354,29 @@ bool EasySelectorWidget::tooltipTextAt(const QPoint &pos, QString &helpText) con
   const int ys = d_ptr->bgPixmap.height() / (Password::MaxComplexityValue + 1);
   const int length = pos.x() / xs + d_ptr->minLength;
   const int complexity = Password::MaxComplexityValue - pos.y() / ys;
-  QString crackDuration = makeCrackDuration(tianhe2Secs(length, complexity));
+  QString crackDuration = makeCrackDuration(attackerSecs(length, complexity));
   QString myCrackDuration = makeCrackDuration(mySecs(length, complexity));
-  helpText = tr("%1 characters,\n"
-                "est. crack time w/ Tianhe-2: %2,\n"
-                "on your computer: %3")
+  helpText = tr("%1 characters, %2 iterations,\n"
+                "est. crack time w/ GPU cluster: %3,\n"
+                "on your computer: %4")
       .arg(length)
+      .arg(d_ptr->iterations)
       .arg(crackDuration)
-      .arg(d_ptr->hashesPerSec < 0 ? tr("calculating ...") : myCrackDuration);
+      .arg(d_ptr->iterationsPerSec < 0 ? tr("calculating ...") : myCrackDuration);
   return (d_ptr->minLength <= length) && (length <= d_ptr->maxLength);
 }
 
 
-qreal EasySelectorWidget::sha1Secs(int length, int complexityValue, qreal sha1PerSec) const
+/*!
+ * \brief EasySelectorWidget::crackSecs
+ *
+ * \return average time needed to find a password by brute force if `iterationsPerSec`
+ * PBKDF2 iterations can be computed per second
+ */
+qreal EasySelectorWidget::crackSecs(int length, int complexityValue, qreal iterationsPerSec) const
 {
   int charCount = 0;
-  if (qFuzzyIsNull(sha1PerSec)) {
+  if (iterationsPerSec <= 0) {
     return std::numeric_limits<qreal>::infinity();
   }
   Password::Complexity complexity = Password::Complexity::fromValue(complexityValue);
@@ -359,30 +392,27 @@ qreal EasySelectorWidget::sha1Secs(int length, int complexityValue, qreal sha1Pe
   if (complexity.extra) {
     charCount += d_ptr->extraCharCount;
   }
-  static const int Iterations = 1;
   const qreal perms = qPow(charCount, length);
-  const qreal t2secs = perms * Iterations / sha1PerSec;
-  return .5 * t2secs;
-
+  return .5 * perms * d_ptr->iterations / iterationsPerSec;
 }
 
 
-qreal EasySelectorWidget::tianhe2Secs(int length, int complexityValue) const
+qreal EasySelectorWidget::attackerSecs(int length, int complexityValue) const
 {
-  return sha1Secs(length, complexityValue, 767896613647.0);
+  return crackSecs(length, complexityValue, StrengthEstimator::DefaultAttackerHashRate);
 }
 
 
 qreal EasySelectorWidget::mySecs(int length, int complexityValue) const
 {
-  return sha1Secs(length, complexityValue, d_ptr->hashesPerSec);
+  return crackSecs(length, complexityValue, d_ptr->iterationsPerSec);
 }
 
 
 qreal EasySelectorWidget::passwordStrength(int length, int complexityValue) const
 {
-  const qreal t2y = tianhe2Secs(length, complexityValue) / 60 / 60 / 24 / 365.25;
-  return t2y * 1e8;
+  const qreal years = attackerSecs(length, complexityValue) / 60 / 60 / 24 / 365.25;
+  return years * 1e8;
 }
 
 
@@ -411,47 +441,35 @@ void EasySelectorWidget::setMaxLength(int maxLength)
 void EasySelectorWidget::onSpeedTestBegin(void)
 {
   Q_D(EasySelectorWidget);
-  QTimer::singleShot(3000, this, SLOT(onSpeedTestAbort()));
   d->speedTestFuture = QtConcurrent::run(this, &EasySelectorWidget::speedTest);
 }
 
 
-void EasySelectorWidget::onSpeedTestEnd(qreal hashesPerSec)
+void EasySelectorWidget::onSpeedTestEnd(qreal iterationsPerSec)
 {
   Q_D(EasySelectorWidget);
-  d->hashesPerSec = hashesPerSec;
+  d->iterationsPerSec = iterationsPerSec;
 }
 
 
 void EasySelectorWidget::onSpeedTestAbort(void)
 {
   Q_D(EasySelectorWidget);
-  d->doAbortSpeedTest = true;
+  d->benchmark.abort();
 }
 
 
+/*!
+ * \brief EasySelectorWidget::speedTest
+ *
+ * Measures the PBKDF2 throughput of this machine unless a recent result is cached.
+ * The result doesn't depend much on the iteration count, so the default is good
+ * enough to estimate the crack times of all domains.
+ */
 void EasySelectorWidget::speedTest(void)
 {
   Q_D(EasySelectorWidget);
-  static const int BufSize = 512 / 8;
-  QByteArray data(BufSize, static_cast<char>(0));
-  QCryptographicHash hash(QCryptographicHash::Sha1);
-  QElapsedTimer t;
-  t.start();
-  qint64 n = 0;
-  while (!d->doAbortSpeedTest && t.elapsed() < 5000) {
-    for (auto d = data.begin(); d != data.end(); ++d) {
-      *d = qrand() & 0xff;
-    }
-    hash.addData(data);
-    hash.result();
-    hash.reset();
-    ++n;
-  }
-  const int coreCount = QThread::idealThreadCount() > 0 ? QThread::idealThreadCount() : 1;
-  const qint64 nsecsElapsed = t.nsecsElapsed();
-  if (nsecsElapsed > 0) {
-    const qreal hashesPerSec = n * coreCount * 1e9 / nsecsElapsed;
-    emit speedTestFinished(hashesPerSec);
+  if (d->benchmark.loadCached() || d->benchmark.run(DomainSettings::DefaultIterations)) {
+    emit speedTestFinished(d->benchmark.iterationsPerSec());
   }
 }
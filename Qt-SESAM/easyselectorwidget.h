@@ -44,6 +44,8 @@ public:
   int length(void) const;
   int complexityValue(void) const;
   void setExtraCharacters(const QString &extraChars);
+  void setIterations(int iterations);
+  int iterations(void) const;
 
 protected:
   void mouseMoveEvent(QMouseEvent*) Q_DECL_OVERRIDE;
@@ -56,13 +58,13 @@ protected:
 
 signals:
   void valuesChanged(int newLength, int newComplexity);
-  void speedTestFinished(qreal);
+  void speedTestFinished(qreal iterationsPerSec);
 
 public slots:
   void setMinLength(int);
   void setMaxLength(int);
   void onSpeedTestBegin(void);
-  void onSpeedTestEnd(qreal hashesPerSec);
+  void onSpeedTestEnd(qreal iterationsPerSec);
   void onSpeedTestAbort(void);
 
 private:
@@ -77,9 +79,9 @@ private: // methods
   void speedTest(void);
   void redrawBackground(void);
   bool tooltipTextAt(const QPoint &pos, QString &helpText) const;
-  qreal tianhe2Secs(int length, int complexityValue) const;
+  qreal attackerSecs(int length, int complexityValue) const;
   qreal passwordStrength(int length, int complexityValue) const;
-  qreal sha1Secs(int length, int complexityValue, qreal sha1PerSec) const;
+  qreal crackSecs(int length, int complexityValue, qreal iterationsPerSec) const;
   qreal mySecs(int length, int complexityValue) const;
 };
 
@@ -27,29 +27,291 @@
 #include <QDir>
 #include <QFile>
 #include <QFileInfo>
+#include <QThread>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QWaitCondition>
+#include <QRegExp>
+#include <QAtomicInteger>
 #include <QtGlobal>
 
+
+const int Logger::Capacity = 4096;
+
+static const char *const LevelNames[] = { "DEBUG", "INFO", "WARN", "ERROR" };
+static const QString TimestampFormat = "yyyy-MM-ddThh:mm:ss.zzz";
+static const int WriterIdleMs = 50;
+
+
+struct LogRecord {
+  LogRecord(void)
+    : timestamp(0)
+    , level(Logger::Info)
+  { /* ... */ }
+  qint64 timestamp;
+  int level;
+  QString message;
+  QVariantMap fields;
+};
+
+
+struct LogSlot {
+  QAtomicInteger<quint32> sequence;
+  LogRecord record;
+};
+
+
+class LoggerPrivate;
+
+class LoggerThread : public QThread
+{
+public:
+  explicit LoggerThread(LoggerPrivate *d)
+    : d(d)
+  { /* ... */ }
+protected:
+  void run(void) Q_DECL_OVERRIDE;
+private:
+  LoggerPrivate *d;
+};
+
+
 class LoggerPrivate {
 public:
   LoggerPrivate(void)
-    : enabled(false)
-  { /* ... */ }
+    : ring(new LogSlot[Logger::Capacity])
+    , mask(quint32(Logger::Capacity - 1))
+    , enqueuePos(0)
+    , dequeuePos(0)
+    , drainedPos(0)
+    , enabled(0)
+    , level(Logger::Debug)
+    , dropped(0)
+    , reportedDropped(0)
+    , stop(0)
+    , reopen(0)
+    , maxFileSize(1024 * 1024)
+    , maxFileAge(24 * 60 * 60)
+    , maxFiles(5)
+    , writer(this)
+  {
+    for (quint32 i = 0; i <= mask; ++i) {
+      ring[i].sequence.store(i);
+    }
+  }
+  ~LoggerPrivate()
+  {
+    delete [] ring;
+  }
+
+  // Bounded multi-producer queue after Dmitry Vyukov. Each slot carries a sequence
+  // number telling producers and the consumer whose turn it is, so neither side
+  // ever takes a lock. A full buffer drops the record instead of blocking the caller.
+  bool push(const LogRecord &rec)
+  {
+    quint32 pos = enqueuePos.load();
+    LogSlot *slot;
+    forever {
+      slot = &ring[pos & mask];
+      const qint32 diff = qint32(slot->sequence.loadAcquire() - pos);
+      if (diff == 0) {
+        if (enqueuePos.testAndSetRelaxed(pos, pos + 1))
+          break;
+        pos = enqueuePos.load();
+      }
+      else if (diff < 0) {
+        return false;
+      }
+      else {
+        pos = enqueuePos.load();
+      }
+    }
+    slot->record = rec;
+    slot->sequence.storeRelease(pos + 1);
+    return true;
+  }
+  // must only be called from the writer thread
+  bool pop(LogRecord &rec)
+  {
+    LogSlot *slot = &ring[dequeuePos & mask];
+    if (qint32(slot->sequence.loadAcquire() - (dequeuePos + 1)) < 0)
+      return false;
+    rec = slot->record;
+    slot->record = LogRecord();
+    slot->sequence.storeRelease(dequeuePos + mask + 1);
+    ++dequeuePos;
+    return true;
+  }
+  void drain(void)
+  {
+    if (reopen.fetchAndStoreAcquire(0) != 0) {
+      openFile();
+    }
+    const int nDropped = dropped.load();
+    if (nDropped != reportedDropped) {
+      LogRecord rec;
+      rec.timestamp = QDateTime::currentMSecsSinceEpoch();
+      rec.level = Logger::Warning;
+      rec.message = QString("%1 log messages dropped because the buffer was full").arg(nDropped - reportedDropped);
+      write(rec);
+      reportedDropped = nDropped;
+    }
+    LogRecord rec;
+    bool written = false;
+    while (pop(rec)) {
+      write(rec);
+      written = true;
+    }
+    if (written && file.isOpen()) {
+      file.flush();
+    }
+    drainedPos.storeRelease(dequeuePos);
+  }
+  void write(const LogRecord &rec)
+  {
+    QString line = QString("[%1] %2 %3")
+        .arg(QDateTime::fromMSecsSinceEpoch(rec.timestamp).toString(TimestampFormat))
+        .arg(LevelNames[rec.level])
+        .arg(rec.message);
+    for (QVariantMap::const_iterator field = rec.fields.constBegin(); field != rec.fields.constEnd(); ++field) {
+      line += QString(" %1=%2").arg(field.key()).arg(quoted(field.value().toString()));
+    }
+    if (file.isOpen()) {
+      const QByteArray &data = (line + "\n").toUtf8();
+      rotateIfNeeded(data.size());
+      file.write(data);
+    }
+    else {
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 4, 0))
+      qDebug().noquote().nospace() << line;
+#else
+      qDebug().nospace() << line;
+#endif
+    }
+  }
+  static QString quoted(QString value)
+  {
+    if (!value.isEmpty() && !value.contains(QRegExp("[\\s\"=]")))
+      return value;
+    return "\"" + value.replace("\\", "\\\\").replace("\"", "\\\"").replace("\n", "\\n") + "\"";
+  }
+  void openFile(void)
+  {
+    if (file.isOpen()) {
+      file.close();
+    }
+    QString filename;
+    {
+      QMutexLocker locker(&configMutex);
+      filename = fileName;
+    }
+    if (filename.isEmpty())
+      return;
+    QDir().mkpath(QFileInfo(filename).absolutePath());
+    file.setFileName(filename);
+    if (!file.open(QIODevice::ReadWrite | QIODevice::Append))
+      return;
+    // the age of a log file is that of its first record
+    fileStarted = QDateTime::currentDateTime();
+    if (file.size() > 0 && file.seek(0)) {
+      const QByteArray &firstLine = file.readLine(64);
+      const QDateTime &started = QDateTime::fromString(QString::fromUtf8(firstLine.mid(1, TimestampFormat.size())), TimestampFormat);
+      if (started.isValid()) {
+        fileStarted = started;
+      }
+    }
+    file.seek(file.size());
+  }
+  void rotateIfNeeded(qint64 pending)
+  {
+    qint64 maxSize;
+    int maxAge;
+    int nFiles;
+    {
+      QMutexLocker locker(&configMutex);
+      maxSize = maxFileSize;
+      maxAge = maxFileAge;
+      nFiles = maxFiles;
+    }
+    const bool tooBig = maxSize > 0 && file.size() > 0 && file.size() + pending > maxSize;
+    const bool tooOld = maxAge > 0 && fileStarted.secsTo(QDateTime::currentDateTime()) > maxAge;
+    if (!tooBig && !tooOld)
+      return;
+    const QString filename = file.fileName();
+    file.close();
+    QFile::remove(QString("%1.%2").arg(filename).arg(nFiles));
+    for (int i = nFiles - 1; i > 0; --i) {
+      QFile::rename(QString("%1.%2").arg(filename).arg(i), QString("%1.%2").arg(filename).arg(i + 1));
+    }
+    if (nFiles > 0) {
+      QFile::rename(filename, filename + ".1");
+    }
+    else {
+      QFile::remove(filename);
+    }
+    openFile();
+  }
+  LogSlot *ring;
+  const quint32 mask;
+  QAtomicInteger<quint32> enqueuePos;
+  quint32 dequeuePos;
+  QAtomicInteger<quint32> drainedPos;
+  QAtomicInt enabled;
+  QAtomicInt level;
+  QAtomicInt dropped;
+  int reportedDropped;
+  QAtomicInt stop;
+  QAtomicInt reopen;
+  QMutex configMutex;
+  QString fileName;
+  qint64 maxFileSize;
+  int maxFileAge;
+  int maxFiles;
   QFile file;
-  bool enabled;
+  QDateTime fileStarted;
+  QMutex wakeMutex;
+  QWaitCondition wake;
+  LoggerThread writer;
 };
 
 
+void LoggerThread::run(void)
+{
+  forever {
+    const bool stopping = d->stop.loadAcquire() != 0;
+    d->drain();
+    if (stopping)
+      break;
+    QMutexLocker locker(&d->wakeMutex);
+    d->wake.wait(&d->wakeMutex, WriterIdleMs);
+  }
+}
+
+
+/*!
+ * \brief Logger::Logger
+ *
+ * Callers only format a record and put it into a lock-free ring buffer; a background
+ * thread drains the buffer, writes the records and takes care of rotating the log file.
+ * Logging therefore never waits for the disk. If the writer can't keep up, records are
+ * dropped and the number of dropped records is logged later.
+ */
 Logger::Logger(void)
   : d_ptr(new LoggerPrivate)
 {
+  Q_D(Logger);
   setFileName(QString("%1/%2.log").arg(QStandardPaths::writableLocation(QStandardPaths::DataLocation)).arg(AppName));
+  d->writer.start(QThread::LowPriority);
 }
 
 
 Logger::~Logger()
 {
   Q_D(Logger);
-  log(QString("Logger shutting down ..."));
+  log(Info, QString("Logger shutting down ..."));
+  d->stop.storeRelease(1);
+  d->wake.wakeOne();
+  d->writer.wait();
   d->file.close();
 }
 
@@ -61,44 +323,131 @@ Logger &Logger::instance(void)
 }
 
 
-void Logger::log(const QString &message)
+void Logger::log(Level level, const QString &message, const QVariantMap &fields)
 {
   Q_D(Logger);
-  if (d->enabled) {
-    const QByteArray &logMsg = QString("[%1] %2")
-        .arg(QDateTime::currentDateTime().toString(Qt::ISODate))
-        .arg(message).toUtf8();
-    if (d->file.isOpen()) {
-      d->file.write(logMsg);
-      d->file.write("\n");
-      d->file.flush();
-    }
-    else {
-#if (QT_VERSION >= QT_VERSION_CHECK(5, 4, 0))
-      qDebug().noquote().nospace() << logMsg;
-#else
-      qDebug().nospace() << logMsg;
-#endif
-    }
+  if (!isEnabled(level))
+    return;
+  LogRecord rec;
+  rec.timestamp = QDateTime::currentMSecsSinceEpoch();
+  rec.level = level;
+  rec.message = message;
+  rec.fields = fields;
+  if (!d->push(rec)) {
+    d->dropped.fetchAndAddRelaxed(1);
+    return;
+  }
+  if (level >= Warning) {
+    d->wake.wakeOne();
   }
 }
 
 
+void Logger::log(const QString &message)
+{
+  log(Info, message);
+}
+
+
+bool Logger::isEnabled(Level level) const
+{
+  Q_D(const Logger);
+  return d->enabled.load() != 0 && int(level) >= d->level.load();
+}
+
+
 void Logger::setEnabled(bool enabled)
 {
   Q_D(Logger);
-  d->enabled = enabled;
+  d->enabled.store(enabled ? 1 : 0);
+}
+
+
+void Logger::setLevel(Level level)
+{
+  Q_D(Logger);
+  d->level.store(int(level));
+}
+
+
+Logger::Level Logger::level(void) const
+{
+  Q_D(const Logger);
+  return Level(d->level.load());
 }
 
 
 void Logger::setFileName(const QString &filename)
 {
   Q_D(Logger);
-  if (d->file.isOpen()) {
-    d->file.close();
+  {
+    QMutexLocker locker(&d->configMutex);
+    d->fileName = filename;
+  }
+  d->reopen.storeRelease(1);
+  d->wake.wakeOne();
+  log(Info, QString("Logger writing to %1").arg(filename));
+}
+
+
+/*!
+ * \brief Logger::setMaxFileSize
+ *
+ * The log file is rotated before it would grow beyond `bytes`. 0 disables size based rotation.
+ */
+void Logger::setMaxFileSize(qint64 bytes)
+{
+  Q_D(Logger);
+  QMutexLocker locker(&d->configMutex);
+  d->maxFileSize = bytes;
+}
+
+
+/*!
+ * \brief Logger::setMaxFileAge
+ *
+ * The log file is rotated once its first record is older than `secs`. 0 disables time based rotation.
+ */
+void Logger::setMaxFileAge(int secs)
+{
+  Q_D(Logger);
+  QMutexLocker locker(&d->configMutex);
+  d->maxFileAge = secs;
+}
+
+
+/*!
+ * \brief Logger::setMaxFiles
+ *
+ * Sets the number of rotated log files to keep besides the current one.
+ */
+void Logger::setMaxFiles(int n)
+{
+  Q_D(Logger);
+  QMutexLocker locker(&d->configMutex);
+  d->maxFiles = qMax(0, n);
+}
+
+
+int Logger::dropped(void) const
+{
+  Q_D(const Logger);
+  return d->dropped.load();
+}
+
+
+/*!
+ * \brief Logger::flush
+ *
+ * Blocks until all records logged so far have been written.
+ */
+void Logger::flush(void)
+{
+  Q_D(Logger);
+  const quint32 target = d->enqueuePos.load();
+  d->wake.wakeOne();
+  while (d->writer.isRunning() && qint32(d->drainedPos.loadAcquire() - target) < 0) {
+    QThread::msleep(1);
+    d->wake.wakeOne();
   }
-  QDir().mkpath(QFileInfo(filename).canonicalPath());
-  d->file.setFileName(filename);
-  d->file.open(QIODevice::WriteOnly | QIODevice::Append);
-  log(QString("Logger writing to %1").arg(filename));
 }
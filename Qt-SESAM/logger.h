@@ -17,12 +17,13 @@
 
 */
 
+
 #ifndef __LOGGER_H_
 #define __LOGGER_H_
 
 #include <QtGlobal>
 #include <QString>
-#include <QFile>
+#include <QVariantMap>
 #include <QScopedPointer>
 
 class LoggerPrivate;
@@ -30,10 +31,28 @@ class LoggerPrivate;
 class Logger
 {
 public:
+  enum Level {
+    Debug = 0,
+    Info,
+    Warning,
+    Error
+  };
+
   static Logger &instance(void);
+  void log(Level level, const QString &message, const QVariantMap &fields = QVariantMap());
   void log(const QString &);
+  bool isEnabled(Level level) const;
   void setEnabled(bool);
+  void setLevel(Level);
+  Level level(void) const;
   void setFileName(const QString &);
+  void setMaxFileSize(qint64 bytes);
+  void setMaxFileAge(int secs);
+  void setMaxFiles(int);
+  int dropped(void) const;
+  void flush(void);
+
+  static const int Capacity;
 
   Logger(const Logger &) = delete;
   void operator=(Logger const &) = delete;
@@ -48,6 +67,26 @@ private:
 
 };
 
-#define _LOG Logger::instance().log
+
+// Messages below this level are compiled out together with their arguments.
+#ifndef QTSESAM_LOG_LEVEL
+#ifdef QT_NO_DEBUG
+#define QTSESAM_LOG_LEVEL 1
+#else
+#define QTSESAM_LOG_LEVEL 0
+#endif
+#endif
+
+#define _LOG_AT(level, ...) \
+  do { \
+    if (QTSESAM_LOG_LEVEL <= level && Logger::instance().isEnabled(level)) \
+      Logger::instance().log(level, __VA_ARGS__); \
+  } while (false)
+
+#define _LOG_DEBUG(...) _LOG_AT(Logger::Debug, __VA_ARGS__)
+#define _LOG_INFO(...) _LOG_AT(Logger::Info, __VA_ARGS__)
+#define _LOG_WARNING(...) _LOG_AT(Logger::Warning, __VA_ARGS__)
+#define _LOG_ERROR(...) _LOG_AT(Logger::Error, __VA_ARGS__)
+#define _LOG _LOG_INFO
 
 #endif // __LOGGER_H_
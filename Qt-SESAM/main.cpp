@@ -19,6 +19,7 @@
 
 #include "mainwindow.h"
 #include "global.h"
+#include "tracer.h"
 #include <QApplication>
 #include <QSettings>
 #include <QTranslator>
@@ -29,7 +30,17 @@ int main(int argc, char *argv[])
   Q_INIT_RESOURCE(QtSESAM);
   checkPortable();
   QSettings settings(QSettings::IniFormat, QSettings::UserScope, AppCompanyName, AppName);
-  const bool forceStart = argc > 1 && qstrcmp(argv[1], "--force-start") == 0;
+  bool forceStart = false;
+  QString traceFilename;
+  for (int i = 1; i < argc; ++i) {
+    if (qstrcmp(argv[i], "--force-start") == 0) {
+      forceStart = true;
+    }
+    else if (qstrcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+      traceFilename = QString::fromLocal8Bit(argv[++i]);
+    }
+  }
+  Tracer::instance().setEnabled(!traceFilename.isEmpty());
   int exitCode = 0;
   do {
     QApplication a(argc, argv);
@@ -48,5 +59,8 @@ int main(int argc, char *argv[])
     w.activateWindow();
     exitCode = a.exec();
   } while (exitCode == MainWindow::EXIT_CODE_RESTART_APP);
+  if (!traceFilename.isEmpty()) {
+    Tracer::instance().writeChromeTrace(traceFilename);
+  }
   return exitCode;
 }
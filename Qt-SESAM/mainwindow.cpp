@@ -28,6 +28,8 @@
 #include <QObject>
 #include <QList>
 #include <QPair>
+#include <QMap>
+#include <QSet>
 #include <QClipboard>
 #include <QStringListModel>
 #include <QStandardPaths>
@@ -49,19 +51,26 @@
 #include <QProgressDialog>
 #include <QSysInfo>
 #include <QElapsedTimer>
+#include <QFileSystemWatcher>
+#include <QSaveFile>
 #include <QtConcurrent>
 #include <QFuture>
 #include <QFutureWatcher>
+#include <QEventLoop>
 #include <QMutexLocker>
+#include <QAtomicInt>
 #include <QSemaphore>
 #include <QDesktopServices>
 #include <QCompleter>
 #include <QShortcut>
 #include <QGraphicsOpacityEffect>
 #include <QLockFile>
-#include <QPainter>
 #include <QPixmap>
 #include <QCursor>
+#include <QMessageAuthenticationCode>
+#include <QBuffer>
+#include <QDataStream>
+#include <QInputDialog>
 
 #include "logger.h"
 #include "global.h"
@@ -84,14 +93,31 @@
 #include "passwordchecker.h"
 #include "tcpclient.h"
 #include "exporter.h"
+#include "vault.h"
+#include "domainindex.h"
+#include "blobstore.h"
+#include "backupstore.h"
+#include "vaultauditor.h"
+#include "filewiper.h"
+#include "syncpatch.h"
+#include "syncdecoder.h"
+#include "syncscheduler.h"
+#include "tracer.h"
+#include "metrics.h"
 #include "keepass2xmlreader.h"
 #include "passwordsafereader.h"
 
-#include "qrencode.h"
+#include "qrcoderenderer.h"
+#include "qrsheetwriter.h"
+#include "qrsheetexportdialog.h"
 
 static const int DefaultMasterPasswordInvalidationTimeMins = 5;
 static const bool CompressionEnabled = true;
 static const int NotFound = -1;
+static const int MaxCASRetries = 3;
+static const int UploadChunkSize = 1024 * 1024;
+static const int SyncFileSettleMs = 1500;
+static const int VaultWriteDelayMs = 300;
 
 enum TabIndexes {
   TabGeneratedPassword,
@@ -141,6 +167,27 @@ public:
     , deleteReply(Q_NULLPTR)
     , readReply(Q_NULLPTR)
     , writeReply(Q_NULLPTR)
+    , serverSupportsBlobs(false)
+    , serverSupportsDelta(false)
+    , serverSupportsBinary(false)
+    , uploadChunkIndex(-1)
+    , uploadConditional(false)
+    , pendingDeltaRevision(-1)
+    , readTraceStart(0)
+    , writeTraceStart(0)
+    , readRequestStart(0)
+    , writeRequestStart(0)
+    , casRetries(0)
+    , remoteDomainsHoldLocalState(false)
+    , blobTransfersPending(0)
+    , blobTransfersDone(0)
+    , coordinatedSync(false)
+    , syncPeersPending(0)
+    , serverSyncedIncrementally(false)
+    , backgroundSync(false)
+    , scheduledSync(false)
+    , syncFailed(false)
+    , syncChangedLocalData(false)
     , completer(Q_NULLPTR)
     , pwdLabelOpacityEffect(Q_NULLPTR)
     , counter(0)
@@ -150,11 +197,20 @@ public:
     , doConvertLocalToLegacy(false)
     , lockFile(Q_NULLPTR)
     , forceStart(false)
+    , unlockStagesPending(0)
+    , unlockRepeatedPasswordEntry(false)
+    , timeToInteractiveMs(-1)
+    , attachmentsPending(0)
+    , passwordChecker(Q_NULLPTR)
   {
     resetSSLConf();
+    vault.setFileName(QFileInfo(settings.fileName()).absolutePath() + "/" + AppName + ".vault");
+    blobStore.setPath(QFileInfo(settings.fileName()).absolutePath() + "/" + AppName + ".blobs");
+    backupStore.setPath(QStandardPaths::writableLocation(QStandardPaths::DataLocation) + "/backups");
   }
   ~MainWindowPrivate()
   {
+    SafeDelete(passwordChecker);
     SecureErase(masterPassword);
   }
   void resetSSLConf(void)
@@ -187,7 +243,11 @@ public:
   DomainSettings domainSettingsBeforceSync;
   QSettings settings;
   DomainSettingsList domains;
-  DomainSettingsList remoteDomains;
+  DomainIndex legacyDomains;
+  DomainIndex remoteDomains;
+  Vault vault;
+  BlobStore blobStore;
+  BackupStore backupStore;
   bool customCharacterSetDirty;
   bool parameterSetDirty;
   ExpandableGroupbox *expandableGroupBox;
@@ -219,6 +279,86 @@ public:
   QNetworkReply *deleteReply;
   QNetworkReply *readReply;
   QNetworkReply *writeReply;
+  QNetworkAccessManager blobNAM;
+  bool serverSupportsBlobs;
+  bool serverSupportsDelta;
+  bool serverSupportsBinary;
+  QList<QByteArray> uploadChunks;
+  QByteArray uploadId;
+  int uploadChunkIndex;
+  bool uploadConditional;
+  QVariantList pendingDeltaChanges;
+  qint64 pendingDeltaRevision;
+  QDateTime pendingDeltaTimestamp;
+  QSet<QString> outgoingChanges;
+  QSet<QString> outgoingChangesInFlight;
+  QByteArray fileETag;
+  QByteArray serverETag;
+  QByteArray pendingWriteETag;
+  qint64 readTraceStart;
+  qint64 writeTraceStart;
+  qint64 readRequestStart;
+  qint64 writeRequestStart;
+  QDateTime pendingETagTimestamp;
+  int casRetries;
+  bool remoteDomainsHoldLocalState;
+  QStringList serverBlobsToFetch;
+  int blobTransfersPending;
+  int blobTransfersDone;
+  SyncDecoder syncDecoder;
+  bool coordinatedSync;
+  int syncPeersPending;
+  bool serverSyncedIncrementally;
+  QMutex peerResultMutex;
+  QMap<int, SyncDecoder::Result> peerResults;
+  QMap<int, QByteArray> peerETags;
+  QFuture<void> peerReadFuture;
+  QFuture<void> serverDecodeFuture;
+  bool backgroundSync;
+  QFileSystemWatcher syncFileWatcher;
+  QTimer syncFileSettleTimer;
+  SyncScheduler syncScheduler;
+  bool scheduledSync;
+  bool syncFailed;
+  bool syncChangedLocalData;
+  DomainSettingsList pendingVaultWrites;
+  QTimer vaultWriteTimer;
+  struct UnlockError {
+    UnlockError(void)
+      : decryptionFailed(false)
+      , errorType(0)
+    { /* ... */ }
+    bool decryptionFailed;
+    int errorType;
+    QString errorString;
+  };
+  // each decoding thread writes only its own fields
+  struct UnlockResult {
+    UnlockResult(void)
+      : hasSyncData(false)
+      , hasDomainData(false)
+      , vaultOpened(false)
+    { /* ... */ }
+    UnlockError syncSettingsError;
+    UnlockError domainDataError;
+    QString vaultError;
+    QString parseError;
+    bool hasSyncData;
+    QVariantMap syncData;
+    SecureByteArray syncDataKGK;
+    bool hasDomainData;
+    bool vaultOpened;
+    DomainIndex legacyDomains;
+    SecureByteArray domainDataKGK;
+  } unlockResult;
+  QAtomicInt unlockStagesPending;
+  bool unlockRepeatedPasswordEntry;
+  QFuture<void> unlockSyncSettingsFuture;
+  QFuture<void> unlockDomainDataFuture;
+  QElapsedTimer unlockClock;
+  QMutex unlockTimingMutex;
+  QList<QPair<QString, qint64> > unlockTimings;
+  qint64 timeToInteractiveMs;
   QCompleter *completer;
   QGraphicsOpacityEffect *pwdLabelOpacityEffect;
   int counter;
@@ -232,6 +372,12 @@ public:
   bool forceStart;
   QString lastAttachFileDir;
   QString lastSaveAttachmentDir;
+  QFuture<void> attachmentFuture;
+  QString attachmentDomain;
+  int attachmentsPending;
+  QFuture<void> blobSyncFuture;
+  PasswordChecker *passwordChecker;
+  VaultAuditor auditor;
 };
 
 
@@ -243,7 +389,7 @@ MainWindow::MainWindow(bool forceStart, QWidget *parent)
   Q_D(MainWindow);
 
   // Logger::instance().setFileName(QString("%1/%2.log").arg(QStandardPaths::writableLocation(QStandardPaths::DataLocation)).arg(AppName));
-  _LOG("MainWindow::MainWindow()");
+  _LOG_DEBUG("MainWindow::MainWindow()");
   d->forceStart = forceStart;
   const QString lockfilePath = QDir::homePath() + "/.qt-sesam.lck";
   d->lockFile = new QLockFile(lockfilePath);
@@ -305,6 +451,24 @@ MainWindow::MainWindow(bool forceStart, QWidget *parent)
   QObject::connect(d->optionsDialog, SIGNAL(masterPasswordInvalidationTimeMinsChanged(int)), SLOT(masterPasswordInvalidationTimeMinsChanged(int)));
   QObject::connect(this, SIGNAL(backupFilesDeleted(bool)), SLOT(onBackupFilesRemoved(bool)));
   QObject::connect(this, SIGNAL(backupFilesDeleted(int)), SLOT(onBackupFilesRemoved(int)));
+  QObject::connect(this, SIGNAL(attachmentProgress(qint64, qint64)), SLOT(onAttachmentProgress(qint64, qint64)));
+  QObject::connect(this, SIGNAL(wipeProgress(qint64, qint64)), SLOT(onWipeProgress(qint64, qint64)));
+  QObject::connect(this, SIGNAL(attachmentStored(QString, QVariantMap)), SLOT(onAttachmentStored(QString, QVariantMap)));
+  QObject::connect(this, SIGNAL(attachmentFailed(QString, QString)), SLOT(onAttachmentFailed(QString, QString)));
+  QObject::connect(this, SIGNAL(attachmentSaved(QString)), SLOT(onAttachmentSaved(QString)));
+  QObject::connect(this, SIGNAL(blobsSynced(int)), SLOT(onBlobsSynced(int)));
+  QObject::connect(this, SIGNAL(peerDecoded(int)), SLOT(onPeerDecoded(int)));
+  QObject::connect(this, SIGNAL(unlockStageFinished(int)), SLOT(onUnlockStageFinished(int)));
+  d->syncFileSettleTimer.setSingleShot(true);
+  d->syncFileSettleTimer.setInterval(SyncFileSettleMs);
+  QObject::connect(&d->syncFileSettleTimer, SIGNAL(timeout()), SLOT(onSyncFileSettled()));
+  QObject::connect(&d->syncFileWatcher, SIGNAL(fileChanged(QString)), SLOT(onSyncFileChanged(QString)));
+  QObject::connect(&d->syncFileWatcher, SIGNAL(directoryChanged(QString)), SLOT(onSyncFileChanged(QString)));
+  QObject::connect(&d->syncScheduler, SIGNAL(syncDue()), SLOT(onSyncDue()));
+  QObject::connect(&d->syncScheduler, SIGNAL(pendingChangesChanged()), SLOT(saveSyncQueue()));
+  d->vaultWriteTimer.setSingleShot(true);
+  d->vaultWriteTimer.setInterval(VaultWriteDelayMs);
+  QObject::connect(&d->vaultWriteTimer, SIGNAL(timeout()), SLOT(flushVaultWrites()));
   resetAllFields();
 
   QObject::connect(ui->domainsComboBox, SIGNAL(editTextChanged(QString)), SLOT(onDomainTextChanged(QString)));
@@ -348,6 +512,7 @@ MainWindow::MainWindow(bool forceStart, QWidget *parent)
   QObject::connect(ui->actionExportAllDomainSettingsAsJSON, SIGNAL(triggered(bool)), SLOT(onExportAllDomainSettingAsJSON()));
   QObject::connect(ui->actionExportAllLoginDataAsClearText, SIGNAL(triggered(bool)), SLOT(onExportAllLoginDataAsClearText()));
   QObject::connect(ui->actionExportCurrentSettingsAsQRCode, SIGNAL(triggered(bool)), SLOT(onExportCurrentSettingsAsQRCode()));
+  QObject::connect(ui->actionExportQRCodeSheets, SIGNAL(triggered(bool)), SLOT(onExportQRCodeSheets()));
   QObject::connect(ui->actionExportKGK, SIGNAL(triggered(bool)), SLOT(onExportKGK()));
   QObject::connect(ui->actionImportKGK, SIGNAL(triggered(bool)), SLOT(onImportKGK()));
   QObject::connect(ui->actionKeePassXmlFile, SIGNAL(triggered(bool)), SLOT(onImportKeePass2XmlFile()));
@@ -357,6 +522,8 @@ MainWindow::MainWindow(bool forceStart, QWidget *parent)
   QObject::connect(d->masterPasswordDialog, SIGNAL(closing()), SLOT(onMasterPasswordClosing()), Qt::DirectConnection);
   QObject::connect(d->countdownWidget, SIGNAL(timeout()), SLOT(lockApplication()));
   QObject::connect(ui->actionChangeMasterPassword, SIGNAL(triggered(bool)), SLOT(changeMasterPassword()));
+  QObject::connect(ui->actionAuditVault, SIGNAL(triggered(bool)), SLOT(onAuditVault()));
+  QObject::connect(ui->actionRestoreBackup, SIGNAL(triggered(bool)), SLOT(onRestoreBackup()));
   QObject::connect(ui->actionDeleteOldBackupFiles, SIGNAL(triggered(bool)), SLOT(removeOutdatedBackupFiles()));
 #if HACKING_MODE_ENABLED
   QObject::connect(ui->actionHackLegacyPassword, SIGNAL(triggered(bool)), SLOT(hackLegacyPassword()));
@@ -379,6 +546,8 @@ MainWindow::MainWindow(bool forceStart, QWidget *parent)
   QObject::connect(&d->readNAM, SIGNAL(sslErrors(QNetworkReply*,QList<QSslError>)), SLOT(sslErrorsOccured(QNetworkReply*,QList<QSslError>)));
   QObject::connect(&d->writeNAM, SIGNAL(finished(QNetworkReply*)), SLOT(onWriteFinished(QNetworkReply*)));
   QObject::connect(&d->writeNAM, SIGNAL(sslErrors(QNetworkReply*,QList<QSslError>)), SLOT(sslErrorsOccured(QNetworkReply*,QList<QSslError>)));
+  QObject::connect(&d->blobNAM, SIGNAL(finished(QNetworkReply*)), SLOT(onBlobReplyFinished(QNetworkReply*)));
+  QObject::connect(&d->blobNAM, SIGNAL(sslErrors(QNetworkReply*,QList<QSslError>)), SLOT(sslErrorsOccured(QNetworkReply*,QList<QSslError>)));
 
   ui->attachmentTableWidget->installEventFilter(this);
   ui->attachmentTableWidget->setColumnCount(2);
@@ -487,7 +656,7 @@ QSize MainWindow::minimumSizeHint(void) const
 void MainWindow::prepareExit(void)
 {
   Q_D(MainWindow);
-  _LOG("MainWindow::prepareExit()");
+  _LOG_DEBUG("MainWindow::prepareExit()");
   d->trayIcon.hide();
   d->optionsDialog->close();
   d->changeMasterPasswordDialog->close();
@@ -599,6 +768,7 @@ void MainWindow::resetAllFieldsExceptDomainComboBox(void)
   ui->iterationsSpinBox->blockSignals(true);
   ui->iterationsSpinBox->setValue(d->optionsDialog->defaultIterations());
   ui->iterationsSpinBox->blockSignals(false);
+  ui->easySelectorWidget->setIterations(ui->iterationsSpinBox->value());
 
   ui->notesPlainTextEdit->blockSignals(true);
   ui->notesPlainTextEdit->setPlainText(QString());
@@ -807,8 +977,9 @@ void MainWindow::onPasswordLengthChanged(int len)
 }
 
 
-void MainWindow::onIterationsChanged(int)
+void MainWindow::onIterationsChanged(int iterations)
 {
+  ui->easySelectorWidget->setIterations(iterations);
   setDirty(true);
   updatePassword();
 }
@@ -1018,6 +1189,7 @@ void MainWindow::changeMasterPassword(void)
       d->masterPassword = d->changeMasterPasswordDialog->newPassword();
       d->keyGenerationFuture.waitForFinished();
       generateSaltKeyIV().waitForFinished();
+      d->vault.rekey(d->masterKey, d->IV, d->salt);
       cleanupAfterMasterPasswordChanged();
     }
   }
@@ -1044,6 +1216,7 @@ void MainWindow::nextChangeMasterPasswordStep(void)
     d->progressDialog->setValue(2);
     d->masterPassword = d->changeMasterPasswordDialog->newPassword();
     generateSaltKeyIV().waitForFinished();
+    d->vault.rekey(d->masterKey, d->IV, d->salt);
     d->progressDialog->setText(tr("Writing to sync peers ..."));
     if (d->optionsDialog->useSyncFile()) {
       writeToRemote(SyncPeerFile);
@@ -1170,12 +1343,21 @@ void MainWindow::onServerCertificatesUpdated(const QList<QSslCertificate> &certs
 void MainWindow::showOptionsDialog(void)
 {
   Q_D(MainWindow);
+  int domainCount = 0;
+  foreach (DomainIndex::Entry e, localDomainIndex()) {
+    if (!e.deleted)
+      ++domainCount;
+  }
+  METRIC_GAUGE("domains.count").set(domainCount);
+  METRIC_GAUGE("attachments.bytes_on_disk").set(d->blobStore.bytesOnDisk());
   d->interactionSemaphore.acquire();
   const int button = d->optionsDialog->exec();
   d->interactionSemaphore.release();
   if (button == QDialog::Accepted) {
     saveSyncDataToSettings();
     saveUiSettings();
+    watchSyncFile();
+    updateSyncScheduler();
   }
 }
 
@@ -1184,7 +1366,7 @@ QFuture<void> &MainWindow::generateSaltKeyIV(void)
 {
   Q_D(MainWindow);
   // qDebug() << "MainWindow::generateSaltKeyIV()";
-  _LOG("MainWindow::generateSaltKeyIV() ...");
+  _LOG_DEBUG("MainWindow::generateSaltKeyIV() ...");
   d->keyGenerationFuture = QtConcurrent::run(this, &MainWindow::generateSaltKeyIVThread);
   return d->keyGenerationFuture;
 }
@@ -1193,14 +1375,20 @@ QFuture<void> &MainWindow::generateSaltKeyIV(void)
 void MainWindow::generateSaltKeyIVThread(void)
 {
   Q_D(MainWindow);
+  TRACE_SPAN("unlock", "MainWindow::generateSaltKeyIVThread");
   Q_ASSERT_X(!d->masterPassword.isEmpty(), "MainWindow::generateSaltKeyIVThread()", "d->masterPassword must not be empty");
   if (d->masterPassword.isEmpty()) {
     qWarning() << "Error in  MainWindow::generateSaltKeyIVThread(): d->masterPassword must not be empty";
     return;
   }
   QMutexLocker(&d->keyGenerationMutex);
+  QElapsedTimer t;
+  t.start();
   d->salt = Crypter::generateSalt();
   Crypter::makeKeyAndIVFromPassword(d->masterPassword.toUtf8(), d->salt, d->masterKey, d->IV);
+  if ((d->unlockStagesPending.load() & UnlockKey) != 0) {
+    recordUnlockStage("generate key", t.elapsed());
+  }
   emit saltKeyIVGenerated();
 }
 
@@ -1208,7 +1396,11 @@ void MainWindow::generateSaltKeyIVThread(void)
 void MainWindow::onGeneratedSaltKeyIV(void)
 {
   Q_D(MainWindow);
-  _LOG("MainWindow::onGeneratedSaltKeyIV()");
+  _LOG_DEBUG("MainWindow::onGeneratedSaltKeyIV()");
+  if ((d->unlockStagesPending.load() & UnlockKey) != 0) {
+    onUnlockStageFinished(UnlockKey);
+    return;
+  }
   ui->statusBar->showMessage(tr("Auto-generated new salt (%1) and key.").arg(QString::fromLatin1(d->salt.mid(0, 4).toHex())), 2000);
 }
 
@@ -1252,6 +1444,7 @@ void MainWindow::onImportKGK(void)
       SecureByteArray kgk = Exporter(kgkFilename).read(d->masterPassword.toUtf8());
       if (kgk.size() == Crypter::KGKSize) {
         d->KGK = kgk;
+        resetLastSeenETags();
         QMessageBox::information(this,
                                  tr("KGK imported"),
                                  tr("KGK successfully imported. Your generated passwords may have changed. "
@@ -1328,8 +1521,9 @@ void MainWindow::onImportKeePass2XmlFile(void)
         renamed.append(qMakePair(ds.domainName, newDomainName));
       ds.domainName = newDomainName;
       d->domains.append(ds);
+      addOutgoingChange(ds.domainName);
     }
-    DomainSettings currentDomainSettings = d->domains.at(ui->domainsComboBox->currentText());
+    DomainSettings currentDomainSettings = domainSettings(ui->domainsComboBox->currentText());
     makeDomainComboBox();
     if (!currentDomainSettings.isEmpty()) {
       copyDomainSettingsToGUI(currentDomainSettings);
@@ -1393,8 +1587,9 @@ void MainWindow::onImportPasswordSafeFile(void)
         renamed.append(qMakePair(ds.domainName, newDomainName));
       ds.domainName = newDomainName;
       d->domains.append(ds);
+      addOutgoingChange(ds.domainName);
     }
-    DomainSettings currentDomainSettings = d->domains.at(ui->domainsComboBox->currentText());
+    DomainSettings currentDomainSettings = domainSettings(ui->domainsComboBox->currentText());
     saveAllDomainDataToSettings();
     makeDomainComboBox();
     if (!currentDomainSettings.isEmpty()) {
@@ -1469,6 +1664,7 @@ void MainWindow::copyDomainSettingsToGUI(DomainSettings ds)
   ui->iterationsSpinBox->blockSignals(true);
   ui->iterationsSpinBox->setValue(ds.iterations);
   ui->iterationsSpinBox->blockSignals(false);
+  ui->easySelectorWidget->setIterations(ds.iterations);
   setAttachments(ds.files);
   ui->createdLabel->setText(ds.createdDate.toString(Qt::ISODate));
   ui->modifiedLabel->setText(ds.modifiedDate.toString(Qt::ISODate));
@@ -1523,7 +1719,64 @@ void MainWindow::copyDomainSettingsToGUI(const QString &domain)
 {
   Q_D(MainWindow);
   // qDebug() << "MainWindow::copyDomainSettingsToGUI(" << domain << ")";
-  copyDomainSettingsToGUI(d->domains.at(domain));
+  copyDomainSettingsToGUI(domainSettings(domain));
+}
+
+
+DomainSettings MainWindow::domainSettings(const QString &domainName)
+{
+  Q_D(MainWindow);
+  DomainSettings ds = d->domains.at(domainName);
+  if (ds.isEmpty()) {
+    METRIC_COUNTER("domains.cache.misses").add();
+    if (d->vault.contains(domainName)) {
+      try {
+        ds = d->vault.read(domainName);
+      }
+      catch (CryptoPP::Exception &e) {
+        _LOG_ERROR(QString("ERROR in MainWindow::domainSettings(): %1").arg(e.what()));
+      }
+    }
+    else if (d->legacyDomains.contains(domainName)) {
+      ds = d->legacyDomains.decode(domainName);
+    }
+    if (!ds.isEmpty()) {
+      d->domains.append(ds);
+    }
+  }
+  else {
+    METRIC_COUNTER("domains.cache.hits").add();
+  }
+  return ds;
+}
+
+
+void MainWindow::loadAllDomainSettings(void)
+{
+  Q_D(MainWindow);
+  const QSet<QString> &loaded = d->domains.keys().toSet();
+  foreach (QString domainName, d->vault.keys() + d->legacyDomains.keys()) {
+    if (!loaded.contains(domainName)) {
+      domainSettings(domainName);
+    }
+  }
+}
+
+
+QMap<QString, DomainIndex::Entry> MainWindow::localDomainIndex(void) const
+{
+  Q_D(const MainWindow);
+  QMap<QString, DomainIndex::Entry> local;
+  foreach (DomainIndex::Entry e, d->legacyDomains.entries()) {
+    local.insert(e.domainName, e);
+  }
+  foreach (Vault::IndexEntry e, d->vault.index()) {
+    local.insert(e.domainName, e);
+  }
+  foreach (DomainSettings ds, d->domains) {
+    local.insert(ds.domainName, DomainIndex::Entry::fromDomainSettings(ds));
+  }
+  return local;
 }
 
 
@@ -1534,9 +1787,9 @@ void MainWindow::makeDomainComboBox(void)
   ui->domainsComboBox->blockSignals(true);
   ui->domainsComboBox->clear();
   QStringList domainNames;
-  foreach(DomainSettings ds, d->domains) {
-    if (!ds.deleted) {
-      domainNames.append(ds.domainName);
+  foreach (DomainIndex::Entry e, localDomainIndex()) {
+    if (!e.deleted) {
+      domainNames.append(e.domainName);
     }
   }
   domainNames.sort(Qt::CaseInsensitive);
@@ -1579,16 +1832,84 @@ void MainWindow::saveDomainSettings(DomainSettings ds)
       domainList.append(ds.domainName);
     }
   }
+  externalizeAttachments(ds);
   d->domains.updateWith(ds);
   makeDomainComboBox();
   ui->domainsComboBox->blockSignals(true);
   ui->domainsComboBox->setCurrentText(currentDomain);
   ui->domainsComboBox->blockSignals(false);
-  saveAllDomainDataToSettings();
+  queueVaultWrite(ds);
+  addOutgoingChange(ds.domainName);
+  d->syncScheduler.addPendingChange(SyncPatch::entryId(d->kgk(), ds.domainName));
   setDirty(false);
 }
 
 
+/*!
+ * \brief MainWindow::queueVaultWrite
+ *
+ * Saves arriving in quick succession, e.g. while importing or bulk editing,
+ * are collected and written to the vault in a single commit.
+ * The timer isn't restarted by further saves, so a save is never delayed
+ * by more than `VaultWriteDelayMs`.
+ */
+void MainWindow::queueVaultWrite(const DomainSettings &ds)
+{
+  Q_D(MainWindow);
+  d->pendingVaultWrites.updateWith(ds);
+  if (!d->vaultWriteTimer.isActive()) {
+    d->vaultWriteTimer.start();
+  }
+}
+
+
+/*!
+ * \brief MainWindow::flushVaultWrites
+ *
+ * Writes all queued domain settings to the vault. The vault syncs the batch
+ * to disk before it returns, so a save is confirmed to the user only after
+ * it has become durable.
+ */
+void MainWindow::flushVaultWrites(void)
+{
+  Q_D(MainWindow);
+  d->vaultWriteTimer.stop();
+  if (d->pendingVaultWrites.isEmpty())
+    return;
+  if (!d->vault.isOpen() || d->vault.KGK() != d->kgk()) {
+    // d->domains already contains the queued settings
+    saveAllDomainDataToSettings();
+    ui->statusBar->showMessage(tr("Domain settings saved."), 3000);
+    return;
+  }
+  // the batch is kept until it's been written, so that the next flush tries again
+  const DomainSettingsList batch = d->pendingVaultWrites;
+  bool ok = false;
+  QString errorString;
+  try {
+    ok = d->vault.write(batch);
+    errorString = d->vault.errorString();
+  }
+  catch (CryptoPP::Exception &e) {
+    _LOG_ERROR(QString("ERROR in MainWindow::flushVaultWrites(): %1").arg(e.what()));
+    errorString = QString::fromUtf8(e.what());
+  }
+  if (!ok) {
+    QMessageBox::warning(this, tr("Vault write error"), tr("Writing to your vault file %1 failed: %2")
+                         .arg(d->vault.fileName())
+                         .arg(errorString), QMessageBox::Ok);
+    return;
+  }
+  d->pendingVaultWrites.clear();
+  ui->statusBar->showMessage(batch.count() == 1
+                             ? tr("Domain settings saved.")
+                             : tr("%1 domain settings saved.").arg(batch.count()), 3000);
+  if (d->masterPasswordChangeStep == 0 && d->optionsDialog->writeBackups()) {
+    writeBackupFile();
+  }
+}
+
+
 void MainWindow::saveCurrentDomainSettings(void)
 {
   Q_D(MainWindow);
@@ -1601,7 +1922,6 @@ void MainWindow::saveCurrentDomainSettings(void)
     if (ds.deleted) {
       resetAllFields();
     }
-    ui->statusBar->showMessage(tr("Domain settings saved."), 3000);
     d->lastCleanDomainSettings = ds;
   }
 }
@@ -1626,56 +1946,39 @@ void MainWindow::onLegacyPasswordChanged(QString legacyPassword)
 bool MainWindow::wipeFile(const QString &filename)
 {
   Q_D(MainWindow);
-  QFile f(filename);
-  bool ok = f.open(QIODevice::ReadWrite | QIODevice::Unbuffered);
-  const int N = f.size();
-  if (ok) {
-    if (d->optionsDialog->extensiveWipeout()) {
-      static const int NumSinglePatterns = 16;
-      static const unsigned char SinglePatterns[NumSinglePatterns] = {
-        0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
-        0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff
-      };
-      for (int i = 0; i < NumSinglePatterns; ++i) {
-        char b = SinglePatterns[i];
-        f.seek(0);
-        for (int j = 0; j < N; ++j) {
-          f.write(&b, 1);
-        }
-        f.flush();
-      }
-      static const int NumTriplets = 6;
-      static const unsigned char Triplets[NumTriplets][3] = {
-        { 0x92, 0x49, 0x24 }, { 0x49, 0x24, 0x92 }, { 0x24, 0x92, 0x49 },
-        { 0x6d, 0xb6, 0xdb }, { 0xb6, 0xdb, 0x6d }, { 0xdb, 0x6d, 0xb6 }
-      };
-      for (int i = 0; i < NumTriplets; ++i) {
-        const char *b = reinterpret_cast<const char*>(&Triplets[i][0]);
-        f.seek(0);
-        for (int j = 0; j < N / 3; ++j) {
-          f.write(b, 3);
-        }
-        f.flush();
-      }
-    }
-    f.seek(0);
-    const qint64 bytesWritten = f.write(Crypter::randomBytes(N));
-    ok = (bytesWritten == N);
-    f.close();
-    if (ok) {
-      ok = f.remove();
-    }
-  }
-  return ok;
+  FileWiper wiper;
+  wiper.setExtensive(d->optionsDialog->extensiveWipeout());
+  return wiper.wipeFile(filename);
+}
+
+
+/*!
+ * \brief MainWindow::wipeFiles
+ *
+ * Wipes several files in parallel, reporting the progress via `wipeProgress()`.
+ *
+ * \return number of files wiped
+ */
+int MainWindow::wipeFiles(const QStringList &filenames)
+{
+  Q_D(MainWindow);
+  if (filenames.isEmpty())
+    return 0;
+  FileWiper wiper;
+  wiper.setExtensive(d->optionsDialog->extensiveWipeout());
+  QObject::connect(&wiper, SIGNAL(progress(qint64, qint64)), this, SIGNAL(wipeProgress(qint64, qint64)), Qt::DirectConnection);
+  return filenames.size() - wiper.wipeFiles(filenames).size();
 }
 
 
 void MainWindow::cleanupAfterMasterPasswordChanged(void)
 {
+  Q_D(MainWindow);
   static const QStringList BackupFilenameFilters = { QString("*-%1-backup.txt").arg(AppName) };
   const QString &backupFilePath = QStandardPaths::writableLocation(QStandardPaths::DataLocation);
   const QStringList backupFileNames = QDir(backupFilePath).entryList(BackupFilenameFilters, QDir::Files | QDir::CaseSensitive, QDir::NoSort);
-  if (!backupFileNames.isEmpty()) {
+  const int nBackups = backupFileNames.size() + d->backupStore.snapshots().size();
+  if (nBackups > 0) {
     int rc = QMessageBox::question(this,
                                    tr("Delete backup files?"),
                                    tr("You've changed your master password. "
@@ -1684,39 +1987,63 @@ void MainWindow::cleanupAfterMasterPasswordChanged(void)
                                       "I found %1 backup file(s) in %2. "
                                       "Do you want me to securely delete them "
                                       "and write a new backup file with the current settings?")
-                                   .arg(backupFileNames.size())
+                                   .arg(nBackups)
                                    .arg(backupFilePath));
     if (rc == QMessageBox::Yes) {
-      removeOutdatedBackupFiles();
+      d->backupFileDeletionFuture.waitForFinished();
+      d->backupFileDeletionFuture = QtConcurrent::run(this, &MainWindow::removeOutdatedBackupFilesThread, true);
     }
   }
 }
 
 
-void MainWindow::removeOutdatedBackupFilesThread(void)
+/*!
+ * \brief MainWindow::removeOutdatedBackupFilesThread
+ *
+ * Wipes backup files written by older versions of the application that exceed the
+ * configured age and prunes the snapshot store down to the configured age and count.
+ * If `all` is `true` every backup is wiped regardless of its age, e.g. after the
+ * master password has been changed.
+ */
+void MainWindow::removeOutdatedBackupFilesThread(bool all)
 {
   Q_D(MainWindow);
   const QString &backupFilePath = QStandardPaths::writableLocation(QStandardPaths::DataLocation);
   const QStringList backupFileNames = QDir(backupFilePath).entryList(BackupFilenameFilters, QDir::Files | QDir::CaseSensitive, QDir::NoSort);
-  bool allRemoved = true;
+  QStringList outdatedFileNames;
   if (!backupFileNames.isEmpty()) {
     static const QRegExp reBackupFileTimestamp("^\\d{8}T\\d{6}");
     const QDateTime TooOld = QDateTime::currentDateTime().addDays(-d->optionsDialog->maxBackupFileAge());
-    int nFilesRemoved = 0;
     foreach (QString backupFilename, backupFileNames) {
       if (reBackupFileTimestamp.indexIn(backupFilename) == 0) {
         const QDateTime fileTimestamp = QDateTime::fromString(reBackupFileTimestamp.cap(0), "yyyyMMddThhmmss");
-        if (fileTimestamp < TooOld) {
-          if (wipeFile(backupFilePath + QDir::separator() + backupFilename)) {
-            emit backupFilesDeleted(++nFilesRemoved);
-          }
-          else {
-            allRemoved = false;
-          }
+        if (all || fileTimestamp < TooOld) {
+          outdatedFileNames << backupFilePath + QDir::separator() + backupFilename;
         }
       }
     }
   }
+  const int nFilesRemoved = wipeFiles(outdatedFileNames);
+  bool allRemoved = (nFilesRemoved == outdatedFileNames.size());
+  if (nFilesRemoved > 0) {
+    emit backupFilesDeleted(nFilesRemoved);
+  }
+  if (all) {
+    const int nSnapshots = d->backupStore.snapshots().size();
+    const QStringList &storeFileNames = d->backupStore.files();
+    allRemoved &= (wipeFiles(storeFileNames) == storeFileNames.size());
+    QDir(d->backupStore.path()).removeRecursively();
+    d->backupStore.setPath(d->backupStore.path());
+    if (nSnapshots > 0) {
+      emit backupFilesDeleted(nFilesRemoved + nSnapshots);
+    }
+  }
+  else {
+    const int nSnapshotsRemoved = d->backupStore.prune(d->optionsDialog->maxBackupFileAge(), d->optionsDialog->maxBackupCount());
+    if (nSnapshotsRemoved > 0) {
+      emit backupFilesDeleted(nFilesRemoved + nSnapshotsRemoved);
+    }
+  }
   emit backupFilesDeleted(allRemoved);
 }
 
@@ -1726,8 +2053,8 @@ void MainWindow::removeOutdatedBackupFiles(void)
   Q_D(MainWindow);
   const QString &backupFilePath = QStandardPaths::writableLocation(QStandardPaths::DataLocation);
   const QStringList backupFileNames = QDir(backupFilePath).entryList(BackupFilenameFilters, QDir::Files | QDir::CaseSensitive, QDir::NoSort);
-  if (!backupFileNames.isEmpty()) {
-    d->backupFileDeletionFuture = QtConcurrent::run(this, &MainWindow::removeOutdatedBackupFilesThread);
+  if (!backupFileNames.isEmpty() || !d->backupStore.snapshots().isEmpty()) {
+    d->backupFileDeletionFuture = QtConcurrent::run(this, &MainWindow::removeOutdatedBackupFilesThread, false);
   }
   else {
     ui->statusBar->showMessage(tr("There are no backup files present in %1.")
@@ -1764,52 +2091,181 @@ void MainWindow::onBackupFilesRemoved(int n)
   ui->statusBar->showMessage(tr("Deleted %1 outdated backup files.").arg(n), 3000);
 }
 
+
+void MainWindow::onWipeProgress(qint64 bytesDone, qint64 bytesTotal)
+{
+  if (bytesTotal > 0) {
+    ui->statusBar->showMessage(tr("Wiping backup files ... %1%").arg(100 * bytesDone / bytesTotal), 3000);
+  }
+}
+
+
+/*!
+ * \brief MainWindow::writeBackupFile
+ *
+ * Adds a snapshot of the settings and the vault to the backup store. Only chunks
+ * not already contained in earlier snapshots get written, so a backup after
+ * editing a single domain costs a few kilobytes instead of a full copy.
+ */
 void MainWindow::writeBackupFile(void)
 {
   Q_D(MainWindow);
-  const QString &backupFilePath = QStandardPaths::writableLocation(QStandardPaths::DataLocation);
-  const QString &backupFilename = QString("%1/%2-%3-backup.txt")
-      .arg(backupFilePath)
-      .arg(QDateTime::currentDateTime().toString("yyyyMMddThhmmss"))
-      .arg(AppName);
-  if (QDir().mkpath(backupFilePath)) {
-    _LOG(QString("Writing backup of settings to %1 ...").arg(backupFilename));
-    QSettings backupSettings(backupFilename, QSettings::IniFormat);
-    foreach (QString key, d->settings.allKeys()) {
-      backupSettings.setValue(key, d->settings.value(key));
+  QVariantMap settings;
+  foreach (QString key, d->settings.allKeys()) {
+    settings[key] = d->settings.value(key);
+  }
+  QByteArray baSettings;
+  QDataStream(&baSettings, QIODevice::WriteOnly) << settings;
+  QVariantMap files;
+  files["settings"] = baSettings;
+  QFile vaultFile(d->vault.fileName());
+  if (vaultFile.open(QIODevice::ReadOnly)) {
+    files["vault"] = vaultFile.readAll();
+    vaultFile.close();
+  }
+  QString id;
+  {
+    QMutexLocker locker(&d->keyGenerationMutex);
+    d->keyGenerationFuture.waitForFinished();
+    if (!validCredentials()) {
+      _LOG_ERROR("ERROR in MainWindow::writeBackupFile(): invalid credentials");
+      return;
+    }
+    try {
+      id = d->backupStore.write(d->masterKey, d->IV, d->salt, d->kgk(), files);
+    }
+    catch (CryptoPP::Exception &e) {
+      _LOG_ERROR(QString("ERROR in MainWindow::writeBackupFile(): %1").arg(e.what()));
+      return;
+    }
+  }
+  if (id.isEmpty()) {
+    _LOG_ERROR(QString("ERROR in MainWindow::writeBackupFile(): %1").arg(d->backupStore.errorString()));
+    return;
+  }
+  _LOG(QString("Backup %1 written to %2 (%3 new bytes)").arg(id).arg(d->backupStore.path()).arg(d->backupStore.lastWriteNewBytes()));
+  if (d->optionsDialog->autoDeleteBackupFiles()) {
+    d->backupStore.prune(d->optionsDialog->maxBackupFileAge(), d->optionsDialog->maxBackupCount());
+  }
+}
+
+
+void MainWindow::onRestoreBackup(void)
+{
+  Q_D(MainWindow);
+  const QList<BackupStore::Snapshot> &snapshots = d->backupStore.snapshots();
+  if (snapshots.isEmpty()) {
+    ui->statusBar->showMessage(tr("There are no backups to restore."), 5000);
+    return;
+  }
+  QStringList items;
+  for (int i = snapshots.size() - 1; i >= 0; --i) {
+    items << snapshots.at(i).created.toLocalTime().toString(Qt::DefaultLocaleLongDate);
+  }
+  bool ok = false;
+  d->interactionSemaphore.acquire();
+  const QString &item = QInputDialog::getItem(this, tr("Restore backup"), tr("Select the backup to restore:"), items, 0, false, &ok);
+  d->interactionSemaphore.release();
+  if (!ok || items.indexOf(item) < 0)
+    return;
+  const BackupStore::Snapshot &snapshot = snapshots.at(snapshots.size() - 1 - items.indexOf(item));
+  int button = QMessageBox::warning(this,
+                                    tr("Really restore backup?"),
+                                    tr("Restoring the backup of %1 replaces all of your current settings and domain data. "
+                                       "A backup of the current state will be written beforehand. "
+                                       "%2 will restart afterwards. Continue?")
+                                    .arg(item)
+                                    .arg(AppName),
+                                    QMessageBox::Yes | QMessageBox::No,
+                                    QMessageBox::No);
+  if (button != QMessageBox::Yes)
+    return;
+  flushVaultWrites();
+  writeBackupFile();
+  QVariantMap files;
+  try {
+    files = d->backupStore.read(snapshot.id, d->masterPassword.toUtf8());
+  }
+  catch (CryptoPP::Exception &e) {
+    QMessageBox::critical(this,
+                          tr("Restore failed"),
+                          tr("The backup cannot be decrypted (%1). "
+                             "It may have been written before your master password was changed.")
+                          .arg(e.what()));
+    return;
+  }
+  if (files.isEmpty()) {
+    QMessageBox::critical(this, tr("Restore failed"), tr("The backup cannot be read: %1").arg(d->backupStore.errorString()));
+    return;
+  }
+  QVariantMap settings;
+  QDataStream(files["settings"].toByteArray()) >> settings;
+  d->vault.close();
+  if (files.contains("vault")) {
+    const QByteArray &vaultData = files["vault"].toByteArray();
+    QSaveFile vaultFile(d->vault.fileName());
+    if (!vaultFile.open(QIODevice::WriteOnly) || vaultFile.write(vaultData) != vaultData.size() || !vaultFile.commit()) {
+      QMessageBox::critical(this, tr("Restore failed"), tr("The vault cannot be written: %1").arg(vaultFile.errorString()));
+      return;
     }
-    backupSettings.sync();
   }
+  d->settings.clear();
+  for (QVariantMap::const_iterator kv = settings.constBegin(); kv != settings.constEnd(); ++kv) {
+    d->settings.setValue(kv.key(), kv.value());
+  }
+  d->settings.sync();
+  _LOG(QString("Backup %1 restored. Restarting ...").arg(snapshot.id));
+  d->domains.clear();
+  d->pendingVaultWrites.clear();
+  d->vaultWriteTimer.stop();
+  d->lockFile->unlock();
+  qApp->exit(EXIT_CODE_RESTART_APP);
 }
 
 
 void MainWindow::saveAllDomainDataToSettings(void)
 {
   Q_D(MainWindow);
+  METRIC_TIMER("settings.save_all_us");
   // qDebug() << "MainWindow::saveAllDomainDataToSettings()";
   if (!d->masterKey.isEmpty()) {
-    QByteArray cipher;
+    bool ok = false;
     {
       QMutexLocker locker(&d->keyGenerationMutex);
       try {
         d->keyGenerationFuture.waitForFinished();
         if (validCredentials()) {
-          cipher = Crypter::encode(d->masterKey, d->IV, d->salt, d->kgk(), d->domains.toJson(), CompressionEnabled);
+          if (d->vault.isOpen() && d->vault.KGK() == d->kgk()) {
+            ok = d->vault.write(d->domains) && d->vault.rekey(d->masterKey, d->IV, d->salt);
+          }
+          else {
+            loadAllDomainSettings();
+            ok = d->vault.create(d->masterKey, d->IV, d->salt, d->kgk(), d->domains);
+            if (ok) {
+              d->legacyDomains.clear();
+            }
+          }
+          if (!ok) {
+            _LOG_ERROR(QString("ERROR in MainWindow::saveAllDomainDataToSettings(): %1").arg(d->vault.errorString()));
+          }
         }
         else {
-          _LOG(QString("ERROR in MainWindow::saveAllDomainDataToSettings(): invalid credentials"));
+          _LOG_ERROR(QString("ERROR in MainWindow::saveAllDomainDataToSettings(): invalid credentials"));
         }
       }
       catch (CryptoPP::Exception &e) {
         qErrnoWarning((int)e.GetErrorType(), e.what());
-        _LOG(QString("ERROR in MainWindow::saveAllDomainDataToSettings(): %1").arg(e.what()));
+        _LOG_ERROR(QString("ERROR in MainWindow::saveAllDomainDataToSettings(): %1").arg(e.what()));
         return;
       }
     }
-    if (!cipher.isEmpty()) {
-      const QString &b64DomainData = QString::fromUtf8(cipher.toBase64());
-      d->settings.setValue("sync/domains", b64DomainData);
-      d->settings.sync();
+    if (ok) {
+      d->pendingVaultWrites.clear();
+      d->vaultWriteTimer.stop();
+      if (d->settings.contains("sync/domains")) {
+        d->settings.remove("sync/domains");
+        d->settings.sync();
+      }
       if (d->masterPasswordChangeStep == 0) {
         if (d->optionsDialog->writeBackups()) {
           writeBackupFile();
@@ -1819,41 +2275,102 @@ void MainWindow::saveAllDomainDataToSettings(void)
     }
   }
   else {
-    _LOG("ERROR in MainWindow::saveAllDomainDataToSettings(): d->masterKey must not empty");
+    _LOG_ERROR("ERROR in MainWindow::saveAllDomainDataToSettings(): d->masterKey must not empty");
   }
 }
 
 
-bool MainWindow::restoreDomainDataFromSettings(void)
+/*!
+ * \brief MainWindow::decodeDomainDataThread
+ *
+ * Opens the vault or, if there is none yet, decrypts and parses the domain
+ * settings stored by older versions. Runs in parallel to the decryption of
+ * the sync settings and the generation of a fresh key.
+ */
+void MainWindow::decodeDomainDataThread(const SecureByteArray &masterPassword, const QByteArray &legacyCipher)
 {
   Q_D(MainWindow);
-  Q_ASSERT_X(!d->masterPassword.isEmpty(), "MainWindow::restoreDomainDataFromSettings()", "d->masterPassword must not be empty");
-  QJsonDocument json;
-  QStringList domainList;
-  const QByteArray &domains = QByteArray::fromBase64(d->settings.value("sync/domains").toByteArray());
-  if (!domains.isEmpty()) {
+  TRACE_SPAN("unlock", "MainWindow::decodeDomainDataThread");
+  MainWindowPrivate::UnlockResult &r = d->unlockResult;
+  MainWindowPrivate::UnlockError &error = r.domainDataError;
+  QElapsedTimer t;
+  t.start();
+  if (d->vault.exists()) {
+    try {
+      r.vaultOpened = d->vault.open(masterPassword);
+      if (!r.vaultOpened) {
+        r.vaultError = d->vault.errorString();
+      }
+    }
+    catch (CryptoPP::Exception &e) {
+      error.decryptionFailed = true;
+      error.errorType = (int)e.GetErrorType();
+      error.errorString = e.what();
+    }
+    recordUnlockStage("open vault", t.elapsed());
+  }
+  else if (!legacyCipher.isEmpty()) {
     QByteArray recovered;
     try {
-      recovered = Crypter::decode(d->masterPassword.toUtf8(), domains, CompressionEnabled, d->KGK);
+      recovered = Crypter::decode(masterPassword, legacyCipher, CompressionEnabled, r.domainDataKGK);
+      r.hasDomainData = true;
     }
     catch (CryptoPP::Exception &e) {
-      wrongPasswordWarning((int)e.GetErrorType(), e.what());
-      return false;
+      error.decryptionFailed = true;
+      error.errorType = (int)e.GetErrorType();
+      error.errorString = e.what();
     }
-    QJsonParseError parseError;
-    json = QJsonDocument::fromJson(recovered, &parseError);
-    if (parseError.error == QJsonParseError::NoError) {
-      domainList = json.object().keys();
-      ui->statusBar->showMessage(tr("Password accepted. Restored %1 domains.")
-                                 .arg(domainList.count()), 5000);
+    recordUnlockStage("decrypt domains", t.restart());
+    if (r.hasDomainData) {
+      QJsonParseError parseError;
+      const QJsonDocument &json = QJsonDocument::fromJson(recovered, &parseError);
+      if (parseError.error == QJsonParseError::NoError) {
+        r.legacyDomains = DomainIndex::fromQJsonDocument(json);
+      }
+      else {
+        r.parseError = parseError.errorString();
+      }
+      recordUnlockStage("parse domains", t.elapsed());
     }
-    else {
-      QMessageBox::warning(this, tr("Bad data from sync server"),
-                           tr("Decoding the data from the sync server failed: %1")
-                           .arg(parseError.errorString()), QMessageBox::Ok);
+  }
+  emit unlockStageFinished(UnlockDomainData);
+}
+
+
+bool MainWindow::applyDomainData(void)
+{
+  Q_D(MainWindow);
+  const MainWindowPrivate::UnlockResult &r = d->unlockResult;
+  if (d->vault.exists()) {
+    if (!r.vaultOpened) {
+      QMessageBox::warning(this, tr("Vault read error"),
+                           tr("Your vault file %1 cannot be opened: %2")
+                           .arg(d->vault.fileName())
+                           .arg(r.vaultError), QMessageBox::Ok);
+      return false;
+    }
+    d->KGK = d->vault.KGK();
+    d->legacyDomains.clear();
+    ui->statusBar->showMessage(tr("Password accepted. Restored %1 domains.")
+                               .arg(d->vault.count()), 5000);
+  }
+  else {
+    if (r.hasDomainData) {
+      d->KGK = r.domainDataKGK;
+      if (r.parseError.isEmpty()) {
+        ui->statusBar->showMessage(tr("Password accepted. Restored %1 domains.")
+                                   .arg(r.legacyDomains.count()), 5000);
+      }
+      else {
+        QMessageBox::warning(this, tr("Bad data from sync server"),
+                             tr("Decoding the data from the sync server failed: %1")
+                             .arg(r.parseError), QMessageBox::Ok);
+      }
     }
+    d->legacyDomains = r.legacyDomains;
   }
-  d->domains = DomainSettingsList::fromQJsonDocument(json);
+  d->domains.clear();
+  d->domains.setDirty(false);
   makeDomainComboBox();
   return true;
 }
@@ -1874,6 +2391,7 @@ void MainWindow::saveSyncDataToSettings(void)
   syncData["sync/server/readUrl"] = d->optionsDialog->readUrl();
   syncData["sync/server/deleteUrl"] = d->optionsDialog->deleteUrl();
   syncData["sync/onStart"] = d->optionsDialog->syncOnStart();
+  syncData["sync/automatic"] = d->optionsDialog->syncAutomatically();
   syncData["sync/filename"] = d->optionsDialog->syncFilename();
   syncData["sync/useFile"] = d->optionsDialog->useSyncFile();
   syncData["sync/useServer"] = d->optionsDialog->useSyncServer();
@@ -1884,12 +2402,12 @@ void MainWindow::saveSyncDataToSettings(void)
       baCryptedData = Crypter::encode(d->masterKey, d->IV, d->salt, d->kgk(), QJsonDocument::fromVariant(syncData).toJson(QJsonDocument::Compact), CompressionEnabled);
     }
     else {
-      _LOG(QString("ERROR in MainWindow::collectedSyncData(): invalid credentials"));
+      _LOG_ERROR(QString("ERROR in MainWindow::collectedSyncData(): invalid credentials"));
     }
   }
   catch (CryptoPP::Exception &e) {
     wrongPasswordWarning((int)e.GetErrorType(), e.what());
-    _LOG(QString("ERROR in MainWindow::collectedSyncData(): %1").arg(e.what()));
+    _LOG_ERROR(QString("ERROR in MainWindow::collectedSyncData(): %1").arg(e.what()));
   }
   d->settings.setValue("sync/param",baCryptedData.toBase64());
   d->settings.sync();
@@ -1900,7 +2418,7 @@ void MainWindow::saveSettings(void)
 {
   Q_D(MainWindow);
   // qDebug() << "MainWindow::saveSettings()";
-  _LOG("MainWindow::saveSettings()");
+  _LOG_DEBUG("MainWindow::saveSettings()");
   saveSyncDataToSettings();
   saveAllDomainDataToSettings();
   saveUiSettings();
@@ -1925,6 +2443,7 @@ void MainWindow::saveUiSettings(void)
   d->settings.setValue("misc/writeBackups", d->optionsDialog->writeBackups());
   d->settings.setValue("misc/autoDeleteBackupFiles", d->optionsDialog->autoDeleteBackupFiles());
   d->settings.setValue("misc/maxBackupFileAge", d->optionsDialog->maxBackupFileAge());
+  d->settings.setValue("misc/maxBackupCount", d->optionsDialog->maxBackupCount());
   d->settings.setValue("misc/maxAttachmentSizeKbyte", d->optionsDialog->maxAttachmentSizeKbyte());
   d->settings.setValue("misc/extensiveWipeout", d->optionsDialog->extensiveWipeout());
   d->settings.setValue("misc/passwordFile", d->optionsDialog->passwordFilename());
@@ -1950,6 +2469,7 @@ void MainWindow::restoreUiSettings(void)
   d->optionsDialog->setDefaultPasswordLength(d->settings.value("misc/defaultPasswordLength", DomainSettings::DefaultPasswordLength).toInt());
   d->optionsDialog->setDefaultIterations(d->settings.value("misc/defaultPBKDF2Iterations", DomainSettings::DefaultIterations).toInt());
   d->optionsDialog->setMaxBackupFileAge(d->settings.value("misc/maxBackupFileAge", 30).toInt());
+  d->optionsDialog->setMaxBackupCount(d->settings.value("misc/maxBackupCount", 200).toInt());
   d->optionsDialog->setMaxAttachmentSizeKbyte(d->settings.value("misc/maxAttachmentSizeKbyte", 50).toInt());
   d->optionsDialog->setAutoDeleteBackupFiles(d->settings.value("misc/autoDeleteBackupFiles", true).toBool());
   d->optionsDialog->setExtensiveWipeout(d->settings.value("misc/extensiveWipeout", false).toBool());
@@ -1965,23 +2485,41 @@ void MainWindow::restoreUiSettings(void)
 }
 
 
-bool MainWindow::restoreSyncSettings(void)
+void MainWindow::decodeSyncSettingsThread(const SecureByteArray &masterPassword, const QByteArray &cipher)
 {
   Q_D(MainWindow);
-  QByteArray baCryptedData = QByteArray::fromBase64(d->settings.value("sync/param").toByteArray());
-  if (!baCryptedData.isEmpty()) {
-    QByteArray baSyncData;
+  TRACE_SPAN("unlock", "MainWindow::decodeSyncSettingsThread");
+  MainWindowPrivate::UnlockResult &r = d->unlockResult;
+  MainWindowPrivate::UnlockError &error = r.syncSettingsError;
+  QElapsedTimer t;
+  t.start();
+  if (!cipher.isEmpty()) {
     try {
-      baSyncData = Crypter::decode(d->masterPassword.toUtf8(), baCryptedData, CompressionEnabled, d->KGK);
+      const QByteArray &baSyncData = Crypter::decode(masterPassword, cipher, CompressionEnabled, r.syncDataKGK);
+      r.syncData = QJsonDocument::fromJson(baSyncData).toVariant().toMap();
+      r.hasSyncData = true;
     }
     catch (CryptoPP::Exception &e) {
-      wrongPasswordWarning((int)e.GetErrorType(), e.what());
-      return false;
+      error.decryptionFailed = true;
+      error.errorType = (int)e.GetErrorType();
+      error.errorString = e.what();
     }
-    const QJsonDocument &jsonSyncData = QJsonDocument::fromJson(baSyncData);
-    QVariantMap syncData = jsonSyncData.toVariant().toMap();
+    recordUnlockStage("decrypt sync settings", t.elapsed());
+  }
+  emit unlockStageFinished(UnlockSyncSettings);
+}
+
+
+void MainWindow::applySyncSettings(void)
+{
+  Q_D(MainWindow);
+  const MainWindowPrivate::UnlockResult &r = d->unlockResult;
+  if (r.hasSyncData) {
+    const QVariantMap &syncData = r.syncData;
+    d->KGK = r.syncDataKGK;
     d->optionsDialog->setSyncFilename(syncData["sync/filename"].toString());
     d->optionsDialog->setSyncOnStart(syncData["sync/onStart"].toBool());
+    d->optionsDialog->setSyncAutomatically(syncData.value("sync/automatic", true).toBool());
     d->optionsDialog->setUseSyncFile(syncData["sync/useFile"].toBool());
     d->optionsDialog->setUseSyncServer(syncData["sync/useServer"].toBool());
     d->optionsDialog->setServerRootUrl(syncData["sync/server/root"].toString());
@@ -1994,15 +2532,8 @@ bool MainWindow::restoreSyncSettings(void)
     d->optionsDialog->setServerPassword(syncData["sync/server/password"].toString());
   }
   Logger::instance().setEnabled(d->settings.value("misc/logger/enabled", true).toBool());
-  _LOG("MainWindow::restoreSettings() finish.");
-  return true;
-}
-
-
-bool MainWindow::restoreSettings(void)
-{
-  Q_D(MainWindow);
-  return restoreSyncSettings();
+  Logger::instance().setLevel(Logger::Level(d->settings.value("misc/logger/level", Logger::Info).toInt()));
+  _LOG_DEBUG("MainWindow::applySyncSettings() finish.");
 }
 
 
@@ -2041,9 +2572,59 @@ void MainWindow::hackLegacyPassword(void)
 void MainWindow::onWriteFinished(QNetworkReply *reply)
 {
   Q_D(MainWindow);
+  TRACE_COMPLETE("network", "sync server write", d->writeTraceStart);
+  METRIC_HISTOGRAM("sync.server.write_roundtrip_us").record(METRIC_NOW() - d->writeRequestStart);
+  TRACE_SPAN("sync", "MainWindow::onWriteFinished");
   ++d->counter;
   d->progressDialog->setValue(d->counter);
+  const int httpStatus = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+  if (d->uploadChunkIndex >= 0) {
+    if (reply->error() == QNetworkReply::NoError && d->uploadChunkIndex + 1 < d->uploadChunks.size()) {
+      ++d->uploadChunkIndex;
+      sendChunkToSyncServer();
+      reply->close();
+      return;
+    }
+    d->uploadChunks.clear();
+    d->uploadChunkIndex = -1;
+  }
+  if (httpStatus == 409 || httpStatus == 412) {
+    // the server data has changed since we've read it
+    d->pendingDeltaRevision = -1;
+    if (++d->casRetries <= MaxCASRetries) {
+      d->progressDialog->setText(tr("Server data changed meanwhile, merging again ..."));
+      d->counter = 0;
+      d->maxCounter = 1;
+      d->progressDialog->setRange(0, d->maxCounter);
+      beginSyncWithServer();
+    }
+    else {
+      d->progressDialog->setText(tr("Writing to the server failed because its data keeps changing. Please try again later."));
+      finishScheduledSync(false);
+    }
+    reply->close();
+    return;
+  }
   if (reply->error() == QNetworkReply::NoError) {
+    const QByteArray etag = reply->hasRawHeader("ETag")
+        ? reply->rawHeader("ETag").replace('"', QByteArray())
+        : d->pendingWriteETag;
+    if (!etag.isEmpty()) {
+      d->serverETag = etag;
+      if (!d->doConvertLocalToLegacy && d->masterPasswordChangeStep == 0) {
+        setLastSeenETag(SyncPeerServer, etag, d->pendingETagTimestamp);
+      }
+    }
+    d->casRetries = 0;
+    acknowledgeOutgoingChanges(d->outgoingChangesInFlight);
+    d->outgoingChangesInFlight.clear();
+    if (d->serverSupportsDelta && d->pendingDeltaRevision >= 0) {
+      const QVariantMap &map = QJsonDocument::fromJson(reply->readAll()).toVariant().toMap();
+      const qint64 revision = map[SyncPatch::REVISION].toLongLong();
+      // only skip ahead if nobody else has written since we read
+      saveDeltaState(revision == d->pendingDeltaRevision + 1 ? revision : d->pendingDeltaRevision, d->pendingDeltaTimestamp);
+      d->pendingDeltaRevision = -1;
+    }
     if (d->masterPasswordChangeStep > 0) {
       nextChangeMasterPasswordStep();
     }
@@ -2053,10 +2634,12 @@ void MainWindow::onWriteFinished(QNetworkReply *reply)
         if (d->doConvertLocalToLegacy && !d->optionsDialog->useSyncFile())
           warnAboutDifferingKGKs();
       }
+      finishScheduledSync(true);
     }
   }
   else {
     d->progressDialog->setText(tr("Writing to the server failed. Reason: %1").arg(reply->errorString()));
+    finishScheduledSync(false);
   }
   reply->close();
 }
@@ -2096,11 +2679,11 @@ void MainWindow::createEmptySyncFile(void)
       domains = Crypter::encode(d->masterKey, d->IV, d->salt, d->kgk(), QByteArray("{}"), CompressionEnabled);
     }
     else {
-      _LOG(QString("ERROR in MainWindow::createEmptySyncFile(): invalid credentials"));
+      _LOG_ERROR(QString("ERROR in MainWindow::createEmptySyncFile(): invalid credentials"));
     }
   }
   catch (CryptoPP::Exception &e) {
-    _LOG(QString("ERROR in MainWindow::createEmptySyncFile(): %1").arg(e.what()));
+    _LOG_ERROR(QString("ERROR in MainWindow::createEmptySyncFile(): %1").arg(e.what()));
     return;
   }
   if (!domains.isEmpty() && syncFile.isOpen()) {
@@ -2110,11 +2693,45 @@ void MainWindow::createEmptySyncFile(void)
 }
 
 
+/*!
+ * \brief etagOf
+ * \return entity tag of an encrypted domain list as used for conditional sync requests
+ */
+static QByteArray etagOf(const QByteArray &cipher)
+{
+  return QCryptographicHash::hash(cipher, QCryptographicHash::Sha256).toHex();
+}
+
+
+/*!
+ * \brief syncSourceTag
+ *
+ * The path of the sync file and the URL of the sync server are only stored
+ * inside the encrypted sync settings. State kept in the plain settings refers
+ * to them by this keyed hash.
+ *
+ * \return keyed hash of `source`
+ */
+static QString syncSourceTag(const SecureByteArray &KGK, const QString &source)
+{
+  QMessageAuthenticationCode mac(QCryptographicHash::Sha256, KGK);
+  mac.addData(QByteArray("ctSESAM sync source"));
+  mac.addData(source.toUtf8());
+  return QString::fromLatin1(mac.result().toHex());
+}
+
+
+static QString etagKey(int syncPeer)
+{
+  return QString("sync/etag/%1").arg(syncPeer);
+}
+
+
 void MainWindow::syncWithFile(void)
 {
   Q_D(MainWindow);
   // qDebug() << "MainWindow::syncWithFile()";
-  _LOG(QString("MainWindow::syncWithFile() %1").arg(d->optionsDialog->syncFilename()));
+  _LOG_DEBUG(QString("MainWindow::syncWithFile() %1").arg(d->optionsDialog->syncFilename()));
   QFile syncFile(d->optionsDialog->syncFilename());
   bool ok = syncFile.open(QIODevice::ReadOnly);
   if (!ok) {
@@ -2124,7 +2741,97 @@ void MainWindow::syncWithFile(void)
   }
   QByteArray domains = syncFile.readAll();
   syncFile.close();
+  d->fileETag = etagOf(domains);
+  d->pendingETagTimestamp = QDateTime::currentDateTime();
+  if (d->masterPasswordChangeStep == 0 && d->fileETag == lastSeenETag(SyncPeerFile)) {
+    if (haveLocalChangesSince(lastSeenTimestamp(SyncPeerFile))) {
+      pushLocalState(SyncPeerFile);
+    }
+    else {
+      ui->statusBar->showMessage(tr("Sync file unchanged."), 3000);
+    }
+    return;
+  }
   syncWith(SyncPeerFile, domains);
+  if (!d->remoteDomains.isDirty() && !d->doConvertLocalToLegacy) {
+    setLastSeenETag(SyncPeerFile, d->fileETag, d->pendingETagTimestamp);
+  }
+}
+
+
+QByteArray MainWindow::lastSeenETag(SyncPeer syncPeer) const
+{
+  Q_D(const MainWindow);
+  const QString &source = syncPeer == SyncPeerFile ? d->optionsDialog->syncFilename() : d->optionsDialog->serverRootUrl();
+  if (d->settings.value(etagKey(syncPeer) + "/source").toString() != syncSourceTag(d->KGK, source))
+    return QByteArray();
+  return d->settings.value(etagKey(syncPeer) + "/etag").toByteArray();
+}
+
+
+QDateTime MainWindow::lastSeenTimestamp(SyncPeer syncPeer) const
+{
+  Q_D(const MainWindow);
+  return d->settings.value(etagKey(syncPeer) + "/timestamp").toDateTime();
+}
+
+
+/*!
+ * \brief MainWindow::setLastSeenETag
+ *
+ * Remembers which encrypted blob the local domain settings were last merged
+ * with, so that an unchanged blob needn't be downloaded or decoded again.
+ */
+void MainWindow::setLastSeenETag(SyncPeer syncPeer, const QByteArray &etag, const QDateTime &timestamp)
+{
+  Q_D(MainWindow);
+  const QString &source = syncPeer == SyncPeerFile ? d->optionsDialog->syncFilename() : d->optionsDialog->serverRootUrl();
+  d->settings.setValue(etagKey(syncPeer) + "/source", syncSourceTag(d->KGK, source));
+  d->settings.setValue(etagKey(syncPeer) + "/etag", etag);
+  d->settings.setValue(etagKey(syncPeer) + "/timestamp", timestamp);
+  d->settings.sync();
+}
+
+
+void MainWindow::resetLastSeenETags(void)
+{
+  Q_D(MainWindow);
+  d->settings.remove("sync/etag");
+  d->fileETag.clear();
+  d->serverETag.clear();
+}
+
+
+bool MainWindow::haveLocalChangesSince(const QDateTime &timestamp) const
+{
+  if (!timestamp.isValid())
+    return true;
+  foreach (DomainIndex::Entry e, localDomainIndex()) {
+    if (e.lastChanged() > timestamp)
+      return true;
+  }
+  return false;
+}
+
+
+/*!
+ * \brief MainWindow::pushLocalState
+ *
+ * The peer still holds the blob the local data was last merged with,
+ * so the local data is a superset of it and can be written back without
+ * decoding the peer's blob first.
+ */
+void MainWindow::pushLocalState(SyncPeer syncPeer)
+{
+  Q_D(MainWindow);
+  // a CAS retry reuses the list built by the previous try unless something has been merged or saved meanwhile
+  if (!d->remoteDomainsHoldLocalState) {
+    loadAllDomainSettings();
+    d->remoteDomains = DomainIndex::fromQJsonDocument(d->domains.toJsonDocument());
+    d->remoteDomainsHoldLocalState = true;
+  }
+  writeToRemote(syncPeer);
+  syncBlobs(syncPeer);
 }
 
 
@@ -2133,25 +2840,119 @@ void MainWindow::beginSyncWithServer(void)
   Q_D(MainWindow);
   d->progressDialog->setText(tr("Reading from server ..."));
   QUrl serverUrl = QUrl(d->optionsDialog->serverRootUrl() + d->optionsDialog->readUrl());
-  _LOG(QString("MainWindow::beginSyncWithServer() %1").arg(serverUrl.toString()));
+  _LOG_DEBUG(QString("MainWindow::beginSyncWithServer() %1").arg(serverUrl.toString()));
   QNetworkRequest req(serverUrl);
   req.setHeader(QNetworkRequest::ContentTypeHeader, "application/x-www-form-urlencoded");
   req.setHeader(QNetworkRequest::UserAgentHeader, AppUserAgent);
   req.setRawHeader("Authorization", d->optionsDialog->httpBasicAuthenticationString());
   req.setSslConfiguration(d->sslConf);
-  d->readReply = d->readNAM.post(req, QByteArray());
+  req.setRawHeader("Accept", "application/octet-stream, application/json");
+  const QByteArray &etag = lastSeenETag(SyncPeerServer);
+  if (d->masterPasswordChangeStep == 0 && !etag.isEmpty()) {
+    req.setRawHeader("If-None-Match", "\"" + etag + "\"");
+  }
+  const qint64 since = d->masterPasswordChangeStep == 0 ? deltaRevision() : 0;
+  d->readTraceStart = TRACE_NOW();
+  d->readRequestStart = METRIC_NOW();
+  d->readReply = d->readNAM.post(req, "since=" + QByteArray::number(since));
 }
 
 
-void MainWindow::onSync(void)
+qint64 MainWindow::deltaRevision(void) const
+{
+  Q_D(const MainWindow);
+  if (d->settings.value("sync/delta/server").toString() != syncSourceTag(d->KGK, d->optionsDialog->serverRootUrl()))
+    return 0;
+  return d->settings.value("sync/delta/revision", 0).toLongLong();
+}
+
+
+/*!
+ * \brief MainWindow::addOutgoingChange
+ *
+ * Remembers that the entry for `domainName` has to be sent to the sync server
+ * with the next incremental sync. Unlike a comparison of modification dates
+ * with the time of the last sync this also catches entries merged in from
+ * the sync file or imported with older dates, and isn't fooled by clocks
+ * that differ between computers.
+ */
+void MainWindow::addOutgoingChange(const QString &domainName)
 {
   Q_D(MainWindow);
-  restartInvalidationTimer();
-  d->domainSettingsBeforceSync = d->domains.at(ui->domainsComboBox->currentText());
-  if (d->optionsDialog->useSyncFile() && !d->optionsDialog->syncFilename().isEmpty()) {
-    ui->statusBar->showMessage(tr("Syncing with file ..."));
-    QFileInfo fi(d->optionsDialog->syncFilename());
-    if (!fi.isFile()) {
+  const QString &id = SyncPatch::entryId(d->kgk(), domainName);
+  d->outgoingChanges.insert(id);
+  d->remoteDomainsHoldLocalState = false;
+  // a request already on its way carries the previous state of the entry
+  d->outgoingChangesInFlight.remove(id);
+  saveOutgoingChanges();
+}
+
+
+/*!
+ * \brief MainWindow::acknowledgeOutgoingChanges
+ *
+ * Forgets the outgoing changes the sync server has confirmed to hold.
+ */
+void MainWindow::acknowledgeOutgoingChanges(const QSet<QString> &ids)
+{
+  Q_D(MainWindow);
+  if (ids.isEmpty() || d->outgoingChanges.isEmpty())
+    return;
+  d->outgoingChanges.subtract(ids);
+  saveOutgoingChanges();
+}
+
+
+void MainWindow::saveOutgoingChanges(void)
+{
+  Q_D(MainWindow);
+  d->settings.setValue("sync/outgoing", QStringList(d->outgoingChanges.toList()));
+}
+
+
+void MainWindow::saveDeltaState(qint64 revision, const QDateTime &timestamp)
+{
+  Q_D(MainWindow);
+  d->settings.setValue("sync/delta/server", syncSourceTag(d->KGK, d->optionsDialog->serverRootUrl()));
+  d->settings.setValue("sync/delta/revision", revision);
+  d->settings.setValue("sync/delta/timestamp", timestamp);
+  d->settings.sync();
+}
+
+
+void MainWindow::resetDeltaState(void)
+{
+  Q_D(MainWindow);
+  d->settings.remove("sync/delta");
+  d->pendingDeltaRevision = -1;
+}
+
+
+void MainWindow::onSync(void)
+{
+  Q_D(MainWindow);
+  restartInvalidationTimer();
+  if (d->coordinatedSync) {
+    ui->statusBar->showMessage(tr("A sync is already in progress."), 3000);
+    return;
+  }
+  d->domainSettingsBeforceSync = domainSettings(ui->domainsComboBox->currentText());
+  if (d->masterPasswordChangeStep == 0) {
+    // a manual sync carries the changes queued for the next scheduled one as well
+    d->syncScheduler.syncStarted();
+    d->scheduledSync = true;
+    beginCoordinatedSync(SyncPeerFile | SyncPeerServer, false);
+    if (!d->coordinatedSync) {
+      finishScheduledSync(false);
+    }
+    return;
+  }
+  d->casRetries = 0;
+  d->remoteDomainsHoldLocalState = false;
+  if (d->optionsDialog->useSyncFile() && !d->optionsDialog->syncFilename().isEmpty()) {
+    ui->statusBar->showMessage(tr("Syncing with file ..."));
+    QFileInfo fi(d->optionsDialog->syncFilename());
+    if (!fi.isFile()) {
       createEmptySyncFile();
     }
     if (fi.isFile() && fi.isReadable()) {
@@ -2181,6 +2982,480 @@ void MainWindow::onSync(void)
 }
 
 
+/*!
+ * \brief MainWindow::beginCoordinatedSync
+ *
+ * Reads all enabled sync peers at the same time. The sync file is read and decoded
+ * in a worker thread while the server request is in flight. Once every peer has
+ * delivered, `mergeSyncPeers()` merges them all with the local data in one go.
+ *
+ * A background sync neither shows the progress dialog nor interrupts the user
+ * with message boxes, and it skips decoding a sync file whose contents are
+ * the same as when it was last read or written.
+ */
+void MainWindow::beginCoordinatedSync(int syncPeers, bool background)
+{
+  Q_D(MainWindow);
+  d->peerReadFuture.waitForFinished();
+  d->serverDecodeFuture.waitForFinished();
+  d->syncDecoder.setPassword(d->masterPassword.toUtf8());
+  d->peerResults.clear();
+  d->peerETags.clear();
+  d->syncPeersPending = 0;
+  d->serverSyncedIncrementally = false;
+  d->pendingETagTimestamp = QDateTime::currentDateTime();
+  d->backgroundSync = background;
+  d->syncFailed = false;
+  d->syncChangedLocalData = false;
+  d->casRetries = 0;
+  d->remoteDomainsHoldLocalState = false;
+  const QString &syncFilename = d->optionsDialog->syncFilename();
+  if ((syncPeers & SyncPeerFile) && d->optionsDialog->useSyncFile() && !syncFilename.isEmpty()) {
+    if (!QFileInfo(syncFilename).isFile() && !background) {
+      createEmptySyncFile();
+    }
+    if (QFileInfo(syncFilename).isReadable()) {
+      d->syncPeersPending |= SyncPeerFile;
+    }
+    else if (!background) {
+      QMessageBox::warning(this,
+                           tr("Sync file read error"),
+                           tr("The sync file %1 cannot be opened for reading.")
+                           .arg(syncFilename), QMessageBox::Ok);
+    }
+  }
+  if ((syncPeers & SyncPeerServer) && d->optionsDialog->useSyncServer()) {
+    d->syncPeersPending |= SyncPeerServer;
+  }
+  if (d->syncPeersPending == 0)
+    return;
+  d->coordinatedSync = true;
+  d->counter = 0;
+  d->maxCounter = ((d->syncPeersPending & SyncPeerFile) ? 1 : 0) + ((d->syncPeersPending & SyncPeerServer) ? 1 : 0);
+  if (background) {
+    ui->statusBar->showMessage(tr("Syncing in the background ..."));
+  }
+  else {
+    d->progressDialog->setText(tr("Reading from sync peers ..."));
+    d->progressDialog->setRange(0, d->maxCounter);
+    d->progressDialog->setValue(d->counter);
+    d->progressDialog->show();
+    d->progressDialog->raise();
+  }
+  if (d->syncPeersPending & SyncPeerFile) {
+    _LOG_DEBUG(QString("MainWindow::beginCoordinatedSync() %1").arg(syncFilename));
+    const QByteArray &knownETag = background && !d->fileETag.isEmpty() ? d->fileETag : lastSeenETag(SyncPeerFile);
+    d->peerReadFuture = QtConcurrent::run(this, &MainWindow::readSyncFileThread, syncFilename, knownETag);
+  }
+  if (d->syncPeersPending & SyncPeerServer) {
+    beginSyncWithServer();
+  }
+}
+
+
+void MainWindow::readSyncFileThread(const QString &filename, const QByteArray &lastSeen)
+{
+  Q_D(MainWindow);
+  TRACE_SPAN("sync", "MainWindow::readSyncFileThread");
+  QFile syncFile(filename);
+  if (!syncFile.open(QIODevice::ReadOnly)) {
+    SyncDecoder::Result result;
+    result.errorCode = NotFound;
+    result.errorString = syncFile.errorString();
+    QMutexLocker locker(&d->peerResultMutex);
+    d->peerResults.insert(SyncPeerFile, result);
+    emit peerDecoded(SyncPeerFile);
+    return;
+  }
+  const QByteArray &cipher = syncFile.readAll();
+  syncFile.close();
+  const QByteArray &etag = etagOf(cipher);
+  if (etag == lastSeen) {
+    QMutexLocker locker(&d->peerResultMutex);
+    d->peerETags.insert(SyncPeerFile, etag);
+    emit peerDecoded(SyncPeerFile);
+    return;
+  }
+  decodePeerDataThread(SyncPeerFile, cipher, etag);
+}
+
+
+/*!
+ * \brief MainWindow::decodePeerDataThread
+ *
+ * Decodes the encrypted domain list of a sync peer. If another peer has delivered
+ * the same ciphertext, the result of its decoding is reused.
+ */
+void MainWindow::decodePeerDataThread(int syncPeer, const QByteArray &cipher, const QByteArray &etag)
+{
+  Q_D(MainWindow);
+  TRACE_SPAN("sync", "MainWindow::decodePeerDataThread");
+  SyncDecoder::Result result;
+  if (cipher.isEmpty()) {
+    result.ok = true;
+  }
+  else {
+    result = d->syncDecoder.decode(cipher).result();
+  }
+  QMutexLocker locker(&d->peerResultMutex);
+  d->peerResults.insert(syncPeer, result);
+  if (!etag.isEmpty()) {
+    d->peerETags.insert(syncPeer, etag);
+  }
+  emit peerDecoded(syncPeer);
+}
+
+
+void MainWindow::onPeerDecoded(int syncPeer)
+{
+  Q_D(MainWindow);
+  if (!d->coordinatedSync || (d->syncPeersPending & syncPeer) == 0)
+    return;
+  d->syncPeersPending &= ~syncPeer;
+  if (syncPeer == SyncPeerFile) {
+    ++d->counter;
+    d->progressDialog->setValue(d->counter);
+    d->progressDialog->setText(tr("Reading sync file finished."));
+  }
+  if (d->syncPeersPending == 0) {
+    mergeSyncPeers();
+  }
+}
+
+
+static bool haveSameEntries(const DomainIndex &a, const DomainIndex &b)
+{
+  if (a.count() != b.count())
+    return false;
+  foreach (DomainIndex::Entry e, b.entries()) {
+    if (!a.contains(e.domainName))
+      return false;
+    const DomainIndex::Entry &other = a.entry(e.domainName);
+    if (other.lastChanged() != e.lastChanged() || other.deleted != e.deleted)
+      return false;
+  }
+  return true;
+}
+
+
+/*!
+ * \brief MainWindow::mergeSyncPeers
+ *
+ * Combines the domain lists of all peers read by `beginCoordinatedSync()`,
+ * the most recently changed entry winning, merges the result with the local data
+ * and writes it back to each peer that isn't up to date. The merged list is
+ * encrypted only once for all peers.
+ */
+void MainWindow::mergeSyncPeers(void)
+{
+  Q_D(MainWindow);
+  TRACE_SPAN("sync", "MainWindow::mergeSyncPeers");
+  d->coordinatedSync = false;
+  QMap<int, SyncDecoder::Result> results;
+  QMap<int, QByteArray> etags;
+  {
+    QMutexLocker locker(&d->peerResultMutex);
+    results = d->peerResults;
+    etags = d->peerETags;
+    d->peerResults.clear();
+    d->peerETags.clear();
+  }
+  d->syncDecoder.clear();
+  if (etags.contains(SyncPeerFile)) {
+    d->fileETag = etags.value(SyncPeerFile);
+  }
+  const bool background = d->backgroundSync;
+  d->backgroundSync = false;
+  for (QMap<int, SyncDecoder::Result>::const_iterator r = results.constBegin(); r != results.constEnd(); ++r) {
+    if (r.value().ok)
+      continue;
+    if (background) {
+      _LOG_ERROR(QString("ERROR in MainWindow::mergeSyncPeers(): sync peer %1: %2").arg(r.key()).arg(r.value().errorString));
+      ui->statusBar->showMessage(tr("Background sync failed: %1").arg(r.value().errorString), 5000);
+      finishScheduledSync(false);
+      return;
+    }
+    if (r.value().errorCode == NotFound) {
+      QMessageBox::warning(this, tr("Sync file read error"),
+                           tr("The sync file %1 cannot be opened for reading. Reason: %2")
+                           .arg(d->optionsDialog->syncFilename()).arg(r.value().errorString), QMessageBox::Ok);
+    }
+    else {
+      wrongPasswordWarning(r.value().errorCode, r.value().errorString);
+    }
+    d->progressDialog->hide();
+    return;
+  }
+
+  const bool fileUnchanged = etags.contains(SyncPeerFile) && !results.contains(SyncPeerFile);
+  if (background && results.isEmpty() && !(fileUnchanged && haveLocalChangesSince(lastSeenTimestamp(SyncPeerFile)))) {
+    // neither the peers nor the local data have changed
+    ui->statusBar->clearMessage();
+    finishScheduledSync(!d->syncFailed);
+    return;
+  }
+  d->doConvertLocalToLegacy = false;
+  const bool haveLocalDomains = !localDomainIndex().isEmpty();
+  bool haveKGK = false;
+  QMap<int, DomainIndex> peerDomains;
+  DomainIndex merged;
+  for (QMap<int, SyncDecoder::Result>::const_iterator r = results.constBegin(); r != results.constEnd(); ++r) {
+    const int syncPeer = r.key();
+    QJsonDocument json;
+    if (!r.value().data.isEmpty()) {
+      if (!haveKGK) {
+        if (d->KGK != r.value().KGK) {
+          d->doConvertLocalToLegacy = haveLocalDomains;
+          d->KGK = r.value().KGK;
+        }
+        haveKGK = true;
+      }
+      else if (d->KGK != r.value().KGK) {
+        _LOG_WARNING(QString("MainWindow::mergeSyncPeers(): sync peer %1 uses a different KGK").arg(syncPeer));
+      }
+      QJsonParseError parseError;
+      json = QJsonDocument::fromJson(r.value().data, &parseError);
+      if (parseError.error != QJsonParseError::NoError) {
+        if (background) {
+          _LOG_ERROR(QString("ERROR in MainWindow::mergeSyncPeers(): bad data from sync peer %1: %2").arg(syncPeer).arg(parseError.errorString()));
+        }
+        else {
+          QMessageBox::warning(this, tr("Bad data from sync peer"),
+                               tr("Decoding the data from the sync peer failed: %1")
+                               .arg(parseError.errorString()), QMessageBox::Ok);
+        }
+      }
+    }
+    d->remoteDomains = DomainIndex::fromQJsonDocument(json);
+    d->remoteDomainsHoldLocalState = false;
+    if (syncPeer == SyncPeerServer && d->serverSupportsDelta) {
+      applyDeltaChanges();
+    }
+    peerDomains.insert(syncPeer, d->remoteDomains);
+    foreach (DomainIndex::Entry e, d->remoteDomains.entries()) {
+      if (!merged.contains(e.domainName) || merged.entry(e.domainName).lastChanged() < e.lastChanged()) {
+        merged.updateWith(d->remoteDomains.decode(e.domainName));
+      }
+    }
+  }
+
+  d->domains.setDirty(false);
+  merged.setDirty(false);
+  d->remoteDomains = merged;
+  if (!results.isEmpty()) {
+    mergeLocalAndRemoteData();
+  }
+  else if (fileUnchanged) {
+    loadAllDomainSettings();
+    d->remoteDomains = DomainIndex::fromQJsonDocument(d->domains.toJsonDocument());
+    d->remoteDomainsHoldLocalState = true;
+  }
+
+  int stalePeers = 0;
+  for (QMap<int, DomainIndex>::const_iterator p = peerDomains.constBegin(); p != peerDomains.constEnd(); ++p) {
+    if (d->remoteDomains.isDirty() || !haveSameEntries(p.value(), d->remoteDomains)) {
+      stalePeers |= p.key();
+    }
+  }
+  if (fileUnchanged && (d->domains.isDirty() || haveLocalChangesSince(lastSeenTimestamp(SyncPeerFile)))) {
+    // the file holds what we've merged with last time, so the merged data is a superset of it
+    stalePeers |= SyncPeerFile;
+  }
+  const bool localChanged = d->domains.isDirty();
+
+  if (stalePeers != 0) {
+    writeToRemote(SyncPeer(stalePeers));
+  }
+  if (!d->doConvertLocalToLegacy) {
+    if (results.contains(SyncPeerFile) && (stalePeers & SyncPeerFile) == 0) {
+      setLastSeenETag(SyncPeerFile, d->fileETag, d->pendingETagTimestamp);
+    }
+    if (results.contains(SyncPeerServer) && (stalePeers & SyncPeerServer) == 0) {
+      setLastSeenETag(SyncPeerServer, d->serverETag, d->pendingETagTimestamp);
+    }
+  }
+  if (results.contains(SyncPeerServer) && (stalePeers & SyncPeerServer) == 0) {
+    acknowledgeOutgoingChanges(d->outgoingChanges);
+  }
+  if (results.contains(SyncPeerServer) && (stalePeers & SyncPeerServer) == 0 && d->serverSupportsDelta) {
+    saveDeltaState(d->pendingDeltaRevision, d->pendingDeltaTimestamp);
+    d->pendingDeltaRevision = -1;
+  }
+
+  if (d->domains.isDirty()) {
+    saveAllDomainDataToSettings();
+    makeDomainComboBox();
+    d->domains.setDirty(false);
+  }
+
+  if (localChanged && d->serverSyncedIncrementally && d->optionsDialog->useSyncServer()) {
+    // the server has only been merged incrementally, so send it what came from the file
+    d->casRetries = 0;
+    beginSyncWithServer();
+  }
+
+  foreach (int syncPeer, peerDomains.keys()) {
+    syncBlobs(SyncPeer(syncPeer));
+  }
+  if ((stalePeers & SyncPeerServer) == 0) {
+    d->progressDialog->setText(tr("Sync finished."));
+    if (d->doConvertLocalToLegacy) {
+      if (!background) {
+        warnAboutDifferingKGKs();
+      }
+      else {
+        _LOG_ERROR("ERROR in MainWindow::mergeSyncPeers(): the sync peer uses a different KGK, local passwords have been converted to legacy passwords");
+      }
+    }
+  }
+
+  if (background) {
+    ui->statusBar->showMessage(localChanged ? tr("Merged changes from sync peers.") : tr("Sync peers are up to date."), 3000);
+  }
+  copyDomainSettingsToGUI(d->domainSettingsBeforceSync);
+
+  d->syncChangedLocalData = localChanged;
+  if ((stalePeers & SyncPeerServer) == 0 || !d->optionsDialog->syncToServerEnabled()) {
+    finishScheduledSync(!d->syncFailed);
+  }
+}
+
+
+/*!
+ * \brief MainWindow::watchSyncFile
+ *
+ * Watches the sync file and the directory it lives in, so that changes arriving
+ * through a shared or replicated folder get merged without the user having to sync.
+ * The directory is watched too because tools that replace the file by renaming
+ * a temporary file over it make most platforms drop the watch on the file itself.
+ */
+void MainWindow::watchSyncFile(void)
+{
+  Q_D(MainWindow);
+  unwatchSyncFile();
+  const QString &syncFilename = d->optionsDialog->syncFilename();
+  if (d->masterPassword.isEmpty() || !d->optionsDialog->useSyncFile() || syncFilename.isEmpty())
+    return;
+  const QFileInfo fi(syncFilename);
+  if (fi.absoluteDir().exists()) {
+    d->syncFileWatcher.addPath(fi.absolutePath());
+  }
+  if (fi.isFile()) {
+    d->syncFileWatcher.addPath(fi.absoluteFilePath());
+  }
+}
+
+
+void MainWindow::unwatchSyncFile(void)
+{
+  Q_D(MainWindow);
+  d->syncFileSettleTimer.stop();
+  if (!d->syncFileWatcher.files().isEmpty()) {
+    d->syncFileWatcher.removePaths(d->syncFileWatcher.files());
+  }
+  if (!d->syncFileWatcher.directories().isEmpty()) {
+    d->syncFileWatcher.removePaths(d->syncFileWatcher.directories());
+  }
+}
+
+
+/*!
+ * \brief MainWindow::onSyncFileChanged
+ *
+ * Replication tools and network shares tend to touch a file several times in a row,
+ * so the actual sync is deferred until the file has been quiet for a moment.
+ */
+void MainWindow::onSyncFileChanged(const QString &path)
+{
+  Q_D(MainWindow);
+  const QFileInfo fi(d->optionsDialog->syncFilename());
+  if (path != fi.absoluteFilePath() && path != fi.absolutePath())
+    return;
+  if (fi.isFile() && !d->syncFileWatcher.files().contains(fi.absoluteFilePath())) {
+    d->syncFileWatcher.addPath(fi.absoluteFilePath());
+  }
+  d->syncFileSettleTimer.start();
+}
+
+
+void MainWindow::onSyncFileSettled(void)
+{
+  Q_D(MainWindow);
+  if (d->masterPassword.isEmpty() || !QFileInfo(d->optionsDialog->syncFilename()).isFile())
+    return;
+  if (d->coordinatedSync || d->masterPasswordChangeStep != 0 || d->parameterSetDirty || d->interactionSemaphore.available() == 0) {
+    // try again when the user or the running sync is done
+    d->syncFileSettleTimer.start();
+    return;
+  }
+  d->domainSettingsBeforceSync = domainSettings(ui->domainsComboBox->currentText());
+  beginCoordinatedSync(SyncPeerFile, true);
+}
+
+
+void MainWindow::updateSyncScheduler(void)
+{
+  Q_D(MainWindow);
+  const bool haveSyncPeer = (d->optionsDialog->useSyncFile() && !d->optionsDialog->syncFilename().isEmpty()) || d->optionsDialog->useSyncServer();
+  d->syncScheduler.setEnabled(!d->masterPassword.isEmpty() && d->optionsDialog->syncAutomatically() && haveSyncPeer);
+}
+
+
+/*!
+ * \brief MainWindow::saveSyncQueue
+ *
+ * Persists the ids of local changes not yet pushed to the sync peers,
+ * so that they get pushed soon after the next start even if the application
+ * was quit while offline. The ids are keyed hashes of the domain names.
+ */
+void MainWindow::saveSyncQueue(void)
+{
+  Q_D(MainWindow);
+  d->settings.setValue("sync/queue", d->syncScheduler.toVariantMap());
+}
+
+
+void MainWindow::onSyncDue(void)
+{
+  Q_D(MainWindow);
+  if (d->masterPassword.isEmpty())
+    return;
+  if (d->coordinatedSync || d->masterPasswordChangeStep != 0 || d->parameterSetDirty || d->interactionSemaphore.available() == 0) {
+    d->syncScheduler.postpone();
+    return;
+  }
+  _LOG_DEBUG("MainWindow::onSyncDue()");
+  d->domainSettingsBeforceSync = domainSettings(ui->domainsComboBox->currentText());
+  d->syncScheduler.syncStarted();
+  d->scheduledSync = true;
+  beginCoordinatedSync(SyncPeerFile | SyncPeerServer, true);
+  if (!d->coordinatedSync) {
+    finishScheduledSync(false);
+  }
+}
+
+
+/*!
+ * \brief MainWindow::finishScheduledSync
+ *
+ * Reports the outcome of a sync started by the scheduler, which then
+ * decides when to sync next.
+ */
+void MainWindow::finishScheduledSync(bool ok)
+{
+  Q_D(MainWindow);
+  if (!d->scheduledSync)
+    return;
+  d->scheduledSync = false;
+  if (ok) {
+    d->syncScheduler.syncSucceeded(d->syncChangedLocalData);
+  }
+  else {
+    d->syncScheduler.syncFailed();
+  }
+}
+
+
 QByteArray MainWindow::cryptedRemoteDomains(void)
 {
   Q_D(MainWindow);
@@ -2192,7 +3467,7 @@ QByteArray MainWindow::cryptedRemoteDomains(void)
       cipher = Crypter::encode(d->masterKey, d->IV, d->salt, d->kgk(), d->remoteDomains.toJson(), CompressionEnabled);
     }
     else {
-      _LOG(QString("ERROR in MainWindow::cryptedRemoteDomains(): invalid credentials"));
+      _LOG_ERROR(QString("ERROR in MainWindow::cryptedRemoteDomains(): invalid credentials"));
     }
   }
   catch (CryptoPP::Exception &e) {
@@ -2219,6 +3494,7 @@ void MainWindow::syncWith(SyncPeer syncPeer, const QByteArray &remoteDomainsEnco
   // qDebug() << "MainWindow::syncWith(" << syncPeer << ")";
   QJsonDocument remoteJSON;
   d->doConvertLocalToLegacy = false;
+  const bool haveLocalDomains = !localDomainIndex().isEmpty();
   if (!remoteDomainsEncoded.isEmpty()) {
     QByteArray baDomains;
     bool ok = true;
@@ -2226,7 +3502,7 @@ void MainWindow::syncWith(SyncPeer syncPeer, const QByteArray &remoteDomainsEnco
       SecureByteArray KGK;
       baDomains = Crypter::decode(d->masterPassword.toUtf8(), remoteDomainsEncoded, CompressionEnabled, KGK);
       if (d->KGK != KGK) {
-        d->doConvertLocalToLegacy = !d->domains.isEmpty();
+        d->doConvertLocalToLegacy = haveLocalDomains;
         d->KGK = KGK;
       }
     }
@@ -2241,7 +3517,7 @@ void MainWindow::syncWith(SyncPeer syncPeer, const QByteArray &remoteDomainsEnco
       try {
         SecureByteArray KGK;
         baDomains = Crypter::decode(d->changeMasterPasswordDialog->newPassword().toUtf8(), remoteDomainsEncoded, CompressionEnabled, KGK);
-        if (d->KGK != KGK && !d->domains.isEmpty()) {
+        if (d->KGK != KGK && haveLocalDomains) {
           d->doConvertLocalToLegacy = true;
           d->KGK = KGK;
         }
@@ -2263,7 +3539,11 @@ void MainWindow::syncWith(SyncPeer syncPeer, const QByteArray &remoteDomainsEnco
   }
 
   d->domains.setDirty(false);
-  d->remoteDomains = DomainSettingsList::fromQJsonDocument(remoteJSON);
+  d->remoteDomains = DomainIndex::fromQJsonDocument(remoteJSON);
+  d->remoteDomainsHoldLocalState = false;
+  if (syncPeer == SyncPeerServer && d->serverSupportsDelta) {
+    applyDeltaChanges();
+  }
   mergeLocalAndRemoteData();
 
   if (d->remoteDomains.isDirty()) {
@@ -2272,14 +3552,331 @@ void MainWindow::syncWith(SyncPeer syncPeer, const QByteArray &remoteDomainsEnco
 
   if (d->domains.isDirty()) {
     saveAllDomainDataToSettings();
-    restoreDomainDataFromSettings();
+    makeDomainComboBox();
+    d->domains.setDirty(false);
+  }
+
+  syncBlobs(syncPeer);
+
+  copyDomainSettingsToGUI(d->domainSettingsBeforceSync);
+}
+
+
+/*!
+ * \brief MainWindow::applyDeltaChanges
+ *
+ * Overlays the per-entry changes the server has collected since its last
+ * whole-blob write onto `remoteDomains`.
+ */
+void MainWindow::applyDeltaChanges(void)
+{
+  Q_D(MainWindow);
+  const bool wasDirty = d->remoteDomains.isDirty();
+  try {
+    foreach (DomainSettings ds, SyncPatch::decodeList(d->kgk(), d->pendingDeltaChanges)) {
+      if (!d->remoteDomains.contains(ds.domainName) || d->remoteDomains.entry(ds.domainName).lastChanged() < ds.modifiedDate) {
+        d->remoteDomains.updateWith(ds);
+      }
+    }
+  }
+  catch (CryptoPP::Exception &e) {
+    _LOG_ERROR(QString("ERROR in MainWindow::applyDeltaChanges(): %1").arg(e.what()));
+  }
+  d->remoteDomains.setDirty(wasDirty);
+  d->pendingDeltaChanges.clear();
+}
+
+
+/*!
+ * \brief MainWindow::syncDeltaWithServer
+ *
+ * Merges the entries changed on the server since the last sync with the entries
+ * changed locally since then. Neither the password based key derivation nor a
+ * transfer of the whole domain list is needed.
+ */
+void MainWindow::syncDeltaWithServer(void)
+{
+  Q_D(MainWindow);
+  DomainSettingsList remoteChanges;
+  try {
+    remoteChanges = SyncPatch::decodeList(d->kgk(), d->pendingDeltaChanges);
+  }
+  catch (CryptoPP::Exception &e) {
+    _LOG_WARNING(QString("MainWindow::syncDeltaWithServer(): cannot decode changes (%1), falling back to full sync").arg(e.what()));
+    resetDeltaState();
+    beginSyncWithServer();
+    return;
+  }
+  d->pendingDeltaChanges.clear();
+  d->domainSettingsBeforceSync = domainSettings(ui->domainsComboBox->currentText());
+  const QMap<QString, DomainIndex::Entry> &local = localDomainIndex();
+  DomainSettingsList outgoing;
+  d->remoteDomains.clear();
+  d->remoteDomainsHoldLocalState = false;
+  d->domains.setDirty(false);
+  foreach (DomainSettings remote, remoteChanges) {
+    d->remoteDomains.updateWith(remote);
+    if (!local.contains(remote.domainName)) {
+      if (!remote.deleted) {
+        d->domains.updateWith(remote);
+      }
+    }
+    else {
+      const QDateTime &localChanged = local[remote.domainName].lastChanged();
+      const QDateTime &remoteChanged = remote.modifiedDate.isValid() ? remote.modifiedDate : remote.createdDate;
+      if (remoteChanged > localChanged) {
+        d->domains.updateWith(remote);
+      }
+      else if (remoteChanged < localChanged) {
+        outgoing.append(domainSettings(remote.domainName));
+      }
+    }
+  }
+  foreach (DomainIndex::Entry e, local) {
+    if (!d->remoteDomains.contains(e.domainName) && d->outgoingChanges.contains(SyncPatch::entryId(d->kgk(), e.domainName))) {
+      outgoing.append(domainSettings(e.domainName));
+    }
+  }
+  foreach (DomainSettings ds, outgoing) {
+    d->remoteDomains.updateWith(ds);
+  }
+
+  if (d->domains.isDirty()) {
+    saveAllDomainDataToSettings();
+    makeDomainComboBox();
     d->domains.setDirty(false);
   }
 
+  if (!outgoing.isEmpty()) {
+    sendPatchesToSyncServer(outgoing);
+  }
+  else {
+    saveDeltaState(d->pendingDeltaRevision, d->pendingDeltaTimestamp);
+    d->pendingDeltaRevision = -1;
+    d->progressDialog->setText(tr("Sync to server finished."));
+  }
+
+  syncBlobs(SyncPeerServer);
+
   copyDomainSettingsToGUI(d->domainSettingsBeforceSync);
 }
 
 
+void MainWindow::sendPatchesToSyncServer(const DomainSettingsList &domains)
+{
+  Q_D(MainWindow);
+  if (d->masterPasswordChangeStep == 0) {
+    d->counter = 0;
+    d->maxCounter = 1;
+    d->progressDialog->setText(tr("Sending %1 changed domain(s) to server ...").arg(domains.count()));
+    d->progressDialog->setRange(0, d->maxCounter);
+    d->progressDialog->setValue(0);
+    d->progressDialog->show();
+  }
+  d->outgoingChangesInFlight.clear();
+  foreach (DomainSettings ds, domains) {
+    d->outgoingChangesInFlight.insert(SyncPatch::entryId(d->kgk(), ds.domainName));
+  }
+  const QByteArray &data = "baseRevision=" + QByteArray::number(d->pendingDeltaRevision)
+      + "&patches=" + QUrl::toPercentEncoding(SyncPatch::encodeList(d->kgk(), domains));
+  QNetworkRequest req(QUrl(d->optionsDialog->serverRootUrl() + d->optionsDialog->writeUrl()));
+  req.setHeader(QNetworkRequest::ContentTypeHeader, "application/x-www-form-urlencoded");
+  req.setHeader(QNetworkRequest::ContentLengthHeader, data.size());
+  req.setHeader(QNetworkRequest::UserAgentHeader, AppUserAgent);
+  req.setRawHeader("Authorization", d->optionsDialog->httpBasicAuthenticationString());
+  req.setSslConfiguration(d->sslConf);
+  d->pendingWriteETag.clear();
+  d->writeTraceStart = TRACE_NOW();
+  d->writeRequestStart = METRIC_NOW();
+  d->writeReply = d->writeNAM.post(req, data);
+}
+
+
+/*!
+ * \brief MainWindow::syncBlobs
+ *
+ * Exchanges the attachment chunks referenced by the merged domain settings
+ * with the sync peer. Only chunks missing on either side are transferred.
+ */
+void MainWindow::syncBlobs(SyncPeer syncPeer)
+{
+  Q_D(MainWindow);
+  const QStringList &ids = d->remoteDomains.referencedBlobs();
+  if (ids.isEmpty())
+    return;
+  d->blobStore.setKGK(d->kgk());
+  if (syncPeer == SyncPeerFile) {
+    d->blobSyncFuture.waitForFinished();
+    // the worker gets its own copies so that locking or re-keying doesn't pull the store out from under it
+    d->blobSyncFuture = QtConcurrent::run(this, &MainWindow::syncBlobsWithFileThread, ids, d->blobStore.ids(), d->blobStore.path(), d->optionsDialog->syncFilename() + ".blobs", SecureByteArray(d->kgk()));
+  }
+  else if (syncPeer == SyncPeerServer) {
+    syncBlobsWithServer(ids);
+  }
+}
+
+
+void MainWindow::syncBlobsWithFileThread(const QStringList &ids, const QStringList &localIds, const QString &localPath, const QString &peerPath, const SecureByteArray &KGK)
+{
+  BlobStore local(localPath);
+  local.setKGK(KGK);
+  BlobStore peer(peerPath);
+  peer.setKGK(KGK);
+  const QSet<QString> &haveLocalIds = localIds.toSet();
+  int nTransferred = 0;
+  foreach (QString id, ids) {
+    const bool haveLocal = haveLocalIds.contains(id);
+    const bool havePeer = peer.contains(id);
+    if (haveLocal && !havePeer) {
+      if (peer.putRawBlob(id, local.rawBlob(id))) {
+        ++nTransferred;
+      }
+      else {
+        _LOG_ERROR(QString("ERROR in MainWindow::syncBlobsWithFileThread(): %1").arg(peer.errorString()));
+      }
+    }
+    else if (!haveLocal && havePeer) {
+      if (local.putRawBlob(id, peer.rawBlob(id))) {
+        ++nTransferred;
+      }
+      else {
+        _LOG_ERROR(QString("ERROR in MainWindow::syncBlobsWithFileThread(): %1").arg(local.errorString()));
+      }
+    }
+  }
+  emit blobsSynced(nTransferred);
+}
+
+
+static bool isOctetStream(QNetworkReply *reply)
+{
+  return reply->header(QNetworkRequest::ContentTypeHeader).toString().startsWith("application/octet-stream");
+}
+
+
+/*!
+ * \brief envelopeFromHeaders
+ *
+ * In binary transport mode the body carries nothing but the encrypted data;
+ * the status information otherwise found in the JSON envelope is sent as `X-SESAM-*` headers.
+ */
+static QVariantMap envelopeFromHeaders(QNetworkReply *reply)
+{
+  QVariantMap map;
+  map["status"] = QString::fromUtf8(reply->rawHeader("X-SESAM-Status"));
+  map["error"] = QString::fromUtf8(reply->rawHeader("X-SESAM-Error"));
+  map["features"] = QString::fromUtf8(reply->rawHeader("X-SESAM-Features")).split(',', QString::SkipEmptyParts);
+  if (reply->hasRawHeader("X-SESAM-Revision")) {
+    map[SyncPatch::REVISION] = reply->rawHeader("X-SESAM-Revision").toLongLong();
+  }
+  return map;
+}
+
+
+void MainWindow::syncBlobsWithServer(const QStringList &ids)
+{
+  Q_D(MainWindow);
+  if (!d->serverSupportsBlobs) {
+    _LOG_WARNING("MainWindow::syncBlobsWithServer(): the sync server doesn't store attachments");
+    return;
+  }
+  d->serverBlobsToFetch = d->blobStore.missing(ids);
+  d->blobTransfersPending = 1;
+  d->blobTransfersDone = 0;
+  postBlobRequest(d->optionsDialog->readUrl(), "list", QString(), "blobs=" + ids.join(',').toLatin1());
+}
+
+
+void MainWindow::postBlobRequest(const QString &url, const QString &op, const QString &id, const QByteArray &data, const QByteArray &contentType)
+{
+  Q_D(MainWindow);
+  QNetworkRequest req(QUrl(d->optionsDialog->serverRootUrl() + url));
+  req.setHeader(QNetworkRequest::ContentTypeHeader, contentType);
+  req.setRawHeader("Accept", "application/octet-stream, application/json");
+  req.setHeader(QNetworkRequest::ContentLengthHeader, data.size());
+  req.setHeader(QNetworkRequest::UserAgentHeader, AppUserAgent);
+  req.setRawHeader("Authorization", d->optionsDialog->httpBasicAuthenticationString());
+  req.setSslConfiguration(d->sslConf);
+  req.setAttribute(QNetworkRequest::User, op);
+  req.setAttribute(QNetworkRequest::Attribute(QNetworkRequest::User + 1), id);
+  d->blobNAM.post(req, data);
+}
+
+
+void MainWindow::onBlobReplyFinished(QNetworkReply *reply)
+{
+  Q_D(MainWindow);
+  const QString &op = reply->request().attribute(QNetworkRequest::User).toString();
+  const QString &id = reply->request().attribute(QNetworkRequest::Attribute(QNetworkRequest::User + 1)).toString();
+  --d->blobTransfersPending;
+  if (reply->error() == QNetworkReply::NoError) {
+    const QByteArray &res = reply->readAll();
+    const bool binary = isOctetStream(reply);
+    QJsonParseError parseError;
+    parseError.error = QJsonParseError::NoError;
+    const QVariantMap &map = binary
+        ? envelopeFromHeaders(reply)
+        : QJsonDocument::fromJson(res, &parseError).toVariant().toMap();
+    if (parseError.error != QJsonParseError::NoError || map["status"].toString() != "ok") {
+      _LOG_ERROR(QString("ERROR in MainWindow::onBlobReplyFinished(): %1 %2 failed: %3").arg(op).arg(id).arg(map["error"].toString()));
+    }
+    else if (op == "list") {
+      const QStringList &missingOnServer = map["missing"].toStringList();
+      foreach (QString missingId, missingOnServer) {
+        if (d->blobStore.contains(missingId)) {
+          if (d->serverSupportsBinary) {
+            postBlobRequest(d->optionsDialog->writeUrl() + "?blob=" + missingId, "put", missingId, d->blobStore.rawBlob(missingId), "application/octet-stream");
+          }
+          else {
+            const QByteArray &data = "blob=" + missingId.toLatin1() + "&data=" + QUrl::toPercentEncoding(d->blobStore.rawBlob(missingId).toBase64());
+            postBlobRequest(d->optionsDialog->writeUrl(), "put", missingId, data);
+          }
+          ++d->blobTransfersPending;
+        }
+      }
+      foreach (QString missingId, d->serverBlobsToFetch) {
+        if (!missingOnServer.contains(missingId)) {
+          postBlobRequest(d->optionsDialog->readUrl(), "get", missingId, "blob=" + missingId.toLatin1());
+          ++d->blobTransfersPending;
+        }
+      }
+    }
+    else if (op == "get") {
+      const QByteArray &blob = binary ? res : QByteArray::fromBase64(map["result"].toByteArray());
+      if (d->blobStore.putRawBlob(id, blob)) {
+        ++d->blobTransfersDone;
+      }
+      else {
+        _LOG_ERROR(QString("ERROR in MainWindow::onBlobReplyFinished(): %1").arg(d->blobStore.errorString()));
+      }
+    }
+    else if (op == "put") {
+      ++d->blobTransfersDone;
+    }
+  }
+  else {
+    _LOG_ERROR(QString("ERROR in MainWindow::onBlobReplyFinished(): %1 %2 failed: %3").arg(op).arg(id).arg(reply->errorString()));
+  }
+  if (d->blobTransfersPending > 0) {
+    ui->statusBar->showMessage(tr("Transferring attachments (%1 of %2) ...")
+                               .arg(d->blobTransfersDone)
+                               .arg(d->blobTransfersDone + d->blobTransfersPending));
+  }
+  else {
+    onBlobsSynced(d->blobTransfersDone);
+  }
+  reply->close();
+}
+
+
+void MainWindow::onBlobsSynced(int nTransferred)
+{
+  if (nTransferred > 0) {
+    ui->statusBar->showMessage(tr("%1 attachment chunks transferred.").arg(nTransferred), 3000);
+  }
+}
+
+
 void MainWindow::shrink(void)
 {
   const QSize &newSize = QSize(width(), 0);
@@ -2330,25 +3927,32 @@ void MainWindow::convertToLegacyPassword(DomainSettings &ds)
 void MainWindow::mergeLocalAndRemoteData(void)
 {
   Q_D(MainWindow);
-  QStringList allDomainNames = d->remoteDomains.keys() + d->domains.keys();
+  TRACE_SPAN("sync", "MainWindow::mergeLocalAndRemoteData");
+  const QMap<QString, DomainIndex::Entry> &local = localDomainIndex();
+  QStringList allDomainNames = d->remoteDomains.keys() + local.keys();
   allDomainNames.removeDuplicates();
   foreach(QString domainName, allDomainNames) {
-    const DomainSettings &remoteDomainSetting = d->remoteDomains.at(domainName);
-    DomainSettings localDomainSetting = d->domains.at(domainName);
-    if (!localDomainSetting.isEmpty() && !remoteDomainSetting.isEmpty()) {
-      if (remoteDomainSetting.modifiedDate > localDomainSetting.modifiedDate) {
-        d->domains.updateWith(remoteDomainSetting);
+    const bool haveRemote = d->remoteDomains.contains(domainName);
+    const bool haveLocal = local.contains(domainName);
+    if (haveLocal && haveRemote) {
+      const QDateTime &remoteModifiedDate = d->remoteDomains.entry(domainName).modifiedDate;
+      const QDateTime &localModifiedDate = local[domainName].modifiedDate;
+      if (remoteModifiedDate > localModifiedDate) {
+        d->domains.updateWith(d->remoteDomains.decode(domainName));
+        addOutgoingChange(domainName);
       }
-      else if (remoteDomainSetting.modifiedDate < localDomainSetting.modifiedDate) {
+      else if (remoteModifiedDate < localModifiedDate) {
+        DomainSettings localDomainSetting = domainSettings(domainName);
         if (d->doConvertLocalToLegacy && !localDomainSetting.deleted) {
           convertToLegacyPassword(localDomainSetting);
-          localDomainSetting.domainName = selectAlternativeDomainNameFor(domainName, d->domains.keys());
+          localDomainSetting.domainName = selectAlternativeDomainNameFor(domainName, local.keys());
         }
         d->remoteDomains.updateWith(localDomainSetting);
       }
     }
-    else if (remoteDomainSetting.isEmpty()) {
-      if (!localDomainSetting.deleted) {
+    else if (!haveRemote) {
+      if (!local[domainName].deleted) {
+        DomainSettings localDomainSetting = domainSettings(domainName);
         if (d->doConvertLocalToLegacy) {
           convertToLegacyPassword(localDomainSetting);
         }
@@ -2356,10 +3960,12 @@ void MainWindow::mergeLocalAndRemoteData(void)
       }
       else {
         d->domains.remove(domainName);
+        d->vault.remove(domainName);
       }
     }
     else {
-      d->domains.updateWith(remoteDomainSetting);
+      d->domains.updateWith(d->remoteDomains.decode(domainName));
+      addOutgoingChange(domainName);
     }
   }
 }
@@ -2370,12 +3976,13 @@ void MainWindow::writeToRemote(SyncPeer syncPeer)
   Q_D(MainWindow);
   const QByteArray &cipher = cryptedRemoteDomains();
   if (!cipher.isEmpty()) {
-    if ((syncPeer & SyncPeerFile) == SyncPeerFile && d->optionsDialog->syncToFileEnabled()) {
-      writeToSyncFile(cipher);
-    }
+    // start the upload first so that it proceeds while the file is being written
     if ((syncPeer & SyncPeerServer) == SyncPeerServer && d->optionsDialog->syncToServerEnabled()) {
       sendToSyncServer(cipher);
     }
+    if ((syncPeer & SyncPeerFile) == SyncPeerFile && d->optionsDialog->syncToFileEnabled()) {
+      writeToSyncFile(cipher);
+    }
   }
   else {
     // TODO: catch encryption error
@@ -2386,21 +3993,45 @@ void MainWindow::writeToRemote(SyncPeer syncPeer)
 void MainWindow::writeToSyncFile(const QByteArray &cipher)
 {
   Q_D(MainWindow);
+  TRACE_SPAN("sync", "MainWindow::writeToSyncFile");
   if (d->optionsDialog->syncToFileEnabled()) {
     QFile syncFile(d->optionsDialog->syncFilename());
-    syncFile.open(QIODevice::WriteOnly);
-    const qint64 bytesWritten = syncFile.write(cipher);
-    syncFile.close();
-    if (bytesWritten < 0) {
+    if (d->masterPasswordChangeStep == 0 && !d->fileETag.isEmpty() && syncFile.open(QIODevice::ReadOnly)) {
+      const QByteArray &currentETag = etagOf(syncFile.readAll());
+      syncFile.close();
+      if (currentETag != d->fileETag) {
+        // someone else has written to the sync file since we've read it
+        if (++d->casRetries <= MaxCASRetries) {
+          _LOG_WARNING("MainWindow::writeToSyncFile(): sync file changed meanwhile, merging again");
+          syncWithFile();
+        }
+        else {
+          QMessageBox::warning(this, tr("Sync file write error"), tr("Your sync file %1 keeps being changed by another program. "
+                                                                     "Please try again later.")
+                               .arg(d->optionsDialog->syncFilename()), QMessageBox::Ok);
+        }
+        return;
+      }
+    }
+    // write to a temporary file and rename it, so that other machines never see a half-written file
+    QSaveFile saveFile(d->optionsDialog->syncFilename());
+    const bool ok = saveFile.open(QIODevice::WriteOnly) && saveFile.write(cipher) == cipher.size() && saveFile.commit();
+    if (!ok) {
       QMessageBox::warning(this, tr("Sync file write error"), tr("Writing to your sync file %1 failed: %2")
                            .arg(d->optionsDialog->syncFilename())
-                           .arg(syncFile.errorString()), QMessageBox::Ok);
+                           .arg(saveFile.errorString()), QMessageBox::Ok);
+    }
+    else {
+      d->fileETag = etagOf(cipher);
+      if (!d->doConvertLocalToLegacy) {
+        setLastSeenETag(SyncPeerFile, d->fileETag, d->pendingETagTimestamp);
+      }
     }
   }
 }
 
 
-void MainWindow::sendToSyncServer(const QByteArray &cipher)
+void MainWindow::sendToSyncServer(const QByteArray &cipher, bool conditional)
 {
   Q_D(MainWindow);
   if (d->masterPasswordChangeStep == 0) {
@@ -2411,6 +4042,24 @@ void MainWindow::sendToSyncServer(const QByteArray &cipher)
     d->progressDialog->setValue(0);
     d->progressDialog->show();
   }
+  d->pendingWriteETag = etagOf(cipher);
+  // the whole domain list replaces the server's, so it covers all outgoing changes
+  d->outgoingChangesInFlight = d->outgoingChanges;
+  if (d->serverSupportsBinary) {
+    d->uploadChunks.clear();
+    for (int offset = 0; offset < cipher.size(); offset += UploadChunkSize) {
+      d->uploadChunks << cipher.mid(offset, UploadChunkSize);
+    }
+    d->uploadId = Crypter::randomBytes(16).toHex();
+    d->uploadChunkIndex = 0;
+    d->uploadConditional = conditional;
+    if (d->masterPasswordChangeStep == 0) {
+      d->maxCounter = d->uploadChunks.size();
+      d->progressDialog->setRange(0, d->maxCounter);
+    }
+    sendChunkToSyncServer();
+    return;
+  }
   QUrlQuery params;
   // XXX: Wouldn't QByteArray::Base64UrlEncoding be better?
   params.addQueryItem("data", cipher.toBase64(QByteArray::Base64Encoding));
@@ -2421,6 +4070,44 @@ void MainWindow::sendToSyncServer(const QByteArray &cipher)
   req.setHeader(QNetworkRequest::UserAgentHeader, AppUserAgent);
   req.setRawHeader("Authorization", d->optionsDialog->httpBasicAuthenticationString());
   req.setSslConfiguration(d->sslConf);
+  if (conditional && !d->serverETag.isEmpty()) {
+    req.setRawHeader("If-Match", "\"" + d->serverETag + "\"");
+  }
+  d->writeTraceStart = TRACE_NOW();
+  d->writeRequestStart = METRIC_NOW();
+  d->writeReply = d->writeNAM.post(req, data);
+}
+
+
+/*!
+ * \brief MainWindow::sendChunkToSyncServer
+ *
+ * Posts the next piece of a binary upload. The server assembles the pieces
+ * and replaces the stored data only after the last one has arrived.
+ */
+void MainWindow::sendChunkToSyncServer(void)
+{
+  Q_D(MainWindow);
+  QUrl url(d->optionsDialog->serverRootUrl() + d->optionsDialog->writeUrl());
+  if (d->uploadChunks.size() > 1) {
+    QUrlQuery query;
+    query.addQueryItem("upload", QString::fromLatin1(d->uploadId));
+    query.addQueryItem("chunk", QString::number(d->uploadChunkIndex));
+    query.addQueryItem("chunks", QString::number(d->uploadChunks.size()));
+    url.setQuery(query);
+  }
+  const QByteArray &data = d->uploadChunks.at(d->uploadChunkIndex);
+  QNetworkRequest req(url);
+  req.setHeader(QNetworkRequest::ContentTypeHeader, "application/octet-stream");
+  req.setHeader(QNetworkRequest::ContentLengthHeader, data.size());
+  req.setHeader(QNetworkRequest::UserAgentHeader, AppUserAgent);
+  req.setRawHeader("Authorization", d->optionsDialog->httpBasicAuthenticationString());
+  req.setSslConfiguration(d->sslConf);
+  if (d->uploadConditional && !d->serverETag.isEmpty()) {
+    req.setRawHeader("If-Match", "\"" + d->serverETag + "\"");
+  }
+  d->writeTraceStart = TRACE_NOW();
+  d->writeRequestStart = METRIC_NOW();
   d->writeReply = d->writeNAM.post(req, data);
 }
 
@@ -2428,6 +4115,7 @@ void MainWindow::sendToSyncServer(const QByteArray &cipher)
 void MainWindow::onForcedPush(void)
 {
   Q_D(MainWindow);
+  loadAllDomainSettings();
   QByteArray cipher;
   {
     QMutexLocker(&d->keyGenerationMutex);
@@ -2437,7 +4125,7 @@ void MainWindow::onForcedPush(void)
         cipher = Crypter::encode(d->masterKey, d->IV, d->salt, d->kgk(), d->domains.toJson(), CompressionEnabled);
       }
       else {
-        _LOG("ERROR in MainWindow::onForcedPush(): invalid credentials");
+        _LOG_ERROR("ERROR in MainWindow::onForcedPush(): invalid credentials");
       }
     }
     catch (CryptoPP::Exception &e) {
@@ -2446,7 +4134,7 @@ void MainWindow::onForcedPush(void)
     }
   }
   if (!cipher.isEmpty()) {
-    sendToSyncServer(cipher);
+    sendToSyncServer(cipher, false);
   }
 }
 
@@ -2454,7 +4142,7 @@ void MainWindow::onForcedPush(void)
 void MainWindow::onDomainSelected(QString domain)
 {
   Q_D(MainWindow);
-  _LOG(QString("MainWindow::onDomainSelected(\"%1\") d->lastCleanDomainSettings.domainName = \"%2\", SENDER = %3")
+  _LOG_DEBUG(QString("MainWindow::onDomainSelected(\"%1\") d->lastCleanDomainSettings.domainName = \"%2\", SENDER = %3")
        .arg(domain)
        .arg(d->lastCleanDomainSettings.domainName)
        .arg((sender() != Q_NULLPTR ? sender()->objectName() : "NONE")));
@@ -2482,7 +4170,7 @@ void MainWindow::onDomainSelected(QString domain)
       break;
     }
   }
-  d->lastCleanDomainSettings = d->domains.at(domain);
+  d->lastCleanDomainSettings = domainSettings(domain);
   // qDebug() << d->lastCleanDomainSettings;
   copyDomainSettingsToGUI(d->lastCleanDomainSettings);
   ui->generatedPasswordLineEdit->setEchoMode(QLineEdit::Password);
@@ -2493,7 +4181,7 @@ void MainWindow::onDomainSelected(QString domain)
 void MainWindow::onDomainTextChanged(const QString &domain)
 {
   Q_D(MainWindow);
-  _LOG(QString("MainWindow::onDomainTextChanged(\"%1\") d->lastCleanDomainSettings.domainName = \"%2\"")
+  _LOG_DEBUG(QString("MainWindow::onDomainTextChanged(\"%1\") d->lastCleanDomainSettings.domainName = \"%2\"")
        .arg(domain)
        .arg(d->lastCleanDomainSettings.domainName));
   int idx = findDomainInComboBox(domain);
@@ -2541,6 +4229,7 @@ void MainWindow::onExportAllDomainSettingAsJSON(void)
     QFile f(filename);
     f.open(QIODevice::Truncate | QIODevice::WriteOnly);
     if (f.isOpen()) {
+      loadAllDomainSettings();
       QByteArray data = d->domains.toJsonDocument().toJson(QJsonDocument::Indented);
       f.write(data);
       f.close();
@@ -2605,6 +4294,7 @@ void MainWindow::onExportAllLoginDataAsClearText(void)
                                    QString(),
                                    LoginDataFileExtension);
   if (!filename.isEmpty()) {
+    loadAllDomainSettings();
     QProgressDialog progressDialog(this);
     progressDialog.setLabelText(tr("Exporting logins\nin %1 thread%2 ...")
                                 .arg(QThread::idealThreadCount())
@@ -2641,35 +4331,116 @@ void MainWindow::onExportAllLoginDataAsClearText(void)
 }
 
 
-QImage MainWindow::currentDomainSettings2QRCode(void) const
+void MainWindow::onAuditVault(void)
+{
+  Q_D(MainWindow);
+  const QString &passwordFilename = d->optionsDialog->passwordFilename();
+  if (passwordFilename.isEmpty()) {
+    SafeDelete(d->passwordChecker);
+    d->auditor.setListedFunction(VaultAuditor::ListedFunction());
+  }
+  else if (d->passwordChecker == Q_NULLPTR || d->passwordChecker->passwordFilename() != passwordFilename || d->passwordChecker->isStale()) {
+    SafeRenew(d->passwordChecker, new PasswordChecker(passwordFilename));
+    PasswordChecker *checker = d->passwordChecker;
+    d->auditor.setListedFunction([checker](const QString &password) {
+      return checker->findInPasswordFile(password) >= 0;
+    });
+  }
+  if (d->passwordChecker != Q_NULLPTR && d->passwordChecker->isLoading()) {
+    QObject::connect(d->passwordChecker, SIGNAL(ready(bool)), SLOT(onAuditVault()), Qt::UniqueConnection);
+    ui->statusBar->showMessage(tr("Loading password file. The audit starts when it's done ..."));
+    return;
+  }
+  ui->statusBar->showMessage(QString());
+  d->auditor.setKGK(d->KGK);
+  const QList<DomainIndex::Entry> &entries = localDomainIndex().values();
+  DomainSettingsList outdated;
+  foreach (QString domainName, d->auditor.outdated(entries)) {
+    outdated << domainSettings(domainName);
+  }
+  _LOG_INFO(QString("Auditing %1 of %2 domains").arg(outdated.count()).arg(entries.count()));
+  QFutureWatcher<VaultAuditor::Result> futureWatcher;
+  futureWatcher.setFuture(d->auditor.audit(outdated));
+  if (outdated.count() > QThread::idealThreadCount()) {
+    QProgressDialog progressDialog(this);
+    progressDialog.setLabelText(tr("Auditing %1 domains\nin %2 thread%3 ...")
+                                .arg(outdated.count())
+                                .arg(QThread::idealThreadCount())
+                                .arg(QThread::idealThreadCount() == 1 ? "" : tr("s")));
+    QObject::connect(&futureWatcher, SIGNAL(finished()), &progressDialog, SLOT(reset()));
+    QObject::connect(&progressDialog, SIGNAL(canceled()), &futureWatcher, SLOT(cancel()));
+    QObject::connect(&futureWatcher, SIGNAL(progressRangeChanged(int, int)), &progressDialog, SLOT(setRange(int, int)));
+    QObject::connect(&futureWatcher, SIGNAL(progressValueChanged(int)), &progressDialog, SLOT(setValue(int)));
+    progressDialog.exec();
+  }
+  futureWatcher.waitForFinished();
+  if (futureWatcher.future().isCanceled())
+    return;
+  d->auditor.update(futureWatcher.future().results());
+  const QList<VaultAuditor::Finding> &findings = d->auditor.findings(entries);
+  int weak = 0, reused = 0, listed = 0, expired = 0;
+  QStringList details;
+  foreach (VaultAuditor::Finding f, findings) {
+    QStringList issues;
+    if (f.issues.testFlag(VaultAuditor::Weak)) {
+      issues << tr("weak (about 10^%1 guesses)").arg(f.guessesLog10, 0, 'f', 1);
+      ++weak;
+    }
+    if (f.issues.testFlag(VaultAuditor::Reused)) {
+      issues << tr("also used for %1").arg(f.reusedBy.join(", "));
+      ++reused;
+    }
+    if (f.issues.testFlag(VaultAuditor::Listed)) {
+      issues << tr("found in password file");
+      ++listed;
+    }
+    if (f.issues.testFlag(VaultAuditor::Expired)) {
+      issues << tr("expired");
+      ++expired;
+    }
+    details << QString("%1: %2").arg(f.domainName).arg(issues.join("; "));
+  }
+  QMessageBox msgBox(this);
+  msgBox.setWindowTitle(tr("Vault audit"));
+  if (findings.isEmpty()) {
+    msgBox.setIcon(QMessageBox::Information);
+    msgBox.setText(tr("No issues found in %1 domains.").arg(d->auditor.cachedCount()));
+  }
+  else {
+    msgBox.setIcon(QMessageBox::Warning);
+    msgBox.setText(tr("%1 of %2 domains have issues: %3 weak, %4 reused, %5 found in the password file, %6 expired.")
+                   .arg(findings.count())
+                   .arg(d->auditor.cachedCount())
+                   .arg(weak)
+                   .arg(reused)
+                   .arg(listed)
+                   .arg(expired));
+    msgBox.setDetailedText(details.join("\n"));
+  }
+  msgBox.exec();
+}
+
+
+static QByteArray domainSettings2QRCodeData(const DomainSettings &ds, const QString &password)
 {
-  static const int ModuleSize = 10;
-  static const int Margin = ModuleSize;
-  DomainSettings ds = collectedDomainSettings();
-  QString str = QString("%1\n%2\n%3\n%4")
+  return QString("%1\n%2\n%3\n%4")
       .arg(ds.domainName)
       .arg(ds.url)
       .arg(ds.userName)
-      .arg(ui->generatedPasswordLineEdit->text());
-  QRcode *qrcode = QRcode_encodeString8bit(str.toStdString().c_str(), 0, QR_ECLEVEL_L);
-  const int sz = qrcode->width * ModuleSize + 2 * Margin;
-  QPixmap qr(sz, sz);
-  QPainter p(&qr);
-  p.fillRect(qr.rect(), Qt::white);
-  p.setPen(QPen(Qt::transparent, 0));
-  p.translate(QPoint(Margin, Margin));
-  unsigned char *m = qrcode->data;
-  for (int y = 0; y < qrcode->width; ++y) {
-    unsigned char *row = m + y * qrcode->width;
-    int yy = y * ModuleSize;
-    for (int x = 0; x < qrcode->width; ++x) {
-      p.setBrush(((row[x] & 0x1) == 0x1) ? Qt::black : Qt::white);
-      p.drawRect(x * ModuleSize, yy, ModuleSize, ModuleSize);
-    }
-  }
-  p.end();
-  QRcode_free(qrcode);
-  return qr.toImage();
+      .arg(password)
+      .toUtf8();
+}
+
+
+QByteArray MainWindow::currentDomainSettings2QRCodeData(void) const
+{
+  return domainSettings2QRCodeData(collectedDomainSettings(), ui->generatedPasswordLineEdit->text());
+}
+
+
+QImage MainWindow::currentDomainSettings2QRCode(void) const
+{
+  return QRCodeRenderer::toImage(currentDomainSettings2QRCodeData());
 }
 
 
@@ -2679,7 +4450,7 @@ bool MainWindow::validCredentials(void) const
 }
 
 
-static const QString QRCodeFileExtension = QObject::tr("QR code file (*.png)");
+static const QString QRCodeFileExtension = QObject::tr("QR code file (*.png);;SVG file (*.svg)");
 
 void MainWindow::onExportCurrentSettingsAsQRCode(void)
 {
@@ -2689,8 +4460,172 @@ void MainWindow::onExportCurrentSettingsAsQRCode(void)
                                                   QString(),
                                                   QRCodeFileExtension);
   if (!filename.isEmpty()) {
-    QImage qrcode = currentDomainSettings2QRCode();
-    qrcode.save(filename);
+    bool ok;
+    QString errorString;
+    if (filename.endsWith(".svg", Qt::CaseInsensitive)) {
+      QSaveFile f(filename);
+      const QByteArray &svg = QRCodeRenderer::toSvg(currentDomainSettings2QRCodeData());
+      ok = f.open(QIODevice::WriteOnly) && f.write(svg) == svg.size() && f.commit();
+      errorString = f.errorString();
+    }
+    else {
+      ok = currentDomainSettings2QRCode().save(filename);
+    }
+    if (!ok) {
+      QMessageBox::warning(this, tr("Export failed"), tr("The QR code could not be written to %1. %2").arg(filename).arg(errorString));
+    }
+  }
+}
+
+
+struct DomainSettingsToQRCodeConverter
+{
+  explicit DomainSettingsToQRCodeConverter(const SecureByteArray &kgk)
+    : kgk(kgk)
+  { /* ... */ }
+  typedef QRSheetWriter::Cell result_type;
+  SecureByteArray kgk;
+  QRSheetWriter::Cell operator()(const DomainSettings &ds)
+  {
+    SecureString pwd = ds.legacyPassword;
+    if (pwd.isEmpty()) {
+      Password gpwd(ds);
+      gpwd.generate(kgk);
+      pwd = gpwd.password();
+    }
+    QRSheetWriter::Cell cell;
+    cell.title = ds.domainName;
+    cell.subtitle = ds.userName;
+    cell.code = QRCodeRenderer::toImage(domainSettings2QRCodeData(ds, pwd), 1, 4);
+    return cell;
+  }
+};
+
+
+static const QString QRCodeSheetsFileExtension = QObject::tr("PDF file (*.pdf);;PNG files (*.png)");
+
+/*!
+ * \brief MainWindow::onExportQRCodeSheets
+ *
+ * Holds off the automatic lock and scheduled syncs while the sheets are
+ * exported: the export keeps the event loop running, and the domains are
+ * read from the vault page by page.
+ */
+void MainWindow::onExportQRCodeSheets(void)
+{
+  Q_D(MainWindow);
+  d->interactionSemaphore.acquire();
+  exportQRCodeSheets();
+  d->interactionSemaphore.release();
+}
+
+
+/*!
+ * \brief MainWindow::exportQRCodeSheets
+ *
+ * Prints the login data of the domains picked in a `QRSheetExportDialog` as
+ * labelled QR codes on A4 sheets.
+ *
+ * Passwords are derived and QR codes rendered one page at a time in the thread
+ * pool. While a page is being laid out and written, the next one is already
+ * being computed, so no more than two pages of QR codes are held in memory
+ * regardless of the number of domains.
+ *
+ * The domains of a page are decoded on the GUI thread before the page is
+ * handed to the pool, because the vault may be remapped by a write at any time.
+ * Decoding a record takes microseconds; the key derivation in the workers is
+ * what takes long.
+ */
+void MainWindow::exportQRCodeSheets(void)
+{
+  Q_D(MainWindow);
+  QRSheetExportDialog dlg(this);
+  dlg.setEntries(localDomainIndex().values());
+  if (dlg.exec() != QDialog::Accepted)
+    return;
+  const QStringList &domainNames = dlg.checkedDomains();
+  if (domainNames.isEmpty())
+    return;
+  const QString &filename = QFileDialog::getSaveFileName(this,
+                                                         tr("Export QR code sheets"),
+                                                         QString(),
+                                                         QRCodeSheetsFileExtension);
+  if (filename.isEmpty())
+    return;
+  QRSheetWriter writer;
+  writer.setFileName(filename);
+  writer.setFormat(filename.endsWith(".png", Qt::CaseInsensitive) ? QRSheetWriter::PngFormat : QRSheetWriter::PdfFormat);
+  writer.setGrid(dlg.columns(), dlg.rows());
+  writer.setTitle(tr("%1 emergency sheet, %2").arg(AppName).arg(QDateTime::currentDateTime().toString(Qt::DefaultLocaleShortDate)));
+  if (!writer.open()) {
+    QMessageBox::warning(this, tr("Export failed"), writer.errorString());
+    return;
+  }
+  const int pageSize = writer.cellsPerPage();
+  const DomainSettingsToQRCodeConverter converter(d->KGK);
+  auto startPage = [this, &domainNames, &converter, pageSize](int first) {
+    DomainSettingsList page;
+    for (int i = first; i < qMin(first + pageSize, domainNames.count()); ++i) {
+      page << domainSettings(domainNames.at(i));
+    }
+    return QtConcurrent::mapped(page, converter);
+  };
+  QProgressDialog progressDialog(this);
+  progressDialog.setWindowModality(Qt::WindowModal);
+  progressDialog.setLabelText(tr("Exporting %1 QR codes\nin %2 thread%3 ...")
+                              .arg(domainNames.count())
+                              .arg(QThread::idealThreadCount())
+                              .arg(QThread::idealThreadCount() == 1 ? "" : tr("s")));
+  progressDialog.setRange(0, domainNames.count());
+  progressDialog.show();
+  bool ok = true;
+  int done = 0;
+  QFuture<QRSheetWriter::Cell> current;
+  QFuture<QRSheetWriter::Cell> next = startPage(0);
+  auto cancel = [&current, &next, &writer]() {
+    current.cancel();
+    next.cancel();
+    current.waitForFinished();
+    next.waitForFinished();
+    writer.abort();
+  };
+  for (int first = 0; ok && first < domainNames.count(); first += pageSize) {
+    current = next;
+    if (first + pageSize < domainNames.count()) {
+      next = startPage(first + pageSize);
+    }
+    if (!current.isFinished()) {
+      // keep the progress dialog responsive while the page is being computed
+      QFutureWatcher<QRSheetWriter::Cell> pageWatcher;
+      QEventLoop loop;
+      QObject::connect(&pageWatcher, SIGNAL(finished()), &loop, SLOT(quit()));
+      QObject::connect(&progressDialog, SIGNAL(canceled()), &loop, SLOT(quit()));
+      pageWatcher.setFuture(current);
+      loop.exec();
+    }
+    if (progressDialog.wasCanceled()) {
+      cancel();
+      return;
+    }
+    foreach (QRSheetWriter::Cell cell, current.results()) {
+      ok = writer.write(cell);
+      if (!ok)
+        break;
+      progressDialog.setValue(++done);
+    }
+    if (progressDialog.wasCanceled()) {
+      cancel();
+      return;
+    }
+  }
+  ok = writer.close() && ok;
+  progressDialog.reset();
+  if (ok) {
+    QMessageBox::information(this, tr("QR code sheets exported"), tr("Successfully exported %1 QR codes on %2 pages.").arg(done).arg(writer.pageCount()));
+  }
+  else {
+    cancel();
+    QMessageBox::warning(this, tr("Export failed"), writer.errorString());
   }
 }
 
@@ -2816,53 +4751,163 @@ void MainWindow::enterMasterPassword(void)
 }
 
 
+/*!
+ * \brief MainWindow::onMasterPasswordEntered
+ *
+ * Unlocking runs as a small dependency graph. Decrypting the sync settings,
+ * opening the vault and generating a fresh key for the next save each take
+ * a full key derivation, so they run in parallel. The main window shows up as
+ * soon as both decryption stages are done; migrating legacy data, cleaning
+ * up backups and syncing wait for the fresh key and run afterwards.
+ * Every stage is timed, see `reportUnlockTimings()`.
+ */
 void MainWindow::onMasterPasswordEntered(void)
 {
   Q_D(MainWindow);
-  bool ok = true;
   qsrand(static_cast<uint>(QDateTime::currentDateTime().toMSecsSinceEpoch()));
   const QString masterPwd = d->masterPasswordDialog->masterPassword();
-  const bool repeatedPasswordEntry = d->masterPasswordDialog->repeatedPasswordEntry();
-  if (!masterPwd.isEmpty()) {
-    d->masterPassword = masterPwd;
-    ok = restoreSettings();
-    if (ok) {
-      createLanguageMenu();
-      ok = restoreDomainDataFromSettings();
-      if (ok) {
-        generateSaltKeyIV().waitForFinished();
-        d->settings.setValue("mainwindow/masterPasswordEntered", true);
-        d->settings.sync();
-        ui->domainsComboBox->setCurrentText(d->lastDomainBeforeLock);
-        ui->domainsComboBox->setFocus();
-        d->masterPasswordDialog->hide();
-        show();
-        if (d->optionsDialog->autoDeleteBackupFiles()) {
-          removeOutdatedBackupFiles();
-        }
-        if (d->optionsDialog->syncOnStart()) {
-          onSync();
-        }
-        else if (repeatedPasswordEntry) {
-          int rc = QMessageBox::warning(this,
-                               tr("Sync now!"),
-                               tr("You've started %1 for the first time on this computer. "
-                                  "If you're using a sync server or file, please go to the "
-                                  "Options dialog, enter your sync settings there, and then do a sync. "
-                                  "If you don't follow this advice you may encounter problems later on. "
-                                  "Click OK to open the Options dialog now.").arg(AppName),
-                               QMessageBox::Ok | QMessageBox::Ignore);
-          if (rc == QMessageBox::Ok) {
-            showOptionsDialog();
-          }
-        }
-        restartInvalidationTimer();
-      }
+  if (masterPwd.isEmpty() || (d->unlockStagesPending.load() & (UnlockSyncSettings | UnlockDomainData)) != 0)
+    return;
+  d->unlockClock.start();
+  d->unlockTimings.clear();
+  d->timeToInteractiveMs = -1;
+  d->unlockRepeatedPasswordEntry = d->masterPasswordDialog->repeatedPasswordEntry();
+  d->masterPassword = masterPwd;
+  d->unlockResult = MainWindowPrivate::UnlockResult();
+  d->unlockStagesPending.store(UnlockSyncSettings | UnlockDomainData | UnlockKey);
+  d->masterPasswordDialog->setEnabled(false);
+  QApplication::setOverrideCursor(Qt::WaitCursor);
+  const SecureByteArray &masterPassword = masterPwd.toUtf8();
+  generateSaltKeyIV();
+  d->unlockSyncSettingsFuture = QtConcurrent::run(this, &MainWindow::decodeSyncSettingsThread,
+                                                  masterPassword, QByteArray::fromBase64(d->settings.value("sync/param").toByteArray()));
+  d->unlockDomainDataFuture = QtConcurrent::run(this, &MainWindow::decodeDomainDataThread,
+                                                masterPassword, QByteArray::fromBase64(d->settings.value("sync/domains").toByteArray()));
+}
+
+
+void MainWindow::onUnlockStageFinished(int stage)
+{
+  Q_D(MainWindow);
+  // the stages are only changed here, on the GUI thread; the key generation thread merely reads them
+  const int pending = d->unlockStagesPending.load();
+  if ((pending & stage) == 0)
+    return;
+  d->unlockStagesPending.store(pending & ~stage);
+  if (stage != UnlockKey && (d->unlockStagesPending.load() & (UnlockSyncSettings | UnlockDomainData)) == 0) {
+    QApplication::restoreOverrideCursor();
+    d->masterPasswordDialog->setEnabled(true);
+    if (!unlockInteractive()) {
+      d->unlockStagesPending.store(0);
+      return;
     }
   }
-  if (!ok ) {
+  if (d->unlockStagesPending.load() == 0) {
+    finishUnlock();
+  }
+}
+
+
+/*!
+ * \brief MainWindow::unlockInteractive
+ *
+ * Applies the decrypted settings and domains and shows the main window.
+ *
+ * \return `false` if decryption failed and the master password must be entered again
+ */
+bool MainWindow::unlockInteractive(void)
+{
+  Q_D(MainWindow);
+  TRACE_SPAN("unlock", "MainWindow::unlockInteractive");
+  QElapsedTimer t;
+  t.start();
+  const MainWindowPrivate::UnlockResult &r = d->unlockResult;
+  if (r.domainDataError.decryptionFailed || r.syncSettingsError.decryptionFailed) {
+    const MainWindowPrivate::UnlockError &error = r.domainDataError.decryptionFailed ? r.domainDataError : r.syncSettingsError;
+    wrongPasswordWarning(error.errorType, error.errorString);
+    return false;
+  }
+  applySyncSettings();
+  createLanguageMenu();
+  if (!applyDomainData()) {
     enterMasterPassword();
+    return false;
+  }
+  d->settings.setValue("mainwindow/masterPasswordEntered", true);
+  d->settings.sync();
+  ui->domainsComboBox->setCurrentText(d->lastDomainBeforeLock);
+  ui->domainsComboBox->setFocus();
+  d->masterPasswordDialog->hide();
+  show();
+  recordUnlockStage("show window", t.elapsed());
+  d->timeToInteractiveMs = d->unlockClock.elapsed();
+  watchSyncFile();
+  d->syncScheduler.restore(d->settings.value("sync/queue").toMap());
+  d->outgoingChanges = d->settings.value("sync/outgoing").toStringList().toSet();
+  updateSyncScheduler();
+  if (!d->optionsDialog->syncOnStart() && d->unlockRepeatedPasswordEntry) {
+    int rc = QMessageBox::warning(this,
+                         tr("Sync now!"),
+                         tr("You've started %1 for the first time on this computer. "
+                            "If you're using a sync server or file, please go to the "
+                            "Options dialog, enter your sync settings there, and then do a sync. "
+                            "If you don't follow this advice you may encounter problems later on. "
+                            "Click OK to open the Options dialog now.").arg(AppName),
+                         QMessageBox::Ok | QMessageBox::Ignore);
+    if (rc == QMessageBox::Ok) {
+      showOptionsDialog();
+    }
+  }
+  restartInvalidationTimer();
+  return true;
+}
+
+
+/*!
+ * \brief MainWindow::finishUnlock
+ *
+ * Runs the stages of unlocking that need the freshly generated key.
+ */
+void MainWindow::finishUnlock(void)
+{
+  Q_D(MainWindow);
+  TRACE_SPAN("unlock", "MainWindow::finishUnlock");
+  QElapsedTimer t;
+  t.start();
+  if (!d->vault.isOpen() && !d->legacyDomains.isEmpty()) {
+    saveAllDomainDataToSettings();
+    recordUnlockStage("migrate to vault", t.restart());
+  }
+  if (d->optionsDialog->autoDeleteBackupFiles()) {
+    removeOutdatedBackupFiles();
+  }
+  if (d->optionsDialog->syncOnStart()) {
+    onSync();
+    recordUnlockStage("start sync", t.elapsed());
+  }
+  reportUnlockTimings();
+}
+
+
+void MainWindow::recordUnlockStage(const QString &stage, qint64 ms)
+{
+  Q_D(MainWindow);
+  QMutexLocker locker(&d->unlockTimingMutex);
+  d->unlockTimings.append(qMakePair(stage, ms));
+}
+
+
+void MainWindow::reportUnlockTimings(void)
+{
+  Q_D(MainWindow);
+  QMutexLocker locker(&d->unlockTimingMutex);
+  QVariantMap fields;
+  fields["total_ms"] = d->unlockClock.elapsed();
+  fields["interactive_ms"] = d->timeToInteractiveMs;
+  for (QList<QPair<QString, qint64> >::const_iterator stage = d->unlockTimings.constBegin(); stage != d->unlockTimings.constEnd(); ++stage) {
+    fields[QString(stage->first).replace(' ', '_') + "_ms"] = stage->second;
   }
+  _LOG_INFO("Unlocked", fields);
 }
 
 
@@ -2890,6 +4935,17 @@ void MainWindow::clearAllSettings(void)
     d->settings.setValue("mainwindow/masterPasswordEntered", false);
     d->settings.remove("sync");
     d->settings.sync();
+    d->pendingVaultWrites.clear();
+    d->vaultWriteTimer.stop();
+    d->vault.close();
+    d->legacyDomains.clear();
+    d->domains.clear();
+    if (d->vault.exists()) {
+      wipeFile(d->vault.fileName());
+    }
+    d->attachmentFuture.waitForFinished();
+    d->blobSyncFuture.waitForFinished();
+    QDir(d->blobStore.path()).removeRecursively();
     if (d->optionsDialog->useSyncFile() && !d->optionsDialog->syncFilename().isEmpty()) {
       QFileInfo fi(d->optionsDialog->syncFilename());
       if (fi.isWritable()) {
@@ -2927,10 +4983,27 @@ void MainWindow::invalidateMasterPassword(bool reenter)
 {
   Q_D(MainWindow);
   // qDebug() << "MainWindow::invalidatePassword()";
+  flushVaultWrites();
   SecureErase(d->masterPassword);
   d->masterPasswordDialog->invalidatePassword();
   d->KGK.invalidate();
   d->masterKey.invalidate();
+  d->vault.close();
+  d->attachmentFuture.waitForFinished();
+  d->blobSyncFuture.waitForFinished();
+  unwatchSyncFile();
+  d->syncScheduler.setEnabled(false);
+  d->scheduledSync = false;
+  d->peerReadFuture.waitForFinished();
+  d->serverDecodeFuture.waitForFinished();
+  d->coordinatedSync = false;
+  d->backgroundSync = false;
+  d->syncDecoder.clear();
+  d->blobStore.setKGK(SecureByteArray());
+  d->auditor.setKGK(SecureByteArray());
+  d->auditor.clearCache();
+  d->legacyDomains.clear();
+  d->domains.clear();
   if (reenter) {
     enterMasterPassword();
   }
@@ -2941,7 +5014,7 @@ void MainWindow::lockApplication(void)
 {
   Q_D(MainWindow);
   // qDebug() << "MainWindow::lockApplication() triggered by" << (sender() == Q_NULLPTR ? sender()->objectName() : "NONE");
-  _LOG("MainWindow::lockApplication()");
+  _LOG_DEBUG("MainWindow::lockApplication()");
   if (d->interactionSemaphore.available() == 0) {
     restartInvalidationTimer();
     return;
@@ -2981,6 +5054,9 @@ void MainWindow::onDeleteFinished(QNetworkReply *reply)
     if (parseError.error == QJsonParseError::NoError) {
       QVariantMap map = json.toVariant().toMap();
       if (map["status"].toString() == "ok") {
+        // the revisions and entity tags seen so far refer to the deleted data
+        resetDeltaState();
+        resetLastSeenETags();
         QMessageBox::information(
               this,
               tr("Deletion on server finished"),
@@ -3007,22 +5083,94 @@ void MainWindow::onDeleteFinished(QNetworkReply *reply)
 void MainWindow::onReadFinished(QNetworkReply *reply)
 {
   Q_D(MainWindow);
+  TRACE_COMPLETE("network", "sync server read", d->readTraceStart);
+  METRIC_HISTOGRAM("sync.server.read_roundtrip_us").record(METRIC_NOW() - d->readRequestStart);
+  TRACE_SPAN("sync", "MainWindow::onReadFinished");
   ++d->counter;
   d->progressDialog->setValue(d->counter);
 
+  d->pendingETagTimestamp = QDateTime::currentDateTime();
+  if (reply->error() == QNetworkReply::NoError && reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() == 304) {
+    d->progressDialog->setText(tr("Server data unchanged."));
+    d->serverETag = lastSeenETag(SyncPeerServer);
+    d->serverSyncedIncrementally = true;
+    if (deltaRevision() > 0) {
+      d->serverSupportsDelta = true;
+      d->pendingDeltaRevision = deltaRevision();
+      d->pendingDeltaTimestamp = d->pendingETagTimestamp;
+      d->pendingDeltaChanges.clear();
+      syncDeltaWithServer();
+    }
+    else if (haveLocalChangesSince(lastSeenTimestamp(SyncPeerServer))) {
+      pushLocalState(SyncPeerServer);
+    }
+    if (d->coordinatedSync) {
+      onPeerDecoded(SyncPeerServer);
+    }
+    reply->close();
+    return;
+  }
+
+  bool decodingServerData = false;
   if (reply->error() == QNetworkReply::NoError) {
     const QByteArray &res = reply->readAll();
     d->progressDialog->setText(tr("Reading from server finished."));
+    const bool binary = isOctetStream(reply);
     QJsonParseError parseError;
-    const QJsonDocument &json = QJsonDocument::fromJson(res, &parseError);
+    parseError.error = QJsonParseError::NoError;
+    QVariantMap map;
+    QByteArray baDomains;
+    if (binary) {
+      map = envelopeFromHeaders(reply);
+      baDomains = res;
+    }
+    else {
+      map = QJsonDocument::fromJson(res, &parseError).toVariant().toMap();
+      baDomains = QByteArray::fromBase64(map["result"].toByteArray());
+    }
     if (parseError.error == QJsonParseError::NoError) {
-      QVariantMap map = json.toVariant().toMap();
       if (map["status"].toString() == "ok") {
-        QByteArray baDomains = QByteArray::fromBase64(map["result"].toByteArray());
-        syncWith(SyncPeerServer, baDomains);
+        const QStringList &features = map["features"].toStringList();
+        d->serverSupportsBlobs = features.contains("blobs");
+        d->serverSupportsBinary = features.contains("binary");
+        d->serverSupportsDelta = features.contains("delta") && map.contains(SyncPatch::REVISION);
+        if (d->serverSupportsDelta) {
+          d->pendingDeltaRevision = map[SyncPatch::REVISION].toLongLong();
+          d->pendingDeltaTimestamp = QDateTime::currentDateTime();
+          d->pendingDeltaChanges = map["changes"].toList();
+        }
+        if (d->serverSupportsDelta && !binary && !map.contains("result")) {
+          d->serverSyncedIncrementally = true;
+          syncDeltaWithServer();
+        }
+        else if (d->coordinatedSync) {
+          d->serverETag = reply->hasRawHeader("ETag")
+              ? reply->rawHeader("ETag").replace('"', QByteArray())
+              : etagOf(baDomains);
+          d->serverDecodeFuture = QtConcurrent::run(this, &MainWindow::decodePeerDataThread, int(SyncPeerServer), baDomains, QByteArray());
+          decodingServerData = true;
+        }
+        else {
+          d->serverETag = reply->hasRawHeader("ETag")
+              ? reply->rawHeader("ETag").replace('"', QByteArray())
+              : etagOf(baDomains);
+          syncWith(SyncPeerServer, baDomains);
+          if (!d->remoteDomains.isDirty() && !d->doConvertLocalToLegacy && d->masterPasswordChangeStep == 0) {
+            setLastSeenETag(SyncPeerServer, d->serverETag, d->pendingETagTimestamp);
+          }
+          if (!d->remoteDomains.isDirty()) {
+            // the server already holds everything merged
+            acknowledgeOutgoingChanges(d->outgoingChanges);
+          }
+          if (d->serverSupportsDelta && !d->remoteDomains.isDirty()) {
+            saveDeltaState(d->pendingDeltaRevision, d->pendingDeltaTimestamp);
+            d->pendingDeltaRevision = -1;
+          }
+        }
       }
       else {
         d->progressDialog->setText(tr("Reading from the sync server failed. Status: %1 - Error: %2").arg(map["status"].toString()).arg(map["error"].toString()));
+        d->syncFailed = true;
       }
       if (d->masterPasswordChangeStep > 0) {
         nextChangeMasterPasswordStep();
@@ -3030,10 +5178,18 @@ void MainWindow::onReadFinished(QNetworkReply *reply)
     }
     else {
       d->progressDialog->setText(tr("Decoding the data from the sync server failed: %1").arg(parseError.errorString()));
+      d->syncFailed = true;
     }
   }
   else {
     d->progressDialog->setText(tr("Critical Network Error: %1").arg(reply->errorString()));
+    d->syncFailed = true;
+    if (!d->coordinatedSync) {
+      finishScheduledSync(false);
+    }
+  }
+  if (d->coordinatedSync && !decodingServerData) {
+    onPeerDecoded(SyncPeerServer);
   }
   reply->close();
 }
@@ -3183,11 +5339,13 @@ bool MainWindow::eventFilter(QObject *obj, QEvent *event)
     if (obj == ui->attachmentTableWidget) {
       QDropEvent *const dropEvent = reinterpret_cast<QDropEvent*>(event);
       if (dropEvent->mimeData() != Q_NULLPTR && dropEvent->mimeData()->hasUrls()) {
+        QStringList filenames;
         foreach (const QUrl &url, dropEvent->mimeData()->urls()) {
           if (url.isLocalFile()) {
-            attachFile(url.toLocalFile());
+            filenames << url.toLocalFile();
           }
         }
+        attachFiles(filenames);
         dropEvent->accept();
         restartInvalidationTimer();
         return true;
@@ -3226,19 +5384,63 @@ void MainWindow::saveAttachmentAs(const QTableWidgetItem *item)
   if (item != Q_NULLPTR) {
     QString filename = QFileDialog::getSaveFileName(this, tr("Save attachment as ..."), d->lastSaveAttachmentDir + "/" + item->text());
     if (!filename.isEmpty()) {
-      QFile f(filename);
-      bool ok = f.open(QIODevice::WriteOnly);
-      if (ok) {
-        d->lastSaveAttachmentDir = QFileInfo(filename).absolutePath();
-        const QByteArray &contents = QByteArray::fromBase64(item->data(Qt::UserRole).toByteArray());
-        f.write(contents);
-        f.close();
+      d->lastSaveAttachmentDir = QFileInfo(filename).absolutePath();
+      const QVariant &contents = item->data(Qt::UserRole);
+      if (BlobStore::Reference::isReference(contents)) {
+        d->attachmentFuture.waitForFinished();
+        d->blobStore.setKGK(d->kgk());
+        d->progressDialog->setText(tr("Saving attachment %1 ...").arg(item->text()));
+        d->progressDialog->setRange(0, 100);
+        d->progressDialog->setValue(0);
+        d->progressDialog->show();
+        d->attachmentFuture = QtConcurrent::run(this, &MainWindow::fetchAttachmentThread, contents.toMap(), filename);
+      }
+      else {
+        QFile f(filename);
+        bool ok = f.open(QIODevice::WriteOnly);
+        if (ok) {
+          f.write(QByteArray::fromBase64(contents.toByteArray()));
+          f.close();
+        }
       }
     }
   }
 }
 
 
+void MainWindow::fetchAttachmentThread(const QVariantMap &ref, const QString &filename)
+{
+  Q_D(MainWindow);
+  const BlobStore::Reference &r = BlobStore::Reference::fromVariant(ref);
+  QSaveFile f(filename);
+  if (!f.open(QIODevice::WriteOnly)) {
+    emit attachmentFailed(filename, f.errorString());
+    return;
+  }
+  qint64 bytesWritten = 0;
+  foreach (QString id, r.chunks) {
+    const QByteArray &chunk = d->blobStore.get(id);
+    if (chunk.isEmpty()) {
+      f.cancelWriting();
+      emit attachmentFailed(filename, d->blobStore.errorString());
+      return;
+    }
+    if (f.write(chunk) != chunk.size()) {
+      f.cancelWriting();
+      emit attachmentFailed(filename, f.errorString());
+      return;
+    }
+    bytesWritten += chunk.size();
+    emit attachmentProgress(bytesWritten, r.size);
+  }
+  if (!f.commit()) {
+    emit attachmentFailed(filename, f.errorString());
+    return;
+  }
+  emit attachmentSaved(filename);
+}
+
+
 int MainWindow::attachmentRow(const QString &filename) const
 {
   int row = -1;
@@ -3269,16 +5471,19 @@ static QString toKbyte(qint64 a)
 }
 
 
-void MainWindow::appendAttachmentToTable(const QString &filename, const QByteArray &contents)
+void MainWindow::appendAttachmentToTable(const QString &filename, const QVariant &contents)
 {
   // qDebug() << "MainWindow::appendAttachmentToTable(" << filename << "," << contents << ")";
+  const qint64 size = BlobStore::Reference::isReference(contents)
+      ? BlobStore::Reference::fromVariant(contents).size
+      : QByteArray::fromBase64(contents.toByteArray()).size();
   const int row = ui->attachmentTableWidget->rowCount();
   ui->attachmentTableWidget->insertRow(row);
   QTableWidgetItem *const itemFilename = new QTableWidgetItem(filename);
   itemFilename->setData(Qt::UserRole, contents);
   itemFilename->setTextAlignment(Qt::AlignLeft | Qt::AlignVCenter);
   ui->attachmentTableWidget->setItem(row, 0, itemFilename);
-  QTableWidgetItem *const itemSize = new QTableWidgetItem(toKbyte(contents.size()));
+  QTableWidgetItem *const itemSize = new QTableWidgetItem(toKbyte(size));
   itemSize->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
   ui->attachmentTableWidget->setItem(row, 1, itemSize);
 }
@@ -3289,38 +5494,150 @@ void MainWindow::setAttachments(const QVariantMap &attachments)
   Q_D(MainWindow);
   ui->attachmentTableWidget->setRowCount(0);
   foreach (QString key, attachments.keys()) {
-    appendAttachmentToTable(key, attachments[key].toByteArray());
+    appendAttachmentToTable(key, attachments[key]);
   }
 }
 
 
-void MainWindow::attachFile(const QString &filename)
+/*!
+ * \brief MainWindow::externalizeAttachments
+ *
+ * Moves attachments that are still inlined as base64 strings into the blob store
+ * and replaces them with references.
+ */
+void MainWindow::externalizeAttachments(DomainSettings &ds)
 {
   Q_D(MainWindow);
-  bool anyAttached = false;
-  QFileInfo fi(filename);
-  const QString &fn = fi.fileName();
-  if (!attachmentExists(fn)) {
-    if (fi.size() < d->optionsDialog->maxAttachmentSizeKbyte() * 1024) {
-      QFile f(filename);
-      const bool ok = f.open(QIODevice::ReadOnly);
-      if (ok) {
-        QByteArray contents = f.readAll().toBase64();
-        f.close();
-        appendAttachmentToTable(fn, contents);
-        anyAttached = true;
+  if (ds.files.isEmpty())
+    return;
+  d->blobStore.setKGK(d->kgk());
+  foreach (QString filename, ds.files.keys()) {
+    const QVariant &contents = ds.files[filename];
+    if (!BlobStore::Reference::isReference(contents)) {
+      QBuffer buffer;
+      buffer.setData(QByteArray::fromBase64(contents.toByteArray()));
+      buffer.open(QIODevice::ReadOnly);
+      const BlobStore::Reference &ref = d->blobStore.store(&buffer);
+      if (ref.isValid()) {
+        ds.files[filename] = ref.toVariantMap();
       }
       else {
-        QMessageBox::information(
-              this,
-              tr("Read error"),
-              tr("The file '%1' was not added because it cannot be read (%2).")
-              .arg(fn)
-              .arg(f.errorString())
-              );
+        _LOG_ERROR(QString("ERROR in MainWindow::externalizeAttachments(): %1").arg(d->blobStore.errorString()));
       }
     }
+  }
+}
+
+
+void MainWindow::storeAttachmentsThread(const QStringList &filenames)
+{
+  Q_D(MainWindow);
+  qint64 bytesTotal = 0;
+  foreach (QString filename, filenames) {
+    bytesTotal += QFileInfo(filename).size();
+  }
+  qint64 bytesRead = 0;
+  foreach (QString filename, filenames) {
+    QFile f(filename);
+    if (!f.open(QIODevice::ReadOnly)) {
+      emit attachmentFailed(filename, f.errorString());
+      continue;
+    }
+    BlobStore::Reference ref;
+    bool ok = true;
+    while (ok && !f.atEnd()) {
+      const QByteArray &chunk = f.read(BlobStore::ChunkSize);
+      if (chunk.isEmpty())
+        break;
+      const QString &id = d->blobStore.put(chunk);
+      ok = !id.isEmpty();
+      ref.chunks << id;
+      ref.size += chunk.size();
+      bytesRead += chunk.size();
+      emit attachmentProgress(bytesRead, bytesTotal);
+    }
+    f.close();
+    if (ok) {
+      emit attachmentStored(QFileInfo(filename).fileName(), ref.toVariantMap());
+    }
     else {
+      emit attachmentFailed(filename, d->blobStore.errorString());
+    }
+  }
+}
+
+
+void MainWindow::onAttachmentProgress(qint64 bytesDone, qint64 bytesTotal)
+{
+  Q_D(MainWindow);
+  if (bytesTotal > 0) {
+    d->progressDialog->setValue(int(100 * bytesDone / bytesTotal));
+  }
+}
+
+
+void MainWindow::onAttachmentStored(const QString &filename, const QVariantMap &ref)
+{
+  Q_D(MainWindow);
+  d->attachmentsPending = qMax(0, d->attachmentsPending - 1);
+  if (d->attachmentsPending == 0) {
+    d->progressDialog->hide();
+  }
+  if (ui->domainsComboBox->currentText() != d->attachmentDomain) {
+    QMessageBox::information(
+          this,
+          tr("Attachment not added"),
+          tr("The file '%1' was not added because you switched to another domain while it was being stored.")
+          .arg(filename));
+    return;
+  }
+  if (!attachmentExists(filename)) {
+    appendAttachmentToTable(filename, ref);
+    setDirty(true);
+  }
+}
+
+
+void MainWindow::onAttachmentFailed(const QString &filename, const QString &errorString)
+{
+  Q_D(MainWindow);
+  d->attachmentsPending = qMax(0, d->attachmentsPending - 1);
+  if (d->attachmentsPending == 0) {
+    d->progressDialog->hide();
+  }
+  QMessageBox::warning(
+        this,
+        tr("Attachment error"),
+        tr("Processing the attachment '%1' failed: %2")
+        .arg(QFileInfo(filename).fileName())
+        .arg(errorString));
+}
+
+
+void MainWindow::onAttachmentSaved(const QString &filename)
+{
+  Q_D(MainWindow);
+  d->progressDialog->hide();
+  ui->statusBar->showMessage(tr("Attachment saved to %1.").arg(filename), 3000);
+}
+
+
+void MainWindow::attachFiles(const QStringList &filenames)
+{
+  Q_D(MainWindow);
+  QStringList accepted;
+  QStringList acceptedNames;
+  foreach (QString filename, filenames) {
+    QFileInfo fi(filename);
+    const QString &fn = fi.fileName();
+    if (attachmentExists(fn) || acceptedNames.contains(fn)) {
+      QMessageBox::information(
+            this,
+            tr("Attachment already exists"),
+            tr("The file '%1' was not added because an attachment with the same name already exists.")
+            .arg(fn));
+    }
+    else if (fi.size() >= d->optionsDialog->maxAttachmentSizeKbyte() * 1024) {
       QMessageBox::information(
             this,
             tr("Attachment too large"),
@@ -3332,34 +5649,54 @@ void MainWindow::attachFile(const QString &filename)
             .arg(d->optionsDialog->maxAttachmentSizeKbyte())
             );
     }
+    else if (!fi.isReadable()) {
+      QMessageBox::information(
+            this,
+            tr("Read error"),
+            tr("The file '%1' was not added because it cannot be read.")
+            .arg(fn)
+            );
+    }
+    else {
+      accepted << filename;
+      acceptedNames << fn;
+      d->lastAttachFileDir = fi.absolutePath();
+    }
   }
-  else {
-    QMessageBox::information(
-          this,
-          tr("Attachment already exists"),
-          tr("The file '%1' was not added because an attachment with the same name already exists.")
-          .arg(fn));
-  }
-  if (anyAttached) {
-    setDirty(true);
-    d->lastAttachFileDir = fi.absolutePath();
+  if (!accepted.isEmpty()) {
+    d->attachmentFuture.waitForFinished();
+    d->blobStore.setKGK(d->kgk());
+    d->attachmentDomain = ui->domainsComboBox->currentText();
+    d->attachmentsPending = accepted.count();
+    d->progressDialog->setText(tr("Storing attachments ..."));
+    d->progressDialog->setRange(0, 100);
+    d->progressDialog->setValue(0);
+    d->progressDialog->show();
+    d->attachmentFuture = QtConcurrent::run(this, &MainWindow::storeAttachmentsThread, accepted);
   }
 }
 
 
+void MainWindow::attachFile(const QString &filename)
+{
+  attachFiles(QStringList() << filename);
+}
+
+
 void MainWindow::onAttachFile(void)
 {
   Q_D(MainWindow);
   QStringList filenames = QFileDialog::getOpenFileNames(
         this, tr("Attach files"), d->lastAttachFileDir);
-  if (!filenames.isEmpty()) {
-    foreach (QString filename, filenames) {
-      QFileInfo fi(filename);
-      if (fi.exists()) {
-        attachFile(filename);
-      }
+  QStringList existing;
+  foreach (QString filename, filenames) {
+    if (QFileInfo(filename).exists()) {
+      existing << filename;
     }
   }
+  if (!existing.isEmpty()) {
+    attachFiles(existing);
+  }
 }
 
 
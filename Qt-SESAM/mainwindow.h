@@ -38,6 +38,8 @@
 #include <QSystemTrayIcon>
 #include <QNetworkReply>
 #include <QList>
+#include <QMap>
+#include <QSet>
 #include <QSslError>
 #include <QEvent>
 #include <QMessageBox>
@@ -50,6 +52,7 @@
 #include "password.h"
 #include "domainsettings.h"
 #include "domainsettingslist.h"
+#include "domainindex.h"
 #include "pbkdf2.h"
 #include "securebytearray.h"
 
@@ -80,6 +83,11 @@ private:
     SyncPeerServer = 0x00000002,
     LastPeerName
   } SyncPeer;
+  typedef enum _UnlockStage {
+    UnlockSyncSettings = 0x00000001,
+    UnlockDomainData = 0x00000002,
+    UnlockKey = 0x00000004
+  } UnlockStage;
 
 private slots:
   void onLogin(void);
@@ -110,6 +118,8 @@ private slots:
   void onExportAllDomainSettingAsJSON(void);
   void onExportAllLoginDataAsClearText(void);
   void onExportCurrentSettingsAsQRCode(void);
+  void onExportQRCodeSheets(void);
+  void onAuditVault(void);
   void onPasswordTemplateChanged(const QString &);
   void masterPasswordInvalidationTimeMinsChanged(int);
   void onShuffleUsername(void);
@@ -159,14 +169,37 @@ private slots:
   void onImportPasswordSafeFile(void);
   void onBackupFilesRemoved(bool ok);
   void onBackupFilesRemoved(int);
+  void onRestoreBackup(void);
+  void onWipeProgress(qint64 bytesDone, qint64 bytesTotal);
   void onSelectLanguage(QAction *);
   void onAttachFile(void);
+  void onAttachmentProgress(qint64 bytesDone, qint64 bytesTotal);
+  void onAttachmentStored(const QString &filename, const QVariantMap &ref);
+  void onAttachmentFailed(const QString &filename, const QString &errorString);
+  void onAttachmentSaved(const QString &filename);
+  void onBlobReplyFinished(QNetworkReply*);
+  void onBlobsSynced(int);
+  void onPeerDecoded(int);
+  void onUnlockStageFinished(int);
+  void onSyncFileChanged(const QString &);
+  void onSyncFileSettled(void);
+  void onSyncDue(void);
+  void saveSyncQueue(void);
+  void flushVaultWrites(void);
 
 signals:
   void passwordGenerated(void);
   void saltKeyIVGenerated(void);
   void backupFilesDeleted(int);
   void backupFilesDeleted(bool);
+  void attachmentProgress(qint64, qint64);
+  void unlockStageFinished(int);
+  void wipeProgress(qint64, qint64);
+  void attachmentStored(QString, QVariantMap);
+  void attachmentFailed(QString, QString);
+  void attachmentSaved(QString);
+  void blobsSynced(int);
+  void peerDecoded(int);
 
 protected:
   void closeEvent(QCloseEvent *);
@@ -188,12 +221,17 @@ private: // methods
   QMessageBox::StandardButton saveYesNoCancel(void);
   void resetAllFieldsExceptDomainComboBox(void);
   void resetAllFields(void);
-  bool restoreSettings(void);
   void saveDomainSettings(DomainSettings ds);
   void saveAllDomainDataToSettings(void);
-  bool restoreDomainDataFromSettings(void);
+  void decodeDomainDataThread(const SecureByteArray &masterPassword, const QByteArray &legacyCipher);
+  bool applyDomainData(void);
   void copyDomainSettingsToGUI(DomainSettings ds);
   void copyDomainSettingsToGUI(const QString &domain);
+  DomainSettings domainSettings(const QString &domainName);
+  void exportQRCodeSheets(void);
+  void loadAllDomainSettings(void);
+  QMap<QString, DomainIndex::Entry> localDomainIndex(void) const;
+  void queueVaultWrite(const DomainSettings &ds);
   void updateWindowTitle(void);
   void makeDomainComboBox(void);
   void wrongPasswordWarning(int errCode, QString errMsg);
@@ -203,12 +241,21 @@ private: // methods
   QByteArray cryptedRemoteDomains(void);
   void mergeLocalAndRemoteData(void);
   void writeToRemote(SyncPeer syncPeer);
-  void sendToSyncServer(const QByteArray &cipher);
+  void sendToSyncServer(const QByteArray &cipher, bool conditional = true);
+  void sendChunkToSyncServer(void);
   void writeToSyncFile(const QByteArray &cipher);
   void writeBackupFile(void);
   void createEmptySyncFile(void);
   void syncWithFile(void);
   void beginSyncWithServer(void);
+  void beginCoordinatedSync(int syncPeers, bool background);
+  void readSyncFileThread(const QString &filename, const QByteArray &lastSeen);
+  void decodePeerDataThread(int syncPeer, const QByteArray &cipher, const QByteArray &etag);
+  void mergeSyncPeers(void);
+  void watchSyncFile(void);
+  void unwatchSyncFile(void);
+  void updateSyncScheduler(void);
+  void finishScheduledSync(bool ok);
   int findDomainInComboBox(const QString &domain) const;
   int findDomainInComboBox(const QString &domain, int lo, int hi) const;
   bool domainComboboxContains(const QString &domain) const;
@@ -222,20 +269,50 @@ private: // methods
   QString selectAlternativeDomainNameFor(const QString &domainName, const QStringList &domainNameList);
   void saveSyncDataToSettings(void);
   bool wipeFile(const QString &filename);
+  int wipeFiles(const QStringList &filenames);
   void cleanupAfterMasterPasswordChanged(void);
   void prepareExit(void);
-  void removeOutdatedBackupFilesThread(void);
+  void removeOutdatedBackupFilesThread(bool all);
+  QByteArray currentDomainSettings2QRCodeData(void) const;
   QImage currentDomainSettings2QRCode(void) const;
   bool validCredentials(void) const;
   void attachFile(const QString &filename);
+  void attachFiles(const QStringList &filenames);
+  void storeAttachmentsThread(const QStringList &filenames);
+  void fetchAttachmentThread(const QVariantMap &ref, const QString &filename);
+  void externalizeAttachments(DomainSettings &ds);
+  void syncBlobs(SyncPeer syncPeer);
+  qint64 deltaRevision(void) const;
+  void addOutgoingChange(const QString &domainName);
+  void acknowledgeOutgoingChanges(const QSet<QString> &ids);
+  void saveOutgoingChanges(void);
+  void saveDeltaState(qint64 revision, const QDateTime &timestamp);
+  void resetDeltaState(void);
+  QByteArray lastSeenETag(SyncPeer syncPeer) const;
+  QDateTime lastSeenTimestamp(SyncPeer syncPeer) const;
+  void setLastSeenETag(SyncPeer syncPeer, const QByteArray &etag, const QDateTime &timestamp);
+  void resetLastSeenETags(void);
+  bool haveLocalChangesSince(const QDateTime &timestamp) const;
+  void pushLocalState(SyncPeer syncPeer);
+  void applyDeltaChanges(void);
+  void syncDeltaWithServer(void);
+  void sendPatchesToSyncServer(const DomainSettingsList &domains);
+  void syncBlobsWithFileThread(const QStringList &ids, const QStringList &localIds, const QString &localPath, const QString &peerPath, const SecureByteArray &KGK);
+  void syncBlobsWithServer(const QStringList &ids);
+  void postBlobRequest(const QString &url, const QString &op, const QString &id, const QByteArray &data, const QByteArray &contentType = "application/x-www-form-urlencoded");
   void setAttachments(const QVariantMap &attachments);
   int attachmentRow(const QString &filename) const;
   bool attachmentExists(const QString &filename) const;
   void saveAttachmentAs(const QTableWidgetItem *);
   void deleteAttachment(const QTableWidgetItem *);
   void restoreUiSettings(void);
-  bool restoreSyncSettings(void);
-  void appendAttachmentToTable(const QString &filename, const QByteArray &contents);
+  void decodeSyncSettingsThread(const SecureByteArray &masterPassword, const QByteArray &cipher);
+  void applySyncSettings(void);
+  bool unlockInteractive(void);
+  void finishUnlock(void);
+  void recordUnlockStage(const QString &stage, qint64 ms);
+  void reportUnlockTimings(void);
+  void appendAttachmentToTable(const QString &filename, const QVariant &contents);
   void executeAttachmentContextMenu(QEvent *event);
   void dragEnterAttachmentWidget(QEvent *event);
 };
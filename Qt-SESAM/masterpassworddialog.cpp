@@ -21,6 +21,7 @@
 #include "masterpassworddialog.h"
 #include "ui_masterpassworddialog.h"
 #include "passwordchecker.h"
+#include "strengthestimator.h"
 #include "util.h"
 #include "global.h"
 
@@ -30,8 +31,11 @@ class MasterPasswordDialogPrivate
 public:
   MasterPasswordDialogPrivate(void)
     : repeatedPasswordEntry(false)
-  { /* ... */ }
+  {
+    estimator.addUserInputs(QStringList() << "sesam" << "ctsesam" << "qtsesam");
+  }
   bool repeatedPasswordEntry;
+  StrengthEstimator estimator;
 };
 
 
@@ -63,6 +67,8 @@ MasterPasswordDialog::~MasterPasswordDialog()
 
 void MasterPasswordDialog::invalidatePassword(void)
 {
+  Q_D(MasterPasswordDialog);
+  d->estimator.clear();
   SecureErase(ui->passwordLineEdit->text());
   ui->passwordLineEdit->clear();
   SecureErase(ui->repeatPasswordLineEdit->text());
@@ -142,10 +148,16 @@ void MasterPasswordDialog::okClicked(void)
 
 void MasterPasswordDialog::checkPasswords(void)
 {
+  Q_D(MasterPasswordDialog);
   if (ui->repeatPasswordLineEdit->isVisible()) {
+    const QString &password = ui->passwordLineEdit->text();
     QString grade;
     QColor color;
-    PasswordChecker::evaluatePasswordStrength(ui->passwordLineEdit->text(), color, grade, Q_NULLPTR);
+    d->estimator.setPassword(password);
+    PasswordChecker::evaluatePasswordStrength(d->estimator, color, grade);
+    ui->strengthLabel->setToolTip(password.isEmpty()
+                                  ? QString()
+                                  : tr("About 10^%1 guesses needed; cracking would take %2.").arg(d->estimator.guessesLog10(), 0, 'f', 1).arg(d->estimator.crackTimeDisplay()));
     ui->strengthLabel->setText(tr("%1").arg(grade));
     ui->strengthLabel->setStyleSheet(QString("background-color: rgb(%1, %2, %3); font-weight: bold").arg(color.red()).arg(color.green()).arg(color.blue()));
     ui->okPushButton->setEnabled(!ui->passwordLineEdit->text().isEmpty() && ui->repeatPasswordLineEdit->text() == ui->passwordLineEdit->text());
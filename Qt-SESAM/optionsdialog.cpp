@@ -20,6 +20,7 @@
 #include "util.h"
 #include "global.h"
 #include "servercertificatewidget.h"
+#include "metrics.h"
 #include "optionsdialog.h"
 #include "ui_optionsdialog.h"
 
@@ -84,6 +85,10 @@ OptionsDialog::OptionsDialog(QWidget *parent)
   QObject::connect(ui->checkConnectivityPushButton, SIGNAL(pressed()), SLOT(checkConnectivity()));
   QObject::connect(ui->selectPasswordFilePushButton, SIGNAL(pressed()), SLOT(choosePasswordFile()));
   QObject::connect(ui->serverRootURLLineEdit, SIGNAL(textChanged(QString)), SLOT(onServerRootUrlChanged(QString)));
+  QObject::connect(ui->tabWidget, SIGNAL(currentChanged(int)), SLOT(onTabChanged(int)));
+  QObject::connect(ui->refreshMetricsPushButton, SIGNAL(pressed()), SLOT(refreshMetrics()));
+  QObject::connect(ui->resetMetricsPushButton, SIGNAL(pressed()), SLOT(resetMetrics()));
+  QObject::connect(ui->saveMetricsPushButton, SIGNAL(pressed()), SLOT(saveMetrics()));
   QObject::connect(ui->saltLengthSpinBox, SIGNAL(valueChanged(int)), SIGNAL(saltLengthChanged(int)));
   QObject::connect(ui->maxPasswordLengthSpinBox, SIGNAL(valueChanged(int)), SIGNAL(maxPasswordLengthChanged(int)));
   QObject::connect(ui->defaultPasswordLengthSpinBox, SIGNAL(valueChanged(int)), SIGNAL(defaultPasswordLengthChanged(int)));
@@ -253,6 +258,18 @@ void OptionsDialog::setSyncOnStart(bool doSync)
 }
 
 
+bool OptionsDialog::syncAutomatically(void) const
+{
+  return ui->syncAutomaticallyCheckBox->isChecked();
+}
+
+
+void OptionsDialog::setSyncAutomatically(bool doSync)
+{
+  ui->syncAutomaticallyCheckBox->setChecked(doSync);
+}
+
+
 QString OptionsDialog::syncFilename(void) const
 {
   return ui->syncFileLineEdit->text();
@@ -346,6 +363,18 @@ int OptionsDialog::maxBackupFileAge(void) const
 }
 
 
+void OptionsDialog::setMaxBackupCount(int n)
+{
+  ui->maxBackupCountSpinBox->setValue(n);
+}
+
+
+int OptionsDialog::maxBackupCount(void) const
+{
+  return ui->maxBackupCountSpinBox->value();
+}
+
+
 void OptionsDialog::setLoggingEnabled(bool enabled)
 {
   ui->enabledLoggingCheckBox->setChecked(enabled);
@@ -551,6 +580,47 @@ void OptionsDialog::chooseSyncFile(void)
 }
 
 
+void OptionsDialog::showEvent(QShowEvent *e)
+{
+  QDialog::showEvent(e);
+  if (ui->tabWidget->currentWidget() == ui->tabDiagnostics) {
+    refreshMetrics();
+  }
+}
+
+
+void OptionsDialog::onTabChanged(int)
+{
+  if (ui->tabWidget->currentWidget() == ui->tabDiagnostics) {
+    refreshMetrics();
+  }
+}
+
+
+void OptionsDialog::refreshMetrics(void)
+{
+  ui->metricsPlainTextEdit->setPlainText(Metrics::instance().toText());
+}
+
+
+void OptionsDialog::resetMetrics(void)
+{
+  Metrics::instance().reset();
+  refreshMetrics();
+}
+
+
+void OptionsDialog::saveMetrics(void)
+{
+  const QString &filename = QFileDialog::getSaveFileName(this, tr("Save metrics"), QString(), tr("JSON file (*.json);;Text file (*.txt)"));
+  if (filename.isEmpty())
+    return;
+  if (!Metrics::instance().dump(filename)) {
+    QMessageBox::warning(this, tr("Cannot save metrics"), tr("The metrics could not be written to %1.").arg(filename));
+  }
+}
+
+
 void OptionsDialog::choosePasswordFile()
 {
   const QString &currentFile = ui->passwordFileLineEdit->text();
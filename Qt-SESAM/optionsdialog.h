@@ -28,6 +28,7 @@
 #include <QList>
 #include <QString>
 #include <QEvent>
+#include <QShowEvent>
 
 namespace Ui {
 class OptionsDialog;
@@ -45,6 +46,8 @@ public:
 
   bool syncOnStart(void) const;
   void setSyncOnStart(bool);
+  bool syncAutomatically(void) const;
+  void setSyncAutomatically(bool);
 
   QString syncFilename(void) const;
   void setSyncFilename(const QString &);
@@ -94,6 +97,9 @@ public:
   void setMaxBackupFileAge(int days);
   int maxBackupFileAge(void) const;
 
+  void setMaxBackupCount(int);
+  int maxBackupCount(void) const;
+
   void setLoggingEnabled(bool);
   bool loggingEnabled(void) const;
 
@@ -146,6 +152,13 @@ private slots:
   void onReadFinished(QNetworkReply*);
   void sslErrorsOccured(QNetworkReply *, const QList<QSslError> &);
   void onServerRootUrlChanged(QString);
+  void onTabChanged(int);
+  void refreshMetrics(void);
+  void resetMetrics(void);
+  void saveMetrics(void);
+
+protected:
+  void showEvent(QShowEvent *);
 
 private:
   Ui::OptionsDialog *ui;
@@ -19,149 +19,209 @@
 
 
 #include "passwordchecker.h"
+#include "wordlist.h"
+#include "breachfilter.h"
 
 #include <QDebug>
-#include <QFile>
 #include <QColor>
+#include <QStandardPaths>
+#include <QFuture>
+#include <QFutureWatcher>
+#include <QtConcurrent>
+
+#include <cmath>
 
 class PasswordCheckerPrivate
 {
 public:
   PasswordCheckerPrivate(void)
+    : loadOk(false)
+    , loading(false)
   { /* ... */ }
   ~PasswordCheckerPrivate()
   { /* ... */ }
-  QFile pwdFile;
-  QString pwdFilename;
+  WordList wordList;
+  BreachFilter breachFilter;
+  QFuture<void> loadFuture;
+  QFutureWatcher<void> loadWatcher;
+  bool loadOk;
+  bool loading;
 };
 
 
+/*!
+ * \brief PasswordChecker::PasswordChecker
+ *
+ * Opens the password file in a worker thread, which may take a while the first
+ * time a large list is indexed. The file may as well be a breach filter built
+ * by SESAMBreachFilter. `ready()` is emitted in the thread the checker
+ * lives in when it's done; until then `findInPasswordFile()` doesn't find
+ * anything.
+ */
 PasswordChecker::PasswordChecker(const QString &passwordFilename, QObject *parent)
   : QObject(parent)
   , d_ptr(new PasswordCheckerPrivate)
 {
-  d_ptr->pwdFilename = passwordFilename;
+  Q_D(PasswordChecker);
+  if (!passwordFilename.isEmpty()) {
+    d->wordList.setFileName(passwordFilename);
+    d->breachFilter.setFileName(passwordFilename);
+    d->wordList.setCacheDirectory(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/wordlists");
+    d->loading = true;
+    QObject::connect(&d->loadWatcher, SIGNAL(finished()), SLOT(onLoaded()));
+    d->loadFuture = QtConcurrent::run(this, &PasswordChecker::loadThread);
+    d->loadWatcher.setFuture(d->loadFuture);
+  }
 }
 
 
 PasswordChecker::~PasswordChecker()
 {
-  // ...
+  Q_D(PasswordChecker);
+  d->wordList.abort();
+  d->loadFuture.waitForFinished();
 }
 
 
-qint64 PasswordChecker::findInPasswordFile(const QString &needle)
+void PasswordChecker::loadThread(void)
 {
   Q_D(PasswordChecker);
-  qint64 pos = -1;
-  if (!d->pwdFilename.isEmpty()) {
-    d->pwdFile.setFileName(d->pwdFilename);
-    d->pwdFile.open(QIODevice::ReadOnly);
-    if (d->pwdFile.isOpen()) {
-      pos = findInPasswordFile(0, d->pwdFile.size(), needle);
-      d->pwdFile.close();
-    }
+  const bool isFilter = BreachFilter::isFilterFile(d->breachFilter.fileName());
+  const bool ok = isFilter ? d->breachFilter.open() : d->wordList.open();
+  if (!ok) {
+    qWarning() << "Cannot open password file" << d->wordList.fileName() << ":"
+               << (isFilter ? d->breachFilter.errorString() : d->wordList.errorString());
   }
-  return pos;
+  d->loadOk = ok;
 }
 
 
-qint64 PasswordChecker::findInPasswordFile(qint64 lo, qint64 hi, const QString &needle)
+void PasswordChecker::onLoaded(void)
 {
   Q_D(PasswordChecker);
-  if (hi <= lo)
-    return -1;
-  qint64 mid = (lo + hi) / 2;
-  d->pwdFile.seek(mid);
-  char ch = '\0';
-  while (d->pwdFile.read(&ch, 1) == 1 && !d->pwdFile.atEnd()) {
-    if (ch == '\n')
-      break;
-    d->pwdFile.seek(d->pwdFile.pos() - 2);
-  }
-  mid = d->pwdFile.pos();
-  const QString &word = QString::fromLatin1(d->pwdFile.readLine()).trimmed();
-  const int comparison = needle.compare(word, Qt::CaseInsensitive);
-  if (comparison < 0) {
-    return findInPasswordFile(lo, mid - 1, needle);
-  }
-  else if (comparison > 0) {
-    return findInPasswordFile(mid + word.size(), hi, needle);
-  }
-  return mid;
+  d->loading = false;
+  emit ready(d->loadOk);
 }
 
 
-qreal PasswordChecker::entropy(const QString &str) {
-  static const int Range = 256;
-  const QByteArray &sample = str.toLatin1();
-  QVector<int> histo(Range, 0);
-  for (int i = 0; i < sample.size(); ++i) {
-    ++histo[static_cast<uchar>(sample.at(i))];
-  }
-  qreal ent = 0;
-  const qreal l = sample.size();
-  for (int i = 0; i < Range; ++i) {
-    const qreal p = qreal(histo[i]) / l;
-    if (p > 0) {
-      ent += p * M_LOG2E * qLn(1.0 / p);
-    }
-  }
-  const qreal bitsPerVariate = qLn(qreal(Range)) * M_LOG2E;
-  return ent / bitsPerVariate;
+QString PasswordChecker::passwordFilename(void) const
+{
+  Q_D(const PasswordChecker);
+  return d->wordList.fileName();
 }
 
 
-void PasswordChecker::evaluatePasswordStrength(const QString &password, QColor &color, QString &grade, qreal *_fitness)
+bool PasswordChecker::isReady(void) const
 {
-  qreal fitness = 0;
+  Q_D(const PasswordChecker);
+  return d->loadFuture.isFinished() && (d->wordList.isOpen() || d->breachFilter.isOpen());
+}
+
+
+/*!
+ * \brief PasswordChecker::isLoading
+ *
+ * \return `true` until `ready()` has been emitted
+ */
+bool PasswordChecker::isLoading(void) const
+{
+  Q_D(const PasswordChecker);
+  return d->loading;
+}
+
+
+/*!
+ * \brief PasswordChecker::isStale
+ *
+ * \return `true` if the password file has been modified since it was loaded
+ */
+bool PasswordChecker::isStale(void) const
+{
+  Q_D(const PasswordChecker);
+  return d->loadFuture.isFinished() && d->wordList.isStale();
+}
+
+
+void PasswordChecker::waitForFinished(void)
+{
+  Q_D(PasswordChecker);
+  d->loadFuture.waitForFinished();
+}
+
+
+/*!
+ * \brief PasswordChecker::findInPasswordFile
+ *
+ * Only reads from the loaded file, so it's safe to call from multiple threads once loading has finished.
+ */
+qint64 PasswordChecker::findInPasswordFile(const QString &needle)
+{
+  Q_D(PasswordChecker);
+  if (!isReady())
+    return -1;
+  if (d->breachFilter.isOpen())
+    return d->breachFilter.containsPassword(needle) ? 0 : -1;
+  return d->wordList.find(needle.toUtf8(), Qt::CaseInsensitive);
+}
+
+
+/*!
+ * \brief PasswordChecker::evaluatePasswordStrength
+ *
+ * Grades a password by the time an attacker needs to crack it as estimated
+ * by `estimator`, which must already have been fed the password.
+ */
+void PasswordChecker::evaluatePasswordStrength(const StrengthEstimator &estimator, QColor &color, QString &grade)
+{
+  static const qreal Minute = 60;
+  static const qreal Hour = 60 * Minute;
+  static const qreal Day = 24 * Hour;
+  static const qreal Month = 31 * Day;
+  static const qreal Year = 365 * Day;
   color.setRgb(153, 153, 153);
-  if (password.isEmpty()) {
+  if (estimator.password().isEmpty()) {
     grade = "?";
+    return;
+  }
+  const qreal t = estimator.crackTimeLog10Seconds();
+  if (t >= std::log10(1e6 * Year)) {
+    color.setRgb(0, 255, 30);
+    grade = tr("Supercalifragilisticexpialidocious");
+  }
+  else if (t >= std::log10(1e4 * Year)) {
+    color.setRgb(0, 255, 30);
+    grade = tr("Brutally strong");
+  }
+  else if (t >= std::log10(100 * Year)) {
+    color.setRgb(0, 255, 30);
+    grade = tr("Fabulous");
+  }
+  else if (t >= std::log10(Year)) {
+    color.setRgb(0, 255, 30);
+    grade = tr("Very good");
+  }
+  else if (t >= std::log10(Month)) {
+    color.setRgb(111, 255, 0);
+    grade = tr("Good");
+  }
+  else if (t >= std::log10(Day)) {
+    color.setRgb(234, 255, 0);
+    grade = tr("Mediocre");
+  }
+  else if (t >= std::log10(Hour)) {
+    color.setRgb(255, 153, 0);
+    grade = tr("You can do better");
+  }
+  else if (t >= std::log10(Minute)) {
+    color.setRgb(255, 48, 0);
+    grade = tr("Bad");
+  }
+  else if (t >= 0) {
+    color.setRgb(255, 0, 0);
+    grade = tr("It can hardly be worse");
   }
   else {
-    fitness = password.size() * entropy(password);
-    if (fitness >= 11.0) {
-      color.setRgb(0, 255, 30);
-      grade = tr("Supercalifragilisticexpialidocious");
-    }
-    else if (fitness >= 9.0) {
-      color.setRgb(0, 255, 30);
-      grade = tr("Brutally strong");
-    }
-    else if (fitness >= 7.0) {
-      color.setRgb(0, 255, 30);
-      grade = tr("Fabulous");
-    }
-    else if (fitness >= 5.0) {
-      color.setRgb(0, 255, 30);
-      grade = tr("Very good");
-    }
-    else if (fitness >= 4.0) {
-      color.setRgb(111, 255, 0);
-      grade = tr("Good");
-    }
-    else if (fitness >= 3.0) {
-      color.setRgb(234, 255, 0);
-      grade = tr("Mediocre");
-    }
-    else if (fitness >= 2.5) {
-      color.setRgb(255, 153, 0);
-      grade = tr("You can do better");
-    }
-    else if (fitness >= 2.0) {
-      color.setRgb(255, 48, 0);
-      grade = tr("Bad");
-    }
-    else if (fitness >= 1.5) {
-      color.setRgb(255, 0, 0);
-      grade = tr("It can hardly be worse");
-    }
-    else {
-      color.setRgb(200, 0, 0);
-      grade = tr("Useless");
-    }
+    color.setRgb(200, 0, 0);
+    grade = tr("Useless");
   }
-  if (_fitness != Q_NULLPTR)
-    *_fitness = fitness;
 }
@@ -24,9 +24,11 @@
 #include <QtGlobal>
 #include <QObject>
 #include <QByteArray>
+#include <QString>
 #include <QScopedPointer>
 
 #include "util.h"
+#include "strengthestimator.h"
 
 class PasswordCheckerPrivate;
 
@@ -37,14 +39,20 @@ public:
   explicit PasswordChecker(const QString &passwordFilename = QString(), QObject *parent = Q_NULLPTR);
   ~PasswordChecker();
 
+  QString passwordFilename(void) const;
+  bool isReady(void) const;
+  bool isLoading(void) const;
+  bool isStale(void) const;
+  void waitForFinished(void);
   qint64 findInPasswordFile(const QString &needle);
 
-  static qreal entropy(const QString &);
-  static void evaluatePasswordStrength(const QString &password, QColor &color, QString &grade, qreal *_fitness);
+  static void evaluatePasswordStrength(const StrengthEstimator &estimator, QColor &color, QString &grade);
 
 signals:
+  void ready(bool ok);
 
-public slots:
+private slots:
+  void onLoaded(void);
 
 private:
   QScopedPointer<PasswordCheckerPrivate> d_ptr;
@@ -52,7 +60,7 @@ private:
   Q_DISABLE_COPY(PasswordChecker)
 
 private: // methods
-  qint64 findInPasswordFile(qint64 lo, qint64 hi, const QString &needle);
+  void loadThread(void);
 };
 
 #endif // __PASSWORDCHECKER_H_
@@ -0,0 +1,113 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include <cstdlib>
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <QVector>
+
+#include "qrcoderenderer.h"
+#include "qrencode.h"
+#include "qrraster.h"
+
+
+const int QRCodeRenderer::DefaultModuleSize = 10;
+const int QRCodeRenderer::DefaultMargin = 1;
+
+// libqrencode is built without pthread support, so its frame and Reed-Solomon caches must not be filled concurrently
+static QMutex encoderMutex;
+
+
+static QRcode *encode(const QByteArray &data)
+{
+  QMutexLocker locker(&encoderMutex);
+  return QRcode_encodeData(data.size(), reinterpret_cast<const unsigned char*>(data.constData()), 0, QR_ECLEVEL_L);
+}
+
+
+/*!
+ * \brief QRCodeRenderer::toImage
+ *
+ * Encodes `data` in 8-bit mode and rasterizes the symbol straight into the image buffer,
+ * so no paint device is involved and it's safe to call this function from any thread.
+ *
+ * \param data the bytes to encode
+ * \param moduleSize width of a module in pixels
+ * \param margin width of the quiet zone in modules
+ * \param format `QImage::Format_Mono` and `QImage::Format_Grayscale8` are rendered directly,
+ * other formats are converted from an 8 bit image
+ * \return the QR code; a null image if `data` could not be encoded
+ */
+QImage QRCodeRenderer::toImage(const QByteArray &data, int moduleSize, int margin, QImage::Format format)
+{
+  QRcode *qrcode = encode(data);
+  if (qrcode == Q_NULLPTR)
+    return QImage();
+  QImage img;
+  const int sz = QRraster_size(qrcode, moduleSize, margin);
+  if (sz > 0) {
+    if (format == QImage::Format_Mono) {
+      img = QImage(sz, sz, QImage::Format_Mono);
+      img.setColorTable(QVector<QRgb>() << qRgb(255, 255, 255) << qRgb(0, 0, 0));
+      QRraster_renderMono(qrcode, moduleSize, margin, img.bits(), img.bytesPerLine());
+    }
+    else {
+#if QT_VERSION >= 0x050500
+      img = QImage(sz, sz, QImage::Format_Grayscale8);
+#else
+      img = QImage(sz, sz, QImage::Format_Indexed8);
+      QVector<QRgb> grays(256);
+      for (int i = 0; i < grays.size(); ++i)
+        grays[i] = qRgb(i, i, i);
+      img.setColorTable(grays);
+#endif
+      QRraster_renderGray8(qrcode, moduleSize, margin, img.bits(), img.bytesPerLine());
+      if (img.format() != format) {
+        img = img.convertToFormat(format);
+      }
+    }
+  }
+  QRcode_free(qrcode);
+  return img;
+}
+
+
+/*!
+ * \brief QRCodeRenderer::toSvg
+ *
+ * Encodes `data` in 8-bit mode and renders the symbol as an SVG document.
+ *
+ * \return the SVG document; an empty byte array if `data` could not be encoded
+ */
+QByteArray QRCodeRenderer::toSvg(const QByteArray &data, int moduleSize, int margin)
+{
+  QRcode *qrcode = encode(data);
+  if (qrcode == Q_NULLPTR)
+    return QByteArray();
+  QByteArray result;
+  char *svg = QRraster_svg(qrcode, moduleSize, margin);
+  if (svg != Q_NULLPTR) {
+    result = QByteArray(svg);
+    free(svg);
+  }
+  QRcode_free(qrcode);
+  return result;
+}
@@ -0,0 +1,37 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef __QRCODERENDERER_H_
+#define __QRCODERENDERER_H_
+
+#include <QByteArray>
+#include <QImage>
+
+class QRCodeRenderer
+{
+public:
+  static const int DefaultModuleSize;
+  static const int DefaultMargin;
+
+  static QImage toImage(const QByteArray &data, int moduleSize = DefaultModuleSize, int margin = DefaultMargin, QImage::Format format = QImage::Format_Mono);
+  static QByteArray toSvg(const QByteArray &data, int moduleSize = DefaultModuleSize, int margin = DefaultMargin);
+};
+
+#endif // __QRCODERENDERER_H_
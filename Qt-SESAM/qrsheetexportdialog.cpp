@@ -0,0 +1,195 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include <QListWidgetItem>
+#include <QSet>
+
+#include "qrsheetexportdialog.h"
+#include "ui_qrsheetexportdialog.h"
+
+
+static bool isInGroup(const QString &groupHierarchy, const QString &group)
+{
+  return groupHierarchy == group
+      || groupHierarchy.startsWith(group + "/")
+      || groupHierarchy.startsWith(group + ";");
+}
+
+
+class QRSheetExportDialogPrivate
+{
+public:
+  QRSheetExportDialogPrivate(void)
+  { /* ... */ }
+  QList<DomainIndex::Entry> entries;
+};
+
+
+/*!
+ * \brief QRSheetExportDialog::QRSheetExportDialog
+ *
+ * Lets the user pick the domains to be printed as QR code sheets,
+ * one by one or by group or tag.
+ */
+QRSheetExportDialog::QRSheetExportDialog(QWidget *parent)
+  : QDialog(parent)
+  , ui(new Ui::QRSheetExportDialog)
+  , d_ptr(new QRSheetExportDialogPrivate)
+{
+  ui->setupUi(this);
+  setWindowIcon(QIcon(":/images/ctSESAM.ico"));
+  QObject::connect(ui->checkAllPushButton, SIGNAL(clicked(bool)), SLOT(checkAll()));
+  QObject::connect(ui->checkNonePushButton, SIGNAL(clicked(bool)), SLOT(checkNone()));
+  QObject::connect(ui->checkSelectedPushButton, SIGNAL(clicked(bool)), SLOT(checkSelected()));
+  QObject::connect(ui->checkGroupPushButton, SIGNAL(clicked(bool)), SLOT(checkGroup()));
+  QObject::connect(ui->checkTagPushButton, SIGNAL(clicked(bool)), SLOT(checkTag()));
+  QObject::connect(ui->domainsListWidget, SIGNAL(itemChanged(QListWidgetItem*)), SLOT(updateCount()));
+  QObject::connect(ui->okPushButton, SIGNAL(clicked(bool)), SLOT(accept()));
+  QObject::connect(ui->cancelPushButton, SIGNAL(clicked(bool)), SLOT(reject()));
+}
+
+
+QRSheetExportDialog::~QRSheetExportDialog()
+{
+  delete ui;
+}
+
+
+void QRSheetExportDialog::setEntries(const QList<DomainIndex::Entry> &entries)
+{
+  Q_D(QRSheetExportDialog);
+  d->entries.clear();
+  ui->domainsListWidget->clear();
+  QSet<QString> groups;
+  QSet<QString> tags;
+  foreach (DomainIndex::Entry e, entries) {
+    if (e.deleted)
+      continue;
+    d->entries << e;
+    QListWidgetItem *item = new QListWidgetItem(e.domainName);
+    item->setFlags(item->flags() | Qt::ItemIsUserCheckable);
+    item->setCheckState(Qt::Unchecked);
+    if (!e.groupHierarchy.isEmpty()) {
+      item->setToolTip(e.groupHierarchy);
+      for (int i = 0; i < e.groupHierarchy.size(); ++i) {
+        if (e.groupHierarchy.at(i) == QChar('/') || e.groupHierarchy.at(i) == QChar(';')) {
+          groups << e.groupHierarchy.left(i);
+        }
+      }
+      groups << e.groupHierarchy;
+    }
+    tags += e.tags.toSet();
+    ui->domainsListWidget->addItem(item);
+  }
+  QStringList groupList = groups.toList();
+  groupList.sort(Qt::CaseInsensitive);
+  ui->groupComboBox->clear();
+  ui->groupComboBox->addItems(groupList);
+  ui->groupComboBox->setEnabled(!groupList.isEmpty());
+  ui->checkGroupPushButton->setEnabled(!groupList.isEmpty());
+  QStringList tagList = tags.toList();
+  tagList.sort(Qt::CaseInsensitive);
+  ui->tagComboBox->clear();
+  ui->tagComboBox->addItems(tagList);
+  ui->tagComboBox->setEnabled(!tagList.isEmpty());
+  ui->checkTagPushButton->setEnabled(!tagList.isEmpty());
+  updateCount();
+}
+
+
+QStringList QRSheetExportDialog::checkedDomains(void) const
+{
+  QStringList domains;
+  for (int i = 0; i < ui->domainsListWidget->count(); ++i) {
+    const QListWidgetItem *item = ui->domainsListWidget->item(i);
+    if (item->checkState() == Qt::Checked) {
+      domains << item->text();
+    }
+  }
+  return domains;
+}
+
+
+int QRSheetExportDialog::columns(void) const
+{
+  return ui->columnsSpinBox->value();
+}
+
+
+int QRSheetExportDialog::rows(void) const
+{
+  return ui->rowsSpinBox->value();
+}
+
+
+void QRSheetExportDialog::checkAll(void)
+{
+  for (int i = 0; i < ui->domainsListWidget->count(); ++i) {
+    ui->domainsListWidget->item(i)->setCheckState(Qt::Checked);
+  }
+}
+
+
+void QRSheetExportDialog::checkNone(void)
+{
+  for (int i = 0; i < ui->domainsListWidget->count(); ++i) {
+    ui->domainsListWidget->item(i)->setCheckState(Qt::Unchecked);
+  }
+}
+
+
+void QRSheetExportDialog::checkSelected(void)
+{
+  foreach (QListWidgetItem *item, ui->domainsListWidget->selectedItems()) {
+    item->setCheckState(Qt::Checked);
+  }
+}
+
+
+void QRSheetExportDialog::checkGroup(void)
+{
+  Q_D(QRSheetExportDialog);
+  const QString &group = ui->groupComboBox->currentText();
+  for (int i = 0; i < d->entries.count(); ++i) {
+    if (isInGroup(d->entries.at(i).groupHierarchy, group)) {
+      ui->domainsListWidget->item(i)->setCheckState(Qt::Checked);
+    }
+  }
+}
+
+
+void QRSheetExportDialog::checkTag(void)
+{
+  Q_D(QRSheetExportDialog);
+  const QString &tag = ui->tagComboBox->currentText();
+  for (int i = 0; i < d->entries.count(); ++i) {
+    if (d->entries.at(i).tags.contains(tag)) {
+      ui->domainsListWidget->item(i)->setCheckState(Qt::Checked);
+    }
+  }
+}
+
+
+void QRSheetExportDialog::updateCount(void)
+{
+  const int n = checkedDomains().count();
+  ui->countLabel->setText(tr("%1 of %2 domains").arg(n).arg(ui->domainsListWidget->count()));
+  ui->okPushButton->setEnabled(n > 0);
+}
@@ -0,0 +1,66 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef __QRSHEETEXPORTDIALOG_H_
+#define __QRSHEETEXPORTDIALOG_H_
+
+#include <QDialog>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <QScopedPointer>
+
+#include "domainindex.h"
+
+
+namespace Ui {
+class QRSheetExportDialog;
+}
+
+class QRSheetExportDialogPrivate;
+
+class QRSheetExportDialog : public QDialog
+{
+  Q_OBJECT
+
+public:
+  explicit QRSheetExportDialog(QWidget *parent = Q_NULLPTR);
+  ~QRSheetExportDialog();
+  void setEntries(const QList<DomainIndex::Entry> &entries);
+  QStringList checkedDomains(void) const;
+  int columns(void) const;
+  int rows(void) const;
+
+private slots:
+  void checkAll(void);
+  void checkNone(void);
+  void checkSelected(void);
+  void checkGroup(void);
+  void checkTag(void);
+  void updateCount(void);
+
+private:
+  Ui::QRSheetExportDialog *ui;
+  QScopedPointer<QRSheetExportDialogPrivate> d_ptr;
+  Q_DECLARE_PRIVATE(QRSheetExportDialog)
+  Q_DISABLE_COPY(QRSheetExportDialog)
+};
+
+#endif // __QRSHEETEXPORTDIALOG_H_
@@ -0,0 +1,401 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include <QObject>
+#include <QFile>
+#include <QFileInfo>
+#include <QFont>
+#include <QFontMetrics>
+#include <QPainter>
+#include <QPdfWriter>
+#include <QPen>
+#include <QRect>
+
+#include "qrsheetwriter.h"
+#include "global.h"
+#include "util.h"
+
+
+const int QRSheetWriter::DefaultColumns = 3;
+const int QRSheetWriter::DefaultRows = 4;
+const int QRSheetWriter::DefaultResolution = 300;
+
+static const qreal PageWidthMm = 210;
+static const qreal PageHeightMm = 297;
+static const qreal PageMarginMm = 10;
+static const qreal CellPaddingMm = 3;
+
+
+class QRSheetWriterPrivate {
+public:
+  QRSheetWriterPrivate(void)
+    : format(QRSheetWriter::PdfFormat)
+    , columns(QRSheetWriter::DefaultColumns)
+    , rows(QRSheetWriter::DefaultRows)
+    , resolution(QRSheetWriter::DefaultResolution)
+    , pdf(Q_NULLPTR)
+    , cell(-1)
+    , pages(0)
+  { /* ... */ }
+  ~QRSheetWriterPrivate()
+  {
+    if (painter.isActive()) {
+      painter.end();
+    }
+    SafeDelete(pdf);
+  }
+  int mmToPixels(qreal mm) const
+  {
+    return qRound(mm * resolution / 25.4);
+  }
+  QString pageFileName(int page) const
+  {
+    const QFileInfo fi(fileName);
+    return QString("%1/%2-%3.%4")
+        .arg(fi.absolutePath())
+        .arg(fi.completeBaseName())
+        .arg(page, 3, 10, QChar('0'))
+        .arg(fi.suffix().isEmpty() ? QString("png") : fi.suffix());
+  }
+  QRect printableArea(void) const
+  {
+    const QPaintDevice *device = painter.device();
+    const int margin = mmToPixels(PageMarginMm);
+    return QRect(0, 0, device->width(), device->height()).adjusted(margin, margin, -margin, -margin);
+  }
+  bool beginPage(void)
+  {
+    if (format == QRSheetWriter::PdfFormat) {
+      if (pages > 0 && !pdf->newPage()) {
+        errorString = QObject::tr("Cannot add a page to %1").arg(fileName);
+        return false;
+      }
+    }
+    else {
+      page.fill(Qt::white);
+      if (!painter.begin(&page)) {
+        errorString = QObject::tr("Cannot paint the page");
+        return false;
+      }
+    }
+    ++pages;
+    cell = 0;
+    drawHeader();
+    return true;
+  }
+  bool endPage(void)
+  {
+    cell = -1;
+    if (format == QRSheetWriter::PngFormat) {
+      painter.end();
+      const QString &filename = pageFileName(pages);
+      if (!page.save(filename, "PNG")) {
+        errorString = QObject::tr("Cannot write %1").arg(filename);
+        return false;
+      }
+      files << filename;
+    }
+    return true;
+  }
+  void drawHeader(void)
+  {
+    const QRect &area = printableArea();
+    QFont font;
+    font.setPointSizeF(8);
+    painter.setFont(font);
+    painter.setPen(Qt::black);
+    const QRect header(area.left(), area.top(), area.width(), painter.fontMetrics().lineSpacing());
+    painter.drawText(header, Qt::AlignLeft | Qt::AlignVCenter, title);
+    painter.drawText(header, Qt::AlignRight | Qt::AlignVCenter, QObject::tr("Page %1").arg(pages));
+  }
+  void drawCell(const QRSheetWriter::Cell &c)
+  {
+    QFont font;
+    font.setPointSizeF(8);
+    painter.setFont(font);
+    const int lineSpacing = painter.fontMetrics().lineSpacing();
+    const QRect &area = printableArea();
+    const QRect grid = area.adjusted(0, 2 * lineSpacing, 0, 0);
+    const int w = grid.width() / columns;
+    const int h = grid.height() / rows;
+    const QRect frame(grid.left() + (cell % columns) * w, grid.top() + (cell / columns) * h, w, h);
+    const int padding = mmToPixels(CellPaddingMm);
+    const QRect r = frame.adjusted(padding, padding, -padding, -padding);
+    painter.setPen(QPen(Qt::lightGray, 0, Qt::DashLine));
+    painter.drawRect(frame);
+    painter.setPen(Qt::black);
+    const int side = qMin(r.width(), r.height() - 2 * lineSpacing);
+    if (!c.code.isNull() && side >= c.code.width()) {
+      // integral module sizes keep the modules crisp on raster devices
+      const int sz = (side / c.code.width()) * c.code.width();
+      painter.drawImage(QRect(r.left() + (r.width() - sz) / 2, r.top() + (side - sz) / 2, sz, sz), c.code);
+    }
+    else {
+      painter.drawText(QRect(r.left(), r.top(), r.width(), side), Qt::AlignCenter | Qt::TextWordWrap, QObject::tr("Too much data for a QR code"));
+    }
+    const QRect titleRect(r.left(), r.top() + side, r.width(), lineSpacing);
+    const QRect subtitleRect = titleRect.translated(0, lineSpacing);
+    painter.drawText(subtitleRect, Qt::AlignHCenter | Qt::AlignVCenter, painter.fontMetrics().elidedText(c.subtitle, Qt::ElideMiddle, r.width()));
+    font.setBold(true);
+    painter.setFont(font);
+    painter.drawText(titleRect, Qt::AlignHCenter | Qt::AlignVCenter, painter.fontMetrics().elidedText(c.title, Qt::ElideMiddle, r.width()));
+  }
+
+  QString fileName;
+  QRSheetWriter::Format format;
+  int columns;
+  int rows;
+  int resolution;
+  QString title;
+  QPdfWriter *pdf;
+  QImage page;
+  QPainter painter;
+  int cell;
+  int pages;
+  QStringList files;
+  QString errorString;
+};
+
+
+/*!
+ * \brief QRSheetWriter::QRSheetWriter
+ *
+ * A `QRSheetWriter` lays out labelled QR codes in a grid on A4 pages, either as a
+ * multipage PDF or as one PNG file per page. Pages are written as soon as they are
+ * full, so only the page being filled is held in memory, no matter how many codes
+ * are written.
+ */
+QRSheetWriter::QRSheetWriter(void)
+  : d_ptr(new QRSheetWriterPrivate)
+{
+  /* ... */
+}
+
+
+QRSheetWriter::~QRSheetWriter()
+{
+  /* ... */
+}
+
+
+void QRSheetWriter::setFileName(const QString &fileName)
+{
+  Q_D(QRSheetWriter);
+  d->fileName = fileName;
+}
+
+
+QString QRSheetWriter::fileName(void) const
+{
+  Q_D(const QRSheetWriter);
+  return d->fileName;
+}
+
+
+void QRSheetWriter::setFormat(Format format)
+{
+  Q_D(QRSheetWriter);
+  d->format = format;
+}
+
+
+QRSheetWriter::Format QRSheetWriter::format(void) const
+{
+  Q_D(const QRSheetWriter);
+  return d->format;
+}
+
+
+void QRSheetWriter::setGrid(int columns, int rows)
+{
+  Q_D(QRSheetWriter);
+  d->columns = qMax(1, columns);
+  d->rows = qMax(1, rows);
+}
+
+
+int QRSheetWriter::columns(void) const
+{
+  Q_D(const QRSheetWriter);
+  return d->columns;
+}
+
+
+int QRSheetWriter::rows(void) const
+{
+  Q_D(const QRSheetWriter);
+  return d->rows;
+}
+
+
+int QRSheetWriter::cellsPerPage(void) const
+{
+  Q_D(const QRSheetWriter);
+  return d->columns * d->rows;
+}
+
+
+void QRSheetWriter::setResolution(int dpi)
+{
+  Q_D(QRSheetWriter);
+  d->resolution = dpi;
+}
+
+
+int QRSheetWriter::resolution(void) const
+{
+  Q_D(const QRSheetWriter);
+  return d->resolution;
+}
+
+
+void QRSheetWriter::setTitle(const QString &title)
+{
+  Q_D(QRSheetWriter);
+  d->title = title;
+}
+
+
+QString QRSheetWriter::title(void) const
+{
+  Q_D(const QRSheetWriter);
+  return d->title;
+}
+
+
+bool QRSheetWriter::open(void)
+{
+  Q_D(QRSheetWriter);
+  d->pages = 0;
+  d->cell = -1;
+  d->files.clear();
+  d->errorString.clear();
+  if (d->format == PdfFormat) {
+    SafeRenew(d->pdf, new QPdfWriter(d->fileName));
+    d->pdf->setResolution(d->resolution);
+    d->pdf->setPageSize(QPagedPaintDevice::A4);
+    d->pdf->setTitle(d->title);
+    d->pdf->setCreator(AppName);
+    if (!d->painter.begin(d->pdf)) {
+      d->errorString = QObject::tr("Cannot write to %1").arg(d->fileName);
+      SafeDelete(d->pdf);
+      return false;
+    }
+    d->files << d->fileName;
+  }
+  else {
+#if QT_VERSION >= 0x050500
+    d->page = QImage(d->mmToPixels(PageWidthMm), d->mmToPixels(PageHeightMm), QImage::Format_Grayscale8);
+#else
+    d->page = QImage(d->mmToPixels(PageWidthMm), d->mmToPixels(PageHeightMm), QImage::Format_RGB32);
+#endif
+    if (d->page.isNull()) {
+      d->errorString = QObject::tr("Not enough memory for a page of %1 dpi").arg(d->resolution);
+      return false;
+    }
+    const int dotsPerMeter = qRound(d->resolution / 0.0254);
+    d->page.setDotsPerMeterX(dotsPerMeter);
+    d->page.setDotsPerMeterY(dotsPerMeter);
+  }
+  return true;
+}
+
+
+/*!
+ * \brief QRSheetWriter::write
+ *
+ * Adds a cell to the current page, starting a new page if necessary.
+ * The page is written out as soon as its last cell is filled.
+ *
+ * \param cell QR code with its quiet zone, rendered at one pixel per module, plus labels
+ * \return `false` if the page couldn't be written
+ */
+bool QRSheetWriter::write(const Cell &cell)
+{
+  Q_D(QRSheetWriter);
+  if (d->cell < 0 && !d->beginPage())
+    return false;
+  d->drawCell(cell);
+  if (++d->cell == cellsPerPage())
+    return d->endPage();
+  return true;
+}
+
+
+bool QRSheetWriter::close(void)
+{
+  Q_D(QRSheetWriter);
+  bool ok = true;
+  if (d->cell >= 0) {
+    ok = d->endPage();
+  }
+  if (d->format == PdfFormat) {
+    // the PDF is only completed and flushed to disk when painting ends
+    if (d->painter.isActive() && !d->painter.end() && ok) {
+      d->errorString = QObject::tr("Cannot write %1").arg(d->fileName);
+      ok = false;
+    }
+    SafeDelete(d->pdf);
+  }
+  d->page = QImage();
+  return ok;
+}
+
+
+/*!
+ * \brief QRSheetWriter::abort
+ *
+ * Stops writing and removes all files written so far.
+ */
+void QRSheetWriter::abort(void)
+{
+  Q_D(QRSheetWriter);
+  if (d->painter.isActive()) {
+    d->painter.end();
+  }
+  SafeDelete(d->pdf);
+  d->page = QImage();
+  d->cell = -1;
+  foreach (QString filename, d->files) {
+    QFile::remove(filename);
+  }
+  d->files.clear();
+}
+
+
+int QRSheetWriter::pageCount(void) const
+{
+  Q_D(const QRSheetWriter);
+  return d->pages;
+}
+
+
+QStringList QRSheetWriter::writtenFiles(void) const
+{
+  Q_D(const QRSheetWriter);
+  return d->files;
+}
+
+
+QString QRSheetWriter::errorString(void) const
+{
+  Q_D(const QRSheetWriter);
+  return d->errorString;
+}
@@ -0,0 +1,79 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef __QRSHEETWRITER_H_
+#define __QRSHEETWRITER_H_
+
+#include <QString>
+#include <QStringList>
+#include <QImage>
+#include <QScopedPointer>
+
+
+class QRSheetWriterPrivate;
+
+class QRSheetWriter
+{
+public:
+  enum Format {
+    PdfFormat,
+    PngFormat
+  };
+
+  struct Cell {
+    QImage code;
+    QString title;
+    QString subtitle;
+  };
+
+  QRSheetWriter(void);
+  ~QRSheetWriter();
+
+  void setFileName(const QString &);
+  QString fileName(void) const;
+  void setFormat(Format);
+  Format format(void) const;
+  void setGrid(int columns, int rows);
+  int columns(void) const;
+  int rows(void) const;
+  int cellsPerPage(void) const;
+  void setResolution(int dpi);
+  int resolution(void) const;
+  void setTitle(const QString &);
+  QString title(void) const;
+  bool open(void);
+  bool write(const Cell &);
+  bool close(void);
+  void abort(void);
+  int pageCount(void) const;
+  QStringList writtenFiles(void) const;
+  QString errorString(void) const;
+
+  static const int DefaultColumns;
+  static const int DefaultRows;
+  static const int DefaultResolution;
+
+private:
+  QScopedPointer<QRSheetWriterPrivate> d_ptr;
+  Q_DECLARE_PRIVATE(QRSheetWriter)
+  Q_DISABLE_COPY(QRSheetWriter)
+};
+
+#endif // __QRSHEETWRITER_H_
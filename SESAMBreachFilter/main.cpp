@@ -0,0 +1,174 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+#include "breachfilter.h"
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QFile>
+#include <QSaveFile>
+#include <QElapsedTimer>
+#include <QTextStream>
+
+#include <vector>
+
+
+static bool parseHexKey(const char *line, int len, quint64 &key)
+{
+  if (len < 16)
+    return false;
+  key = 0;
+  for (int i = 0; i < 16; ++i) {
+    const char c = line[i];
+    int v;
+    if (c >= '0' && c <= '9')
+      v = c - '0';
+    else if (c >= 'a' && c <= 'f')
+      v = c - 'a' + 10;
+    else if (c >= 'A' && c <= 'F')
+      v = c - 'A' + 10;
+    else
+      return false;
+    key = (key << 4) | quint64(v);
+  }
+  return true;
+}
+
+
+static bool readKeys(const QString &filename, bool plain, BreachFilter::HashAlgorithm algorithm, std::vector<quint64> &keys, qint64 &skipped, QTextStream &err)
+{
+  QFile in;
+  if (filename == "-") {
+    in.open(stdin, QIODevice::ReadOnly);
+  }
+  else {
+    in.setFileName(filename);
+    if (!in.open(QIODevice::ReadOnly)) {
+      err << QString("Cannot open %1: %2").arg(filename).arg(in.errorString()) << endl;
+      return false;
+    }
+    keys.reserve(keys.size() + size_t(in.size() / (plain ? 10 : 41)));
+  }
+  static const int MaxLineLength = 4096;
+  char line[MaxLineLength];
+  qint64 len;
+  while ((len = in.readLine(line, MaxLineLength)) > 0) {
+    while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+      --len;
+    if (len == 0)
+      continue;
+    quint64 key;
+    if (plain) {
+      const QString &password = QString::fromUtf8(line, int(len));
+      keys.push_back(BreachFilter::keyFromDigest(BreachFilter::digest(password, algorithm)));
+    }
+    else if (parseHexKey(line, int(len), key)) {
+      keys.push_back(key);
+    }
+    else {
+      ++skipped;
+    }
+  }
+  return true;
+}
+
+
+int main(int argc, char *argv[])
+{
+  QCoreApplication app(argc, argv);
+  app.setApplicationName("SESAMBreachFilter");
+  app.setApplicationVersion(QTSESAM_VERSION);
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription("Builds a breach filter for Qt-SESAM's password checker from lists of password hashes, "
+                                   "one hex encoded SHA-1 or NTLM hash per line, optionally followed by a colon and a count.");
+  parser.addHelpOption();
+  parser.addVersionOption();
+  parser.addPositionalArgument("files", "Hash lists to read; - reads from stdin.", "<file> ...");
+  QCommandLineOption outputOption(QStringList() << "o" << "output", "Write the filter to <file>.", "file");
+  QCommandLineOption ntlmOption("ntlm", "The lists contain NTLM instead of SHA-1 hashes.");
+  QCommandLineOption plainOption("plain", "The lists contain plain passwords, which are hashed before going into the filter.");
+  QCommandLineOption fpRateOption("fp-rate", "Accept a false positive rate of <r>; chooses 8, 16 or 32 bit fingerprints.", "r", "0.004");
+  QCommandLineOption bitsOption("bits", "Use fingerprints of <n> bits (8, 16 or 32) regardless of --fp-rate.", "n");
+  parser.addOption(outputOption);
+  parser.addOption(ntlmOption);
+  parser.addOption(plainOption);
+  parser.addOption(fpRateOption);
+  parser.addOption(bitsOption);
+  parser.process(app);
+
+  QTextStream out(stdout);
+  QTextStream err(stderr);
+  if (!parser.isSet(outputOption) || parser.positionalArguments().isEmpty()) {
+    parser.showHelp(EXIT_FAILURE);
+  }
+  const BreachFilter::HashAlgorithm algorithm = parser.isSet(ntlmOption) ? BreachFilter::Ntlm : BreachFilter::Sha1;
+  const int bits = parser.isSet(bitsOption)
+      ? parser.value(bitsOption).toInt()
+      : BreachFilter::fingerprintBitsFor(parser.value(fpRateOption).toDouble());
+
+  QElapsedTimer elapsed;
+  elapsed.start();
+  std::vector<quint64> keys;
+  qint64 skipped = 0;
+  foreach (QString filename, parser.positionalArguments()) {
+    out << QString("Reading %1 ...").arg(filename) << endl;
+    if (!readKeys(filename, parser.isSet(plainOption), algorithm, keys, skipped, err))
+      return EXIT_FAILURE;
+  }
+  out << QString("%1 hashes read in %2 s, %3 malformed lines skipped")
+         .arg(keys.size()).arg(1e-3 * elapsed.elapsed(), 0, 'f', 1).arg(skipped)
+      << endl;
+
+  elapsed.restart();
+  const QString &filename = parser.value(outputOption);
+  QSaveFile f(filename);
+  QString errorString;
+  if (!f.open(QIODevice::WriteOnly)) {
+    err << QString("Cannot write %1: %2").arg(filename).arg(f.errorString()) << endl;
+    return EXIT_FAILURE;
+  }
+  if (!BreachFilter::build(keys, algorithm, bits, &f, &errorString) || !f.commit()) {
+    err << QString("Cannot build %1: %2").arg(filename).arg(errorString.isEmpty() ? f.errorString() : errorString) << endl;
+    return EXIT_FAILURE;
+  }
+
+  BreachFilter filter(filename);
+  if (!filter.open()) {
+    err << filter.errorString() << endl;
+    return EXIT_FAILURE;
+  }
+  const size_t step = qMax(size_t(1), keys.size() / 100000);
+  for (size_t i = 0; i < keys.size(); i += step) {
+    if (!filter.contains(keys[i])) {
+      err << "Verification failed" << endl;
+      return EXIT_FAILURE;
+    }
+  }
+  out << QString("%1 distinct hashes, %2 bytes (%3 bytes per hash), false positive rate %4, built in %5 s")
+         .arg(filter.count())
+         .arg(filter.sizeInBytes())
+         .arg(filter.count() > 0 ? double(filter.sizeInBytes()) / filter.count() : 0.0, 0, 'f', 3)
+         .arg(filter.falsePositiveRate())
+         .arg(1e-3 * elapsed.elapsed(), 0, 'f', 1)
+      << endl;
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,223 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "loadclient.h"
+
+#include <QUrl>
+#include <QVariantMap>
+#include <QVariantList>
+#include <QJsonDocument>
+#include <QCryptographicHash>
+
+
+static QByteArray randomBytes(int n)
+{
+  QByteArray data(n, 0);
+  for (int i = 0; i < n; ++i) {
+    data[i] = char(qrand());
+  }
+  return data;
+}
+
+
+/*!
+ * \brief LoadClient::LoadClient
+ *
+ * Simulates one Qt-SESAM instance syncing with the server over a single
+ * kept-alive connection. It sends requests back to back, mostly reads,
+ * and now and then a write of all data or a patch, just like the real client.
+ * The payload is random, because the server never looks inside.
+ */
+LoadClient::LoadClient(const LoadOptions &options, LoadStats *stats, QObject *parent)
+  : QObject(parent)
+  , mOptions(options)
+  , mStats(stats)
+  , mRevision(0)
+  , mOperation(Read)
+  , mRunning(false)
+  , mWaiting(false)
+{
+  mAuthorization = "Basic " + (options.username + ":" + options.password).toBase64();
+  mPayload = randomBytes(options.payloadSize);
+  QObject::connect(&mSocket, SIGNAL(connected()), SLOT(onConnected()));
+  QObject::connect(&mSocket, SIGNAL(readyRead()), SLOT(onReadyRead()));
+  QObject::connect(&mSocket, SIGNAL(disconnected()), SLOT(onDisconnected()));
+}
+
+
+void LoadClient::start(void)
+{
+  mRunning = true;
+  mSocket.connectToHost(mOptions.host, mOptions.port);
+}
+
+
+void LoadClient::stop(void)
+{
+  mRunning = false;
+  mWaiting = false;
+  mSocket.abort();
+}
+
+
+void LoadClient::onConnected(void)
+{
+  mSocket.setSocketOption(QAbstractSocket::LowDelayOption, 1);
+  sendNextRequest();
+}
+
+
+void LoadClient::onDisconnected(void)
+{
+  if (mWaiting) {
+    mWaiting = false;
+    ++mStats->errors;
+  }
+  mBuffer.clear();
+  if (mRunning) {
+    mSocket.connectToHost(mOptions.host, mOptions.port);
+  }
+}
+
+
+void LoadClient::sendNextRequest(void)
+{
+  if (!mRunning)
+    return;
+  const double r = double(qrand()) / RAND_MAX;
+  if (r < mOptions.writeRatio || mRevision == 0) {
+    mOperation = WriteAll;
+    mPayload[qrand() % mPayload.size()] = char(qrand());
+    const QByteArray &ifMatch = mETag.isEmpty() ? QByteArray() : "If-Match: \"" + mETag + "\"\r\n";
+    if (mOptions.binary) {
+      post(mOptions.writeUrl, "application/octet-stream", mPayload, ifMatch);
+    }
+    else {
+      post(mOptions.writeUrl, "application/x-www-form-urlencoded", "data=" + QUrl::toPercentEncoding(mPayload.toBase64()), ifMatch);
+    }
+  }
+  else if (r < mOptions.writeRatio + mOptions.patchRatio) {
+    mOperation = WritePatch;
+    QVariantMap patch;
+    patch["id"] = QCryptographicHash::hash(randomBytes(8), QCryptographicHash::Sha256).toHex();
+    patch["data"] = randomBytes(512).toBase64();
+    const QByteArray &patches = QJsonDocument::fromVariant(QVariantList() << patch).toJson(QJsonDocument::Compact);
+    post(mOptions.writeUrl, "application/x-www-form-urlencoded",
+         "baseRevision=" + QByteArray::number(mRevision) + "&patches=" + QUrl::toPercentEncoding(patches), QByteArray());
+  }
+  else {
+    mOperation = Read;
+    QByteArray headers = mOptions.binary ? QByteArray("Accept: application/octet-stream, application/json\r\n") : QByteArray();
+    if (!mETag.isEmpty()) {
+      headers += "If-None-Match: \"" + mETag + "\"\r\n";
+    }
+    post(mOptions.readUrl, "application/x-www-form-urlencoded", "since=" + QByteArray::number(mRevision), headers);
+  }
+}
+
+
+void LoadClient::post(const QByteArray &url, const QByteArray &contentType, const QByteArray &body, const QByteArray &extraHeaders)
+{
+  const QByteArray &request =
+      "POST " + url + " HTTP/1.1\r\n"
+      "Host: " + mOptions.host.toUtf8() + "\r\n"
+      "Authorization: " + mAuthorization + "\r\n"
+      "Content-Type: " + contentType + "\r\n"
+      "Content-Length: " + QByteArray::number(body.size()) + "\r\n"
+      + extraHeaders
+      + "\r\n"
+      + body;
+  mStats->bytesSent += request.size();
+  mWaiting = true;
+  mElapsed.start();
+  mSocket.write(request);
+}
+
+
+void LoadClient::onReadyRead(void)
+{
+  mBuffer += mSocket.readAll();
+  const int headerEnd = mBuffer.indexOf("\r\n\r\n");
+  if (headerEnd < 0)
+    return;
+  const QByteArray &headers = mBuffer.left(headerEnd);
+  const int contentLength = headerValue(headers, "content-length").toInt();
+  if (mBuffer.size() < headerEnd + 4 + contentLength)
+    return;
+  const int status = headers.mid(9, 3).toInt();
+  const QByteArray &body = mBuffer.mid(headerEnd + 4, contentLength);
+  mStats->bytesReceived += headerEnd + 4 + contentLength;
+  mBuffer.remove(0, headerEnd + 4 + contentLength);
+  finishRequest(status, headers, body);
+}
+
+
+void LoadClient::finishRequest(int status, const QByteArray &headers, const QByteArray &body)
+{
+  mWaiting = false;
+  mStats->latencies.append(mElapsed.nsecsElapsed() / 1000);
+  ++mStats->statusCounts[status];
+  QByteArray etag = headerValue(headers, "etag");
+  etag.replace('"', QByteArray());
+  if (status == 200) {
+    if (!etag.isEmpty()) {
+      mETag = etag;
+    }
+    if (headerValue(headers, "content-type").startsWith("application/octet-stream")) {
+      mRevision = headerValue(headers, "x-sesam-revision").toLongLong();
+    }
+    else {
+      const QVariantMap &map = QJsonDocument::fromJson(body).toVariant().toMap();
+      if (map["status"].toString() != "ok") {
+        ++mStats->errors;
+      }
+      else if (map.contains("revision")) {
+        mRevision = map["revision"].toLongLong();
+      }
+    }
+  }
+  else if (status == 409 || status == 412) {
+    // somebody else wrote meanwhile: read again before the next write
+    ++mStats->conflicts;
+    mETag.clear();
+    mRevision = -1;
+  }
+  else if (status != 304) {
+    ++mStats->errors;
+  }
+  if (mRevision < 0) {
+    mOperation = Read;
+    mRevision = 0;
+    post(mOptions.readUrl, "application/x-www-form-urlencoded", "since=0", QByteArray());
+    return;
+  }
+  sendNextRequest();
+}
+
+
+QByteArray LoadClient::headerValue(const QByteArray &headers, const QByteArray &name)
+{
+  foreach (QByteArray line, headers.split('\n')) {
+    const int colon = line.indexOf(':');
+    if (colon > 0 && line.left(colon).trimmed().toLower() == name)
+      return line.mid(colon + 1).trimmed();
+  }
+  return QByteArray();
+}
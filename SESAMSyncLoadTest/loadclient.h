@@ -0,0 +1,96 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef __LOADCLIENT_H_
+#define __LOADCLIENT_H_
+
+#include <QObject>
+#include <QTcpSocket>
+#include <QElapsedTimer>
+#include <QByteArray>
+#include <QString>
+
+#include "loadstats.h"
+
+
+struct LoadOptions {
+  LoadOptions(void)
+    : port(8080)
+    , writeRatio(0.05)
+    , patchRatio(0.1)
+    , payloadSize(64 * 1024)
+    , binary(false)
+    , sharedAccount(false)
+  { /* ... */ }
+  QString host;
+  quint16 port;
+  QByteArray readUrl;
+  QByteArray writeUrl;
+  QByteArray username;
+  QByteArray password;
+  double writeRatio;
+  double patchRatio;
+  int payloadSize;
+  bool binary;
+  bool sharedAccount;
+};
+
+
+class LoadClient : public QObject
+{
+  Q_OBJECT
+public:
+  LoadClient(const LoadOptions &options, LoadStats *stats, QObject *parent = Q_NULLPTR);
+
+public slots:
+  void start(void);
+  void stop(void);
+
+private slots:
+  void onConnected(void);
+  void onReadyRead(void);
+  void onDisconnected(void);
+
+private:
+  enum Operation {
+    Read,
+    WriteAll,
+    WritePatch
+  };
+  void sendNextRequest(void);
+  void post(const QByteArray &url, const QByteArray &contentType, const QByteArray &body, const QByteArray &extraHeaders);
+  void finishRequest(int status, const QByteArray &headers, const QByteArray &body);
+  static QByteArray headerValue(const QByteArray &headers, const QByteArray &name);
+
+  LoadOptions mOptions;
+  LoadStats *mStats;
+  QTcpSocket mSocket;
+  QByteArray mBuffer;
+  QByteArray mAuthorization;
+  QByteArray mPayload;
+  QByteArray mETag;
+  qint64 mRevision;
+  Operation mOperation;
+  QElapsedTimer mElapsed;
+  bool mRunning;
+  bool mWaiting;
+};
+
+#endif // __LOADCLIENT_H_
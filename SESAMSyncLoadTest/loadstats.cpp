@@ -0,0 +1,82 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "loadstats.h"
+
+#include <QStringList>
+#include <algorithm>
+#include <cmath>
+
+
+void LoadStats::merge(const LoadStats &other)
+{
+  latencies += other.latencies;
+  for (QMap<int, qint64>::const_iterator i = other.statusCounts.constBegin(); i != other.statusCounts.constEnd(); ++i) {
+    statusCounts[i.key()] += i.value();
+  }
+  errors += other.errors;
+  conflicts += other.conflicts;
+  bytesSent += other.bytesSent;
+  bytesReceived += other.bytesReceived;
+}
+
+
+/*!
+ * \brief LoadStats::percentile
+ *
+ * Expects `latencies` to be sorted.
+ *
+ * \return latency in microseconds below which `p` percent of all requests completed
+ */
+qint64 LoadStats::percentile(double p) const
+{
+  if (latencies.isEmpty())
+    return 0;
+  const int idx = qBound(0, int(std::ceil(p / 100.0 * latencies.size())) - 1, latencies.size() - 1);
+  return latencies.at(idx);
+}
+
+
+QString LoadStats::report(qint64 elapsedMs) const
+{
+  LoadStats sorted = *this;
+  std::sort(sorted.latencies.begin(), sorted.latencies.end());
+  const double secs = qMax<qint64>(1, elapsedMs) / 1000.0;
+  QStringList lines;
+  lines << QString("requests:     %1 in %2 s").arg(sorted.latencies.size()).arg(secs, 0, 'f', 1);
+  lines << QString("throughput:   %1 req/s").arg(sorted.latencies.size() / secs, 0, 'f', 1);
+  lines << QString("latency (ms): p50 %1  p90 %2  p99 %3  p99.9 %4  max %5")
+           .arg(sorted.percentile(50) / 1000.0, 0, 'f', 2)
+           .arg(sorted.percentile(90) / 1000.0, 0, 'f', 2)
+           .arg(sorted.percentile(99) / 1000.0, 0, 'f', 2)
+           .arg(sorted.percentile(99.9) / 1000.0, 0, 'f', 2)
+           .arg(sorted.percentile(100) / 1000.0, 0, 'f', 2);
+  lines << QString("transferred:  %1 MB sent, %2 MB received")
+           .arg(bytesSent / 1048576.0, 0, 'f', 1)
+           .arg(bytesReceived / 1048576.0, 0, 'f', 1);
+  QStringList codes;
+  for (QMap<int, qint64>::const_iterator i = statusCounts.constBegin(); i != statusCounts.constEnd(); ++i) {
+    codes << QString("%1: %2").arg(i.key()).arg(i.value());
+  }
+  lines << QString("status codes: %1").arg(codes.join(", "));
+  lines << QString("conflicts:    %1").arg(conflicts);
+  lines << QString("errors:       %1").arg(errors);
+  return lines.join("\n");
+}
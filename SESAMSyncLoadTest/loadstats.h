@@ -0,0 +1,48 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef __LOADSTATS_H_
+#define __LOADSTATS_H_
+
+#include <QVector>
+#include <QMap>
+#include <QString>
+
+
+struct LoadStats {
+  LoadStats(void)
+    : errors(0)
+    , conflicts(0)
+    , bytesSent(0)
+    , bytesReceived(0)
+  { /* ... */ }
+  QVector<qint64> latencies;
+  QMap<int, qint64> statusCounts;
+  qint64 errors;
+  qint64 conflicts;
+  qint64 bytesSent;
+  qint64 bytesReceived;
+
+  void merge(const LoadStats &);
+  qint64 percentile(double p) const;
+  QString report(qint64 elapsedMs) const;
+};
+
+#endif // __LOADSTATS_H_
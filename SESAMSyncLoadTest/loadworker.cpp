@@ -0,0 +1,74 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "loadworker.h"
+
+#include <QTimer>
+#include <QThread>
+#include <QDateTime>
+
+
+/*!
+ * \brief LoadWorker::LoadWorker
+ *
+ * Drives `clientCount` clients from the event loop of the thread it's moved to.
+ * Unless all clients share one account, each of them logs in as its own user.
+ */
+LoadWorker::LoadWorker(const LoadOptions &options, int firstClient, int clientCount, int rampUpMs, int durationMs)
+  : mOptions(options)
+  , mFirstClient(firstClient)
+  , mClientCount(clientCount)
+  , mRampUpMs(rampUpMs)
+  , mDurationMs(durationMs)
+{
+  /* ... */
+}
+
+
+const LoadStats &LoadWorker::stats(void) const
+{
+  return mStats;
+}
+
+
+void LoadWorker::run(void)
+{
+  qsrand(uint(QDateTime::currentMSecsSinceEpoch()) ^ uint(mFirstClient));
+  for (int i = 0; i < mClientCount; ++i) {
+    LoadOptions options = mOptions;
+    if (!options.sharedAccount) {
+      options.username += QByteArray::number(mFirstClient + i);
+    }
+    LoadClient *client = new LoadClient(options, &mStats, this);
+    mClients << client;
+    QTimer::singleShot(mClientCount > 1 ? mRampUpMs * i / mClientCount : 0, client, SLOT(start()));
+  }
+  QTimer::singleShot(mRampUpMs + mDurationMs, this, SLOT(finish()));
+}
+
+
+void LoadWorker::finish(void)
+{
+  foreach (LoadClient *client, mClients) {
+    client->stop();
+  }
+  emit finished();
+  QThread::currentThread()->quit();
+}
@@ -0,0 +1,57 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef __LOADWORKER_H_
+#define __LOADWORKER_H_
+
+#include <QObject>
+#include <QList>
+
+#include "loadclient.h"
+#include "loadstats.h"
+
+
+class LoadWorker : public QObject
+{
+  Q_OBJECT
+public:
+  LoadWorker(const LoadOptions &options, int firstClient, int clientCount, int rampUpMs, int durationMs);
+  const LoadStats &stats(void) const;
+
+signals:
+  void finished(void);
+
+public slots:
+  void run(void);
+
+private slots:
+  void finish(void);
+
+private:
+  LoadOptions mOptions;
+  int mFirstClient;
+  int mClientCount;
+  int mRampUpMs;
+  int mDurationMs;
+  QList<LoadClient*> mClients;
+  LoadStats mStats;
+};
+
+#endif // __LOADWORKER_H_
@@ -0,0 +1,127 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "loadworker.h"
+#include "loadstats.h"
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QThread>
+#include <QElapsedTimer>
+#include <QTextStream>
+
+
+int main(int argc, char *argv[])
+{
+  QCoreApplication app(argc, argv);
+  app.setApplicationName("SESAMSyncLoadTest");
+  app.setApplicationVersion(QTSESAM_VERSION);
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription("Load test driver for SESAMSyncServer");
+  parser.addHelpOption();
+  parser.addVersionOption();
+  QCommandLineOption hostOption("host", "Connect to <host>.", "host", "127.0.0.1");
+  QCommandLineOption portOption("port", "Connect to <port>.", "port", "8080");
+  QCommandLineOption clientsOption("clients", "Simulate <n> clients.", "n", "1000");
+  QCommandLineOption threadsOption("threads", "Run the clients in <n> threads.", "n", QString::number(QThread::idealThreadCount()));
+  QCommandLineOption durationOption("duration", "Run for <n> seconds after ramp-up.", "n", "30");
+  QCommandLineOption rampUpOption("ramp-up", "Start the clients spread over <n> seconds.", "n", "5");
+  QCommandLineOption writeRatioOption("write-ratio", "Fraction <f> of requests writing all data.", "f", "0.05");
+  QCommandLineOption patchRatioOption("patch-ratio", "Fraction <f> of requests writing a patch.", "f", "0.1");
+  QCommandLineOption payloadOption("payload-size", "Size of the data written by each client in bytes.", "n", "65536");
+  QCommandLineOption binaryOption("binary", "Use the binary transport.");
+  QCommandLineOption userOption("user", "Log in as <prefix><n>; the server must run with --register.", "prefix", "loadtest");
+  QCommandLineOption passwordOption("password", "Password of all users.", "password", "loadtest");
+  QCommandLineOption sharedOption("shared-account", "Let all clients use the same account to provoke conflicts.");
+  QCommandLineOption readUrlOption("read-url", "Path of the read endpoint.", "path", "/ajax/read.php");
+  QCommandLineOption writeUrlOption("write-url", "Path of the write endpoint.", "path", "/ajax/write.php");
+  parser.addOption(hostOption);
+  parser.addOption(portOption);
+  parser.addOption(clientsOption);
+  parser.addOption(threadsOption);
+  parser.addOption(durationOption);
+  parser.addOption(rampUpOption);
+  parser.addOption(writeRatioOption);
+  parser.addOption(patchRatioOption);
+  parser.addOption(payloadOption);
+  parser.addOption(binaryOption);
+  parser.addOption(userOption);
+  parser.addOption(passwordOption);
+  parser.addOption(sharedOption);
+  parser.addOption(readUrlOption);
+  parser.addOption(writeUrlOption);
+  parser.process(app);
+
+  LoadOptions options;
+  options.host = parser.value(hostOption);
+  options.port = quint16(parser.value(portOption).toUInt());
+  options.readUrl = parser.value(readUrlOption).toUtf8();
+  options.writeUrl = parser.value(writeUrlOption).toUtf8();
+  options.username = parser.value(userOption).toUtf8();
+  options.password = parser.value(passwordOption).toUtf8();
+  options.writeRatio = parser.value(writeRatioOption).toDouble();
+  options.patchRatio = parser.value(patchRatioOption).toDouble();
+  options.payloadSize = qMax(1, parser.value(payloadOption).toInt());
+  options.binary = parser.isSet(binaryOption);
+  options.sharedAccount = parser.isSet(sharedOption);
+
+  const int clients = qMax(1, parser.value(clientsOption).toInt());
+  const int threads = qBound(1, parser.value(threadsOption).toInt(), clients);
+  const int rampUpMs = parser.value(rampUpOption).toInt() * 1000;
+  const int durationMs = parser.value(durationOption).toInt() * 1000;
+
+  QTextStream out(stdout);
+  out << QString("%1 clients in %2 threads against %3:%4 for %5 s ...")
+         .arg(clients).arg(threads).arg(options.host).arg(options.port).arg((rampUpMs + durationMs) / 1000)
+      << endl;
+
+  QList<QThread*> workerThreads;
+  QList<LoadWorker*> workers;
+  int firstClient = 0;
+  for (int i = 0; i < threads; ++i) {
+    const int count = clients / threads + (i < clients % threads ? 1 : 0);
+    LoadWorker *worker = new LoadWorker(options, firstClient, count, rampUpMs, durationMs);
+    QThread *thread = new QThread;
+    worker->moveToThread(thread);
+    QObject::connect(thread, SIGNAL(started()), worker, SLOT(run()));
+    workers << worker;
+    workerThreads << thread;
+    firstClient += count;
+  }
+  QElapsedTimer elapsed;
+  elapsed.start();
+  foreach (QThread *thread, workerThreads) {
+    thread->start();
+  }
+  foreach (QThread *thread, workerThreads) {
+    thread->wait();
+  }
+  const qint64 elapsedMs = elapsed.elapsed();
+
+  LoadStats total;
+  foreach (LoadWorker *worker, workers) {
+    total.merge(worker->stats());
+  }
+  qDeleteAll(workers);
+  qDeleteAll(workerThreads);
+  out << total.report(elapsedMs) << endl;
+  return total.errors == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,44 @@
+# Copyright (c) 2015 Oliver Lau <ola@ct.de>
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+TEMPLATE = app
+
+include(../Qt-SESAM.pri)
+DEFINES += QTSESAM_VERSION=\\\"$${QTSESAM_VERSION}\\\"
+
+QT += core network concurrent
+QT -= gui
+
+TARGET = SESAMSyncServer
+CONFIG += console
+CONFIG -= app_bundle
+
+win32:DEFINES -= UNICODE
+
+SOURCES += main.cpp \
+    httpmessage.cpp \
+    httpconnection.cpp \
+    httpserver.cpp \
+    synchandler.cpp \
+    syncstorage.cpp \
+    userstore.cpp
+
+HEADERS += \
+    httpmessage.h \
+    httpconnection.h \
+    httpserver.h \
+    synchandler.h \
+    syncstorage.h \
+    userstore.h
@@ -0,0 +1,195 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "httpconnection.h"
+#include "httpserver.h"
+#include "synchandler.h"
+
+#include <QtConcurrent>
+#include <QDebug>
+
+
+/*!
+ * \brief HttpConnection::HttpConnection
+ *
+ * Reads HTTP/1.1 requests from `socket` as data comes in. Requests on a kept-alive
+ * connection are answered one after the other; a connection never occupies
+ * a worker thread while it's waiting for data.
+ * At most one request is buffered ahead of the one being answered. Further
+ * pipelined data is left to the socket, which then stops reading from the
+ * network, so a client cannot make the server buffer without limit.
+ */
+HttpConnection::HttpConnection(QTcpSocket *socket, HttpServer *server)
+  : QObject(server)
+  , mSocket(socket)
+  , mServer(server)
+  , mHeaderComplete(false)
+  , mBusy(false)
+  , mHttp11(true)
+  , mContentLength(0)
+{
+  socket->setParent(this);
+  socket->setReadBufferSize(MaxHeaderSize);
+  mIdleTimer.setSingleShot(true);
+  mIdleTimer.setInterval(server->idleTimeout());
+  QObject::connect(&mIdleTimer, SIGNAL(timeout()), socket, SLOT(close()));
+  QObject::connect(socket, SIGNAL(readyRead()), SLOT(onReadyRead()));
+  QObject::connect(socket, SIGNAL(disconnected()), SLOT(onDisconnected()));
+  QObject::connect(&mWatcher, SIGNAL(finished()), SLOT(onResponseReady()));
+  mIdleTimer.start();
+  if (socket->bytesAvailable() > 0) {
+    onReadyRead();
+  }
+}
+
+
+HttpConnection::~HttpConnection()
+{
+  /* ... */
+}
+
+
+void HttpConnection::onReadyRead(void)
+{
+  if (mSocket.isNull())
+    return;
+  const qint64 room = MaxHeaderSize + mServer->maxBodySize() - mBuffer.size();
+  if (room > 0) {
+    mBuffer += mSocket->read(room);
+  }
+  mIdleTimer.start();
+  processBuffer();
+}
+
+
+void HttpConnection::processBuffer(void)
+{
+  if (mBusy || mSocket.isNull())
+    return;
+  if (!mHeaderComplete) {
+    const int headerEnd = mBuffer.indexOf("\r\n\r\n");
+    if (headerEnd < 0) {
+      if (mBuffer.size() > MaxHeaderSize) {
+        fail(431, tr("request header too large"));
+      }
+      return;
+    }
+    if (!parseHeader(mBuffer.left(headerEnd))) {
+      fail(400, tr("malformed request"));
+      return;
+    }
+    mBuffer.remove(0, headerEnd + 4);
+    if (!mRequest.header("Transfer-Encoding").isEmpty()) {
+      fail(411, tr("Content-Length required"));
+      return;
+    }
+    mContentLength = mRequest.header("Content-Length").toLongLong();
+    if (mContentLength < 0 || mContentLength > mServer->maxBodySize()) {
+      fail(413, tr("request too large"));
+      return;
+    }
+    mHeaderComplete = true;
+    if (mBuffer.size() < mContentLength && mRequest.header("Expect").toLower() == "100-continue") {
+      mSocket->write("HTTP/1.1 100 Continue\r\n\r\n");
+    }
+  }
+  if (mBuffer.size() < mContentLength)
+    return;
+  mRequest.body = mBuffer.left(int(mContentLength));
+  mBuffer.remove(0, int(mContentLength));
+  mHeaderComplete = false;
+  mBusy = true;
+  mIdleTimer.stop();
+  mElapsed.start();
+  mWatcher.setFuture(QtConcurrent::run(mServer->workers(), mServer->handler(), &SyncHandler::handle, mRequest));
+}
+
+
+void HttpConnection::onResponseReady(void)
+{
+  const HttpResponse &response = mWatcher.result();
+  const bool keepAlive = mHttp11 && mRequest.keepAlive();
+  if (mServer->verbose()) {
+    qDebug().noquote() << (mSocket.isNull() ? QString() : mSocket->peerAddress().toString())
+                       << mRequest.method << mRequest.path << response.status
+                       << response.body.size() << QString("%1ms").arg(mElapsed.elapsed());
+  }
+  mBusy = false;
+  mRequest = HttpRequest();
+  if (mSocket.isNull())
+    return;
+  mSocket->write(response.serialize(keepAlive));
+  if (keepAlive) {
+    // pick up what has been left in the socket while the buffer was full
+    onReadyRead();
+  }
+  else {
+    mSocket->disconnectFromHost();
+  }
+}
+
+
+void HttpConnection::onDisconnected(void)
+{
+  mIdleTimer.stop();
+  if (mBusy) {
+    // the worker still has to finish; the result is dropped in onResponseReady()
+    mSocket->deleteLater();
+    QObject::connect(&mWatcher, SIGNAL(finished()), SLOT(deleteLater()));
+  }
+  else {
+    deleteLater();
+  }
+}
+
+
+bool HttpConnection::parseHeader(const QByteArray &header)
+{
+  const QList<QByteArray> &lines = header.split('\n');
+  const QList<QByteArray> &requestLine = lines.first().trimmed().split(' ');
+  if (requestLine.size() != 3 || !requestLine.at(2).startsWith("HTTP/1."))
+    return false;
+  mRequest = HttpRequest();
+  mRequest.method = requestLine.at(0);
+  const QByteArray &target = requestLine.at(1);
+  const int q = target.indexOf('?');
+  mRequest.path = q < 0 ? target : target.left(q);
+  mRequest.query = q < 0 ? QByteArray() : target.mid(q + 1);
+  mHttp11 = requestLine.at(2) == "HTTP/1.1";
+  for (int i = 1; i < lines.size(); ++i) {
+    const QByteArray &line = lines.at(i).trimmed();
+    const int colon = line.indexOf(':');
+    if (colon <= 0)
+      return false;
+    mRequest.headers.insert(line.left(colon).trimmed().toLower(), line.mid(colon + 1).trimmed());
+  }
+  return true;
+}
+
+
+void HttpConnection::fail(int status, const QString &message)
+{
+  mBuffer.clear();
+  mHeaderComplete = false;
+  if (mSocket.isNull())
+    return;
+  mSocket->write(HttpResponse::error(message, status).serialize(false));
+  mSocket->disconnectFromHost();
+}
@@ -0,0 +1,67 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef __HTTPCONNECTION_H_
+#define __HTTPCONNECTION_H_
+
+#include <QObject>
+#include <QTcpSocket>
+#include <QPointer>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+
+#include "httpmessage.h"
+
+class HttpServer;
+
+class HttpConnection : public QObject
+{
+  Q_OBJECT
+public:
+  HttpConnection(QTcpSocket *socket, HttpServer *server);
+  ~HttpConnection();
+
+private slots:
+  void onReadyRead(void);
+  void onResponseReady(void);
+  void onDisconnected(void);
+
+private:
+  void processBuffer(void);
+  bool parseHeader(const QByteArray &);
+  void fail(int status, const QString &message);
+
+  QPointer<QTcpSocket> mSocket;
+  HttpServer *mServer;
+  QByteArray mBuffer;
+  HttpRequest mRequest;
+  bool mHeaderComplete;
+  bool mBusy;
+  bool mHttp11;
+  qint64 mContentLength;
+  QTimer mIdleTimer;
+  QElapsedTimer mElapsed;
+  QFutureWatcher<HttpResponse> mWatcher;
+
+  static const int MaxHeaderSize = 16 * 1024;
+};
+
+#endif // __HTTPCONNECTION_H_
@@ -0,0 +1,174 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "httpmessage.h"
+
+#include <QJsonDocument>
+
+
+QByteArray HttpRequest::header(const QByteArray &name) const
+{
+  return headers.value(name.toLower());
+}
+
+
+QMap<QByteArray, QByteArray> HttpRequest::queryItems(void) const
+{
+  return parseUrlEncoded(query);
+}
+
+
+QMap<QByteArray, QByteArray> HttpRequest::formItems(void) const
+{
+  return isOctetStream() ? QMap<QByteArray, QByteArray>() : parseUrlEncoded(body);
+}
+
+
+bool HttpRequest::isOctetStream(void) const
+{
+  return header("Content-Type").startsWith("application/octet-stream");
+}
+
+
+bool HttpRequest::accepts(const QByteArray &mimeType) const
+{
+  foreach (QByteArray type, header("Accept").split(',')) {
+    if (type.split(';').first().trimmed() == mimeType)
+      return true;
+  }
+  return false;
+}
+
+
+bool HttpRequest::keepAlive(void) const
+{
+  return header("Connection").toLower() != "close";
+}
+
+
+/*!
+ * \brief HttpRequest::parseUrlEncoded
+ *
+ * Unlike browsers Qt-SESAM doesn't escape `+` in form values, because
+ * `QUrlQuery` leaves it alone. A `+` therefore is taken literally and not
+ * as an encoded space, otherwise base64 data would be garbled.
+ */
+QMap<QByteArray, QByteArray> HttpRequest::parseUrlEncoded(const QByteArray &data)
+{
+  QMap<QByteArray, QByteArray> items;
+  foreach (QByteArray item, data.split('&')) {
+    if (item.isEmpty())
+      continue;
+    const int eq = item.indexOf('=');
+    if (eq < 0) {
+      items.insert(QByteArray::fromPercentEncoding(item), QByteArray());
+    }
+    else {
+      items.insert(QByteArray::fromPercentEncoding(item.left(eq)), QByteArray::fromPercentEncoding(item.mid(eq + 1)));
+    }
+  }
+  return items;
+}
+
+
+HttpResponse::HttpResponse(int status)
+  : status(status)
+{
+  /* ... */
+}
+
+
+void HttpResponse::setHeader(const QByteArray &name, const QByteArray &value)
+{
+  for (int i = 0; i < headers.size(); ++i) {
+    if (headers.at(i).first.toLower() == name.toLower()) {
+      headers[i].second = value;
+      return;
+    }
+  }
+  headers.append(qMakePair(name, value));
+}
+
+
+QByteArray HttpResponse::serialize(bool keepAlive) const
+{
+  QByteArray msg = "HTTP/1.1 " + QByteArray::number(status) + " " + reasonPhrase(status) + "\r\n";
+  typedef QPair<QByteArray, QByteArray> Header;
+  foreach (Header h, headers) {
+    msg += h.first + ": " + h.second + "\r\n";
+  }
+  msg += "Content-Length: " + QByteArray::number(body.size()) + "\r\n";
+  msg += keepAlive ? "Connection: keep-alive\r\n" : "Connection: close\r\n";
+  msg += "\r\n";
+  msg += body;
+  return msg;
+}
+
+
+HttpResponse HttpResponse::json(const QVariantMap &map, int status)
+{
+  HttpResponse response(status);
+  response.setHeader("Content-Type", "application/json");
+  response.body = QJsonDocument::fromVariant(map).toJson(QJsonDocument::Compact);
+  return response;
+}
+
+
+HttpResponse HttpResponse::error(const QString &message, int status)
+{
+  QVariantMap map;
+  map["status"] = "error";
+  map["error"] = message;
+  return json(map, status);
+}
+
+
+HttpResponse HttpResponse::octetStream(const QByteArray &data)
+{
+  HttpResponse response(200);
+  response.setHeader("Content-Type", "application/octet-stream");
+  response.body = data;
+  return response;
+}
+
+
+QByteArray HttpResponse::reasonPhrase(int status)
+{
+  switch (status) {
+  case 100: return "Continue";
+  case 200: return "OK";
+  case 304: return "Not Modified";
+  case 400: return "Bad Request";
+  case 401: return "Unauthorized";
+  case 403: return "Forbidden";
+  case 404: return "Not Found";
+  case 405: return "Method Not Allowed";
+  case 408: return "Request Timeout";
+  case 409: return "Conflict";
+  case 411: return "Length Required";
+  case 412: return "Precondition Failed";
+  case 413: return "Payload Too Large";
+  case 431: return "Request Header Fields Too Large";
+  case 500: return "Internal Server Error";
+  case 503: return "Service Unavailable";
+  default: break;
+  }
+  return "Unknown";
+}
@@ -0,0 +1,64 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef __HTTPMESSAGE_H_
+#define __HTTPMESSAGE_H_
+
+#include <QByteArray>
+#include <QMap>
+#include <QList>
+#include <QPair>
+#include <QVariantMap>
+
+
+struct HttpRequest {
+  QByteArray method;
+  QByteArray path;
+  QByteArray query;
+  QMap<QByteArray, QByteArray> headers;
+  QByteArray body;
+
+  QByteArray header(const QByteArray &name) const;
+  QMap<QByteArray, QByteArray> queryItems(void) const;
+  QMap<QByteArray, QByteArray> formItems(void) const;
+  bool isOctetStream(void) const;
+  bool accepts(const QByteArray &mimeType) const;
+  bool keepAlive(void) const;
+
+  static QMap<QByteArray, QByteArray> parseUrlEncoded(const QByteArray &);
+};
+
+
+struct HttpResponse {
+  explicit HttpResponse(int status = 200);
+  int status;
+  QList<QPair<QByteArray, QByteArray> > headers;
+  QByteArray body;
+
+  void setHeader(const QByteArray &name, const QByteArray &value);
+  QByteArray serialize(bool keepAlive) const;
+
+  static HttpResponse json(const QVariantMap &, int status = 200);
+  static HttpResponse error(const QString &message, int status = 200);
+  static HttpResponse octetStream(const QByteArray &data);
+  static QByteArray reasonPhrase(int status);
+};
+
+#endif // __HTTPMESSAGE_H_
@@ -0,0 +1,198 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "httpserver.h"
+#include "httpconnection.h"
+#include "synchandler.h"
+
+#include <QFile>
+#include <QSslSocket>
+#include <QSslCertificate>
+#include <QSslKey>
+#include <QSslConfiguration>
+
+
+class HttpServerPrivate
+{
+public:
+  HttpServerPrivate(SyncHandler *handler)
+    : handler(handler)
+    , maxBodySize(64 * 1024 * 1024)
+    , idleTimeout(60 * 1000)
+    , verbose(false)
+    , useTls(false)
+  { /* ... */ }
+  ~HttpServerPrivate()
+  {
+    workers.waitForDone();
+  }
+  SyncHandler *handler;
+  QThreadPool workers;
+  qint64 maxBodySize;
+  int idleTimeout;
+  bool verbose;
+  bool useTls;
+  QSslConfiguration sslConf;
+  QString errorString;
+};
+
+
+/*!
+ * \brief HttpServer::HttpServer
+ *
+ * Accepts connections in the thread it lives in and reads requests without blocking.
+ * Complete requests are handed to `handler` in a pool of worker threads,
+ * so slow disks don't stall other clients.
+ */
+HttpServer::HttpServer(SyncHandler *handler, QObject *parent)
+  : QTcpServer(parent)
+  , d_ptr(new HttpServerPrivate(handler))
+{
+  /* ... */
+}
+
+
+HttpServer::~HttpServer()
+{
+  QTcpServer::close();
+}
+
+
+SyncHandler *HttpServer::handler(void) const
+{
+  Q_D(const HttpServer);
+  return d->handler;
+}
+
+
+QThreadPool *HttpServer::workers(void)
+{
+  Q_D(HttpServer);
+  return &d->workers;
+}
+
+
+void HttpServer::setWorkerCount(int n)
+{
+  Q_D(HttpServer);
+  d->workers.setMaxThreadCount(n);
+}
+
+
+void HttpServer::setMaxBodySize(qint64 size)
+{
+  Q_D(HttpServer);
+  d->maxBodySize = size;
+}
+
+
+qint64 HttpServer::maxBodySize(void) const
+{
+  Q_D(const HttpServer);
+  return d->maxBodySize;
+}
+
+
+void HttpServer::setIdleTimeout(int ms)
+{
+  Q_D(HttpServer);
+  d->idleTimeout = ms;
+}
+
+
+int HttpServer::idleTimeout(void) const
+{
+  Q_D(const HttpServer);
+  return d->idleTimeout;
+}
+
+
+void HttpServer::setVerbose(bool verbose)
+{
+  Q_D(HttpServer);
+  d->verbose = verbose;
+}
+
+
+bool HttpServer::verbose(void) const
+{
+  Q_D(const HttpServer);
+  return d->verbose;
+}
+
+
+bool HttpServer::setTlsCredentials(const QString &certificateFile, const QString &keyFileName)
+{
+  Q_D(HttpServer);
+  QFile certFile(certificateFile);
+  if (!certFile.open(QIODevice::ReadOnly)) {
+    d->errorString = tr("Cannot read certificate: %1").arg(certFile.errorString());
+    return false;
+  }
+  QFile keyFile(keyFileName);
+  if (!keyFile.open(QIODevice::ReadOnly)) {
+    d->errorString = tr("Cannot read private key: %1").arg(keyFile.errorString());
+    return false;
+  }
+  const QList<QSslCertificate> &chain = QSslCertificate::fromData(certFile.readAll(), QSsl::Pem);
+  const QSslKey key(keyFile.readAll(), QSsl::Rsa, QSsl::Pem);
+  if (chain.isEmpty() || key.isNull()) {
+    d->errorString = tr("Invalid certificate or private key");
+    return false;
+  }
+  d->sslConf = QSslConfiguration::defaultConfiguration();
+  d->sslConf.setLocalCertificateChain(chain);
+  d->sslConf.setPrivateKey(key);
+  d->sslConf.setPeerVerifyMode(QSslSocket::VerifyNone);
+  d->useTls = true;
+  return true;
+}
+
+
+QString HttpServer::errorString(void) const
+{
+  Q_D(const HttpServer);
+  return d->errorString.isEmpty() ? QTcpServer::errorString() : d->errorString;
+}
+
+
+void HttpServer::incomingConnection(qintptr socketDescriptor)
+{
+  Q_D(HttpServer);
+  QTcpSocket *socket = Q_NULLPTR;
+  if (d->useTls) {
+    QSslSocket *sslSocket = new QSslSocket;
+    if (sslSocket->setSocketDescriptor(socketDescriptor)) {
+      sslSocket->setSslConfiguration(d->sslConf);
+      sslSocket->startServerEncryption();
+    }
+    socket = sslSocket;
+  }
+  else {
+    socket = new QTcpSocket;
+    socket->setSocketDescriptor(socketDescriptor);
+  }
+  if (socket->state() != QAbstractSocket::ConnectedState) {
+    delete socket;
+    return;
+  }
+  socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+  new HttpConnection(socket, this);
+}
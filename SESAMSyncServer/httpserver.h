@@ -0,0 +1,61 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef __HTTPSERVER_H_
+#define __HTTPSERVER_H_
+
+#include <QObject>
+#include <QScopedPointer>
+#include <QTcpServer>
+#include <QThreadPool>
+#include <QString>
+
+class SyncHandler;
+class HttpServerPrivate;
+
+class HttpServer : public QTcpServer
+{
+  Q_OBJECT
+public:
+  explicit HttpServer(SyncHandler *handler, QObject *parent = Q_NULLPTR);
+  ~HttpServer();
+
+  SyncHandler *handler(void) const;
+  QThreadPool *workers(void);
+  void setWorkerCount(int);
+  void setMaxBodySize(qint64);
+  qint64 maxBodySize(void) const;
+  void setIdleTimeout(int ms);
+  int idleTimeout(void) const;
+  void setVerbose(bool);
+  bool verbose(void) const;
+  bool setTlsCredentials(const QString &certificateFile, const QString &keyFileName);
+  QString errorString(void) const;
+
+protected:
+  void incomingConnection(qintptr socketDescriptor) Q_DECL_OVERRIDE;
+
+private:
+  QScopedPointer<HttpServerPrivate> d_ptr;
+  Q_DECLARE_PRIVATE(HttpServer)
+  Q_DISABLE_COPY(HttpServer)
+};
+
+#endif // __HTTPSERVER_H_
@@ -0,0 +1,117 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "httpserver.h"
+#include "synchandler.h"
+#include "syncstorage.h"
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QHostAddress>
+#include <QThread>
+#include <QTextStream>
+#include <QDir>
+#include <QDebug>
+
+
+int main(int argc, char *argv[])
+{
+  QCoreApplication app(argc, argv);
+  app.setApplicationName("SESAMSyncServer");
+  app.setApplicationVersion(QTSESAM_VERSION);
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription("Sync server for Qt-SESAM");
+  parser.addHelpOption();
+  parser.addVersionOption();
+  QCommandLineOption addressOption("address", "Listen on <address>.", "address", "0.0.0.0");
+  QCommandLineOption portOption("port", "Listen on <port>.", "port", "8080");
+  QCommandLineOption dataDirOption("data-dir", "Store user data in <dir>.", "dir", "SESAMSyncServer-data");
+  QCommandLineOption workersOption("workers", "Handle requests in <n> threads.", "n", QString::number(2 * QThread::idealThreadCount()));
+  QCommandLineOption registerOption("register", "Create an account for every unknown user on first request.");
+  QCommandLineOption addUserOption("add-user", "Create or reset the account <name> with a password read from stdin, then exit.", "name");
+  QCommandLineOption readUrlOption("read-url", "Path of the read endpoint.", "path", "/ajax/read.php");
+  QCommandLineOption writeUrlOption("write-url", "Path of the write endpoint.", "path", "/ajax/write.php");
+  QCommandLineOption deleteUrlOption("delete-url", "Path of the delete endpoint.", "path", "/ajax/delete.php");
+  QCommandLineOption maxBodyOption("max-body-size", "Reject requests larger than <n> MB.", "n", "64");
+  QCommandLineOption idleTimeoutOption("idle-timeout", "Close idle connections after <n> seconds.", "n", "60");
+  QCommandLineOption certOption("cert", "Serve HTTPS with the PEM certificate chain in <file>.", "file");
+  QCommandLineOption keyOption("key", "PEM private key matching --cert.", "file");
+  QCommandLineOption verboseOption(QStringList() << "v" << "verbose", "Log every request.");
+  parser.addOption(addressOption);
+  parser.addOption(portOption);
+  parser.addOption(dataDirOption);
+  parser.addOption(workersOption);
+  parser.addOption(registerOption);
+  parser.addOption(addUserOption);
+  parser.addOption(readUrlOption);
+  parser.addOption(writeUrlOption);
+  parser.addOption(deleteUrlOption);
+  parser.addOption(maxBodyOption);
+  parser.addOption(idleTimeoutOption);
+  parser.addOption(certOption);
+  parser.addOption(keyOption);
+  parser.addOption(verboseOption);
+  parser.process(app);
+
+  const QString &dataDir = QDir(parser.value(dataDirOption)).absolutePath();
+  if (!QDir().mkpath(dataDir)) {
+    qCritical() << "Cannot create data directory" << dataDir;
+    return EXIT_FAILURE;
+  }
+  SyncStorage storage(dataDir);
+  storage.setRegistrationAllowed(parser.isSet(registerOption));
+
+  if (parser.isSet(addUserOption)) {
+    QTextStream in(stdin);
+    const QByteArray &password = in.readLine().toUtf8();
+    if (!storage.addUser(parser.value(addUserOption), password)) {
+      qCritical() << "Cannot create user" << parser.value(addUserOption);
+      return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+  }
+
+  SyncHandler handler(&storage);
+  handler.setReadPath(parser.value(readUrlOption).toUtf8());
+  handler.setWritePath(parser.value(writeUrlOption).toUtf8());
+  handler.setDeletePath(parser.value(deleteUrlOption).toUtf8());
+
+  HttpServer server(&handler);
+  server.setWorkerCount(qMax(1, parser.value(workersOption).toInt()));
+  server.setMaxBodySize(qMax(1, parser.value(maxBodyOption).toInt()) * 1024LL * 1024LL);
+  server.setIdleTimeout(qMax(1, parser.value(idleTimeoutOption).toInt()) * 1000);
+  server.setVerbose(parser.isSet(verboseOption));
+  server.setMaxPendingConnections(1024);
+  if (parser.isSet(certOption) && !server.setTlsCredentials(parser.value(certOption), parser.value(keyOption))) {
+    qCritical() << server.errorString();
+    return EXIT_FAILURE;
+  }
+  if (!server.listen(QHostAddress(parser.value(addressOption)), quint16(parser.value(portOption).toUInt()))) {
+    qCritical() << "Cannot listen:" << server.errorString();
+    return EXIT_FAILURE;
+  }
+  qDebug().noquote() << QString("Serving %1 on %2:%3 with %4 workers")
+                        .arg(dataDir)
+                        .arg(server.serverAddress().toString())
+                        .arg(server.serverPort())
+                        .arg(server.workers()->maxThreadCount());
+  return app.exec();
+}
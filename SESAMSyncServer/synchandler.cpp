@@ -0,0 +1,314 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "synchandler.h"
+
+#include <QObject>
+#include <QVariantMap>
+#include <QJsonDocument>
+#include <QSharedPointer>
+#include <QMutexLocker>
+
+
+const QStringList SyncHandler::Features = QStringList() << "blobs" << "delta" << "cas" << "binary";
+
+static const int MaxUploadChunks = 4096;
+
+
+static QByteArray unquote(const QByteArray &etag)
+{
+  QByteArray result = etag.trimmed();
+  if (result.startsWith("W/")) {
+    result = result.mid(2);
+  }
+  return result.replace('"', QByteArray());
+}
+
+
+/*!
+ * \brief SyncHandler::SyncHandler
+ *
+ * Implements the sync protocol spoken by Qt-SESAM on top of a `SyncStorage`.
+ * `handle()` may be called from several threads at once; requests of the same
+ * user are serialized by the lock of the user's store.
+ */
+SyncHandler::SyncHandler(SyncStorage *storage)
+  : mStorage(storage)
+  , mReadPath("/ajax/read.php")
+  , mWritePath("/ajax/write.php")
+  , mDeletePath("/ajax/delete.php")
+{
+  /* ... */
+}
+
+
+void SyncHandler::setReadPath(const QByteArray &path)
+{
+  mReadPath = path;
+}
+
+
+void SyncHandler::setWritePath(const QByteArray &path)
+{
+  mWritePath = path;
+}
+
+
+void SyncHandler::setDeletePath(const QByteArray &path)
+{
+  mDeletePath = path;
+}
+
+
+HttpResponse SyncHandler::handle(const HttpRequest &req)
+{
+  if (req.method != "POST") {
+    HttpResponse response = HttpResponse::error(QObject::tr("method not allowed"), 405);
+    response.setHeader("Allow", "POST");
+    return response;
+  }
+  const QByteArray &auth = req.header("Authorization");
+  QString username;
+  QByteArray password;
+  if (auth.startsWith("Basic ")) {
+    const QByteArray &credentials = QByteArray::fromBase64(auth.mid(6).trimmed());
+    const int colon = credentials.indexOf(':');
+    if (colon > 0) {
+      username = QString::fromUtf8(credentials.left(colon));
+      password = credentials.mid(colon + 1);
+    }
+  }
+  if (!mStorage->authenticate(username, password)) {
+    HttpResponse response = HttpResponse::error(QObject::tr("unauthorized"), 401);
+    response.setHeader("WWW-Authenticate", "Basic realm=\"ctSESAM\"");
+    return response;
+  }
+  QSharedPointer<UserStore> store = mStorage->user(username);
+  QMutexLocker locker(store->mutex());
+  if (!store->load())
+    return HttpResponse::error(store->errorString(), 500);
+  if (req.path.endsWith(mReadPath))
+    return read(store.data(), req);
+  if (req.path.endsWith(mWritePath))
+    return write(store.data(), req);
+  if (req.path.endsWith(mDeletePath))
+    return remove(store.data());
+  return HttpResponse::error(QObject::tr("not found"), 404);
+}
+
+
+/*!
+ * \brief SyncHandler::read
+ *
+ * Answers a read with the changes made after the revision given in `since`.
+ * The anchor is sent along if the client hasn't seen it yet. If it's the only
+ * thing to send and the client accepts it, the anchor goes out as a binary body.
+ *
+ * An empty store reports no revision, so the client falls back to a full sync
+ * and writes all of its data.
+ */
+HttpResponse SyncHandler::read(UserStore *store, const HttpRequest &req)
+{
+  const QMap<QByteArray, QByteArray> &form = req.formItems();
+  if (form.contains("blobs")) {
+    QStringList missing;
+    foreach (QByteArray id, form.value("blobs").split(',')) {
+      if (!id.isEmpty() && !store->containsBlob(id)) {
+        missing << QString::fromLatin1(id);
+      }
+    }
+    QVariantMap map;
+    map["status"] = "ok";
+    map["missing"] = missing;
+    return HttpResponse::json(map);
+  }
+  if (form.contains("blob"))
+    return readBlob(store, req, form.value("blob"));
+
+  const QByteArray &etag = store->etag();
+  if (!req.header("If-None-Match").isEmpty() && unquote(req.header("If-None-Match")) == etag) {
+    HttpResponse response(304);
+    response.setHeader("ETag", "\"" + etag + "\"");
+    return response;
+  }
+  qint64 since = form.value("since").toLongLong();
+  if (since < 0 || since > store->revision()) {
+    since = 0;
+  }
+  const bool isEmpty = !store->hasAnchor() && store->changesSince(0).isEmpty();
+  const bool withAnchor = store->hasAnchor() && since < store->anchorRevision();
+  const QVariantList &changes = store->changesSince(since);
+  const QByteArray &anchor = withAnchor ? store->anchor() : QByteArray();
+  if (withAnchor && anchor.isEmpty())
+    return HttpResponse::error(store->errorString(), 500);
+  HttpResponse response;
+  if (withAnchor && changes.isEmpty() && req.accepts("application/octet-stream")) {
+    response = HttpResponse::octetStream(anchor);
+    response.setHeader("X-SESAM-Status", "ok");
+    response.setHeader("X-SESAM-Features", Features.join(',').toLatin1());
+    response.setHeader("X-SESAM-Revision", QByteArray::number(store->revision()));
+  }
+  else {
+    QVariantMap map;
+    map["status"] = "ok";
+    map["features"] = Features;
+    if (!isEmpty) {
+      map["revision"] = store->revision();
+      map["changes"] = changes;
+    }
+    if (withAnchor) {
+      map["result"] = anchor.toBase64();
+    }
+    response = HttpResponse::json(map);
+  }
+  response.setHeader("ETag", "\"" + etag + "\"");
+  return response;
+}
+
+
+HttpResponse SyncHandler::readBlob(UserStore *store, const HttpRequest &req, const QByteArray &id)
+{
+  if (!store->containsBlob(id))
+    return HttpResponse::error(QObject::tr("unknown blob"));
+  const QByteArray &blob = store->blob(id);
+  if (req.accepts("application/octet-stream")) {
+    HttpResponse response = HttpResponse::octetStream(blob);
+    response.setHeader("X-SESAM-Status", "ok");
+    return response;
+  }
+  QVariantMap map;
+  map["status"] = "ok";
+  map["result"] = blob.toBase64();
+  return HttpResponse::json(map);
+}
+
+
+HttpResponse SyncHandler::write(UserStore *store, const HttpRequest &req)
+{
+  if (req.isOctetStream()) {
+    const QMap<QByteArray, QByteArray> &query = req.queryItems();
+    if (query.contains("blob"))
+      return writeBlob(store, query.value("blob"), req.body);
+    if (query.contains("upload"))
+      return writeUploadChunk(store, req);
+    return writeAnchor(store, req, req.body);
+  }
+  const QMap<QByteArray, QByteArray> &form = req.formItems();
+  if (form.contains("blob"))
+    return writeBlob(store, form.value("blob"), QByteArray::fromBase64(form.value("data")));
+  if (form.contains("patches"))
+    return writePatches(store, form.value("baseRevision"), form.value("patches"));
+  if (form.contains("data"))
+    return writeAnchor(store, req, QByteArray::fromBase64(form.value("data")));
+  return HttpResponse::error(QObject::tr("nothing to write"), 400);
+}
+
+
+/*!
+ * \brief SyncHandler::writeAnchor
+ *
+ * Replaces the user's data unless an `If-Match` header names
+ * a version other than the current one.
+ */
+HttpResponse SyncHandler::writeAnchor(UserStore *store, const HttpRequest &req, const QByteArray &data)
+{
+  const QByteArray &ifMatch = unquote(req.header("If-Match"));
+  if (!ifMatch.isEmpty() && ifMatch != "*" && ifMatch != store->etag())
+    return HttpResponse::error(QObject::tr("data has changed"), 412);
+  if (data.isEmpty())
+    return HttpResponse::error(QObject::tr("no data"), 400);
+  if (!store->replaceAnchor(data))
+    return HttpResponse::error(store->errorString(), 500);
+  return ok(store);
+}
+
+
+/*!
+ * \brief SyncHandler::writePatches
+ *
+ * Patches only apply to the revision they're based on,
+ * otherwise the client has to read and merge again.
+ */
+HttpResponse SyncHandler::writePatches(UserStore *store, const QByteArray &baseRevision, const QByteArray &patches)
+{
+  if (baseRevision.toLongLong() != store->revision())
+    return HttpResponse::error(QObject::tr("revision %1 is outdated").arg(QString::fromLatin1(baseRevision)), 409);
+  QJsonParseError parseError;
+  const QVariantList &list = QJsonDocument::fromJson(patches, &parseError).toVariant().toList();
+  if (parseError.error != QJsonParseError::NoError || list.isEmpty())
+    return HttpResponse::error(QObject::tr("malformed patches"), 400);
+  if (!store->applyPatches(list))
+    return HttpResponse::error(store->errorString(), 400);
+  return ok(store);
+}
+
+
+HttpResponse SyncHandler::writeUploadChunk(UserStore *store, const HttpRequest &req)
+{
+  const QMap<QByteArray, QByteArray> &query = req.queryItems();
+  const QByteArray &ifMatch = unquote(req.header("If-Match"));
+  if (!ifMatch.isEmpty() && ifMatch != "*" && ifMatch != store->etag())
+    return HttpResponse::error(QObject::tr("data has changed"), 412);
+  const QByteArray &uploadId = query.value("upload");
+  const int count = query.value("chunks").toInt();
+  const int index = query.value("chunk").toInt();
+  if (count <= 0 || count > MaxUploadChunks)
+    return HttpResponse::error(QObject::tr("invalid number of chunks"), 400);
+  bool complete = false;
+  if (!store->putUploadChunk(uploadId, index, count, req.body, &complete))
+    return HttpResponse::error(store->errorString(), 400);
+  if (complete)
+    return writeAnchor(store, req, store->takeUpload(uploadId, count));
+  QVariantMap map;
+  map["status"] = "ok";
+  map["chunk"] = index;
+  return HttpResponse::json(map);
+}
+
+
+HttpResponse SyncHandler::writeBlob(UserStore *store, const QByteArray &id, const QByteArray &data)
+{
+  if (!store->putBlob(id, data))
+    return HttpResponse::error(store->errorString(), 400);
+  QVariantMap map;
+  map["status"] = "ok";
+  return HttpResponse::json(map);
+}
+
+
+HttpResponse SyncHandler::remove(UserStore *store)
+{
+  if (!store->clear())
+    return HttpResponse::error(store->errorString(), 500);
+  QVariantMap map;
+  map["status"] = "ok";
+  return HttpResponse::json(map);
+}
+
+
+HttpResponse SyncHandler::ok(UserStore *store)
+{
+  QVariantMap map;
+  map["status"] = "ok";
+  map["revision"] = store->revision();
+  HttpResponse response = HttpResponse::json(map);
+  response.setHeader("ETag", "\"" + store->etag() + "\"");
+  return response;
+}
@@ -0,0 +1,60 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef __SYNCHANDLER_H_
+#define __SYNCHANDLER_H_
+
+#include <QByteArray>
+#include <QStringList>
+
+#include "httpmessage.h"
+#include "syncstorage.h"
+
+
+class SyncHandler
+{
+public:
+  explicit SyncHandler(SyncStorage *storage);
+
+  void setReadPath(const QByteArray &);
+  void setWritePath(const QByteArray &);
+  void setDeletePath(const QByteArray &);
+  HttpResponse handle(const HttpRequest &req);
+
+  static const QStringList Features;
+
+private:
+  HttpResponse read(UserStore *store, const HttpRequest &req);
+  HttpResponse readBlob(UserStore *store, const HttpRequest &req, const QByteArray &id);
+  HttpResponse write(UserStore *store, const HttpRequest &req);
+  HttpResponse writeAnchor(UserStore *store, const HttpRequest &req, const QByteArray &data);
+  HttpResponse writePatches(UserStore *store, const QByteArray &baseRevision, const QByteArray &patches);
+  HttpResponse writeUploadChunk(UserStore *store, const HttpRequest &req);
+  HttpResponse writeBlob(UserStore *store, const QByteArray &id, const QByteArray &data);
+  HttpResponse remove(UserStore *store);
+  HttpResponse ok(UserStore *store);
+
+  SyncStorage *mStorage;
+  QByteArray mReadPath;
+  QByteArray mWritePath;
+  QByteArray mDeletePath;
+};
+
+#endif // __SYNCHANDLER_H_
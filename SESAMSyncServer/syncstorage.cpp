@@ -0,0 +1,157 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "syncstorage.h"
+
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QCryptographicHash>
+
+
+class SyncStoragePrivate {
+public:
+  SyncStoragePrivate(const QString &root)
+    : root(root)
+    , registrationAllowed(false)
+  { /* ... */ }
+  ~SyncStoragePrivate()
+  { /* ... */ }
+  QString userPath(const QString &username) const
+  {
+    const QString &h = QString::fromLatin1(QCryptographicHash::hash(username.toUtf8(), QCryptographicHash::Sha256).toHex());
+    return root + "/" + h.left(2) + "/" + h;
+  }
+  QString root;
+  bool registrationAllowed;
+  QMutex mutex;
+  QHash<QString, QSharedPointer<UserStore> > users;
+  QHash<QString, QByteArray> credentials;
+};
+
+
+/*!
+ * \brief SyncStorage::SyncStorage
+ *
+ * Hands out the `UserStore` of each account below `root`.
+ * Directories are named after the SHA-256 digest of the user name,
+ * so user names never end up in paths.
+ */
+SyncStorage::SyncStorage(const QString &root)
+  : d_ptr(new SyncStoragePrivate(root))
+{
+  /* ... */
+}
+
+
+SyncStorage::~SyncStorage()
+{
+  /* ... */
+}
+
+
+QString SyncStorage::root(void) const
+{
+  Q_D(const SyncStorage);
+  return d->root;
+}
+
+
+void SyncStorage::setRegistrationAllowed(bool allowed)
+{
+  Q_D(SyncStorage);
+  d->registrationAllowed = allowed;
+}
+
+
+bool SyncStorage::registrationAllowed(void) const
+{
+  Q_D(const SyncStorage);
+  return d->registrationAllowed;
+}
+
+
+/*!
+ * \brief SyncStorage::authenticate
+ *
+ * Checks the credentials sent with a request. Verifying against the salted
+ * and iterated hash on disk is expensive, so a fast digest of credentials
+ * once found valid is kept in memory.
+ *
+ * If registration is allowed, unknown users get an account with the password
+ * they've sent first.
+ */
+bool SyncStorage::authenticate(const QString &username, const QByteArray &password)
+{
+  Q_D(SyncStorage);
+  if (username.isEmpty() || password.isEmpty())
+    return false;
+  const QByteArray &digest = QCryptographicHash::hash(password, QCryptographicHash::Sha256);
+  {
+    QMutexLocker locker(&d->mutex);
+    if (d->credentials.contains(username))
+      return d->credentials.value(username) == digest;
+  }
+  // don't keep a store around for every user name somebody tries
+  if (!d->registrationAllowed && !UserStore(d->userPath(username)).hasAccount())
+    return false;
+  QSharedPointer<UserStore> store = user(username);
+  QMutexLocker userLocker(store->mutex());
+  bool ok = false;
+  if (store->hasAccount()) {
+    ok = store->checkPassword(password);
+  }
+  else if (d->registrationAllowed) {
+    ok = store->createAccount(password);
+  }
+  if (ok) {
+    QMutexLocker locker(&d->mutex);
+    d->credentials.insert(username, digest);
+  }
+  return ok;
+}
+
+
+bool SyncStorage::addUser(const QString &username, const QByteArray &password)
+{
+  Q_D(SyncStorage);
+  if (username.isEmpty() || password.isEmpty())
+    return false;
+  QSharedPointer<UserStore> store = user(username);
+  QMutexLocker userLocker(store->mutex());
+  if (!store->createAccount(password))
+    return false;
+  QMutexLocker locker(&d->mutex);
+  d->credentials.remove(username);
+  return true;
+}
+
+
+QSharedPointer<UserStore> SyncStorage::user(const QString &username)
+{
+  Q_D(SyncStorage);
+  QMutexLocker locker(&d->mutex);
+  QSharedPointer<UserStore> store = d->users.value(username);
+  if (store.isNull()) {
+    store = QSharedPointer<UserStore>(new UserStore(d->userPath(username)));
+    d->users.insert(username, store);
+  }
+  return store;
+}
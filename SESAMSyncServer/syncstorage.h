@@ -0,0 +1,53 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef __SYNCSTORAGE_H_
+#define __SYNCSTORAGE_H_
+
+#include <QString>
+#include <QByteArray>
+#include <QSharedPointer>
+#include <QScopedPointer>
+
+#include "userstore.h"
+
+
+class SyncStoragePrivate;
+
+class SyncStorage
+{
+public:
+  explicit SyncStorage(const QString &root);
+  ~SyncStorage();
+
+  QString root(void) const;
+  void setRegistrationAllowed(bool);
+  bool registrationAllowed(void) const;
+  bool authenticate(const QString &username, const QByteArray &password);
+  bool addUser(const QString &username, const QByteArray &password);
+  QSharedPointer<UserStore> user(const QString &username);
+
+private:
+  QScopedPointer<SyncStoragePrivate> d_ptr;
+  Q_DECLARE_PRIVATE(SyncStorage)
+  Q_DISABLE_COPY(SyncStorage)
+};
+
+#endif // __SYNCSTORAGE_H_
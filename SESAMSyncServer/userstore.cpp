@@ -0,0 +1,456 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "userstore.h"
+
+#include <QObject>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QDateTime>
+#include <QJsonDocument>
+#include <QCryptographicHash>
+#include <QUuid>
+
+
+static const QString ACCOUNT_FILE = "account.json";
+static const QString STATE_FILE = "state.json";
+static const QString REVISION = "revision";
+static const QString ANCHOR_REVISION = "anchorRevision";
+static const QString ETAG = "etag";
+static const QString CHANGES = "changes";
+static const QString ID = "id";
+static const QString DATA = "data";
+static const int PasswordHashRounds = 4096;
+static const int MaxUploadAgeSecs = 60 * 60;
+
+
+static QByteArray passwordHash(const QByteArray &salt, const QByteArray &password)
+{
+  QByteArray hash = salt + password;
+  for (int i = 0; i < PasswordHashRounds; ++i) {
+    hash = QCryptographicHash::hash(salt + hash, QCryptographicHash::Sha256);
+  }
+  return hash.toHex();
+}
+
+
+/*!
+ * \brief anchorETag
+ *
+ * As long as there are no patches, the ETag is the SHA-256 digest of the anchor,
+ * so it matches what clients calculate from the data they've written themselves.
+ */
+static QByteArray anchorETag(const QByteArray &anchor)
+{
+  return QCryptographicHash::hash(anchor, QCryptographicHash::Sha256).toHex();
+}
+
+
+static bool isHex(const QByteArray &s)
+{
+  foreach (char c, s) {
+    if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f')))
+      return false;
+  }
+  return true;
+}
+
+
+/*!
+ * \brief UserStore::UserStore
+ *
+ * A `UserStore` holds everything the sync server keeps for one account:
+ * the encrypted domain settings last written as a whole (the anchor),
+ * the change log of per-domain patches written since, and attachment chunks.
+ * All files are replaced atomically. The caller must hold `mutex()`
+ * while using the store.
+ */
+UserStore::UserStore(const QString &path)
+  : mPath(path)
+  , mLoaded(false)
+  , mRevision(0)
+  , mAnchorRevision(0)
+{
+  /* ... */
+}
+
+
+QMutex *UserStore::mutex(void)
+{
+  return &mMutex;
+}
+
+
+bool UserStore::hasAccount(void) const
+{
+  return QFileInfo(mPath + "/" + ACCOUNT_FILE).isFile();
+}
+
+
+bool UserStore::createAccount(const QByteArray &password)
+{
+  QDir().mkpath(mPath);
+  const QByteArray &salt = QUuid::createUuid().toRfc4122().toHex();
+  QVariantMap account;
+  account["salt"] = salt;
+  account["hash"] = passwordHash(salt, password);
+  return writeFile(mPath + "/" + ACCOUNT_FILE, QJsonDocument::fromVariant(account).toJson(QJsonDocument::Compact));
+}
+
+
+bool UserStore::checkPassword(const QByteArray &password) const
+{
+  QFile f(mPath + "/" + ACCOUNT_FILE);
+  if (!f.open(QIODevice::ReadOnly))
+    return false;
+  const QVariantMap &account = QJsonDocument::fromJson(f.readAll()).toVariant().toMap();
+  const QByteArray &hash = account["hash"].toByteArray();
+  return !hash.isEmpty() && passwordHash(account["salt"].toByteArray(), password) == hash;
+}
+
+
+bool UserStore::load(void)
+{
+  if (mLoaded)
+    return true;
+  QFile f(mPath + "/" + STATE_FILE);
+  if (f.exists()) {
+    if (!f.open(QIODevice::ReadOnly)) {
+      mErrorString = f.errorString();
+      return false;
+    }
+    const QVariantMap &state = QJsonDocument::fromJson(f.readAll()).toVariant().toMap();
+    mRevision = state[REVISION].toLongLong();
+    mAnchorRevision = state[ANCHOR_REVISION].toLongLong();
+    mETag = state[ETAG].toByteArray();
+    mChanges = state[CHANGES].toList();
+  }
+  else {
+    mRevision = 0;
+    mAnchorRevision = 0;
+    mChanges.clear();
+    mETag = anchorETag(QByteArray());
+  }
+  mLoaded = true;
+  return true;
+}
+
+
+qint64 UserStore::revision(void) const
+{
+  return mRevision;
+}
+
+
+qint64 UserStore::anchorRevision(void) const
+{
+  return mAnchorRevision;
+}
+
+
+QByteArray UserStore::etag(void) const
+{
+  return mETag;
+}
+
+
+bool UserStore::hasAnchor(void) const
+{
+  return mAnchorRevision > 0;
+}
+
+
+QByteArray UserStore::anchor(void)
+{
+  if (!hasAnchor())
+    return QByteArray();
+  QFile f(anchorFileName(mAnchorRevision));
+  if (!f.open(QIODevice::ReadOnly)) {
+    mErrorString = f.errorString();
+    return QByteArray();
+  }
+  return f.readAll();
+}
+
+
+QVariantList UserStore::changesSince(qint64 revision) const
+{
+  QVariantList changes;
+  foreach (QVariant change, mChanges) {
+    if (change.toMap()[REVISION].toLongLong() > revision) {
+      changes << change;
+    }
+  }
+  return changes;
+}
+
+
+/*!
+ * \brief UserStore::replaceAnchor
+ *
+ * Stores `data` as the new anchor. The change log is dropped, because the
+ * client has merged all patches into the data it's writing.
+ */
+bool UserStore::replaceAnchor(const QByteArray &data)
+{
+  const qint64 previousAnchor = mAnchorRevision;
+  const qint64 revision = mRevision + 1;
+  if (!writeFile(anchorFileName(revision), data))
+    return false;
+  const QByteArray &etag = anchorETag(data);
+  if (!saveState(revision, revision, etag, QVariantList())) {
+    QFile::remove(anchorFileName(revision));
+    return false;
+  }
+  mRevision = revision;
+  mAnchorRevision = revision;
+  mETag = etag;
+  mChanges.clear();
+  if (previousAnchor > 0) {
+    QFile::remove(anchorFileName(previousAnchor));
+  }
+  return true;
+}
+
+
+/*!
+ * \brief UserStore::applyPatches
+ *
+ * Appends all `patches` to the change log under a single new revision.
+ * An older change of the same domain is superseded.
+ * Either all patches are applied or none: they are checked before anything
+ * is touched and the store keeps its state if it cannot be saved.
+ */
+bool UserStore::applyPatches(const QVariantList &patches)
+{
+  foreach (QVariant patch, patches) {
+    const QVariantMap &change = patch.toMap();
+    if (change[ID].toString().isEmpty() || change[DATA].toString().isEmpty()) {
+      mErrorString = QObject::tr("malformed patch");
+      return false;
+    }
+  }
+  const qint64 revision = mRevision + 1;
+  QVariantList changes = mChanges;
+  foreach (QVariant patch, patches) {
+    QVariantMap change = patch.toMap();
+    const QString &id = change[ID].toString();
+    for (int i = 0; i < changes.size(); ++i) {
+      if (changes.at(i).toMap()[ID].toString() == id) {
+        changes.removeAt(i);
+        break;
+      }
+    }
+    change[REVISION] = revision;
+    changes << change;
+  }
+  const QByteArray &etag = QCryptographicHash::hash(mETag + "\n" + QByteArray::number(revision), QCryptographicHash::Sha256).toHex();
+  if (!saveState(revision, mAnchorRevision, etag, changes))
+    return false;
+  mRevision = revision;
+  mETag = etag;
+  mChanges = changes;
+  return true;
+}
+
+
+/*!
+ * \brief UserStore::clear
+ *
+ * Removes the anchor, the change log and all blobs, but keeps counting
+ * revisions: a client that read the old data must see the next anchor as
+ * newer than anything it has.
+ */
+bool UserStore::clear(void)
+{
+  if (!load())
+    return false;
+  const qint64 revision = mRevision + 1;
+  const QByteArray &etag = anchorETag(QByteArray());
+  if (!saveState(revision, 0, etag, QVariantList()))
+    return false;
+  mRevision = revision;
+  mAnchorRevision = 0;
+  mETag = etag;
+  mChanges.clear();
+  foreach (QString entry, QDir(mPath).entryList(QDir::AllEntries | QDir::NoDotAndDotDot)) {
+    if (entry == ACCOUNT_FILE || entry == STATE_FILE)
+      continue;
+    const QString &path = mPath + "/" + entry;
+    if (QFileInfo(path).isDir()) {
+      QDir(path).removeRecursively();
+    }
+    else {
+      QFile::remove(path);
+    }
+  }
+  return true;
+}
+
+
+bool UserStore::containsBlob(const QByteArray &id) const
+{
+  return isValidBlobId(id) && QFileInfo(blobFileName(id)).isFile();
+}
+
+
+QByteArray UserStore::blob(const QByteArray &id)
+{
+  QFile f(blobFileName(id));
+  if (!isValidBlobId(id) || !f.open(QIODevice::ReadOnly)) {
+    mErrorString = QObject::tr("unknown blob");
+    return QByteArray();
+  }
+  return f.readAll();
+}
+
+
+bool UserStore::putBlob(const QByteArray &id, const QByteArray &data)
+{
+  if (!isValidBlobId(id) || data.isEmpty()) {
+    mErrorString = QObject::tr("invalid blob");
+    return false;
+  }
+  if (containsBlob(id))
+    return true;
+  QDir().mkpath(QFileInfo(blobFileName(id)).absolutePath());
+  return writeFile(blobFileName(id), data);
+}
+
+
+/*!
+ * \brief UserStore::putUploadChunk
+ *
+ * Keeps one piece of a chunked upload. `complete` is set once all
+ * `count` pieces have arrived.
+ */
+bool UserStore::putUploadChunk(const QByteArray &uploadId, int index, int count, const QByteArray &data, bool *complete)
+{
+  if (!isValidUploadId(uploadId) || index < 0 || index >= count) {
+    mErrorString = QObject::tr("invalid upload");
+    return false;
+  }
+  if (index == 0) {
+    removeStaleUploads();
+  }
+  const QString &dir = uploadDir(uploadId);
+  QDir().mkpath(dir);
+  if (!writeFile(dir + "/" + QString::number(index), data))
+    return false;
+  int received = 0;
+  for (int i = 0; i < count; ++i) {
+    if (QFileInfo(dir + "/" + QString::number(i)).isFile()) {
+      ++received;
+    }
+  }
+  *complete = received == count;
+  return true;
+}
+
+
+QByteArray UserStore::takeUpload(const QByteArray &uploadId, int count)
+{
+  const QString &dir = uploadDir(uploadId);
+  QByteArray data;
+  for (int i = 0; i < count; ++i) {
+    QFile f(dir + "/" + QString::number(i));
+    if (!f.open(QIODevice::ReadOnly)) {
+      mErrorString = f.errorString();
+      data.clear();
+      break;
+    }
+    data += f.readAll();
+  }
+  QDir(dir).removeRecursively();
+  return data;
+}
+
+
+QString UserStore::errorString(void) const
+{
+  return mErrorString;
+}
+
+
+bool UserStore::isValidBlobId(const QByteArray &id)
+{
+  return id.size() == 64 && isHex(id);
+}
+
+
+bool UserStore::isValidUploadId(const QByteArray &id)
+{
+  return !id.isEmpty() && id.size() <= 64 && isHex(id);
+}
+
+
+bool UserStore::saveState(qint64 revision, qint64 anchorRevision, const QByteArray &etag, const QVariantList &changes)
+{
+  QVariantMap state;
+  state[REVISION] = revision;
+  state[ANCHOR_REVISION] = anchorRevision;
+  state[ETAG] = etag;
+  state[CHANGES] = changes;
+  return writeFile(mPath + "/" + STATE_FILE, QJsonDocument::fromVariant(state).toJson(QJsonDocument::Compact));
+}
+
+
+bool UserStore::writeFile(const QString &filename, const QByteArray &data)
+{
+  QDir().mkpath(mPath);
+  QSaveFile f(filename);
+  if (!f.open(QIODevice::WriteOnly) || f.write(data) != data.size() || !f.commit()) {
+    mErrorString = f.errorString();
+    return false;
+  }
+  return true;
+}
+
+
+QString UserStore::anchorFileName(qint64 revision) const
+{
+  return mPath + QString("/data-%1.bin").arg(revision);
+}
+
+
+QString UserStore::blobFileName(const QByteArray &id) const
+{
+  return mPath + "/blobs/" + QString::fromLatin1(id.left(2)) + "/" + QString::fromLatin1(id);
+}
+
+
+QString UserStore::uploadDir(const QByteArray &uploadId) const
+{
+  return mPath + "/uploads/" + QString::fromLatin1(uploadId);
+}
+
+
+void UserStore::removeStaleUploads(void)
+{
+  const QDateTime &expired = QDateTime::currentDateTime().addSecs(-MaxUploadAgeSecs);
+  QDir uploads(mPath + "/uploads");
+  foreach (QFileInfo fi, uploads.entryInfoList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+    if (fi.lastModified() < expired) {
+      QDir(fi.absoluteFilePath()).removeRecursively();
+    }
+  }
+}
@@ -0,0 +1,81 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef __USERSTORE_H_
+#define __USERSTORE_H_
+
+#include <QString>
+#include <QByteArray>
+#include <QVariantList>
+#include <QMutex>
+
+
+class UserStore
+{
+public:
+  explicit UserStore(const QString &path);
+
+  QMutex *mutex(void);
+  bool hasAccount(void) const;
+  bool createAccount(const QByteArray &password);
+  bool checkPassword(const QByteArray &password) const;
+
+  bool load(void);
+  qint64 revision(void) const;
+  qint64 anchorRevision(void) const;
+  QByteArray etag(void) const;
+  bool hasAnchor(void) const;
+  QByteArray anchor(void);
+  QVariantList changesSince(qint64 revision) const;
+  bool replaceAnchor(const QByteArray &data);
+  bool applyPatches(const QVariantList &patches);
+  bool clear(void);
+
+  bool containsBlob(const QByteArray &id) const;
+  QByteArray blob(const QByteArray &id);
+  bool putBlob(const QByteArray &id, const QByteArray &data);
+
+  bool putUploadChunk(const QByteArray &uploadId, int index, int count, const QByteArray &data, bool *complete);
+  QByteArray takeUpload(const QByteArray &uploadId, int count);
+
+  QString errorString(void) const;
+
+  static bool isValidBlobId(const QByteArray &id);
+  static bool isValidUploadId(const QByteArray &id);
+
+private:
+  bool saveState(qint64 revision, qint64 anchorRevision, const QByteArray &etag, const QVariantList &changes);
+  bool writeFile(const QString &filename, const QByteArray &data);
+  QString anchorFileName(qint64 revision) const;
+  QString blobFileName(const QByteArray &id) const;
+  QString uploadDir(const QByteArray &uploadId) const;
+  void removeStaleUploads(void);
+
+  QString mPath;
+  QMutex mMutex;
+  bool mLoaded;
+  qint64 mRevision;
+  qint64 mAnchorRevision;
+  QByteArray mETag;
+  QVariantList mChanges;
+  QString mErrorString;
+};
+
+#endif // __USERSTORE_H_
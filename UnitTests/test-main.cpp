@@ -23,11 +23,36 @@
 #include "crypter.h"
 #include "exporter.h"
 #include "domainsettings.h"
+#include "domainsettingslist.h"
+#include "domainindex.h"
+#include "blobstore.h"
+#include "backupstore.h"
+#include "filewiper.h"
+#include "tracer.h"
+#include "metrics.h"
+#include "wordlist.h"
+#include "breachfilter.h"
+#include "strengthestimator.h"
+#include "vaultauditor.h"
+#include "kdfbenchmark.h"
+#include "syncpatch.h"
+#include "syncdecoder.h"
+#include "syncscheduler.h"
+#include "vault.h"
+#include "qrencode.h"
+#include "qrraster.h"
 
 #include <QDebug>
 #include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QBuffer>
 #include <QMessageAuthenticationCode>
+#include <QRegularExpression>
+#include <QJsonArray>
+#include <QtConcurrent>
 #include <QtTest/QTest>
+#include <QtTest/QSignalSpy>
 
 
 class TestSESAM : public QObject
@@ -299,6 +324,654 @@ private slots:
     QVERIFY(original.size() == recovered.size());
     QVERIFY(original == recovered);
   }
+
+  void vault_write_read(void)
+  {
+    const QString filename = QDir::tempPath() + "/qt-sesam-unit-test.vault";
+    QFile::remove(filename);
+    SecureByteArray masterPassword = QString("7h15p455w0rd15m0r37h4n53cr37").toUtf8();
+    QByteArray salt = Crypter::generateSalt();
+    SecureByteArray key;
+    SecureByteArray IV;
+    Crypter::makeKeyAndIVFromPassword(masterPassword, salt, key, IV);
+    SecureByteArray KGK = Crypter::generateKGK();
+    DomainSettingsList domains;
+    DomainSettings ds1;
+    ds1.domainName = "foo.example";
+    ds1.userName = "foo";
+    ds1.createdDate = QDateTime::currentDateTime();
+    domains << ds1;
+    DomainSettings ds2;
+    ds2.domainName = "bar.example";
+    ds2.legacyPassword = "s3cr3t";
+    ds2.notes = QString(4096, QChar('x'));
+    domains << ds2;
+    {
+      Vault vault(filename);
+      QVERIFY(vault.create(key, IV, salt, KGK, domains));
+      QVERIFY(vault.count() == 2);
+      ds1.userName = "foo2";
+      QVERIFY(vault.write(ds1));
+      DomainSettings ds3;
+      ds3.domainName = "baz.example";
+      QVERIFY(vault.write(ds3));
+    }
+    Vault vault(filename);
+    QVERIFY(vault.open(masterPassword));
+    QVERIFY(vault.KGK() == KGK);
+    QVERIFY(vault.count() == 3);
+    QVERIFY(vault.contains("baz.example"));
+    QVERIFY(vault.read("foo.example").userName == "foo2");
+    QVERIFY(vault.read("bar.example").legacyPassword == ds2.legacyPassword);
+    QVERIFY(vault.read("bar.example").notes == ds2.notes);
+    QVERIFY(vault.read("nonexistent").isEmpty());
+    foreach (Vault::IndexEntry e, vault.index()) {
+      QVERIFY(e.createdDate == vault.read(e.domainName).createdDate);
+    }
+    vault.close();
+    QFile::remove(filename);
+  }
+
+  void vault_batch_write(void)
+  {
+    const QString filename = QDir::tempPath() + "/qt-sesam-unit-test-batch.vault";
+    QFile::remove(filename);
+    SecureByteArray masterPassword = QString("7h15p455w0rd15m0r37h4n53cr37").toUtf8();
+    QByteArray salt = Crypter::generateSalt();
+    SecureByteArray key;
+    SecureByteArray IV;
+    Crypter::makeKeyAndIVFromPassword(masterPassword, salt, key, IV);
+    {
+      Vault vault(filename);
+      QVERIFY(vault.create(key, IV, salt, Crypter::generateKGK(), DomainSettingsList()));
+      const qint64 emptySize = QFileInfo(filename).size();
+      DomainSettingsList batch;
+      for (int i = 0; i < 50; ++i) {
+        DomainSettings ds;
+        ds.domainName = QString("domain%1.example").arg(i);
+        ds.userName = QString("user%1").arg(i);
+        batch << ds;
+      }
+      QVERIFY(vault.write(batch));
+      const qint64 batchSize = QFileInfo(filename).size();
+      QVERIFY(batchSize > emptySize);
+      // unchanged settings aren't written again
+      QVERIFY(vault.write(batch));
+      QVERIFY(QFileInfo(filename).size() == batchSize);
+    }
+    Vault vault(filename);
+    QVERIFY(vault.open(masterPassword));
+    QVERIFY(vault.count() == 50);
+    QVERIFY(vault.read("domain42.example").userName == "user42");
+    vault.close();
+    QFile::remove(filename);
+  }
+
+  void domain_index(void)
+  {
+    DomainSettingsList domains;
+    DomainSettings ds1;
+    ds1.domainName = "foo.example";
+    ds1.groupHierarchy = "work/mail";
+    ds1.tags << "a" << "b";
+    ds1.modifiedDate = QDateTime(QDate(2015, 10, 1), QTime(12, 0, 0));
+    domains << ds1;
+    DomainSettings ds2;
+    ds2.domainName = "bar.example";
+    ds2.deleted = true;
+    domains << ds2;
+    DomainIndex idx = DomainIndex::fromQJsonDocument(QJsonDocument::fromJson(domains.toJson()));
+    QVERIFY(idx.count() == 2);
+    QVERIFY(!idx.isDirty());
+    QVERIFY(idx.entry("foo.example").groupHierarchy == ds1.groupHierarchy);
+    QVERIFY(idx.entry("foo.example").tags == ds1.tags);
+    QVERIFY(idx.entry("foo.example").modifiedDate == ds1.modifiedDate);
+    QVERIFY(idx.entry("bar.example").deleted);
+    QVERIFY(idx.decode("foo.example").domainName == ds1.domainName);
+    QVERIFY(idx.decode("nonexistent").isEmpty());
+    ds1.userName = "foo";
+    idx.updateWith(ds1);
+    QVERIFY(idx.isDirty());
+    DomainIndex idx2 = DomainIndex::fromQJsonDocument(QJsonDocument::fromJson(idx.toJson()));
+    QVERIFY(idx2.decode("foo.example").userName == "foo");
+    idx2.remove("bar.example");
+    QVERIFY(idx2.keys() == QStringList() << "foo.example");
+  }
+
+  void blobstore_store_fetch(void)
+  {
+    const QString &path = QDir::tempPath() + "/test-sesam.blobs";
+    QDir(path).removeRecursively();
+    BlobStore store(path);
+    store.setKGK(Crypter::generateKGK());
+    QVERIFY(store.isValid());
+    QByteArray data(BlobStore::ChunkSize * 2 + 1000, 0);
+    for (int i = 0; i < data.size(); ++i) {
+      data[i] = char(i * 7);
+    }
+    QBuffer src(&data);
+    src.open(QIODevice::ReadOnly);
+    const BlobStore::Reference &ref = store.store(&src);
+    QVERIFY(ref.isValid());
+    QVERIFY(ref.size == data.size());
+    QVERIFY(ref.chunks.size() == 3);
+    QVERIFY(BlobStore::Reference::isReference(ref.toVariantMap()));
+    QVERIFY(store.put(data.left(BlobStore::ChunkSize)) == ref.chunks.first());
+    QVERIFY(store.ids().size() == 3);
+    QByteArray restored;
+    QBuffer dst(&restored);
+    dst.open(QIODevice::WriteOnly);
+    QVERIFY(store.fetch(ref, &dst));
+    QVERIFY(restored == data);
+    QByteArray tampered = store.rawBlob(ref.chunks.last());
+    tampered[tampered.size() - 1] = tampered.at(tampered.size() - 1) ^ 1;
+    BlobStore peer(path + "-peer");
+    peer.setKGK(Crypter::generateKGK());
+    QVERIFY(!peer.putRawBlob(ref.chunks.first(), store.rawBlob(ref.chunks.first())));
+    QVERIFY(!store.putRawBlob(ref.chunks.last(), tampered));
+    QDir(path).removeRecursively();
+    QDir(path + "-peer").removeRecursively();
+  }
+
+  void syncpatch_encode_decode(void)
+  {
+    const SecureByteArray &KGK = Crypter::generateKGK();
+    DomainSettings ds;
+    ds.domainName = "foo.example";
+    ds.userName = "foo";
+    ds.modifiedDate = QDateTime(QDate(2015, 10, 1), QTime(12, 0, 0));
+    const QByteArray &patch = SyncPatch::encode(KGK, ds);
+    QVERIFY(patch.size() < 512);
+    const DomainSettings &decoded = SyncPatch::decode(KGK, patch);
+    QVERIFY(decoded.domainName == ds.domainName);
+    QVERIFY(decoded.userName == ds.userName);
+    QVERIFY(decoded.modifiedDate == ds.modifiedDate);
+    QVERIFY(SyncPatch::entryId(KGK, ds.domainName) == SyncPatch::entryId(KGK, "foo.example"));
+    QVERIFY(SyncPatch::entryId(KGK, ds.domainName) != SyncPatch::entryId(Crypter::generateKGK(), ds.domainName));
+    DomainSettingsList domains;
+    domains << ds;
+    const QVariantList &changes = QJsonDocument::fromJson(SyncPatch::encodeList(KGK, domains)).toVariant().toList();
+    QVERIFY(changes.size() == 1);
+    QVERIFY(SyncPatch::decodeList(KGK, changes).at(0).userName == ds.userName);
+  }
+
+  void syncdecoder_dedup(void)
+  {
+    SecureByteArray masterPassword = QString("7h15p455w0rd15m0r37h4n53cr37").toUtf8();
+    QByteArray salt = Crypter::generateSalt();
+    SecureByteArray key;
+    SecureByteArray IV;
+    Crypter::makeKeyAndIVFromPassword(masterPassword, salt, key, IV);
+    SecureByteArray KGK = Crypter::generateKGK();
+    QByteArray data = Crypter::randomBytes(1024);
+    QByteArray cipher = Crypter::encode(key, IV, salt, KGK, data, true);
+
+    SyncDecoder decoder;
+    decoder.setPassword(masterPassword);
+    QFuture<SyncDecoder::Result> f1 = decoder.decode(cipher);
+    QFuture<SyncDecoder::Result> f2 = decoder.decode(QByteArray(cipher));
+    QVERIFY(decoder.decodeCount() == 1);
+    QVERIFY(f1.result().ok);
+    QVERIFY(f1.result().data == data);
+    QVERIFY(f2.result().KGK == KGK);
+
+    decoder.setPassword(QString("wrong").toUtf8());
+    const SyncDecoder::Result &wrong = decoder.decode(cipher).result();
+    QVERIFY(!wrong.ok);
+  }
+
+  void syncscheduler_backoff(void)
+  {
+    QVERIFY(SyncScheduler::retryDelay(1, 1000, 60000, 0) == 500);
+    QVERIFY(SyncScheduler::retryDelay(1, 1000, 60000, 0.999) < 1000);
+    QVERIFY(SyncScheduler::retryDelay(3, 1000, 60000, 0) == 2000);
+    QVERIFY(SyncScheduler::retryDelay(30, 1000, 60000, 0) == 30000);
+    QVERIFY(SyncScheduler::retryDelay(30, 1000, 60000, 0.999) <= 60000);
+  }
+
+  void syncscheduler_pending_queue(void)
+  {
+    SyncScheduler scheduler;
+    scheduler.addPendingChange("a");
+    scheduler.addPendingChange("b");
+    scheduler.addPendingChange("a");
+    QVERIFY(scheduler.pendingChanges().size() == 2);
+    scheduler.syncStarted();
+    scheduler.addPendingChange("c");
+    scheduler.syncFailed();
+    QVERIFY(scheduler.failures() == 1);
+    QVERIFY(scheduler.pendingChanges().size() == 3);
+    SyncScheduler restored;
+    restored.restore(scheduler.toVariantMap());
+    QVERIFY(restored.pendingChanges() == scheduler.pendingChanges());
+    QVERIFY(restored.failures() == 1);
+    restored.syncStarted();
+    restored.addPendingChange("d");
+    restored.syncSucceeded(false);
+    QVERIFY(restored.failures() == 0);
+    QVERIFY(restored.pendingChanges() == QStringList() << "d");
+    SyncScheduler failing;
+    failing.syncStarted();
+    failing.syncFailed();
+    failing.syncStarted();
+    QSignalSpy spy(&failing, SIGNAL(pendingChangesChanged()));
+    failing.syncSucceeded(false);
+    QVERIFY(spy.count() == 1);
+  }
+
+  void backupstore_dedup(void)
+  {
+    QByteArray data;
+    qsrand(4711);
+    for (int i = 0; i < 512 * 1024; ++i) {
+      data.append(char(qrand() & 0xff));
+    }
+    const QList<int> &cuts = BackupStore::cutPoints(data);
+    QVERIFY(!cuts.isEmpty());
+    QVERIFY(cuts.last() == data.size());
+    int start = 0;
+    foreach (int end, cuts) {
+      QVERIFY(end - start <= BackupStore::MaxChunkSize);
+      QVERIFY(end - start >= BackupStore::MinChunkSize || end == data.size());
+      start = end;
+    }
+    const QString path = QDir::tempPath() + "/qt-sesam-unit-test-backups";
+    QDir(path).removeRecursively();
+    SecureByteArray masterPassword = QString("7h15p455w0rd15m0r37h4n53cr37").toUtf8();
+    QByteArray salt = Crypter::generateSalt();
+    SecureByteArray key;
+    SecureByteArray IV;
+    Crypter::makeKeyAndIVFromPassword(masterPassword, salt, key, IV);
+    const SecureByteArray &KGK = Crypter::generateKGK();
+    BackupStore store(path);
+    QVariantMap files;
+    files["vault"] = data;
+    const QString &id1 = store.write(key, IV, salt, KGK, files);
+    QVERIFY(!id1.isEmpty());
+    QVERIFY(store.lastWriteNewBytes() == data.size());
+    // an insertion only adds the chunks around it
+    data.insert(data.size() / 3, QByteArray(100, 'x'));
+    files["vault"] = data;
+    const QString &id2 = store.write(key, IV, salt, KGK, files);
+    QVERIFY(!id2.isEmpty() && id2 != id1);
+    QVERIFY(store.lastWriteNewBytes() < 3 * BackupStore::MaxChunkSize);
+    QVERIFY(store.snapshots().size() == 2);
+    QVERIFY(store.read(id2, masterPassword)["vault"].toByteArray() == data);
+    QVERIFY(store.prune(0, 1) == 1);
+    QVERIFY(store.snapshots().size() == 1);
+    QVERIFY(store.read(id2, masterPassword)["vault"].toByteArray() == data);
+    QDir(path).removeRecursively();
+  }
+
+  void filewiper(void)
+  {
+    const QString path = QDir::tempPath() + "/qt-sesam-unit-test-wipe";
+    QDir().mkpath(path);
+    QStringList filenames;
+    for (int i = 0; i < 8; ++i) {
+      const QString filename = QString("%1/%2.txt").arg(path).arg(i);
+      QFile f(filename);
+      QVERIFY(f.open(QIODevice::WriteOnly));
+      f.write(QByteArray(FileWiper::BlockSize + 1000 * i, 'x'));
+      f.close();
+      filenames << filename;
+    }
+    FileWiper wiper;
+    wiper.setExtensive(true);
+    QVERIFY(wiper.passes() == 23);
+    QVERIFY(wiper.wipeFiles(filenames).isEmpty());
+    foreach (QString filename, filenames) {
+      QVERIFY(!QFileInfo(filename).exists());
+    }
+    QVERIFY(!wiper.wipeFile(path + "/does-not-exist.txt"));
+    QDir(path).removeRecursively();
+  }
+
+  void filewiper_benchmark(void)
+  {
+    const QString path = QDir::tempPath() + "/qt-sesam-unit-test-wipe-benchmark";
+    const QByteArray data(256 * 1024, 'x');
+    FileWiper wiper;
+    wiper.setExtensive(true);
+    QBENCHMARK {
+      QDir().mkpath(path);
+      QStringList filenames;
+      for (int i = 0; i < 32; ++i) {
+        const QString filename = QString("%1/%2-backup.txt").arg(path).arg(i);
+        QFile f(filename);
+        f.open(QIODevice::WriteOnly);
+        f.write(data);
+        f.close();
+        filenames << filename;
+      }
+      QVERIFY(wiper.wipeFiles(filenames).isEmpty());
+    }
+    QDir(path).removeRecursively();
+  }
+
+  void tracer_chrome_json(void)
+  {
+#ifdef QTSESAM_NO_TRACING
+    QSKIP("trace spans are compiled out (CONFIG+=no_tracing)");
+#endif
+    Tracer &tracer = Tracer::instance();
+    tracer.clear();
+    {
+      TRACE_SPAN("test", "disabled");
+    }
+    QVERIFY(tracer.eventCount() == 0);
+    tracer.setEnabled(true);
+    {
+      TRACE_SPAN("test", "outer");
+      // poll instead of waitForFinished(), which might run the task on this thread
+      QFuture<void> worker = QtConcurrent::run([]() { TRACE_SPAN("test", "worker"); });
+      while (!worker.isFinished()) {
+        QThread::msleep(1);
+      }
+    }
+    tracer.setEnabled(false);
+    QVERIFY(tracer.eventCount() == 2);
+    const QJsonDocument &json = QJsonDocument::fromJson(tracer.toChromeTraceJson());
+    QVERIFY(json.isObject());
+    QSet<int> tids;
+    QStringList names;
+    foreach (QJsonValue v, json.object()["traceEvents"].toArray()) {
+      const QJsonObject &ev = v.toObject();
+      if (ev["ph"].toString() == "X") {
+        names << ev["name"].toString();
+        tids << ev["tid"].toInt();
+        QVERIFY(ev["dur"].toDouble() >= 0);
+      }
+    }
+    names.sort();
+    QVERIFY(names == QStringList() << "outer" << "worker");
+    QVERIFY(tids.size() == 2);
+    tracer.clear();
+  }
+
+  void metrics_histogram(void)
+  {
+    for (qint64 v = 0; v < 100000; v += 7) {
+      const int idx = Metrics::Histogram::bucketIndex(v);
+      QVERIFY(Metrics::Histogram::bucketLowerBound(idx) <= v && v <= Metrics::Histogram::bucketUpperBound(idx));
+    }
+    QVERIFY(Metrics::Histogram::bucketIndex(Q_INT64_C(0x7fffffffffffffff)) == Metrics::Histogram::BucketCount - 1);
+    Metrics::Histogram h;
+    for (int i = 1; i <= 10000; ++i) {
+      h.record(i);
+    }
+    QVERIFY(h.count() == 10000);
+    QVERIFY(h.minimum() == 1);
+    QVERIFY(h.maximum() == 10000);
+    QVERIFY(qAbs(h.mean() - 5000.5) < 1e-9);
+    QVERIFY(qAbs(h.percentile(50) - 5000) <= 5000 / 16);
+    QVERIFY(qAbs(h.percentile(99) - 9900) <= 9900 / 16);
+    QVERIFY(h.percentile(100) == 10000);
+    Metrics &metrics = Metrics::instance();
+    metrics.counter("test.cache.hits").add(3);
+    metrics.counter("test.cache.misses").add(1);
+    metrics.gauge("test.gauge").set(42);
+    const QJsonObject &json = QJsonDocument::fromJson(metrics.toJson()).object();
+    QVERIFY(json["counters"].toObject()["test.cache.hits"].toInt() == 3);
+    QVERIFY(qAbs(json["rates"].toObject()["test.cache.hit_rate"].toDouble() - 0.75) < 1e-9);
+    QVERIFY(json["gauges"].toObject()["test.gauge"].toInt() == 42);
+    QVERIFY(metrics.toText().contains("test.cache.hit_rate"));
+    metrics.reset();
+    QVERIFY(metrics.counter("test.cache.hits").value() == 0);
+  }
+
+  void wordlist_lookup(void)
+  {
+    const QString path = QDir::tempPath() + "/qt-sesam-unit-test-wordlist";
+    QDir(path).removeRecursively();
+    QDir().mkpath(path);
+    QStringList words;
+    for (int i = 0; i < 5000; ++i) {
+      words << QString("pass%1word").arg(i);
+    }
+    words << "Dragon" << "_underscore" << "ZEBRA" << "letmein";
+    words.sort(Qt::CaseInsensitive);
+    QFile sortedFile(path + "/sorted.txt");
+    QVERIFY(sortedFile.open(QIODevice::WriteOnly));
+    sortedFile.write(words.join("\r\n").toUtf8() + "\r\n");
+    sortedFile.close();
+    WordList sorted(sortedFile.fileName());
+    sorted.setCacheDirectory(path + "/cache");
+    QVERIFY(sorted.open());
+    QVERIFY(sorted.wasSorted());
+    QVERIFY(!sorted.indexFromCache());
+    QVERIFY(sorted.count() == words.size());
+    foreach (QString word, words) {
+      QVERIFY(sorted.contains(word.toUtf8(), Qt::CaseSensitive));
+    }
+    QVERIFY(sorted.wordAt(sorted.find("dragon")) == "Dragon");
+    QVERIFY(sorted.contains("dRaGoN"));
+    QVERIFY(!sorted.contains("dragon", Qt::CaseSensitive));
+    QVERIFY(!sorted.contains("pass5000word"));
+    QVERIFY(!sorted.contains("aaa"));
+    QVERIFY(!sorted.contains("zzz"));
+    sorted.close();
+    QVERIFY(sorted.open());
+    QVERIFY(sorted.indexFromCache());
+    QVERIFY(sorted.contains("zebra"));
+    // unsorted input is searched via a sorted copy
+    QFile unsortedFile(path + "/unsorted.txt");
+    QVERIFY(unsortedFile.open(QIODevice::WriteOnly));
+    unsortedFile.write("zulu\nalpha\n\nMike\nalpha\n");
+    unsortedFile.close();
+    WordList unsorted(unsortedFile.fileName());
+    QVERIFY(unsorted.open());
+    QVERIFY(!unsorted.wasSorted());
+    QVERIFY(unsorted.count() == 3);
+    QVERIFY(unsorted.contains("ALPHA") && unsorted.contains("mike") && unsorted.contains("Zulu"));
+    QVERIFY(!unsorted.contains("bravo"));
+    // UTF-8 sequences are compared as they are
+    QVERIFY(WordList::compare("\xc3\x84", 2, "\xc3\xa4", 2) != 0);
+    QVERIFY(WordList::compare("\xc3\x84X", 3, "\xc3\x84x", 3) == 0);
+    QDir(path).removeRecursively();
+  }
+
+  void breachfilter_lookup(void)
+  {
+    QVERIFY(BreachFilter::digest("password", BreachFilter::Sha1).toHex() == "5baa61e4c9b93f3f0682250b6cf8331b7ee68fd8");
+    QVERIFY(BreachFilter::digest("password", BreachFilter::Ntlm).toHex() == "8846f7eaee8fb117ad06bdd830b7586c");
+    QVERIFY(BreachFilter::keyFromDigest(BreachFilter::digest("password", BreachFilter::Sha1)) == Q_UINT64_C(0x5baa61e4c9b93f3f));
+    std::vector<quint64> keys;
+    for (int i = 0; i < 20000; ++i) {
+      keys.push_back(BreachFilter::keyFromDigest(BreachFilter::digest(QString("leaked%1").arg(i), BreachFilter::Sha1)));
+    }
+    keys.push_back(keys.front());
+    const QString filename = QDir::tempPath() + "/qt-sesam-unit-test.breachfilter";
+    QFile f(filename);
+    QVERIFY(f.open(QIODevice::WriteOnly));
+    QVERIFY(BreachFilter::build(keys, BreachFilter::Sha1, 16, &f));
+    f.close();
+    QVERIFY(BreachFilter::isFilterFile(filename));
+    BreachFilter filter(filename);
+    QVERIFY(filter.open());
+    QVERIFY(filter.count() == 20000);
+    QVERIFY(filter.fingerprintBits() == 16);
+    for (int i = 0; i < 20000; ++i) {
+      QVERIFY(filter.containsPassword(QString("leaked%1").arg(i)));
+    }
+    int falsePositives = 0;
+    for (int i = 0; i < 20000; ++i) {
+      if (filter.containsPassword(QString("unlisted%1").arg(i)))
+        ++falsePositives;
+    }
+    QVERIFY(falsePositives < 10);
+    filter.close();
+    QFile::remove(filename);
+  }
+
+  void strengthestimator_patterns(void)
+  {
+    StrengthEstimator estimator;
+    estimator.setPassword("password1");
+    QVERIFY(estimator.score() <= 1);
+    estimator.setPassword("P@ssw0rd");
+    QVERIFY(estimator.score() == 0);
+    QVERIFY(estimator.sequence().first().pattern == StrengthEstimator::Match::Dictionary);
+    estimator.setPassword("qwertz");
+    QVERIFY(estimator.score() == 0);
+    estimator.setPassword("13.09.1991");
+    QVERIFY(estimator.sequence().first().pattern == StrengthEstimator::Match::Date);
+    estimator.setPassword("abcabcabcabc");
+    QVERIFY(estimator.score() == 0);
+    estimator.setPassword("xK9#mQ2$vL7!pR4@");
+    QVERIFY(estimator.score() == 4);
+    // editing in place must yield the same result as evaluating from scratch
+    estimator.setPassword("Tr0ub4dor&3correct1991");
+    estimator.setPassword("Tr0ub4dXr&3");
+    QCOMPARE(estimator.guessesLog10(), StrengthEstimator::estimateGuessesLog10("Tr0ub4dXr&3"));
+  }
+
+  void vaultauditor_findings(void)
+  {
+    DomainSettingsList domains;
+    const char *const legacyPasswords[] = { "xK9#mQ2$vL7!pR4@", "xK9#mQ2$vL7!pR4@", "123456", "fj3kLq9Xz!w2" };
+    for (int i = 0; i < 4; ++i) {
+      DomainSettings ds;
+      ds.domainName = QString("domain%1.example").arg(i);
+      ds.legacyPassword = legacyPasswords[i];
+      ds.modifiedDate = QDateTime(QDate(2015, 10, 1), QTime(12, 0, 0));
+      domains << ds;
+    }
+    domains[3].expiryDate = QDateTime(QDate(2015, 11, 1), QTime(12, 0, 0));
+    QList<DomainIndex::Entry> entries;
+    foreach (DomainSettings ds, domains) {
+      entries << DomainIndex::Entry::fromDomainSettings(ds);
+    }
+    VaultAuditor auditor;
+    auditor.setKGK(Crypter::generateKGK());
+    auditor.setListedFunction([](const QString &password) { return password == "123456"; });
+    QCOMPARE(auditor.outdated(entries).count(), 4);
+    QFuture<VaultAuditor::Result> future = auditor.audit(domains);
+    future.waitForFinished();
+    auditor.update(future.results());
+    QList<VaultAuditor::Finding> findings = auditor.findings(entries);
+    QCOMPARE(findings.count(), 4);
+    QVERIFY(findings.at(0).issues == VaultAuditor::Reused);
+    QVERIFY(findings.at(0).reusedBy == QStringList() << "domain1.example");
+    QVERIFY(findings.at(2).issues == (VaultAuditor::Weak | VaultAuditor::Listed));
+    QVERIFY(findings.at(3).issues == VaultAuditor::Expired);
+    // only the modified domain is audited again
+    domains[1].legacyPassword = "correct horse battery staple";
+    domains[1].modifiedDate = domains[1].modifiedDate.addDays(1);
+    entries[1] = DomainIndex::Entry::fromDomainSettings(domains[1]);
+    QVERIFY(auditor.outdated(entries) == QStringList() << "domain1.example");
+    future = auditor.audit(DomainSettingsList() << domains[1]);
+    future.waitForFinished();
+    auditor.update(future.results());
+    findings = auditor.findings(entries);
+    QCOMPARE(findings.count(), 2);
+  }
+
+  void kdfbenchmark_cache(void)
+  {
+    const QString &filename = QDir::tempPath() + "/qt-sesam-unit-test-kdfbenchmark.json";
+    QFile::remove(filename);
+    KdfBenchmark benchmark;
+    benchmark.setCacheFileName(filename);
+    benchmark.setDuration(200);
+    QVERIFY(!benchmark.loadCached());
+    QVERIFY(benchmark.run(1024));
+    QVERIFY(benchmark.iterationsPerSec() > 0);
+    QCOMPARE(benchmark.guessesPerSec(1024), benchmark.iterationsPerSec() / 1024);
+    KdfBenchmark cached;
+    cached.setCacheFileName(filename);
+    QVERIFY(cached.loadCached());
+    QCOMPARE(cached.iterationsPerSec(), benchmark.iterationsPerSec());
+    QCOMPARE(cached.threadCount(), benchmark.threadCount());
+    QFile::remove(filename);
+  }
+
+  void qrraster_reference(void)
+  {
+    QRcode *qrcode = QRcode_encodeString("https://ola-ct.github.io/Qt-SESAM/", 0, QR_ECLEVEL_M, QR_MODE_8, 1);
+    QVERIFY(qrcode != Q_NULLPTR);
+    const int width = qrcode->width;
+    const QByteArray modules(reinterpret_cast<const char*>(qrcode->data), width * width);
+    QRcode_free(qrcode);
+    QRcode symbol;
+    symbol.version = 0;
+    symbol.width = width;
+    symbol.data = reinterpret_cast<unsigned char*>(const_cast<char*>(modules.constData()));
+    QCOMPARE(QRraster_size(&symbol, 0, 4), -1);
+    QCOMPARE(QRraster_size(&symbol, 1, -1), -1);
+    foreach (int margin, QList<int>() << 0 << 1 << 4) {
+      const int n = width + 2 * margin;
+      auto isDark = [&modules, width, margin](int mx, int my) {
+        mx -= margin;
+        my -= margin;
+        return mx >= 0 && my >= 0 && mx < width && my < width && (modules.at(my * width + mx) & 1) != 0;
+      };
+      foreach (int moduleSize, QList<int>() << 1 << 2 << 3 << 5 << 8) {
+        const int size = QRraster_size(&symbol, moduleSize, margin);
+        QCOMPARE(size, n * moduleSize);
+
+        const int grayStride = size + 3;
+        QByteArray gray(size * grayStride, '\x55');
+        unsigned char *grayBits = reinterpret_cast<unsigned char*>(gray.data());
+        QCOMPARE(QRraster_renderGray8(&symbol, moduleSize, margin, grayBits, size - 1), -1);
+        QCOMPARE(QRraster_renderGray8(&symbol, moduleSize, margin, grayBits, grayStride), 0);
+        for (int y = 0; y < size; ++y) {
+          for (int x = 0; x < grayStride; ++x) {
+            const uchar expected = x < size ? (isDark(x / moduleSize, y / moduleSize) ? 0x00 : 0xff) : 0x55;
+            if (uchar(gray.at(y * grayStride + x)) != expected)
+              QFAIL(qPrintable(QString("Gray8 pixel %1,%2 (module size %3, margin %4)").arg(x).arg(y).arg(moduleSize).arg(margin)));
+          }
+        }
+
+        const int monoBytes = (size + 7) / 8;
+        const int monoStride = monoBytes + 1;
+        QByteArray mono(size * monoStride, '\x55');
+        unsigned char *monoBits = reinterpret_cast<unsigned char*>(mono.data());
+        QCOMPARE(QRraster_renderMono(&symbol, moduleSize, margin, monoBits, monoBytes - 1), -1);
+        QCOMPARE(QRraster_renderMono(&symbol, moduleSize, margin, monoBits, monoStride), 0);
+        for (int y = 0; y < size; ++y) {
+          for (int x = 0; x < monoBytes * 8; ++x) {
+            const bool expected = x < size && isDark(x / moduleSize, y / moduleSize);
+            const bool dark = (uchar(mono.at(y * monoStride + x / 8)) & (0x80 >> (x % 8))) != 0;
+            if (dark != expected)
+              QFAIL(qPrintable(QString("Mono pixel %1,%2 (module size %3, margin %4)").arg(x).arg(y).arg(moduleSize).arg(margin)));
+          }
+          QCOMPARE(uchar(mono.at(y * monoStride + monoBytes)), uchar(0x55));
+        }
+
+        char *svg = QRraster_svg(&symbol, moduleSize, margin);
+        QVERIFY(svg != Q_NULLPTR);
+        const QString document = QString::fromUtf8(svg);
+        free(svg);
+        QVERIFY(document.contains(QString("width=\"%1\" height=\"%1\" viewBox=\"0 0 %2 %2\"").arg(size).arg(n)));
+        const int pathStart = document.indexOf(" d=\"") + 4;
+        const int pathEnd = document.indexOf('"', pathStart);
+        QVERIFY(pathStart >= 4 && pathEnd > pathStart);
+        QVector<bool> painted(n * n, false);
+        QRegularExpression run("^M(\\d+) (\\d+)h(\\d+)v1h-(\\d+)z");
+        for (int pos = pathStart; pos < pathEnd; ) {
+          const QRegularExpressionMatch &m = run.match(document.mid(pos, pathEnd - pos));
+          QVERIFY(m.hasMatch());
+          const int x = m.captured(1).toInt();
+          const int y = m.captured(2).toInt();
+          const int w = m.captured(3).toInt();
+          QCOMPARE(m.captured(4).toInt(), w);
+          QVERIFY(w > 0 && x + w <= n && y < n);
+          for (int i = x; i < x + w; ++i) {
+            QVERIFY(!painted.at(y * n + i));
+            painted[y * n + i] = true;
+          }
+          pos += m.capturedLength();
+        }
+        for (int y = 0; y < n; ++y) {
+          for (int x = 0; x < n; ++x) {
+            if (painted.at(y * n + x) != isDark(x, y))
+              QFAIL(qPrintable(QString("SVG module %1,%2 (module size %3, margin %4)").arg(x).arg(y).arg(moduleSize).arg(margin)));
+          }
+        }
+      }
+    }
+  }
 };
 
 QTEST_GUILESS_MAIN(TestSESAM)
@@ -0,0 +1,474 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include <QDebug>
+#include <QObject>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QDirIterator>
+#include <QSaveFile>
+#include <QBuffer>
+#include <QMap>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+
+#include "backupstore.h"
+#include "blobstore.h"
+#include "crypter.h"
+
+
+const int BackupStore::MinChunkSize = 2 * 1024;
+const int BackupStore::MaxChunkSize = 64 * 1024;
+static const int NormalChunkSize = 8 * 1024;
+// more bits than log2(NormalChunkSize) below the normal size, fewer above (FastCDC's normalized chunking)
+static const quint64 MaskBeforeNormal = Q_UINT64_C(0x7fff) << 49;
+static const quint64 MaskAfterNormal = Q_UINT64_C(0x7ff) << 53;
+
+static const QString SnapshotSuffix = ".snapshot";
+static const QString SnapshotDateFormat = "yyyyMMddThhmmsszzz";
+static const QString INDEX_SNAPSHOTS = "snapshots";
+static const QString MANIFEST_CREATED = "created";
+static const QString MANIFEST_FILES = "files";
+
+
+static const quint64 *gearTable(void)
+{
+  static quint64 table[256];
+  static bool initialized = false;
+  static QMutex mutex;
+  QMutexLocker locker(&mutex);
+  if (!initialized) {
+    // splitmix64 with a fixed seed, so that all installations cut at the same points
+    quint64 x = Q_UINT64_C(0x5345534d41424b50);
+    for (int i = 0; i < 256; ++i) {
+      quint64 z = (x += Q_UINT64_C(0x9e3779b97f4a7c15));
+      z = (z ^ (z >> 30)) * Q_UINT64_C(0xbf58476d1ce4e5b9);
+      z = (z ^ (z >> 27)) * Q_UINT64_C(0x94d049bb133111eb);
+      table[i] = z ^ (z >> 31);
+    }
+    initialized = true;
+  }
+  return table;
+}
+
+
+class BackupStorePrivate {
+public:
+  BackupStorePrivate(void)
+    : indexLoaded(false)
+    , lastWriteNewBytes(0)
+  { /* ... */ }
+  QString snapshotDir(void) const
+  {
+    return path + "/snapshots";
+  }
+  QString chunkDir(void) const
+  {
+    return path + "/chunks";
+  }
+  QString indexFileName(void) const
+  {
+    return path + "/index.json";
+  }
+  QString snapshotFileName(const QString &id) const
+  {
+    return snapshotDir() + "/" + id + SnapshotSuffix;
+  }
+  void loadIndex(void)
+  {
+    if (indexLoaded)
+      return;
+    snapshotChunks.clear();
+    refs.clear();
+    QFile f(indexFileName());
+    if (f.open(QIODevice::ReadOnly)) {
+      const QJsonObject &snapshots = QJsonDocument::fromJson(f.readAll()).object()[INDEX_SNAPSHOTS].toObject();
+      for (QJsonObject::const_iterator s = snapshots.constBegin(); s != snapshots.constEnd(); ++s) {
+        const QStringList &chunks = s.value().toVariant().toStringList();
+        snapshotChunks.insert(s.key(), chunks);
+        foreach (QString id, chunks) {
+          ++refs[id];
+        }
+      }
+    }
+    indexLoaded = true;
+  }
+  bool saveIndex(void)
+  {
+    QJsonObject snapshots;
+    for (QMap<QString, QStringList>::const_iterator s = snapshotChunks.constBegin(); s != snapshotChunks.constEnd(); ++s) {
+      snapshots.insert(s.key(), QJsonArray::fromStringList(s.value()));
+    }
+    QJsonObject root;
+    root[INDEX_SNAPSHOTS] = snapshots;
+    QSaveFile f(indexFileName());
+    const QByteArray &json = QJsonDocument(root).toJson(QJsonDocument::Compact);
+    if (!f.open(QIODevice::WriteOnly) || f.write(json) != json.size() || !f.commit()) {
+      errorString = f.errorString();
+      return false;
+    }
+    return true;
+  }
+  void release(const QString &snapshotId)
+  {
+    foreach (QString id, snapshotChunks.take(snapshotId)) {
+      if (--refs[id] <= 0) {
+        refs.remove(id);
+        blobs.remove(id);
+      }
+    }
+    QFile::remove(snapshotFileName(snapshotId));
+  }
+  QString path;
+  BlobStore blobs;
+  bool indexLoaded;
+  QMap<QString, QStringList> snapshotChunks;
+  QMap<QString, int> refs;
+  qint64 lastWriteNewBytes;
+  QString errorString;
+  mutable QMutex mutex;
+};
+
+
+/*!
+ * \brief BackupStore::BackupStore
+ *
+ * A `BackupStore` keeps snapshots of a set of files in a directory.
+ * The files are cut into chunks at content-defined boundaries and the chunks are
+ * stored encrypted in a `BlobStore`, so a chunk shared by several snapshots is stored
+ * only once, and inserting or appending data changes only the chunks around the change.
+ *
+ * Each snapshot is a small manifest listing the chunks of its files, encrypted with a key
+ * derived from the master password just like the sync data (see `Crypter::encode()`).
+ * Thus a snapshot can be restored with nothing but the master password.
+ *
+ * The unencrypted `index.json` lists which chunks each snapshot uses. Chunk ids are keyed
+ * hashes that reveal nothing about the contents. Dropping a snapshot only touches its own chunks.
+ */
+BackupStore::BackupStore(void)
+  : d_ptr(new BackupStorePrivate)
+{
+  /* ... */
+}
+
+
+BackupStore::BackupStore(const QString &path)
+  : d_ptr(new BackupStorePrivate)
+{
+  setPath(path);
+}
+
+
+BackupStore::~BackupStore()
+{
+  /* ... */
+}
+
+
+void BackupStore::setPath(const QString &path)
+{
+  Q_D(BackupStore);
+  QMutexLocker locker(&d->mutex);
+  d->path = path;
+  d->blobs.setPath(d->chunkDir());
+  d->indexLoaded = false;
+}
+
+
+QString BackupStore::path(void) const
+{
+  Q_D(const BackupStore);
+  QMutexLocker locker(&d->mutex);
+  return d->path;
+}
+
+
+/*!
+ * \brief BackupStore::write
+ *
+ * Writes a snapshot of `files`, each value of which must be a `QByteArray`.
+ * Only chunks not already contained in the store are written.
+ *
+ * \return id of the new snapshot; an empty string on failure
+ */
+QString BackupStore::write(const SecureByteArray &key, const SecureByteArray &IV, const QByteArray &salt, const SecureByteArray &KGK, const QVariantMap &files)
+{
+  Q_D(BackupStore);
+  QMutexLocker locker(&d->mutex);
+  d->loadIndex();
+  d->blobs.setKGK(KGK);
+  d->lastWriteNewBytes = 0;
+  if (!QDir().mkpath(d->snapshotDir())) {
+    d->errorString = QObject::tr("Cannot create directory %1").arg(d->snapshotDir());
+    return QString();
+  }
+  QStringList usedChunks;
+  QVariantMap manifestFiles;
+  for (QVariantMap::const_iterator f = files.constBegin(); f != files.constEnd(); ++f) {
+    const QByteArray &data = f.value().toByteArray();
+    BlobStore::Reference ref;
+    int start = 0;
+    foreach (int end, cutPoints(data)) {
+      const QByteArray &chunk = data.mid(start, end - start);
+      const QString &id = d->blobs.put(chunk);
+      if (id.isEmpty()) {
+        d->errorString = d->blobs.errorString();
+        return QString();
+      }
+      if (!d->refs.contains(id) && !usedChunks.contains(id)) {
+        d->lastWriteNewBytes += chunk.size();
+      }
+      ref.chunks << id;
+      ref.size += chunk.size();
+      usedChunks << id;
+      start = end;
+    }
+    manifestFiles[f.key()] = ref.toVariantMap();
+  }
+  usedChunks.removeDuplicates();
+
+  QDateTime created = QDateTime::currentDateTimeUtc();
+  while (QFileInfo(d->snapshotFileName(created.toString(SnapshotDateFormat))).exists()) {
+    created = created.addMSecs(1);
+  }
+  const QString &id = created.toString(SnapshotDateFormat);
+  QVariantMap manifest;
+  manifest[MANIFEST_CREATED] = created.toString(Qt::ISODate);
+  manifest[MANIFEST_FILES] = manifestFiles;
+  QByteArray cipher;
+  try {
+    cipher = Crypter::encode(key, IV, salt, KGK, QJsonDocument::fromVariant(manifest).toJson(QJsonDocument::Compact), true);
+  }
+  catch (CryptoPP::Exception &e) {
+    d->errorString = QString::fromUtf8(e.what());
+    return QString();
+  }
+  QSaveFile snapshotFile(d->snapshotFileName(id));
+  if (!snapshotFile.open(QIODevice::WriteOnly) || snapshotFile.write(cipher) != cipher.size() || !snapshotFile.commit()) {
+    d->errorString = snapshotFile.errorString();
+    return QString();
+  }
+  d->snapshotChunks.insert(id, usedChunks);
+  foreach (QString chunkId, usedChunks) {
+    ++d->refs[chunkId];
+  }
+  if (!d->saveIndex()) {
+    // a snapshot missing from the index would keep chunks the index doesn't know to protect
+    d->release(id);
+    QFile::remove(d->snapshotFileName(id));
+    return QString();
+  }
+  return id;
+}
+
+
+/*!
+ * \brief BackupStore::read
+ *
+ * Restores the files of a snapshot.
+ *
+ * Throws a `CryptoPP::Exception` if the snapshot cannot be decrypted, e.g. because of a wrong master password.
+ *
+ * \return map of file names to contents; an empty map if the snapshot is missing or damaged
+ */
+QVariantMap BackupStore::read(const QString &id, const SecureByteArray &masterPassword) const
+{
+  Q_D(const BackupStore);
+  QMutexLocker locker(&d->mutex);
+  QVariantMap files;
+  QFile snapshotFile(d->snapshotFileName(id));
+  if (!snapshotFile.open(QIODevice::ReadOnly)) {
+    const_cast<BackupStorePrivate*>(d)->errorString = snapshotFile.errorString();
+    return files;
+  }
+  SecureByteArray KGK;
+  const QByteArray &json = Crypter::decode(masterPassword, snapshotFile.readAll(), true, KGK);
+  const QVariantMap &manifestFiles = QJsonDocument::fromJson(json).toVariant().toMap()[MANIFEST_FILES].toMap();
+  BlobStore blobs(d->chunkDir());
+  blobs.setKGK(KGK);
+  for (QVariantMap::const_iterator f = manifestFiles.constBegin(); f != manifestFiles.constEnd(); ++f) {
+    const BlobStore::Reference &ref = BlobStore::Reference::fromVariant(f.value());
+    QBuffer buffer;
+    buffer.open(QIODevice::WriteOnly);
+    if (!blobs.fetch(ref, &buffer) || buffer.size() != ref.size) {
+      const_cast<BackupStorePrivate*>(d)->errorString = QObject::tr("Snapshot %1 is damaged: %2").arg(id).arg(blobs.errorString());
+      return QVariantMap();
+    }
+    files[f.key()] = buffer.data();
+  }
+  return files;
+}
+
+
+/*!
+ * \brief BackupStore::snapshots
+ *
+ * Lists the snapshots without decrypting them.
+ *
+ * \return snapshots sorted from oldest to newest
+ */
+QList<BackupStore::Snapshot> BackupStore::snapshots(void) const
+{
+  Q_D(const BackupStore);
+  QMutexLocker locker(&d->mutex);
+  QList<Snapshot> result;
+  QStringList names = QDir(d->snapshotDir()).entryList(QStringList() << "*" + SnapshotSuffix, QDir::Files);
+  names.sort();
+  foreach (QString name, names) {
+    Snapshot s;
+    s.id = name.left(name.size() - SnapshotSuffix.size());
+    s.created = QDateTime::fromString(s.id, SnapshotDateFormat);
+    s.created.setTimeSpec(Qt::UTC);
+    if (s.created.isValid()) {
+      result << s;
+    }
+  }
+  return result;
+}
+
+
+/*!
+ * \brief BackupStore::prune
+ *
+ * Removes snapshots older than `maxAgeDays` and all but the newest `maxCount` snapshots.
+ * A value of 0 disables the respective limit. The newest snapshot is always kept.
+ * Chunks no longer used by any snapshot are deleted.
+ *
+ * \return number of snapshots removed
+ */
+int BackupStore::prune(int maxAgeDays, int maxCount)
+{
+  const QList<Snapshot> &all = snapshots();
+  Q_D(BackupStore);
+  QMutexLocker locker(&d->mutex);
+  d->loadIndex();
+  const QDateTime &tooOld = QDateTime::currentDateTimeUtc().addDays(-maxAgeDays);
+  int removed = 0;
+  for (int i = 0; i < all.size() - 1; ++i) {
+    const bool expired = maxAgeDays > 0 && all.at(i).created < tooOld;
+    const bool surplus = maxCount > 0 && all.size() - i > maxCount;
+    if (expired || surplus) {
+      d->release(all.at(i).id);
+      ++removed;
+    }
+  }
+  if (removed > 0) {
+    d->saveIndex();
+  }
+  return removed;
+}
+
+
+bool BackupStore::remove(const QString &id)
+{
+  Q_D(BackupStore);
+  QMutexLocker locker(&d->mutex);
+  d->loadIndex();
+  if (!QFileInfo(d->snapshotFileName(id)).exists())
+    return false;
+  d->release(id);
+  return d->saveIndex();
+}
+
+
+/*!
+ * \brief BackupStore::files
+ *
+ * \return absolute paths of all files belonging to the store, e.g. for wiping them
+ */
+QStringList BackupStore::files(void) const
+{
+  Q_D(const BackupStore);
+  QMutexLocker locker(&d->mutex);
+  QStringList result;
+  QDirIterator it(d->path, QDir::Files, QDirIterator::Subdirectories);
+  while (it.hasNext()) {
+    result << it.next();
+  }
+  return result;
+}
+
+
+/*!
+ * \brief BackupStore::lastWriteNewBytes
+ *
+ * \return number of bytes of chunks that the last call to `write()` had to add to the store
+ */
+qint64 BackupStore::lastWriteNewBytes(void) const
+{
+  Q_D(const BackupStore);
+  QMutexLocker locker(&d->mutex);
+  return d->lastWriteNewBytes;
+}
+
+
+QString BackupStore::errorString(void) const
+{
+  Q_D(const BackupStore);
+  QMutexLocker locker(&d->mutex);
+  return d->errorString;
+}
+
+
+/*!
+ * \brief BackupStore::cutPoints
+ *
+ * Finds content-defined chunk boundaries with a gear rolling hash.
+ * A boundary depends only on the bytes just before it, so an insertion
+ * moves the boundaries after it along with the data instead of shifting them.
+ *
+ * \return end offsets of the chunks; the last one equals `data.size()`
+ */
+QList<int> BackupStore::cutPoints(const QByteArray &data)
+{
+  const quint64 *gear = gearTable();
+  const uchar *p = reinterpret_cast<const uchar*>(data.constData());
+  const int n = data.size();
+  QList<int> cuts;
+  int start = 0;
+  while (start < n) {
+    const int remaining = n - start;
+    int end = start + qMin(remaining, MaxChunkSize);
+    if (remaining > MinChunkSize) {
+      const int normal = start + qMin(remaining, NormalChunkSize);
+      quint64 h = 0;
+      int i = start + MinChunkSize;
+      bool found = false;
+      for (; i < normal && !found; ++i) {
+        h = (h << 1) + gear[p[i]];
+        found = (h & MaskBeforeNormal) == 0;
+      }
+      for (; i < end && !found; ++i) {
+        h = (h << 1) + gear[p[i]];
+        found = (h & MaskAfterNormal) == 0;
+      }
+      if (found) {
+        end = i;
+      }
+    }
+    cuts << end;
+    start = end;
+  }
+  return cuts;
+}
@@ -0,0 +1,71 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef __BACKUPSTORE_H_
+#define __BACKUPSTORE_H_
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QDateTime>
+#include <QList>
+#include <QVariantMap>
+#include <QScopedPointer>
+
+#include "securebytearray.h"
+
+
+class BackupStorePrivate;
+
+class BackupStore
+{
+public:
+  struct Snapshot {
+    QString id;
+    QDateTime created;
+  };
+
+  BackupStore(void);
+  explicit BackupStore(const QString &path);
+  ~BackupStore();
+
+  void setPath(const QString &);
+  QString path(void) const;
+  QString write(const SecureByteArray &key, const SecureByteArray &IV, const QByteArray &salt, const SecureByteArray &KGK, const QVariantMap &files);
+  QVariantMap read(const QString &id, const SecureByteArray &masterPassword) const;
+  QList<Snapshot> snapshots(void) const;
+  int prune(int maxAgeDays, int maxCount);
+  bool remove(const QString &id);
+  QStringList files(void) const;
+  qint64 lastWriteNewBytes(void) const;
+  QString errorString(void) const;
+
+  static QList<int> cutPoints(const QByteArray &data);
+
+  static const int MinChunkSize;
+  static const int MaxChunkSize;
+
+private:
+  QScopedPointer<BackupStorePrivate> d_ptr;
+  Q_DECLARE_PRIVATE(BackupStore)
+  Q_DISABLE_COPY(BackupStore)
+};
+
+#endif // __BACKUPSTORE_H_
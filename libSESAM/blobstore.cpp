@@ -0,0 +1,380 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <QDebug>
+#include <QObject>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QDirIterator>
+#include <QSaveFile>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QMessageAuthenticationCode>
+
+#include "blobstore.h"
+#include "crypter.h"
+#include "metrics.h"
+
+
+const int BlobStore::ChunkSize = 256 * 1024;
+
+static const QString REF_CHUNKS = "chunks";
+static const QString REF_SIZE = "size";
+static const int IdLength = 64;
+
+
+class BlobStorePrivate {
+public:
+  BlobStorePrivate(void)
+  { /* ... */ }
+  ~BlobStorePrivate()
+  {
+    blobKey.invalidate();
+    idKey.invalidate();
+  }
+  QString blobFileName(const QString &id) const
+  {
+    return path + "/" + id.left(2) + "/" + id;
+  }
+  QString makeId(const QByteArray &data) const
+  {
+    QMessageAuthenticationCode mac(QCryptographicHash::Sha256, idKey);
+    mac.addData(data);
+    return QString::fromLatin1(mac.result().toHex());
+  }
+  QByteArray seal(const QByteArray &data) const
+  {
+    const SecureByteArray &IV = Crypter::generateIV();
+    return IV + Crypter::encrypt(blobKey, IV, qCompress(data, 6), CryptoPP::StreamTransformationFilter::PKCS_PADDING);
+  }
+  QByteArray unseal(const QString &id, const QByteArray &blob)
+  {
+    if (blob.size() <= Crypter::AESBlockSize) {
+      setErrorString(QObject::tr("Blob %1 is truncated").arg(id));
+      return QByteArray();
+    }
+    QByteArray data;
+    try {
+      const SecureByteArray &IV = blob.left(Crypter::AESBlockSize);
+      data = qUncompress(Crypter::decrypt(blobKey, IV, blob.mid(Crypter::AESBlockSize), CryptoPP::StreamTransformationFilter::PKCS_PADDING));
+    }
+    catch (CryptoPP::Exception &e) {
+      setErrorString(QObject::tr("Blob %1 cannot be decrypted: %2").arg(id).arg(e.what()));
+      return QByteArray();
+    }
+    if (makeId(data) != id) {
+      setErrorString(QObject::tr("Blob %1 is corrupt").arg(id));
+      return QByteArray();
+    }
+    return data;
+  }
+  bool writeBlob(const QString &id, const QByteArray &blob)
+  {
+    const QString &filename = blobFileName(id);
+    QDir().mkpath(QFileInfo(filename).absolutePath());
+    QSaveFile f(filename);
+    if (!f.open(QIODevice::WriteOnly) || f.write(blob) != blob.size() || !f.commit()) {
+      setErrorString(f.errorString());
+      return false;
+    }
+    METRIC_COUNTER("blobstore.bytes_written").add(blob.size());
+    return true;
+  }
+  void setErrorString(const QString &err)
+  {
+    QMutexLocker locker(&errorMutex);
+    errorString = err;
+  }
+  QString path;
+  SecureByteArray blobKey;
+  SecureByteArray idKey;
+  mutable QMutex errorMutex;
+  QString errorString;
+};
+
+
+bool BlobStore::Reference::isValid(void) const
+{
+  return size >= 0 && (size == 0) == chunks.isEmpty();
+}
+
+
+QVariantMap BlobStore::Reference::toVariantMap(void) const
+{
+  QVariantMap map;
+  map[REF_CHUNKS] = chunks;
+  map[REF_SIZE] = size;
+  return map;
+}
+
+
+BlobStore::Reference BlobStore::Reference::fromVariant(const QVariant &v)
+{
+  Reference ref;
+  const QVariantMap &map = v.toMap();
+  ref.chunks = map[REF_CHUNKS].toStringList();
+  ref.size = map[REF_SIZE].toLongLong();
+  return ref;
+}
+
+
+/*!
+ * \brief BlobStore::Reference::isReference
+ *
+ * Attachments stored before the blob store existed are base64 encoded strings
+ * inlined into `DomainSettings::files`; references are maps.
+ */
+bool BlobStore::Reference::isReference(const QVariant &v)
+{
+  return v.type() == QVariant::Map && v.toMap().contains(REF_CHUNKS);
+}
+
+
+/*!
+ * \brief BlobStore::BlobStore
+ *
+ * A `BlobStore` keeps encrypted chunks of attachment data in a directory,
+ * one file per chunk. Chunks are named after a keyed hash of their plain contents,
+ * so identical data is stored only once and peers sharing the same KGK arrive at
+ * the same names, which lets sync transfer just the chunks the other side lacks.
+ */
+BlobStore::BlobStore(void)
+  : d_ptr(new BlobStorePrivate)
+{
+  /* ... */
+}
+
+
+BlobStore::BlobStore(const QString &path)
+  : d_ptr(new BlobStorePrivate)
+{
+  setPath(path);
+}
+
+
+BlobStore::~BlobStore()
+{
+  /* ... */
+}
+
+
+void BlobStore::setPath(const QString &path)
+{
+  Q_D(BlobStore);
+  d->path = path;
+}
+
+
+QString BlobStore::path(void) const
+{
+  Q_D(const BlobStore);
+  return d->path;
+}
+
+
+void BlobStore::setKGK(const SecureByteArray &KGK)
+{
+  Q_D(BlobStore);
+  if (KGK.isEmpty()) {
+    d->blobKey.invalidate();
+    d->idKey.invalidate();
+    return;
+  }
+  QMessageAuthenticationCode mac(QCryptographicHash::Sha256, KGK);
+  mac.addData(QByteArray("ctSESAM blob key"));
+  const SecureByteArray &blobKey = mac.result();
+  // leave the keys untouched if unchanged so that running workers may keep reading them
+  if (blobKey == d->blobKey)
+    return;
+  mac.reset();
+  mac.addData(QByteArray("ctSESAM blob id"));
+  d->blobKey = blobKey;
+  d->idKey = mac.result();
+}
+
+
+bool BlobStore::isValid(void) const
+{
+  Q_D(const BlobStore);
+  return !d->path.isEmpty() && !d->blobKey.isEmpty();
+}
+
+
+bool BlobStore::isValidId(const QString &id)
+{
+  if (id.size() != IdLength)
+    return false;
+  foreach (QChar c, id) {
+    if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f')))
+      return false;
+  }
+  return true;
+}
+
+
+bool BlobStore::contains(const QString &id) const
+{
+  Q_D(const BlobStore);
+  return isValidId(id) && QFileInfo(d->blobFileName(id)).isFile();
+}
+
+
+QStringList BlobStore::ids(void) const
+{
+  Q_D(const BlobStore);
+  QStringList result;
+  QDirIterator it(d->path, QDir::Files, QDirIterator::Subdirectories);
+  while (it.hasNext()) {
+    const QString &id = QFileInfo(it.next()).fileName();
+    if (isValidId(id)) {
+      result << id;
+    }
+  }
+  return result;
+}
+
+
+qint64 BlobStore::bytesOnDisk(void) const
+{
+  Q_D(const BlobStore);
+  qint64 bytes = 0;
+  QDirIterator it(d->path, QDir::Files, QDirIterator::Subdirectories);
+  while (it.hasNext()) {
+    it.next();
+    bytes += it.fileInfo().size();
+  }
+  return bytes;
+}
+
+
+QStringList BlobStore::missing(const QStringList &ids) const
+{
+  QStringList result;
+  foreach (QString id, ids) {
+    if (!contains(id) && !result.contains(id)) {
+      result << id;
+    }
+  }
+  return result;
+}
+
+
+/*!
+ * \brief BlobStore::put
+ *
+ * Encrypts `data` and stores it as a single chunk unless a chunk with the same
+ * contents already exists.
+ *
+ * \return id of the chunk; an empty string if the chunk could not be written
+ */
+QString BlobStore::put(const QByteArray &data)
+{
+  Q_D(BlobStore);
+  if (!isValid())
+    return QString();
+  const QString &id = d->makeId(data);
+  if (contains(id)) {
+    METRIC_COUNTER("blobstore.dedup.hits").add();
+    return id;
+  }
+  METRIC_COUNTER("blobstore.dedup.misses").add();
+  return d->writeBlob(id, d->seal(data)) ? id : QString();
+}
+
+
+QByteArray BlobStore::get(const QString &id) const
+{
+  Q_D(const BlobStore);
+  return const_cast<BlobStorePrivate*>(d)->unseal(id, rawBlob(id));
+}
+
+
+QByteArray BlobStore::rawBlob(const QString &id) const
+{
+  Q_D(const BlobStore);
+  if (!isValidId(id))
+    return QByteArray();
+  QFile f(d->blobFileName(id));
+  if (!f.open(QIODevice::ReadOnly)) {
+    const_cast<BlobStorePrivate*>(d)->setErrorString(f.errorString());
+    return QByteArray();
+  }
+  return f.readAll();
+}
+
+
+/*!
+ * \brief BlobStore::putRawBlob
+ *
+ * Stores an already encrypted chunk as received from a sync peer.
+ * The chunk is rejected if it doesn't decrypt to contents matching its id.
+ */
+bool BlobStore::putRawBlob(const QString &id, const QByteArray &blob)
+{
+  Q_D(BlobStore);
+  if (!isValidId(id) || d->unseal(id, blob).isNull())
+    return false;
+  if (contains(id))
+    return true;
+  return d->writeBlob(id, blob);
+}
+
+
+bool BlobStore::remove(const QString &id)
+{
+  Q_D(BlobStore);
+  return isValidId(id) && QFile::remove(d->blobFileName(id));
+}
+
+
+BlobStore::Reference BlobStore::store(QIODevice *src)
+{
+  Reference ref;
+  while (!src->atEnd()) {
+    const QByteArray &chunk = src->read(ChunkSize);
+    if (chunk.isEmpty())
+      break;
+    const QString &id = put(chunk);
+    if (id.isEmpty())
+      return Reference();
+    ref.chunks << id;
+    ref.size += chunk.size();
+  }
+  return ref;
+}
+
+
+bool BlobStore::fetch(const Reference &ref, QIODevice *dst) const
+{
+  foreach (QString id, ref.chunks) {
+    const QByteArray &chunk = get(id);
+    if (chunk.isEmpty() || dst->write(chunk) != chunk.size())
+      return false;
+  }
+  return true;
+}
+
+
+QString BlobStore::errorString(void) const
+{
+  Q_D(const BlobStore);
+  QMutexLocker locker(&d->errorMutex);
+  return d->errorString;
+}
@@ -0,0 +1,81 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __BLOBSTORE_H_
+#define __BLOBSTORE_H_
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QVariant>
+#include <QVariantMap>
+#include <QIODevice>
+#include <QScopedPointer>
+
+#include "securebytearray.h"
+
+
+class BlobStorePrivate;
+
+class BlobStore
+{
+public:
+  struct Reference {
+    Reference(void)
+      : size(0)
+    { /* ... */ }
+    QStringList chunks;
+    qint64 size;
+    bool isValid(void) const;
+    QVariantMap toVariantMap(void) const;
+    static Reference fromVariant(const QVariant &);
+    static bool isReference(const QVariant &);
+  };
+
+  BlobStore(void);
+  explicit BlobStore(const QString &path);
+  ~BlobStore();
+
+  void setPath(const QString &);
+  QString path(void) const;
+  void setKGK(const SecureByteArray &KGK);
+  bool isValid(void) const;
+  bool contains(const QString &id) const;
+  QStringList ids(void) const;
+  qint64 bytesOnDisk(void) const;
+  QStringList missing(const QStringList &ids) const;
+  QString put(const QByteArray &data);
+  QByteArray get(const QString &id) const;
+  QByteArray rawBlob(const QString &id) const;
+  bool putRawBlob(const QString &id, const QByteArray &blob);
+  bool remove(const QString &id);
+  Reference store(QIODevice *src);
+  bool fetch(const Reference &ref, QIODevice *dst) const;
+  QString errorString(void) const;
+
+  static const int ChunkSize;
+  static bool isValidId(const QString &id);
+
+private:
+  QScopedPointer<BlobStorePrivate> d_ptr;
+  Q_DECLARE_PRIVATE(BlobStore)
+  Q_DISABLE_COPY(BlobStore)
+};
+
+#endif // __BLOBSTORE_H_
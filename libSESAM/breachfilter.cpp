@@ -0,0 +1,569 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+#include <QObject>
+#include <QFile>
+#include <QCryptographicHash>
+#include <QtEndian>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "breachfilter.h"
+
+
+const QByteArray BreachFilter::Magic = QByteArray("SESAMBF1");
+const quint32 BreachFilter::Version = 1;
+const int BreachFilter::HeaderSize = 64;
+
+static const int MaxBuildAttempts = 100;
+static const int HeaderVersionOffset = 8;
+static const int HeaderBitsOffset = 12;
+static const int HeaderAlgorithmOffset = 16;
+static const int HeaderSegmentLengthOffset = 20;
+static const int HeaderSegmentCountOffset = 24;
+static const int HeaderArrayLengthOffset = 32;
+static const int HeaderKeyCountOffset = 40;
+static const int HeaderSeedOffset = 48;
+
+
+namespace {
+
+// A 3-wise binary fuse filter after Graf and Lemire, "Binary Fuse Filters:
+// Fast and Smaller Than Xor Filters" (2022): each key maps to three slots
+// in consecutive segments, and the XOR of the fingerprints stored there
+// equals the fingerprint of the key.
+struct FuseLayout {
+  quint32 segmentLength;
+  quint32 segmentLengthMask;
+  quint64 segmentCount;
+  quint64 segmentCountLength;
+  quint64 arrayLength;
+
+  static FuseLayout forSize(quint64 n)
+  {
+    FuseLayout l;
+    l.segmentLength = n == 0
+        ? 4
+        : quint32(1) << int(std::floor(std::log(double(n)) / std::log(3.33) + 2.25));
+    if (l.segmentLength > 262144)
+      l.segmentLength = 262144;
+    l.segmentLengthMask = l.segmentLength - 1;
+    const double sizeFactor = n <= 1 ? 0 : qMax(1.125, 0.875 + 0.25 * std::log(1000000.0) / std::log(double(n)));
+    const qint64 capacity = n <= 1 ? 0 : qint64(std::floor(double(n) * sizeFactor + 0.5));
+    const qint64 initSegmentCount = (capacity + l.segmentLength - 1) / l.segmentLength - 2;
+    qint64 segmentCount = ((initSegmentCount + 2) * l.segmentLength + l.segmentLength - 1) / l.segmentLength;
+    segmentCount = segmentCount <= 2 ? 1 : segmentCount - 2;
+    l.segmentCount = quint64(segmentCount);
+    l.arrayLength = (l.segmentCount + 2) * l.segmentLength;
+    l.segmentCountLength = l.segmentCount * l.segmentLength;
+    return l;
+  }
+
+  inline quint64 slot(int i, quint64 hash) const
+  {
+    quint64 h = mulhi(hash, segmentCountLength) + quint64(i) * segmentLength;
+    const quint64 hh = hash & ((Q_UINT64_C(1) << 36) - 1);
+    h ^= (hh >> (36 - 18 * i)) & segmentLengthMask;
+    return h;
+  }
+
+  static inline quint64 mulhi(quint64 a, quint64 b)
+  {
+#if defined(__SIZEOF_INT128__)
+    return quint64((static_cast<unsigned __int128>(a) * b) >> 64);
+#else
+    const quint64 aLo = a & 0xffffffffU;
+    const quint64 aHi = a >> 32;
+    const quint64 bLo = b & 0xffffffffU;
+    const quint64 bHi = b >> 32;
+    const quint64 p0 = aLo * bLo;
+    const quint64 p1 = aLo * bHi;
+    const quint64 p2 = aHi * bLo;
+    const quint64 p3 = aHi * bHi;
+    const quint64 mid = (p0 >> 32) + (p1 & 0xffffffffU) + (p2 & 0xffffffffU);
+    return p3 + (p1 >> 32) + (p2 >> 32) + (mid >> 32);
+#endif
+  }
+};
+
+
+inline quint64 murmur64(quint64 h)
+{
+  h ^= h >> 33;
+  h *= Q_UINT64_C(0xff51afd7ed558ccd);
+  h ^= h >> 33;
+  h *= Q_UINT64_C(0xc4ceb9fe1a85ec53);
+  h ^= h >> 33;
+  return h;
+}
+
+
+inline quint64 splitmix64(quint64 &state)
+{
+  quint64 z = (state += Q_UINT64_C(0x9e3779b97f4a7c15));
+  z = (z ^ (z >> 30)) * Q_UINT64_C(0xbf58476d1ce4e5b9);
+  z = (z ^ (z >> 27)) * Q_UINT64_C(0x94d049bb133111eb);
+  return z ^ (z >> 31);
+}
+
+
+inline quint64 fingerprint(quint64 hash)
+{
+  return hash ^ (hash >> 32);
+}
+
+
+template <typename T>
+inline bool fuseContains(const uchar *fingerprints, const FuseLayout &l, quint64 seed, quint64 key)
+{
+  const quint64 hash = murmur64(key + seed);
+  const T f = T(fingerprint(hash))
+      ^ qFromLittleEndian<T>(fingerprints + l.slot(0, hash) * sizeof(T))
+      ^ qFromLittleEndian<T>(fingerprints + l.slot(1, hash) * sizeof(T))
+      ^ qFromLittleEndian<T>(fingerprints + l.slot(2, hash) * sizeof(T));
+  return f == 0;
+}
+
+
+// Builds the filter by peeling: slots hit by exactly one remaining key are
+// taken off repeatedly; assigning fingerprints in reverse peeling order then
+// satisfies every key. `keys` must not contain duplicates.
+template <typename T>
+bool fusePopulate(const std::vector<quint64> &keys, const FuseLayout &l, quint64 &seed, std::vector<T> &fingerprints)
+{
+  const quint64 n = keys.size();
+  const quint64 m = l.arrayLength;
+  fingerprints.assign(m, T(0));
+  if (n == 0) {
+    seed = 0;
+    return true;
+  }
+  // per slot: number of keys << 2 | XOR of the key's slot numbers (0, 1, 2)
+  std::vector<quint8> counts(m);
+  std::vector<quint64> xorHashes(m);
+  std::vector<quint32> alone(m);
+  std::vector<quint64> stack(n);
+  std::vector<quint8> stackFound(n);
+  quint64 rng = Q_UINT64_C(0x726b2b9d438b9d4d);
+  for (int attempt = 0; attempt < MaxBuildAttempts; ++attempt) {
+    seed = splitmix64(rng);
+    std::fill(counts.begin(), counts.end(), quint8(0));
+    std::fill(xorHashes.begin(), xorHashes.end(), quint64(0));
+    bool overflow = false;
+    for (quint64 k = 0; k < n; ++k) {
+      const quint64 hash = murmur64(keys[k] + seed);
+      for (int i = 0; i < 3; ++i) {
+        const quint64 s = l.slot(i, hash);
+        counts[s] = quint8(counts[s] + 4);
+        counts[s] ^= quint8(i);
+        xorHashes[s] ^= hash;
+        overflow |= counts[s] < 4;
+      }
+    }
+    if (overflow)
+      continue;
+    quint64 queued = 0;
+    for (quint64 s = 0; s < m; ++s) {
+      if ((counts[s] >> 2) == 1) {
+        alone[queued++] = quint32(s);
+      }
+    }
+    quint64 stacked = 0;
+    while (queued > 0) {
+      const quint64 s = alone[--queued];
+      if ((counts[s] >> 2) != 1)
+        continue;
+      const quint64 hash = xorHashes[s];
+      const int found = counts[s] & 3;
+      stack[stacked] = hash;
+      stackFound[stacked] = quint8(found);
+      ++stacked;
+      for (int i = 0; i < 3; ++i) {
+        const quint64 t = l.slot(i, hash);
+        counts[t] = quint8(counts[t] - 4);
+        counts[t] ^= quint8(i);
+        xorHashes[t] ^= hash;
+        if (i != found && (counts[t] >> 2) == 1) {
+          alone[queued++] = quint32(t);
+        }
+      }
+    }
+    if (stacked != n)
+      continue;
+    while (stacked > 0) {
+      --stacked;
+      const quint64 hash = stack[stacked];
+      const int found = stackFound[stacked];
+      quint64 s[3];
+      for (int i = 0; i < 3; ++i) {
+        s[i] = l.slot(i, hash);
+      }
+      fingerprints[s[found]] = T(T(fingerprint(hash)) ^ fingerprints[s[(found + 1) % 3]] ^ fingerprints[s[(found + 2) % 3]]);
+    }
+    return true;
+  }
+  return false;
+}
+
+
+template <typename T>
+bool writeFilter(const std::vector<quint64> &keys, const FuseLayout &layout, BreachFilter::HashAlgorithm algorithm, QIODevice *out, QString &errorString)
+{
+  static const size_t WriteChunkSize = 16 * 1024 * 1024;
+  quint64 seed = 0;
+  std::vector<T> fingerprints;
+  if (!fusePopulate(keys, layout, seed, fingerprints)) {
+    errorString = QObject::tr("Cannot construct the filter; the hashes may not be distinct enough");
+    return false;
+  }
+  QByteArray header(BreachFilter::HeaderSize, '\0');
+  uchar *h = reinterpret_cast<uchar*>(header.data());
+  memcpy(h, BreachFilter::Magic.constData(), size_t(BreachFilter::Magic.size()));
+  qToLittleEndian<quint32>(BreachFilter::Version, h + HeaderVersionOffset);
+  qToLittleEndian<quint32>(quint32(sizeof(T) * 8), h + HeaderBitsOffset);
+  qToLittleEndian<quint32>(quint32(algorithm), h + HeaderAlgorithmOffset);
+  qToLittleEndian<quint32>(layout.segmentLength, h + HeaderSegmentLengthOffset);
+  qToLittleEndian<quint64>(layout.segmentCount, h + HeaderSegmentCountOffset);
+  qToLittleEndian<quint64>(layout.arrayLength, h + HeaderArrayLengthOffset);
+  qToLittleEndian<quint64>(quint64(keys.size()), h + HeaderKeyCountOffset);
+  qToLittleEndian<quint64>(seed, h + HeaderSeedOffset);
+  if (out->write(header) != header.size()) {
+    errorString = out->errorString();
+    return false;
+  }
+  for (size_t i = 0; i < fingerprints.size(); i += WriteChunkSize) {
+    const size_t n = qMin(WriteChunkSize, fingerprints.size() - i);
+    QByteArray chunk(int(n * sizeof(T)), Qt::Uninitialized);
+    for (size_t j = 0; j < n; ++j) {
+      qToLittleEndian<T>(fingerprints[i + j], reinterpret_cast<uchar*>(chunk.data()) + j * sizeof(T));
+    }
+    if (out->write(chunk) != chunk.size()) {
+      errorString = out->errorString();
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+
+class BreachFilterPrivate {
+public:
+  BreachFilterPrivate(void)
+    : map(Q_NULLPTR)
+    , fingerprints(Q_NULLPTR)
+    , bits(0)
+    , algorithm(BreachFilter::Sha1)
+    , count(0)
+    , seed(0)
+  {
+    memset(&layout, 0, sizeof(layout));
+  }
+  QString filename;
+  QFile file;
+  uchar *map;
+  const uchar *fingerprints;
+  int bits;
+  BreachFilter::HashAlgorithm algorithm;
+  qint64 count;
+  quint64 seed;
+  FuseLayout layout;
+  QString errorString;
+};
+
+
+/*!
+ * \brief BreachFilter::BreachFilter
+ *
+ * A `BreachFilter` tells whether a password is among the hashes of a breach
+ * corpus without keeping the corpus itself. It is a binary fuse filter over
+ * the first 64 bits of the SHA-1 or NTLM hashes, built offline by SESAMBreachFilter
+ * and memory-mapped here. A lookup reads three fingerprints, so it takes
+ * constant time regardless of how many hashes went into the filter.
+ *
+ * With 8 bit fingerprints the filter takes about 1.13 bytes per hash and
+ * reports about 0.4 % of unlisted passwords as listed; 16 and 32 bit fingerprints
+ * trade twice or four times the size for a false positive rate of 2^-16 or 2^-32.
+ * Listed passwords are always reported.
+ */
+BreachFilter::BreachFilter(void)
+  : d_ptr(new BreachFilterPrivate)
+{
+  /* ... */
+}
+
+
+BreachFilter::BreachFilter(const QString &filename)
+  : d_ptr(new BreachFilterPrivate)
+{
+  setFileName(filename);
+}
+
+
+BreachFilter::~BreachFilter()
+{
+  close();
+}
+
+
+void BreachFilter::setFileName(const QString &filename)
+{
+  Q_D(BreachFilter);
+  d->filename = filename;
+}
+
+
+QString BreachFilter::fileName(void) const
+{
+  Q_D(const BreachFilter);
+  return d->filename;
+}
+
+
+bool BreachFilter::open(void)
+{
+  Q_D(BreachFilter);
+  close();
+  d->file.setFileName(d->filename);
+  if (!d->file.open(QIODevice::ReadOnly)) {
+    d->errorString = d->file.errorString();
+    return false;
+  }
+  if (d->file.size() < HeaderSize || (d->map = d->file.map(0, d->file.size())) == Q_NULLPTR) {
+    d->errorString = QObject::tr("%1 is not a breach filter").arg(d->filename);
+    close();
+    return false;
+  }
+  if (QByteArray::fromRawData(reinterpret_cast<const char*>(d->map), Magic.size()) != Magic
+      || qFromLittleEndian<quint32>(d->map + HeaderVersionOffset) != Version) {
+    d->errorString = QObject::tr("%1 is not a breach filter or has an unsupported format").arg(d->filename);
+    close();
+    return false;
+  }
+  d->bits = int(qFromLittleEndian<quint32>(d->map + HeaderBitsOffset));
+  d->algorithm = HashAlgorithm(qFromLittleEndian<quint32>(d->map + HeaderAlgorithmOffset));
+  d->count = qint64(qFromLittleEndian<quint64>(d->map + HeaderKeyCountOffset));
+  d->seed = qFromLittleEndian<quint64>(d->map + HeaderSeedOffset);
+  d->layout = FuseLayout::forSize(quint64(d->count));
+  const bool consistent = (d->bits == 8 || d->bits == 16 || d->bits == 32)
+      && (d->algorithm == Sha1 || d->algorithm == Ntlm)
+      && d->layout.segmentLength == qFromLittleEndian<quint32>(d->map + HeaderSegmentLengthOffset)
+      && d->layout.segmentCount == qFromLittleEndian<quint64>(d->map + HeaderSegmentCountOffset)
+      && d->layout.arrayLength == qFromLittleEndian<quint64>(d->map + HeaderArrayLengthOffset)
+      && quint64(d->file.size()) == quint64(HeaderSize) + d->layout.arrayLength * quint64(d->bits / 8);
+  if (!consistent) {
+    d->errorString = QObject::tr("The breach filter %1 is damaged").arg(d->filename);
+    close();
+    return false;
+  }
+  d->fingerprints = d->map + HeaderSize;
+  return true;
+}
+
+
+bool BreachFilter::isOpen(void) const
+{
+  Q_D(const BreachFilter);
+  return d->fingerprints != Q_NULLPTR;
+}
+
+
+void BreachFilter::close(void)
+{
+  Q_D(BreachFilter);
+  if (d->map != Q_NULLPTR) {
+    d->file.unmap(d->map);
+  }
+  d->file.close();
+  d->map = Q_NULLPTR;
+  d->fingerprints = Q_NULLPTR;
+  d->bits = 0;
+  d->count = 0;
+  d->seed = 0;
+}
+
+
+bool BreachFilter::contains(quint64 key) const
+{
+  Q_D(const BreachFilter);
+  if (d->count == 0)
+    return false;
+  switch (d->bits) {
+  case 8:
+    return fuseContains<quint8>(d->fingerprints, d->layout, d->seed, key);
+  case 16:
+    return fuseContains<quint16>(d->fingerprints, d->layout, d->seed, key);
+  case 32:
+    return fuseContains<quint32>(d->fingerprints, d->layout, d->seed, key);
+  default:
+    break;
+  }
+  return false;
+}
+
+
+bool BreachFilter::containsDigest(const QByteArray &digest) const
+{
+  return digest.size() >= 8 && contains(keyFromDigest(digest));
+}
+
+
+bool BreachFilter::containsPassword(const QString &password) const
+{
+  Q_D(const BreachFilter);
+  return isOpen() && containsDigest(digest(password, d->algorithm));
+}
+
+
+BreachFilter::HashAlgorithm BreachFilter::hashAlgorithm(void) const
+{
+  Q_D(const BreachFilter);
+  return d->algorithm;
+}
+
+
+int BreachFilter::fingerprintBits(void) const
+{
+  Q_D(const BreachFilter);
+  return d->bits;
+}
+
+
+qint64 BreachFilter::count(void) const
+{
+  Q_D(const BreachFilter);
+  return d->count;
+}
+
+
+qint64 BreachFilter::sizeInBytes(void) const
+{
+  Q_D(const BreachFilter);
+  return isOpen() ? d->file.size() : 0;
+}
+
+
+double BreachFilter::falsePositiveRate(void) const
+{
+  Q_D(const BreachFilter);
+  return d->bits > 0 ? std::ldexp(1.0, -d->bits) : 0.0;
+}
+
+
+QString BreachFilter::errorString(void) const
+{
+  Q_D(const BreachFilter);
+  return d->errorString;
+}
+
+
+/*!
+ * \brief BreachFilter::digest
+ *
+ * \return SHA-1 of the UTF-8 encoded password, or its NTLM hash, i.e. MD4 of the UTF-16LE encoding
+ */
+QByteArray BreachFilter::digest(const QString &password, HashAlgorithm algorithm)
+{
+  if (algorithm == Ntlm) {
+    QByteArray utf16le(password.size() * 2, Qt::Uninitialized);
+    for (int i = 0; i < password.size(); ++i) {
+      qToLittleEndian<quint16>(password.at(i).unicode(), reinterpret_cast<uchar*>(utf16le.data()) + 2 * i);
+    }
+    const QByteArray &hash = QCryptographicHash::hash(utf16le, QCryptographicHash::Md4);
+    utf16le.fill('\0');
+    return hash;
+  }
+  return QCryptographicHash::hash(password.toUtf8(), QCryptographicHash::Sha1);
+}
+
+
+/*!
+ * \brief BreachFilter::keyFromDigest
+ *
+ * \return the first 64 bits of `digest`, the same as the first 16 digits of its hex representation
+ */
+quint64 BreachFilter::keyFromDigest(const QByteArray &digest)
+{
+  Q_ASSERT(digest.size() >= 8);
+  return qFromBigEndian<quint64>(reinterpret_cast<const uchar*>(digest.constData()));
+}
+
+
+int BreachFilter::fingerprintBitsFor(double falsePositiveRate)
+{
+  if (falsePositiveRate >= std::ldexp(1.0, -8))
+    return 8;
+  if (falsePositiveRate >= std::ldexp(1.0, -16))
+    return 16;
+  return 32;
+}
+
+
+bool BreachFilter::isFilterFile(const QString &filename)
+{
+  QFile f(filename);
+  return f.open(QIODevice::ReadOnly) && f.read(Magic.size()) == Magic;
+}
+
+
+/*!
+ * \brief BreachFilter::build
+ *
+ * Builds a filter from 64 bit hash prefixes as returned by `keyFromDigest()`
+ * and writes it to `out`. `keys` is sorted and stripped of duplicates in place.
+ * Building takes about 30 bytes of memory per key.
+ *
+ * \return `true` if the filter could be built and written
+ */
+bool BreachFilter::build(std::vector<quint64> &keys, HashAlgorithm algorithm, int fingerprintBits, QIODevice *out, QString *errorString)
+{
+  std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+  const FuseLayout &layout = FuseLayout::forSize(keys.size());
+  QString err;
+  bool ok = false;
+  if (layout.arrayLength > Q_UINT64_C(0xffffffff)) {
+    err = QObject::tr("Too many hashes for a single filter");
+  }
+  else {
+    switch (fingerprintBits) {
+    case 8:
+      ok = writeFilter<quint8>(keys, layout, algorithm, out, err);
+      break;
+    case 16:
+      ok = writeFilter<quint16>(keys, layout, algorithm, out, err);
+      break;
+    case 32:
+      ok = writeFilter<quint32>(keys, layout, algorithm, out, err);
+      break;
+    default:
+      err = QObject::tr("Fingerprints must have 8, 16 or 32 bits");
+      break;
+    }
+  }
+  if (!ok && errorString != Q_NULLPTR) {
+    *errorString = err;
+  }
+  return ok;
+}
@@ -0,0 +1,81 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+#ifndef __BREACHFILTER_H_
+#define __BREACHFILTER_H_
+
+#include <QtGlobal>
+#include <QString>
+#include <QByteArray>
+#include <QIODevice>
+#include <QScopedPointer>
+
+#include <vector>
+
+
+class BreachFilterPrivate;
+
+class BreachFilter
+{
+public:
+  enum HashAlgorithm {
+    Sha1 = 0,
+    Ntlm = 1
+  };
+
+  BreachFilter(void);
+  explicit BreachFilter(const QString &filename);
+  ~BreachFilter();
+
+  void setFileName(const QString &);
+  QString fileName(void) const;
+  bool open(void);
+  bool isOpen(void) const;
+  void close(void);
+
+  bool contains(quint64 key) const;
+  bool containsDigest(const QByteArray &digest) const;
+  bool containsPassword(const QString &password) const;
+
+  HashAlgorithm hashAlgorithm(void) const;
+  int fingerprintBits(void) const;
+  qint64 count(void) const;
+  qint64 sizeInBytes(void) const;
+  double falsePositiveRate(void) const;
+  QString errorString(void) const;
+
+  static QByteArray digest(const QString &password, HashAlgorithm algorithm);
+  static quint64 keyFromDigest(const QByteArray &digest);
+  static int fingerprintBitsFor(double falsePositiveRate);
+  static bool isFilterFile(const QString &filename);
+  static bool build(std::vector<quint64> &keys, HashAlgorithm algorithm, int fingerprintBits, QIODevice *out, QString *errorString = Q_NULLPTR);
+
+  static const QByteArray Magic;
+  static const quint32 Version;
+  static const int HeaderSize;
+
+private:
+  QScopedPointer<BreachFilterPrivate> d_ptr;
+  Q_DECLARE_PRIVATE(BreachFilter)
+  Q_DISABLE_COPY(BreachFilter)
+};
+
+#endif // __BREACHFILTER_H_
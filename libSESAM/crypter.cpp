@@ -25,6 +25,8 @@
 #include "pbkdf2.h"
 #include "crypter.h"
 #include "util.h"
+#include "tracer.h"
+#include "metrics.h"
 
 
 const int Crypter::SaltSize = 32;
@@ -117,12 +119,17 @@ QByteArray Crypter::encode(const SecureByteArray &key,
                            const QByteArray &data,
                            bool compress)
 {
+  TRACE_SPAN("crypto", "Crypter::encode");
   const QByteArray &salt2 = generateSalt();
   const SecureByteArray &IV2 = generateIV();
   const SecureByteArray &KGK2 = salt2 + IV2 + KGK;
   const QByteArray &encryptedKGK = encrypt(key, IV, KGK2, CryptoPP::StreamTransformationFilter::NO_PADDING);
   const SecureByteArray &blobKey = Crypter::makeKeyFromPassword(KGK, salt2);
   const SecureByteArray &baPlain = compress ? qCompress(data, 9) : data;
+  if (compress) {
+    METRIC_COUNTER("crypto.compress.bytes_in").add(data.size());
+    METRIC_COUNTER("crypto.compress.bytes_out").add(baPlain.size());
+  }
   const QByteArray &baCipher = encrypt(blobKey, IV2, baPlain, CryptoPP::StreamTransformationFilter::PKCS_PADDING);
   const QByteArray formatFlag(int(1), static_cast<char>(AES256EncryptedMasterkeyFormat));
   return formatFlag + salt + encryptedKGK + baCipher;
@@ -142,6 +149,7 @@ QByteArray Crypter::decode(const SecureByteArray &masterPassword,
                            SecureByteArray &KGK)
 {
   Q_ASSERT_X(!masterPassword.isEmpty(), "Crypter::decode()", "masterPassword must not be empty");
+  TRACE_SPAN("crypto", "Crypter::decode");
   FormatFlags formatFlag = static_cast<FormatFlags>(cipher.at(0));
   if (formatFlag != AES256EncryptedMasterkeyFormat)
     return QByteArray();
@@ -172,6 +180,7 @@ QByteArray Crypter::decode(const SecureByteArray &masterPassword,
  */
 QByteArray Crypter::encrypt(const SecureByteArray &key, const SecureByteArray &IV, const QByteArray &plain, CryptoPP::StreamTransformationFilter::BlockPaddingScheme padding)
 {
+  METRIC_COUNTER("crypto.bytes_encrypted").add(plain.size());
   CryptoPP::CBC_Mode<CryptoPP::AES>::Encryption enc;
   enc.SetKeyWithIV(reinterpret_cast<const byte*>(key.constData()), key.size(), reinterpret_cast<const byte*>(IV.constData()));
   const int cipherSize = (padding == CryptoPP::StreamTransformationFilter::NO_PADDING)
@@ -205,6 +214,7 @@ QByteArray Crypter::encrypt(const SecureByteArray &key, const SecureByteArray &I
  */
 SecureByteArray Crypter::decrypt(const SecureByteArray &key, const SecureByteArray &IV, const QByteArray &cipher, CryptoPP::StreamTransformationFilter::BlockPaddingScheme padding)
 {
+  METRIC_COUNTER("crypto.bytes_decrypted").add(cipher.size());
   CryptoPP::CBC_Mode<CryptoPP::AES>::Decryption dec;
   dec.SetKeyWithIV(reinterpret_cast<const byte*>(key.constData()), key.size(), reinterpret_cast<const byte*>(IV.constData()));
   SecureByteArray plain(cipher.size(), static_cast<char>(0));
@@ -0,0 +1,204 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "domainindex.h"
+#include "blobstore.h"
+
+#include <QtDebug>
+
+
+DomainIndex::Entry DomainIndex::Entry::fromDomainSettings(const DomainSettings &ds)
+{
+  Entry e;
+  e.domainName = ds.domainName;
+  e.createdDate = ds.createdDate;
+  e.modifiedDate = ds.modifiedDate;
+  e.deleted = ds.deleted;
+  e.groupHierarchy = ds.groupHierarchy;
+  e.tags = ds.tags;
+  return e;
+}
+
+
+/*!
+ * \brief DomainIndex::Entry::fromJsonObject
+ *
+ * Picks only the fields needed to list, filter and merge domains from the JSON representation
+ * of a `DomainSettings` object. Notes, attachments etc. are left alone.
+ */
+DomainIndex::Entry DomainIndex::Entry::fromJsonObject(const QJsonObject &o)
+{
+  Entry e;
+  e.domainName = o[DomainSettings::DOMAIN_NAME].toString();
+  e.createdDate = QDateTime::fromString(o[DomainSettings::CDATE].toString(), Qt::ISODate);
+  e.modifiedDate = QDateTime::fromString(o[DomainSettings::MDATE].toString(), Qt::ISODate);
+  e.deleted = o[DomainSettings::DELETED].toBool();
+  e.groupHierarchy = o[DomainSettings::GROUP].toString();
+  e.tags = o[DomainSettings::TAGS].toString().split(QChar('\t'), QString::SkipEmptyParts);
+  return e;
+}
+
+
+/*!
+ * \brief DomainIndex::DomainIndex
+ *
+ * A `DomainIndex` holds domain settings in their JSON representation and decodes
+ * a `DomainSettings` object only when it's actually asked for. Listing, filtering and
+ * merging by modification date only need the lightweight `DomainIndex::Entry`.
+ */
+DomainIndex::DomainIndex(void)
+  : mDirty(false)
+{
+  // ...
+}
+
+
+bool DomainIndex::contains(const QString &domainName) const
+{
+  return mEntries.contains(domainName);
+}
+
+
+DomainIndex::Entry DomainIndex::entry(const QString &domainName) const
+{
+  return mEntries.value(domainName);
+}
+
+
+QList<DomainIndex::Entry> DomainIndex::entries(void) const
+{
+  return mEntries.values();
+}
+
+
+QStringList DomainIndex::keys(void) const
+{
+  return mEntries.keys();
+}
+
+
+int DomainIndex::count(void) const
+{
+  return mEntries.count();
+}
+
+
+bool DomainIndex::isEmpty(void) const
+{
+  return mEntries.isEmpty();
+}
+
+
+void DomainIndex::clear(void)
+{
+  mEntries.clear();
+  mObjects = QJsonObject();
+  mDirty = false;
+}
+
+
+DomainSettings DomainIndex::decode(const QString &domainName) const
+{
+  if (!mEntries.contains(domainName))
+    return DomainSettings();
+  return DomainSettings::fromVariantMap(mObjects[domainName].toObject().toVariantMap());
+}
+
+
+DomainSettingsList DomainIndex::decodeAll(void) const
+{
+  DomainSettingsList dl;
+  foreach (QString domainName, mEntries.keys()) {
+    dl << decode(domainName);
+  }
+  return dl;
+}
+
+
+void DomainIndex::updateWith(const DomainSettings &src)
+{
+  mObjects[src.domainName] = QJsonObject::fromVariantMap(src.toVariantMap());
+  mEntries[src.domainName] = Entry::fromDomainSettings(src);
+  setDirty();
+}
+
+
+void DomainIndex::remove(const QString &domainName)
+{
+  mObjects.remove(domainName);
+  mEntries.remove(domainName);
+  setDirty();
+}
+
+
+QByteArray DomainIndex::toJson(void) const
+{
+  return QJsonDocument(mObjects).toJson(QJsonDocument::Compact);
+}
+
+
+/*!
+ * \brief DomainIndex::referencedBlobs
+ *
+ * \return ids of all attachment chunks referenced by the domains in this index
+ */
+QStringList DomainIndex::referencedBlobs(void) const
+{
+  QStringList ids;
+  for (QJsonObject::const_iterator o = mObjects.constBegin(); o != mObjects.constEnd(); ++o) {
+    const QVariantMap &files = o.value().toObject()[DomainSettings::FILES].toObject().toVariantMap();
+    foreach (QVariant file, files) {
+      if (BlobStore::Reference::isReference(file)) {
+        ids << BlobStore::Reference::fromVariant(file).chunks;
+      }
+    }
+  }
+  ids.removeDuplicates();
+  return ids;
+}
+
+
+DomainIndex DomainIndex::fromQJsonDocument(const QJsonDocument &json)
+{
+  DomainIndex idx;
+  const QJsonObject &root = json.object();
+  for (QJsonObject::const_iterator o = root.constBegin(); o != root.constEnd(); ++o) {
+    if (o.key().isEmpty())
+      continue;
+    const QJsonObject &obj = o.value().toObject();
+    Entry e = Entry::fromJsonObject(obj);
+    if (e.domainName.isEmpty())
+      continue;
+    idx.mEntries.insert(e.domainName, e);
+    idx.mObjects.insert(e.domainName, obj);
+  }
+  return idx;
+}
+
+
+bool DomainIndex::isDirty(void) const
+{
+  return mDirty;
+}
+
+
+void DomainIndex::setDirty(bool dirty)
+{
+  mDirty = dirty;
+}
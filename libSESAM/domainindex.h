@@ -0,0 +1,78 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef __DOMAININDEX_H_
+#define __DOMAININDEX_H_
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+#include <QDateTime>
+#include <QMap>
+#include <QList>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include "domainsettings.h"
+#include "domainsettingslist.h"
+
+class DomainIndex {
+public:
+  struct Entry {
+    Entry(void)
+      : deleted(false)
+    { /* ... */ }
+    QString domainName;
+    QDateTime createdDate;
+    QDateTime modifiedDate;
+    bool deleted;
+    QString groupHierarchy;
+    QStringList tags;
+    QDateTime lastChanged(void) const { return modifiedDate.isValid() ? modifiedDate : createdDate; }
+    static Entry fromDomainSettings(const DomainSettings &);
+    static Entry fromJsonObject(const QJsonObject &);
+  };
+
+  DomainIndex(void);
+  bool contains(const QString &domainName) const;
+  Entry entry(const QString &domainName) const;
+  QList<Entry> entries(void) const;
+  QStringList keys(void) const;
+  int count(void) const;
+  bool isEmpty(void) const;
+  void clear(void);
+  DomainSettings decode(const QString &domainName) const;
+  DomainSettingsList decodeAll(void) const;
+  void updateWith(const DomainSettings &);
+  void remove(const QString &domainName);
+  QByteArray toJson(void) const;
+  QStringList referencedBlobs(void) const;
+  static DomainIndex fromQJsonDocument(const QJsonDocument &);
+
+  bool isDirty(void) const;
+  void setDirty(bool dirty = true);
+
+private:
+  QMap<QString, Entry> mEntries;
+  QJsonObject mObjects;
+  bool mDirty;
+};
+
+#endif // __DOMAININDEX_H_
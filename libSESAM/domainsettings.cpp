@@ -81,6 +81,12 @@ DomainSettings::DomainSettings(const DomainSettings &o)
 
 
 bool DomainSettings::expired(void) const
+{
+  return expired(expiryDate);
+}
+
+
+bool DomainSettings::expired(const QDateTime &expiryDate)
 {
   return !expiryDate.isNull() && expiryDate < QDateTime::currentDateTime();
 }
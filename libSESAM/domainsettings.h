@@ -46,6 +46,7 @@ public:
   void clear(void);
 
   static DomainSettings fromVariantMap(const QVariantMap &);
+  static bool expired(const QDateTime &expiryDate);
 #ifndef OMIT_V2_CODE
   static bool isV2Template(const QString &);
 #endif
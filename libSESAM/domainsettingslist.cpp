@@ -18,6 +18,7 @@
 */
 
 #include "domainsettingslist.h"
+#include "tracer.h"
 
 #include <QtDebug>
 
@@ -82,6 +83,7 @@ QByteArray DomainSettingsList::toJson(void) const
 
 QJsonDocument DomainSettingsList::toJsonDocument(void) const
 {
+  TRACE_SPAN("serialization", "DomainSettingsList::toJsonDocument");
   QVariantMap domains;
   for (DomainSettingsList::const_iterator d = constBegin(); d != constEnd(); ++d) {
     domains[d->domainName] = d->toVariantMap();
@@ -102,6 +104,7 @@ QStringList DomainSettingsList::keys(void) const
 
 DomainSettingsList DomainSettingsList::fromQJsonDocument(const QJsonDocument &json)
 {
+  TRACE_SPAN("serialization", "DomainSettingsList::fromQJsonDocument");
   DomainSettingsList dl;
   const QVariantMap &map = json.toVariant().toMap();
   foreach(QString key, map.keys()) {
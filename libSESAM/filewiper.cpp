@@ -0,0 +1,232 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include <QFile>
+#include <QFileInfo>
+#include <QThreadPool>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QFuture>
+#include <QList>
+#include <QtConcurrent>
+
+#include "filewiper.h"
+#include "util.h"
+
+#include "osrng.h"
+
+
+// a multiple of 3 so that the triplet patterns continue seamlessly from block to block,
+// and a multiple of the page size so that every write is aligned
+const int FileWiper::BlockSize = 3 * 64 * 1024;
+const int FileWiper::DefaultMaxConcurrency = 4;
+
+static const int NumSinglePatterns = 16;
+static const unsigned char SinglePatterns[NumSinglePatterns] = {
+  0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+  0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff
+};
+static const int NumTriplets = 6;
+static const unsigned char Triplets[NumTriplets][3] = {
+  { 0x92, 0x49, 0x24 }, { 0x49, 0x24, 0x92 }, { 0x24, 0x92, 0x49 },
+  { 0x6d, 0xb6, 0xdb }, { 0xb6, 0xdb, 0x6d }, { 0xdb, 0x6d, 0xb6 }
+};
+
+
+class FileWiperPrivate {
+public:
+  FileWiperPrivate(void)
+    : extensive(false)
+    , bytesWritten(0)
+    , bytesTotal(0)
+  {
+    pool.setMaxThreadCount(FileWiper::DefaultMaxConcurrency);
+    for (int i = 0; i < NumSinglePatterns; ++i) {
+      patterns << QByteArray(FileWiper::BlockSize, char(SinglePatterns[i]));
+    }
+    for (int i = 0; i < NumTriplets; ++i) {
+      QByteArray pattern;
+      pattern.reserve(FileWiper::BlockSize);
+      const char *b = reinterpret_cast<const char*>(&Triplets[i][0]);
+      while (pattern.size() < FileWiper::BlockSize) {
+        pattern.append(b, 3);
+      }
+      patterns << pattern;
+    }
+  }
+  qint64 addProgress(qint64 n)
+  {
+    QMutexLocker locker(&progressMutex);
+    bytesWritten += n;
+    return bytesWritten;
+  }
+  bool extensive;
+  QList<QByteArray> patterns;
+  QThreadPool pool;
+  QMutex progressMutex;
+  qint64 bytesWritten;
+  qint64 bytesTotal;
+};
+
+
+/*!
+ * \brief FileWiper::FileWiper
+ *
+ * A `FileWiper` overwrites files block by block before deleting them. With the
+ * extensive setting the file is overwritten with 16 single byte and 6 triplet
+ * patterns first; the last pass always writes random data. Every pass is flushed
+ * to the storage device before the next one starts, otherwise the operating system
+ * would be free to merge all passes into the last one.
+ */
+FileWiper::FileWiper(QObject *parent)
+  : QObject(parent)
+  , d_ptr(new FileWiperPrivate)
+{
+  /* ... */
+}
+
+
+FileWiper::~FileWiper()
+{
+  Q_D(FileWiper);
+  d->pool.waitForDone();
+}
+
+
+void FileWiper::setExtensive(bool extensive)
+{
+  Q_D(FileWiper);
+  d->extensive = extensive;
+}
+
+
+bool FileWiper::isExtensive(void) const
+{
+  Q_D(const FileWiper);
+  return d->extensive;
+}
+
+
+/*!
+ * \brief FileWiper::setMaxConcurrency
+ *
+ * Sets the number of files `wipeFiles()` overwrites at the same time.
+ * More than a handful doesn't pay off because the device becomes the bottleneck.
+ */
+void FileWiper::setMaxConcurrency(int n)
+{
+  Q_D(FileWiper);
+  d->pool.setMaxThreadCount(qMax(1, n));
+}
+
+
+int FileWiper::maxConcurrency(void) const
+{
+  Q_D(const FileWiper);
+  return d->pool.maxThreadCount();
+}
+
+
+int FileWiper::passes(void) const
+{
+  Q_D(const FileWiper);
+  return d->extensive ? d->patterns.size() + 1 : 1;
+}
+
+
+/*!
+ * \brief FileWiper::wipeFile
+ *
+ * Overwrites and deletes a single file.
+ *
+ * \return `true` if the file has been overwritten and deleted
+ */
+bool FileWiper::wipeFile(const QString &filename)
+{
+  Q_D(FileWiper);
+  d->bytesWritten = 0;
+  d->bytesTotal = passes() * QFileInfo(filename).size();
+  return wipe(filename);
+}
+
+
+/*!
+ * \brief FileWiper::wipeFiles
+ *
+ * Overwrites and deletes the given files in parallel and blocks until all of them are done.
+ *
+ * \return names of the files that could not be wiped
+ */
+QStringList FileWiper::wipeFiles(const QStringList &filenames)
+{
+  Q_D(FileWiper);
+  d->bytesWritten = 0;
+  d->bytesTotal = 0;
+  foreach (QString filename, filenames) {
+    d->bytesTotal += passes() * QFileInfo(filename).size();
+  }
+  QList<QFuture<bool> > futures;
+  foreach (QString filename, filenames) {
+    futures << QtConcurrent::run(&d->pool, this, &FileWiper::wipe, filename);
+  }
+  QStringList failed;
+  for (int i = 0; i < futures.size(); ++i) {
+    if (!futures[i].result()) {
+      failed << filenames.at(i);
+    }
+  }
+  return failed;
+}
+
+
+bool FileWiper::wipe(const QString &filename)
+{
+  Q_D(FileWiper);
+  QFile f(filename);
+  if (!f.open(QIODevice::ReadWrite | QIODevice::Unbuffered))
+    return false;
+  const qint64 N = f.size();
+  bool ok = true;
+  // every worker has its own generator, because the fallback of Crypter::randomBytes() is shared by all threads
+  CryptoPP::AutoSeededRandomPool rng;
+  QByteArray randomBlock(BlockSize, static_cast<char>(0));
+  const int nPatterns = d->extensive ? d->patterns.size() : 0;
+  for (int pass = 0; ok && pass <= nPatterns; ++pass) {
+    ok = f.seek(0);
+    for (qint64 pos = 0; ok && pos < N; pos += BlockSize) {
+      const int n = int(qMin<qint64>(BlockSize, N - pos));
+      if (pass == nPatterns) {
+        rng.GenerateBlock(reinterpret_cast<byte*>(randomBlock.data()), n);
+      }
+      const QByteArray &block = (pass < nPatterns) ? d->patterns.at(pass) : randomBlock;
+      ok = f.write(block.constData(), n) == n;
+      emit progress(d->addProgress(n), d->bytesTotal);
+    }
+    ok = ok && syncToDisk(f);
+  }
+  f.close();
+  if (ok) {
+    ok = f.remove();
+  }
+  if (ok) {
+    emit fileWiped(filename);
+  }
+  return ok;
+}
@@ -0,0 +1,64 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef __FILEWIPER_H_
+#define __FILEWIPER_H_
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QScopedPointer>
+
+
+class FileWiperPrivate;
+
+class FileWiper : public QObject
+{
+  Q_OBJECT
+public:
+  explicit FileWiper(QObject *parent = Q_NULLPTR);
+  ~FileWiper();
+
+  void setExtensive(bool extensive);
+  bool isExtensive(void) const;
+  void setMaxConcurrency(int);
+  int maxConcurrency(void) const;
+  int passes(void) const;
+
+  bool wipeFile(const QString &filename);
+  QStringList wipeFiles(const QStringList &filenames);
+
+  static const int BlockSize;
+  static const int DefaultMaxConcurrency;
+
+signals:
+  void progress(qint64 bytesWritten, qint64 bytesTotal);
+  void fileWiped(const QString &filename);
+
+private:
+  bool wipe(const QString &filename);
+
+private:
+  QScopedPointer<FileWiperPrivate> d_ptr;
+  Q_DECLARE_PRIVATE(FileWiper)
+  Q_DISABLE_COPY(FileWiper)
+};
+
+#endif // __FILEWIPER_H_
@@ -0,0 +1,295 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include <QThread>
+#include <QThreadPool>
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QMessageAuthenticationCode>
+#include <QCryptographicHash>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QSaveFile>
+#include <QSysInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QFuture>
+#include <QtConcurrent>
+
+#include "kdfbenchmark.h"
+#include "securebytearray.h"
+#include "metrics.h"
+
+
+const int KdfBenchmark::DefaultDuration = 2000;
+const int KdfBenchmark::CacheValidityDays = 30;
+
+static const QString CACHE_MACHINE = "machine";
+static const QString CACHE_THREADS = "threads";
+static const QString CACHE_ITERATIONS_PER_SEC = "iterationsPerSec";
+static const QString CACHE_MEASURED = "measured";
+static const int DeadlineCheckInterval = 256;
+
+
+class KdfBenchmarkPrivate {
+public:
+  KdfBenchmarkPrivate(void)
+    : durationMs(KdfBenchmark::DefaultDuration)
+    , iterationsPerSec(0)
+    , threadCount(0)
+  { /* ... */ }
+  // Derives keys the way `PBKDF2::generate()` does with SHA-512, minus the
+  // bookkeeping, until the deadline has passed.
+  // Returns the number of HMAC iterations computed.
+  static qint64 work(int iterations, QElapsedTimer clock, qint64 deadlineNs, QAtomicInt *abort)
+  {
+    static const char INT_32_BE1[4] = { 0, 0, 0, 1 };
+    const SecureByteArray pwd("benchmark.example" "benchmark" "0123456789abcdef0123456789abcdef");
+    const QByteArray salt = QByteArray("pepper") + QByteArray(INT_32_BE1, 4);
+    QMessageAuthenticationCode hmac(QCryptographicHash::Sha512);
+    hmac.setKey(pwd);
+    qint64 n = 0;
+    forever {
+      hmac.reset();
+      hmac.addData(salt);
+      QByteArray buffer = hmac.result();
+      QByteArray derivedKey = buffer;
+      ++n;
+      for (int j = 1; j < iterations; ++j) {
+        hmac.reset();
+        hmac.addData(buffer);
+        buffer = hmac.result();
+        for (int i = 0; i < derivedKey.size(); ++i) {
+          derivedKey[i] = derivedKey.at(i) ^ buffer.at(i);
+        }
+        ++n;
+        if ((j % DeadlineCheckInterval) == 0 && (clock.nsecsElapsed() > deadlineNs || abort->load() != 0))
+          return n;
+      }
+      if (clock.nsecsElapsed() > deadlineNs || abort->load() != 0)
+        return n;
+    }
+  }
+  QString cacheFileName;
+  int durationMs;
+  qreal iterationsPerSec;
+  int threadCount;
+  QDateTime measuredAt;
+  QAtomicInt abort;
+  QThreadPool pool;
+};
+
+
+/*!
+ * \brief KdfBenchmark::KdfBenchmark
+ *
+ * Measures how many PBKDF2-HMAC-SHA512 iterations per second this machine
+ * computes on all cores, which is what deriving a domain password costs.
+ * Dividing by the domain's iteration count yields the guesses per second
+ * an attacker with this machine could try.
+ *
+ * Results are cached in a file for `CacheValidityDays` days, tagged with a
+ * machine id so that a cache on a roaming profile isn't mistaken for a
+ * measurement on the current machine.
+ */
+KdfBenchmark::KdfBenchmark(void)
+  : d_ptr(new KdfBenchmarkPrivate)
+{
+  /* ... */
+}
+
+
+KdfBenchmark::~KdfBenchmark()
+{
+  Q_D(KdfBenchmark);
+  abort();
+  d->pool.waitForDone();
+}
+
+
+void KdfBenchmark::setCacheFileName(const QString &filename)
+{
+  Q_D(KdfBenchmark);
+  d->cacheFileName = filename;
+}
+
+
+QString KdfBenchmark::cacheFileName(void) const
+{
+  Q_D(const KdfBenchmark);
+  return d->cacheFileName;
+}
+
+
+void KdfBenchmark::setDuration(int ms)
+{
+  Q_D(KdfBenchmark);
+  d->durationMs = ms;
+}
+
+
+int KdfBenchmark::duration(void) const
+{
+  Q_D(const KdfBenchmark);
+  return d->durationMs;
+}
+
+
+/*!
+ * \brief KdfBenchmark::loadCached
+ *
+ * \return `true` if the cache file holds a recent result measured on this machine
+ */
+bool KdfBenchmark::loadCached(void)
+{
+  Q_D(KdfBenchmark);
+  if (d->cacheFileName.isEmpty())
+    return false;
+  QFile f(d->cacheFileName);
+  if (!f.open(QIODevice::ReadOnly))
+    return false;
+  const QJsonObject &o = QJsonDocument::fromJson(f.readAll()).object();
+  const QDateTime &measuredAt = QDateTime::fromString(o[CACHE_MEASURED].toString(), Qt::ISODate);
+  const qreal iterationsPerSec = o[CACHE_ITERATIONS_PER_SEC].toDouble();
+  if (o[CACHE_MACHINE].toString() != machineId() || iterationsPerSec <= 0 ||
+      !measuredAt.isValid() || measuredAt.addDays(CacheValidityDays) < QDateTime::currentDateTime())
+    return false;
+  d->iterationsPerSec = iterationsPerSec;
+  d->threadCount = o[CACHE_THREADS].toInt();
+  d->measuredAt = measuredAt;
+  return true;
+}
+
+
+/*!
+ * \brief KdfBenchmark::run
+ *
+ * Runs one worker per core for `duration()` milliseconds, each deriving keys
+ * with `iterations` iterations. Blocks until the workers are done.
+ *
+ * \return `true` if the benchmark completed and wasn't aborted
+ */
+bool KdfBenchmark::run(int iterations)
+{
+  Q_D(KdfBenchmark);
+  METRIC_TIMER("kdf.benchmark_us");
+  d->abort.store(0);
+  const int threadCount = qMax(1, QThread::idealThreadCount());
+  d->pool.setMaxThreadCount(threadCount);
+  QElapsedTimer clock;
+  clock.start();
+  const qint64 deadlineNs = qint64(d->durationMs) * 1000000;
+  QList<QFuture<qint64> > futures;
+  for (int i = 0; i < threadCount; ++i) {
+    futures << QtConcurrent::run(&d->pool, &KdfBenchmarkPrivate::work, qMax(1, iterations), clock, deadlineNs, &d->abort);
+  }
+  qint64 n = 0;
+  foreach (QFuture<qint64> future, futures) {
+    n += future.result();
+  }
+  const qint64 nsecsElapsed = clock.nsecsElapsed();
+  if (isAborted() || nsecsElapsed <= 0)
+    return false;
+  d->iterationsPerSec = 1e9 * n / nsecsElapsed;
+  d->threadCount = threadCount;
+  d->measuredAt = QDateTime::currentDateTime();
+  METRIC_GAUGE("kdf.benchmark_iterations_per_sec").set(qint64(d->iterationsPerSec));
+  if (!d->cacheFileName.isEmpty()) {
+    QJsonObject o;
+    o[CACHE_MACHINE] = machineId();
+    o[CACHE_THREADS] = d->threadCount;
+    o[CACHE_ITERATIONS_PER_SEC] = d->iterationsPerSec;
+    o[CACHE_MEASURED] = d->measuredAt.toString(Qt::ISODate);
+    QDir().mkpath(QFileInfo(d->cacheFileName).absolutePath());
+    QSaveFile f(d->cacheFileName);
+    if (f.open(QIODevice::WriteOnly)) {
+      f.write(QJsonDocument(o).toJson(QJsonDocument::Compact));
+      f.commit();
+    }
+  }
+  return true;
+}
+
+
+void KdfBenchmark::abort(void)
+{
+  Q_D(KdfBenchmark);
+  d->abort.store(1);
+}
+
+
+bool KdfBenchmark::isAborted(void) const
+{
+  Q_D(const KdfBenchmark);
+  return d->abort.load() != 0;
+}
+
+
+bool KdfBenchmark::isValid(void) const
+{
+  Q_D(const KdfBenchmark);
+  return d->iterationsPerSec > 0;
+}
+
+
+/*!
+ * \brief KdfBenchmark::iterationsPerSec
+ *
+ * \return PBKDF2-HMAC-SHA512 iterations per second on all cores; 0 if not measured yet
+ */
+qreal KdfBenchmark::iterationsPerSec(void) const
+{
+  Q_D(const KdfBenchmark);
+  return d->iterationsPerSec;
+}
+
+
+qreal KdfBenchmark::guessesPerSec(int iterations) const
+{
+  Q_D(const KdfBenchmark);
+  return d->iterationsPerSec / qMax(1, iterations);
+}
+
+
+int KdfBenchmark::threadCount(void) const
+{
+  Q_D(const KdfBenchmark);
+  return d->threadCount;
+}
+
+
+QDateTime KdfBenchmark::measuredAt(void) const
+{
+  Q_D(const KdfBenchmark);
+  return d->measuredAt;
+}
+
+
+QString KdfBenchmark::machineId(void)
+{
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+#if QT_VERSION >= 0x050400
+  hash.addData(QSysInfo::prettyProductName().toUtf8());
+  hash.addData(QSysInfo::currentCpuArchitecture().toUtf8());
+#endif
+  hash.addData(QByteArray::number(QThread::idealThreadCount()));
+  return QString::fromLatin1(hash.result().toHex());
+}
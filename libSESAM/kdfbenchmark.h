@@ -0,0 +1,64 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef __KDFBENCHMARK_H_
+#define __KDFBENCHMARK_H_
+
+#include <QString>
+#include <QDateTime>
+#include <QScopedPointer>
+
+
+class KdfBenchmarkPrivate;
+
+class KdfBenchmark
+{
+public:
+  KdfBenchmark(void);
+  ~KdfBenchmark();
+
+  void setCacheFileName(const QString &);
+  QString cacheFileName(void) const;
+  void setDuration(int ms);
+  int duration(void) const;
+
+  bool loadCached(void);
+  bool run(int iterations);
+  void abort(void);
+  bool isAborted(void) const;
+  bool isValid(void) const;
+
+  qreal iterationsPerSec(void) const;
+  qreal guessesPerSec(int iterations) const;
+  int threadCount(void) const;
+  QDateTime measuredAt(void) const;
+
+  static QString machineId(void);
+
+  static const int DefaultDuration;
+  static const int CacheValidityDays;
+
+private:
+  QScopedPointer<KdfBenchmarkPrivate> d_ptr;
+  Q_DECLARE_PRIVATE(KdfBenchmark)
+  Q_DISABLE_COPY(KdfBenchmark)
+};
+
+#endif // __KDFBENCHMARK_H_
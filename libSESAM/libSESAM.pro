@@ -44,22 +44,52 @@ SOURCES += \
     crypter.cpp \
     domainsettings.cpp \
     domainsettingslist.cpp \
+    domainindex.cpp \
     password.cpp \
     pbkdf2.cpp \
     securebytearray.cpp \
     securestring.cpp \
-    exporter.cpp
+    exporter.cpp \
+    vault.cpp \
+    blobstore.cpp \
+    syncpatch.cpp \
+    syncdecoder.cpp \
+    syncscheduler.cpp \
+    backupstore.cpp \
+    filewiper.cpp \
+    tracer.cpp \
+    metrics.cpp \
+    wordlist.cpp \
+    breachfilter.cpp \
+    strengthestimator.cpp \
+    vaultauditor.cpp \
+    kdfbenchmark.cpp
 
 HEADERS +=\
     util.h \
     crypter.h \
     domainsettings.h \
     domainsettingslist.h \
+    domainindex.h \
     password.h \
     pbkdf2.h \
     securebytearray.h \
     securestring.h \
-    exporter.h
+    exporter.h \
+    vault.h \
+    blobstore.h \
+    syncpatch.h \
+    syncdecoder.h \
+    syncscheduler.h \
+    backupstore.h \
+    filewiper.h \
+    tracer.h \
+    metrics.h \
+    wordlist.h \
+    breachfilter.h \
+    strengthestimator.h \
+    vaultauditor.h \
+    kdfbenchmark.h
 
 DISTFILES += \
     3rdparty/cryptopp/Crypto++-License
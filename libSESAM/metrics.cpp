@@ -0,0 +1,491 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+#include <QMap>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QJsonObject>
+#include <QJsonDocument>
+#include <QSaveFile>
+#include <QFileInfo>
+#include <QTextStream>
+#include <QDateTime>
+
+#include <cmath>
+
+#include "metrics.h"
+
+
+const int Metrics::Histogram::SubBucketBits = 4;
+const int Metrics::Histogram::BucketCount = (2 + 63 - Metrics::Histogram::SubBucketBits - 1) << Metrics::Histogram::SubBucketBits;
+
+static const qint64 NoMin = Q_INT64_C(0x7fffffffffffffff);
+
+
+static int bitLength(quint64 v)
+{
+  int n = 0;
+  if (v >= Q_UINT64_C(1) << 32) { v >>= 32; n += 32; }
+  if (v >= Q_UINT64_C(1) << 16) { v >>= 16; n += 16; }
+  if (v >= Q_UINT64_C(1) << 8) { v >>= 8; n += 8; }
+  if (v >= Q_UINT64_C(1) << 4) { v >>= 4; n += 4; }
+  while (v != 0) { v >>= 1; ++n; }
+  return n;
+}
+
+
+Metrics::Counter::Counter(void)
+  : mValue(0)
+{
+  /* ... */
+}
+
+
+void Metrics::Counter::add(qint64 delta)
+{
+  mValue.fetchAndAddRelaxed(delta);
+}
+
+
+qint64 Metrics::Counter::value(void) const
+{
+  return mValue.load();
+}
+
+
+void Metrics::Counter::reset(void)
+{
+  mValue.store(0);
+}
+
+
+Metrics::Gauge::Gauge(void)
+  : mValue(0)
+{
+  /* ... */
+}
+
+
+void Metrics::Gauge::set(qint64 value)
+{
+  mValue.store(value);
+}
+
+
+qint64 Metrics::Gauge::value(void) const
+{
+  return mValue.load();
+}
+
+
+void Metrics::Gauge::reset(void)
+{
+  mValue.store(0);
+}
+
+
+/*!
+ * \brief Metrics::Histogram::Histogram
+ *
+ * A histogram in the manner of HdrHistogram: values below 2^(SubBucketBits+1)
+ * get a bucket of their own, larger ones fall into one of 2^SubBucketBits linear
+ * sub-buckets per power of two. That bounds the relative error of any reported
+ * percentile to 1/16 over the full `qint64` range with less than a thousand buckets.
+ * Recording is a handful of relaxed atomic operations and never blocks.
+ */
+Metrics::Histogram::Histogram(void)
+  : mCount(0)
+  , mSum(0)
+  , mMin(NoMin)
+  , mMax(0)
+  , mBuckets(new QAtomicInteger<qint64>[BucketCount])
+{
+  reset();
+}
+
+
+Metrics::Histogram::~Histogram()
+{
+  delete [] mBuckets;
+}
+
+
+int Metrics::Histogram::bucketIndex(qint64 value)
+{
+  const quint64 v = value > 0 ? quint64(value) : 0;
+  const int subBuckets = 1 << SubBucketBits;
+  if (v < quint64(2 * subBuckets))
+    return int(v);
+  const int shift = bitLength(v) - SubBucketBits - 1;
+  const int top = int(v >> shift);
+  return 2 * subBuckets + (shift - 1) * subBuckets + top - subBuckets;
+}
+
+
+qint64 Metrics::Histogram::bucketLowerBound(int idx)
+{
+  const int subBuckets = 1 << SubBucketBits;
+  if (idx < 2 * subBuckets)
+    return idx;
+  const int shift = (idx - 2 * subBuckets) / subBuckets + 1;
+  const qint64 top = (idx - 2 * subBuckets) % subBuckets + subBuckets;
+  return top << shift;
+}
+
+
+qint64 Metrics::Histogram::bucketUpperBound(int idx)
+{
+  const int subBuckets = 1 << SubBucketBits;
+  if (idx < 2 * subBuckets)
+    return idx;
+  const int shift = (idx - 2 * subBuckets) / subBuckets + 1;
+  const quint64 top = quint64((idx - 2 * subBuckets) % subBuckets + subBuckets);
+  return qint64(((top + 1) << shift) - 1);
+}
+
+
+void Metrics::Histogram::record(qint64 value)
+{
+  if (value < 0)
+    value = 0;
+  mBuckets[bucketIndex(value)].fetchAndAddRelaxed(1);
+  mCount.fetchAndAddRelaxed(1);
+  mSum.fetchAndAddRelaxed(value);
+  qint64 current = mMin.load();
+  while (value < current && !mMin.testAndSetRelaxed(current, value))
+    current = mMin.load();
+  current = mMax.load();
+  while (value > current && !mMax.testAndSetRelaxed(current, value))
+    current = mMax.load();
+}
+
+
+qint64 Metrics::Histogram::count(void) const
+{
+  return mCount.load();
+}
+
+
+qint64 Metrics::Histogram::minimum(void) const
+{
+  const qint64 m = mMin.load();
+  return m == NoMin ? 0 : m;
+}
+
+
+qint64 Metrics::Histogram::maximum(void) const
+{
+  return mMax.load();
+}
+
+
+double Metrics::Histogram::mean(void) const
+{
+  const qint64 n = mCount.load();
+  return n > 0 ? double(mSum.load()) / n : 0.0;
+}
+
+
+/*!
+ * \brief Metrics::Histogram::percentile
+ *
+ * \param p percentile in the range [0, 100]
+ * \return the highest value equivalent to the bucket the `p`th percentile falls into,
+ * clamped to the recorded minimum and maximum
+ */
+qint64 Metrics::Histogram::percentile(double p) const
+{
+  qint64 total = 0;
+  for (int i = 0; i < BucketCount; ++i)
+    total += mBuckets[i].load();
+  if (total == 0)
+    return 0;
+  const qint64 rank = qMax(Q_INT64_C(1), qint64(std::ceil(qBound(0.0, p, 100.0) / 100.0 * total)));
+  qint64 seen = 0;
+  for (int i = 0; i < BucketCount; ++i) {
+    seen += mBuckets[i].load();
+    if (seen >= rank)
+      return qBound(minimum(), bucketUpperBound(i), maximum());
+  }
+  return maximum();
+}
+
+
+QVariantMap Metrics::Histogram::toVariantMap(void) const
+{
+  QVariantMap map;
+  map["count"] = count();
+  map["min"] = minimum();
+  map["max"] = maximum();
+  map["mean"] = mean();
+  map["p50"] = percentile(50);
+  map["p90"] = percentile(90);
+  map["p99"] = percentile(99);
+  map["p99.9"] = percentile(99.9);
+  return map;
+}
+
+
+void Metrics::Histogram::reset(void)
+{
+  for (int i = 0; i < BucketCount; ++i)
+    mBuckets[i].store(0);
+  mCount.store(0);
+  mSum.store(0);
+  mMin.store(NoMin);
+  mMax.store(0);
+}
+
+
+Metrics::Timer::Timer(Histogram &histogram)
+  : mHistogram(histogram)
+  , mStart(Metrics::instance().now())
+{
+  /* ... */
+}
+
+
+Metrics::Timer::~Timer()
+{
+  mHistogram.record(Metrics::instance().now() - mStart);
+}
+
+
+// Metrics are never deleted, so references handed out stay valid
+// for the lifetime of the process.
+class MetricsPrivate {
+public:
+  MetricsPrivate(void)
+  {
+    clock.start();
+  }
+  ~MetricsPrivate()
+  {
+    qDeleteAll(counters);
+    qDeleteAll(gauges);
+    qDeleteAll(histograms);
+  }
+  QElapsedTimer clock;
+  mutable QMutex mutex;
+  QMap<QString, Metrics::Counter*> counters;
+  QMap<QString, Metrics::Gauge*> gauges;
+  QMap<QString, Metrics::Histogram*> histograms;
+};
+
+
+/*!
+ * \brief Metrics::Metrics
+ *
+ * Process wide registry of counters, gauges and latency histograms. Metrics
+ * are always on: updating one only touches atomics, so they can stay in
+ * the hot paths of key derivation, encryption and sync.
+ *
+ * Names are dotted paths like "sync.read.roundtrip_us"; durations are
+ * recorded in microseconds and carry a `_us` suffix. Counter pairs named
+ * "<name>.hits" and "<name>.misses" are reported as a hit rate, too.
+ */
+Metrics::Metrics(void)
+  : d_ptr(new MetricsPrivate)
+{
+  /* ... */
+}
+
+
+Metrics::~Metrics()
+{
+  /* ... */
+}
+
+
+Metrics &Metrics::instance(void)
+{
+  static Metrics metrics;
+  return metrics;
+}
+
+
+Metrics::Counter &Metrics::counter(const QString &name)
+{
+  Q_D(Metrics);
+  QMutexLocker locker(&d->mutex);
+  Counter *c = d->counters.value(name, Q_NULLPTR);
+  if (c == Q_NULLPTR) {
+    c = new Counter;
+    d->counters.insert(name, c);
+  }
+  return *c;
+}
+
+
+Metrics::Gauge &Metrics::gauge(const QString &name)
+{
+  Q_D(Metrics);
+  QMutexLocker locker(&d->mutex);
+  Gauge *g = d->gauges.value(name, Q_NULLPTR);
+  if (g == Q_NULLPTR) {
+    g = new Gauge;
+    d->gauges.insert(name, g);
+  }
+  return *g;
+}
+
+
+Metrics::Histogram &Metrics::histogram(const QString &name)
+{
+  Q_D(Metrics);
+  QMutexLocker locker(&d->mutex);
+  Histogram *h = d->histograms.value(name, Q_NULLPTR);
+  if (h == Q_NULLPTR) {
+    h = new Histogram;
+    d->histograms.insert(name, h);
+  }
+  return *h;
+}
+
+
+/*!
+ * \brief Metrics::now
+ *
+ * \return microseconds since the registry was created
+ */
+qint64 Metrics::now(void) const
+{
+  Q_D(const Metrics);
+  return d->clock.nsecsElapsed() / 1000;
+}
+
+
+void Metrics::reset(void)
+{
+  Q_D(Metrics);
+  QMutexLocker locker(&d->mutex);
+  foreach (Counter *c, d->counters)
+    c->reset();
+  foreach (Gauge *g, d->gauges)
+    g->reset();
+  foreach (Histogram *h, d->histograms)
+    h->reset();
+}
+
+
+QVariantMap Metrics::toVariantMap(void) const
+{
+  Q_D(const Metrics);
+  QMutexLocker locker(&d->mutex);
+  QVariantMap counters;
+  QVariantMap rates;
+  for (QMap<QString, Counter*>::const_iterator c = d->counters.constBegin(); c != d->counters.constEnd(); ++c) {
+    counters[c.key()] = c.value()->value();
+    if (c.key().endsWith(".hits")) {
+      const QString &name = c.key().left(c.key().size() - 5);
+      const Counter *misses = d->counters.value(name + ".misses", Q_NULLPTR);
+      const qint64 hits = c.value()->value();
+      const qint64 total = hits + (misses != Q_NULLPTR ? misses->value() : 0);
+      rates[name + ".hit_rate"] = total > 0 ? double(hits) / total : 0.0;
+    }
+  }
+  QVariantMap gauges;
+  for (QMap<QString, Gauge*>::const_iterator g = d->gauges.constBegin(); g != d->gauges.constEnd(); ++g)
+    gauges[g.key()] = g.value()->value();
+  QVariantMap histograms;
+  for (QMap<QString, Histogram*>::const_iterator h = d->histograms.constBegin(); h != d->histograms.constEnd(); ++h)
+    histograms[h.key()] = h.value()->toVariantMap();
+  QVariantMap map;
+  map["timestamp"] = QDateTime::currentDateTime().toString(Qt::ISODate);
+  map["uptime_us"] = now();
+  map["counters"] = counters;
+  map["rates"] = rates;
+  map["gauges"] = gauges;
+  map["histograms"] = histograms;
+  return map;
+}
+
+
+QByteArray Metrics::toJson(void) const
+{
+  return QJsonDocument(QJsonObject::fromVariantMap(toVariantMap())).toJson(QJsonDocument::Indented);
+}
+
+
+QString Metrics::toText(void) const
+{
+  const QVariantMap &map = toVariantMap();
+  QString text;
+  QTextStream out(&text);
+  out << "Metrics as of " << map["timestamp"].toString() << "\n";
+  const QVariantMap &counters = map["counters"].toMap();
+  if (!counters.isEmpty()) {
+    out << "\nCounters\n";
+    for (QVariantMap::const_iterator c = counters.constBegin(); c != counters.constEnd(); ++c)
+      out << "  " << c.key().leftJustified(40, ' ') << " " << c.value().toLongLong() << "\n";
+  }
+  const QVariantMap &rates = map["rates"].toMap();
+  if (!rates.isEmpty()) {
+    out << "\nRates\n";
+    for (QVariantMap::const_iterator r = rates.constBegin(); r != rates.constEnd(); ++r)
+      out << "  " << r.key().leftJustified(40, ' ') << " " << QString::number(100 * r.value().toDouble(), 'f', 1) << "%\n";
+  }
+  const QVariantMap &gauges = map["gauges"].toMap();
+  if (!gauges.isEmpty()) {
+    out << "\nGauges\n";
+    for (QVariantMap::const_iterator g = gauges.constBegin(); g != gauges.constEnd(); ++g)
+      out << "  " << g.key().leftJustified(40, ' ') << " " << g.value().toLongLong() << "\n";
+  }
+  const QVariantMap &histograms = map["histograms"].toMap();
+  if (!histograms.isEmpty()) {
+    out << "\nHistograms" << "\n  " << QString().leftJustified(40, ' ')
+        << QString(" %1 %2 %3 %4 %5 %6")
+           .arg("count", 8).arg("mean", 10).arg("p50", 10).arg("p90", 10).arg("p99", 10).arg("max", 10) << "\n";
+    for (QVariantMap::const_iterator h = histograms.constBegin(); h != histograms.constEnd(); ++h) {
+      const QVariantMap &s = h.value().toMap();
+      out << "  " << h.key().leftJustified(40, ' ')
+          << QString(" %1 %2 %3 %4 %5 %6")
+             .arg(s["count"].toLongLong(), 8)
+             .arg(s["mean"].toDouble(), 10, 'f', 1)
+             .arg(s["p50"].toLongLong(), 10)
+             .arg(s["p90"].toLongLong(), 10)
+             .arg(s["p99"].toLongLong(), 10)
+             .arg(s["max"].toLongLong(), 10)
+          << "\n";
+    }
+  }
+  out.flush();
+  return text;
+}
+
+
+/*!
+ * \brief Metrics::dump
+ *
+ * Writes the current state of all metrics to `filename`, as JSON
+ * if the file name ends with ".json", as plain text otherwise.
+ */
+bool Metrics::dump(const QString &filename) const
+{
+  const bool json = QFileInfo(filename).suffix().toLower() == "json";
+  QSaveFile f(filename);
+  if (!f.open(QIODevice::WriteOnly))
+    return false;
+  f.write(json ? toJson() : toText().toUtf8());
+  return f.commit();
+}
@@ -0,0 +1,132 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef __METRICS_H_
+#define __METRICS_H_
+
+#include <QtGlobal>
+#include <QString>
+#include <QByteArray>
+#include <QVariantMap>
+#include <QAtomicInteger>
+#include <QScopedPointer>
+
+
+class MetricsPrivate;
+
+class Metrics
+{
+public:
+  class Counter {
+  public:
+    Counter(void);
+    void add(qint64 delta = 1);
+    qint64 value(void) const;
+    void reset(void);
+  private:
+    QAtomicInteger<qint64> mValue;
+    Q_DISABLE_COPY(Counter)
+  };
+
+  class Gauge {
+  public:
+    Gauge(void);
+    void set(qint64 value);
+    qint64 value(void) const;
+    void reset(void);
+  private:
+    QAtomicInteger<qint64> mValue;
+    Q_DISABLE_COPY(Gauge)
+  };
+
+  class Histogram {
+  public:
+    Histogram(void);
+    ~Histogram();
+    void record(qint64 value);
+    qint64 count(void) const;
+    qint64 minimum(void) const;
+    qint64 maximum(void) const;
+    double mean(void) const;
+    qint64 percentile(double p) const;
+    QVariantMap toVariantMap(void) const;
+    void reset(void);
+
+    static int bucketIndex(qint64 value);
+    static qint64 bucketLowerBound(int idx);
+    static qint64 bucketUpperBound(int idx);
+
+    static const int SubBucketBits;
+    static const int BucketCount;
+
+  private:
+    QAtomicInteger<qint64> mCount;
+    QAtomicInteger<qint64> mSum;
+    QAtomicInteger<qint64> mMin;
+    QAtomicInteger<qint64> mMax;
+    QAtomicInteger<qint64> *mBuckets;
+    Q_DISABLE_COPY(Histogram)
+  };
+
+  class Timer {
+  public:
+    explicit Timer(Histogram &histogram);
+    ~Timer();
+  private:
+    Histogram &mHistogram;
+    qint64 mStart;
+    Q_DISABLE_COPY(Timer)
+  };
+
+  static Metrics &instance(void);
+  Counter &counter(const QString &name);
+  Gauge &gauge(const QString &name);
+  Histogram &histogram(const QString &name);
+  qint64 now(void) const;
+  void reset(void);
+  QVariantMap toVariantMap(void) const;
+  QByteArray toJson(void) const;
+  QString toText(void) const;
+  bool dump(const QString &filename) const;
+
+  Metrics(const Metrics &) = delete;
+  void operator=(Metrics const &) = delete;
+
+private:
+  Metrics(void);
+  ~Metrics();
+
+  QScopedPointer<MetricsPrivate> d_ptr;
+  Q_DECLARE_PRIVATE(Metrics)
+};
+
+
+#define _METRIC_CONCAT2(a, b) a##b
+#define _METRIC_CONCAT(a, b) _METRIC_CONCAT2(a, b)
+
+// Looking up a metric by name takes a lock, so call sites resolve it once
+// into a function-local static and only touch atomics afterwards.
+#define METRIC_COUNTER(name) ([]() -> Metrics::Counter & { static Metrics::Counter &m = Metrics::instance().counter(name); return m; }())
+#define METRIC_GAUGE(name) ([]() -> Metrics::Gauge & { static Metrics::Gauge &m = Metrics::instance().gauge(name); return m; }())
+#define METRIC_HISTOGRAM(name) ([]() -> Metrics::Histogram & { static Metrics::Histogram &m = Metrics::instance().histogram(name); return m; }())
+#define METRIC_TIMER(name) Metrics::Timer _METRIC_CONCAT(_metricTimer, __LINE__)(METRIC_HISTOGRAM(name))
+#define METRIC_NOW() Metrics::instance().now()
+
+#endif // __METRICS_H_
@@ -28,6 +28,8 @@
 #include "password.h"
 #include "pbkdf2.h"
 #include "util.h"
+#include "tracer.h"
+#include "metrics.h"
 
 #include "3rdparty/bigint/bigInt.h"
 
@@ -187,6 +189,7 @@ void Password::setDomainSettings(const DomainSettings &ds)
 SecureString Password::remix(void)
 {
   Q_D(Password);
+  TRACE_SPAN("password", "Password::remix");
   d->password.clear();
   if (d->ds.usedCharacters.isEmpty()) {
     d->error = EmptyCharacterSetError;
@@ -238,6 +241,7 @@ SecureString Password::remix(void)
 void Password::generate(const SecureByteArray &key)
 {
   Q_D(Password);
+  const qint64 t0 = METRIC_NOW();
   const SecureByteArray &pwd =
       d->ds.domainName.toUtf8() +
       d->ds.userName.toUtf8() +
@@ -247,6 +251,9 @@ void Password::generate(const SecureByteArray &key)
                      d->ds.iterations,
                      QCryptographicHash::Sha512);
   remix();
+  if (!d->pbkdf2.isAborted()) {
+    METRIC_HISTOGRAM("password.generate_us").record(METRIC_NOW() - t0);
+  }
   emit generated();
 }
 
@@ -21,6 +21,8 @@
 
 #include "pbkdf2.h"
 #include "util.h"
+#include "tracer.h"
+#include "metrics.h"
 
 #include <QElapsedTimer>
 #include <QMessageAuthenticationCode>
@@ -77,6 +79,7 @@ auto xorbuf = [](QByteArray &dst, const QByteArray &src) {
 void PBKDF2::generate(const SecureByteArray &pwd, const QByteArray &salt, int iterations, QCryptographicHash::Algorithm algorithm)
 {
   Q_D(PBKDF2);
+  TRACE_SPAN("crypto", "PBKDF2::generate");
 
   d->abortMutex.lock();
   d->abort = false;
@@ -108,7 +111,15 @@ void PBKDF2::generate(const SecureByteArray &pwd, const QByteArray &salt, int it
   }
 
   d->hexKey = d->derivedKey.toHex();
-  d->elapsed = 1e-9 * elapsedTimer.nsecsElapsed();
+  const qint64 nsecs = elapsedTimer.nsecsElapsed();
+  d->elapsed = 1e-9 * nsecs;
+  if (isAborted())
+    return;
+  METRIC_COUNTER("kdf.iterations").add(iterations);
+  METRIC_HISTOGRAM("kdf.latency_us").record(nsecs / 1000);
+  if (nsecs > 0) {
+    METRIC_GAUGE("kdf.iterations_per_sec").set(qint64(1e9 * iterations / nsecs));
+  }
 }
 
 
@@ -0,0 +1,1183 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+#include <QObject>
+#include <QVector>
+#include <QHash>
+#include <QMap>
+#include <QPair>
+#include <QDate>
+
+#include <cmath>
+
+#include "strengthestimator.h"
+#include "crypter.h"
+#include "util.h"
+
+
+// Roughly what a well equipped attacker achieves with a rack of GPUs
+// on PBKDF2-HMAC iterations per second.
+const double StrengthEstimator::DefaultAttackerHashRate = 1e10;
+
+static const int MaxActiveDictionaryStates = 512;
+static const int MaxSequenceDelta = 5;
+static const int MinYearSpace = 20;
+static const int DateMinYear = 1000;
+static const int DateMaxYear = 2050;
+static const double LogSubmatchSingleChar = 1.0;       // log10(10)
+static const double LogSubmatchMultiChar = 1.69897;    // log10(50)
+static const double LogBruteforceSingleChar = 1.04139; // log10(11)
+static const double LogBruteforceMultiChar = 1.70757;  // log10(51)
+static const double LogAdditiveMatchPenalty = 4.0;     // log10(10000)
+
+
+namespace {
+
+// The dictionaries are deliberately small: the most common passwords and
+// words an attacker would try first. Each list is ranked by frequency.
+const char *const CommonPasswords[] = {
+  "123456", "password", "12345678", "qwerty", "123456789", "12345", "1234", "111111",
+  "1234567", "dragon", "123123", "baseball", "abc123", "football", "monkey", "letmein",
+  "696969", "shadow", "master", "666666", "qwertyuiop", "123321", "mustang", "1234567890",
+  "michael", "654321", "superman", "1qaz2wsx", "7777777", "121212", "000000", "qazwsx",
+  "123qwe", "killer", "trustno1", "jordan", "jennifer", "zxcvbnm", "asdfgh", "hunter",
+  "buster", "soccer", "harley", "batman", "andrew", "tigger", "sunshine", "iloveyou",
+  "2000", "charlie", "robert", "thomas", "hockey", "ranger", "daniel", "starwars",
+  "klaster", "112233", "george", "computer", "michelle", "jessica", "pepper", "1111",
+  "zxcvbn", "555555", "11111111", "131313", "freedom", "777777", "pass", "maggie",
+  "159753", "aaaaaa", "ginger", "princess", "joshua", "cheese", "amanda", "summer",
+  "love", "ashley", "nicole", "chelsea", "biteme", "matthew", "access", "yankees",
+  "987654321", "dallas", "austin", "thunder", "taylor", "matrix", "admin", "welcome",
+  "login", "secret", "passw0rd", "p@ssw0rd", "qwertz", "hallo", "hallo123", "passwort",
+  "schatz", "geheim", "schalke04", "fussball", "lol123", "asdf", "asdfghjkl", "qwert",
+  "mypass", "test", "test123", "guest", "root", "changeme", "default", "oracle",
+  "baby", "angel", "flower", "hello", "whatever", "pokemon", "cookie", "sesam",
+  "naruto", "lovely", "nothing", "silver", "orange", "purple", "hannah", "ferrari",
+  Q_NULLPTR
+};
+
+const char *const EnglishWords[] = {
+  "you", "the", "that", "this", "what", "have", "know", "just", "with", "your",
+  "there", "here", "like", "right", "they", "will", "think", "about", "come", "really",
+  "good", "time", "would", "want", "could", "going", "people", "never", "because", "something",
+  "little", "other", "should", "first", "thing", "great", "where", "world", "house", "night",
+  "money", "always", "life", "name", "love", "man", "woman", "girl", "boy", "baby",
+  "family", "friend", "father", "mother", "brother", "sister", "home", "heart", "dream", "light",
+  "water", "fire", "earth", "wind", "star", "moon", "sun", "sky", "blue", "red",
+  "green", "black", "white", "dark", "gold", "silver", "king", "queen", "prince", "power",
+  "magic", "dragon", "tiger", "lion", "eagle", "wolf", "bear", "horse", "dog", "cat",
+  "fish", "bird", "music", "game", "play", "happy", "sweet", "secret", "hello", "welcome",
+  "computer", "internet", "system", "server", "security", "private", "access", "master", "super", "hunter",
+  "winter", "summer", "spring", "autumn", "monday", "friday", "sunday", "january", "december", "christmas",
+  "correct", "staple", "battery", "paper", "chocolate", "coffee", "apple", "banana", "cherry", "orange",
+  "football", "soccer", "hockey", "baseball", "basketball", "golf", "tennis", "racing", "rock", "metal",
+  "angel", "devil", "heaven", "hell", "death", "ghost", "shadow", "storm", "thunder", "rain",
+  Q_NULLPTR
+};
+
+const char *const GermanWords[] = {
+  "ich", "und", "nicht", "das", "sie", "ist", "der", "die", "mit", "ein",
+  "haben", "sein", "auch", "noch", "schon", "mein", "dein", "liebe", "hallo", "schatz",
+  "sonne", "mond", "stern", "himmel", "herz", "blume", "rose", "katze", "hund", "maus",
+  "vogel", "pferd", "tiger", "loewe", "baer", "wolf", "drache", "engel", "teufel", "geheim",
+  "passwort", "kennwort", "schluessel", "sicher", "computer", "fussball", "bayern", "schalke", "borussia", "dortmund",
+  "berlin", "hamburg", "muenchen", "koeln", "hannover", "frankfurt", "deutschland", "sommer", "winter", "fruehling",
+  "herbst", "montag", "freitag", "sonntag", "januar", "dezember", "weihnachten", "ostern", "familie", "freund",
+  "freundin", "mama", "papa", "oma", "opa", "bruder", "schwester", "kind", "baby", "leben",
+  "wasser", "feuer", "erde", "luft", "musik", "spiel", "schule", "arbeit", "geld", "auto",
+  "haus", "garten", "kaffee", "schokolade", "apfel", "banane", "kirsche", "mausi", "hase", "schnecke",
+  Q_NULLPTR
+};
+
+const char *const Names[] = {
+  "michael", "thomas", "andreas", "stefan", "christian", "peter", "daniel", "markus", "alexander", "martin",
+  "john", "david", "james", "robert", "william", "richard", "joseph", "charles", "chris", "paul",
+  "mark", "steven", "kevin", "brian", "jason", "matthew", "tobias", "jan", "lukas", "jonas",
+  "maria", "anna", "julia", "laura", "sarah", "lisa", "lena", "sabine", "claudia", "andrea",
+  "mary", "patricia", "linda", "barbara", "elizabeth", "jennifer", "susan", "jessica", "nicole", "emma",
+  "oliver", "smith", "johnson", "williams", "brown", "jones", "miller", "davis", "mueller", "schmidt",
+  "schneider", "fischer", "weber", "meyer", "wagner", "becker", "schulz", "hoffmann", "koch", "richter",
+  Q_NULLPTR
+};
+
+const char *const QwertyLayout =
+    "`~ 1! 2@ 3# 4$ 5% 6^ 7& 8* 9( 0) -_ =+\n"
+    "    qQ wW eE rR tT yY uU iI oO pP [{ ]} \\|\n"
+    "     aA sS dD fF gG hH jJ kK lL ;: '\"\n"
+    "      zZ xX cC vV bB nN mM ,< .> /?";
+
+const char *const QwertzLayout =
+    "^\xc2\xb0 1! 2\" 3\xc2\xa7 4$ 5% 6& 7/ 8( 9) 0= \xc3\x9f? \xc2\xb4`\n"
+    "    qQ wW eE rR tT zZ uU iI oO pP \xc3\xbc\xc3\x9c +*\n"
+    "     aA sS dD fF gG hH jJ kK lL \xc3\xb6\xc3\x96 \xc3\xa4\xc3\x84 #'\n"
+    "      yY xX cC vV bB nN mM ,; .: -_";
+
+const char *const KeypadLayout =
+    "  / * -\n"
+    "7 8 9 +\n"
+    "4 5 6\n"
+    "1 2 3\n"
+    "  0 .";
+
+struct L33tSubstitution {
+  char sub;
+  char letter;
+};
+
+const L33tSubstitution L33tTable[] = {
+  { '4', 'a' }, { '@', 'a' }, { '8', 'b' }, { '(', 'c' }, { '{', 'c' }, { '[', 'c' },
+  { '<', 'c' }, { '3', 'e' }, { '6', 'g' }, { '9', 'g' }, { '1', 'i' }, { '!', 'i' },
+  { '|', 'i' }, { '1', 'l' }, { '|', 'l' }, { '7', 'l' }, { '0', 'o' }, { '$', 's' },
+  { '5', 's' }, { '+', 't' }, { '7', 't' }, { '%', 'x' }, { '2', 'z' }, { 0, 0 }
+};
+
+
+double log10Add(double a, double b)
+{
+  const double hi = qMax(a, b);
+  const double lo = qMin(a, b);
+  return hi + std::log10(1.0 + std::pow(10.0, lo - hi));
+}
+
+
+double logFactorial(int n)
+{
+  double f = 0;
+  for (int i = 2; i <= n; ++i) {
+    f += std::log10(double(i));
+  }
+  return f;
+}
+
+
+double binomial(int n, int k)
+{
+  if (k > n)
+    return 0;
+  if (k == 0)
+    return 1;
+  double r = 1;
+  for (int d = 1; d <= k; ++d) {
+    r *= n--;
+    r /= d;
+  }
+  return r;
+}
+
+
+// Number of ways to place `a` characters of one kind among `a + b`,
+// counting at least one and at most half of them: the case or l33t
+// variations an attacker has to try on top of the plain word.
+double variations(int a, int b)
+{
+  if (a == 0 || b == 0)
+    return 2;
+  double v = 0;
+  for (int i = 1; i <= qMin(a, b); ++i) {
+    v += binomial(a + b, i);
+  }
+  return v;
+}
+
+
+class Trie {
+public:
+  struct Node {
+    Node(void)
+      : rank(0)
+    { /* ... */ }
+    QVector<QPair<ushort, int> > children;
+    int rank;
+    QString word;
+  };
+
+  Trie(void)
+    : mNodes(1)
+  { /* ... */ }
+
+  void insert(const QString &key, const QString &word, int rank)
+  {
+    int node = 0;
+    for (int i = 0; i < key.size(); ++i) {
+      const ushort c = key.at(i).unicode();
+      int next = child(node, c);
+      if (next < 0) {
+        next = mNodes.size();
+        mNodes[node].children.append(qMakePair(c, next));
+        mNodes.append(Node());
+      }
+      node = next;
+    }
+    Node &n = mNodes[node];
+    if (n.rank == 0 || rank < n.rank) {
+      n.rank = rank;
+      n.word = word;
+    }
+  }
+
+  int child(int node, ushort c) const
+  {
+    const QVector<QPair<ushort, int> > &children = mNodes.at(node).children;
+    for (int i = 0; i < children.size(); ++i) {
+      if (children.at(i).first == c)
+        return children.at(i).second;
+    }
+    return -1;
+  }
+
+  const Node &node(int i) const
+  {
+    return mNodes.at(i);
+  }
+
+private:
+  QVector<Node> mNodes;
+};
+
+
+class KeyboardGraph {
+public:
+  KeyboardGraph(const QString &name, const QString &layout, bool slanted)
+    : mName(name)
+    , mStartingPositions(0)
+    , mAverageDegree(0)
+  {
+    QHash<QPair<int, int>, QString> positions;
+    const QStringList &lines = layout.split(QChar('\n'));
+    int tokenSize = 0;
+    for (int y = 0; y < lines.size(); ++y) {
+      const QString &line = lines.at(y);
+      const int slant = slanted ? y : 0;
+      int i = 0;
+      while (i < line.size()) {
+        if (line.at(i) == QChar(' ')) {
+          ++i;
+          continue;
+        }
+        int j = i;
+        while (j < line.size() && line.at(j) != QChar(' '))
+          ++j;
+        if (tokenSize == 0)
+          tokenSize = j - i;
+        positions.insert(qMakePair((i - slant) / (tokenSize + 1), y), line.mid(i, j - i));
+        i = j;
+      }
+    }
+    int degrees = 0;
+    for (QHash<QPair<int, int>, QString>::const_iterator p = positions.constBegin(); p != positions.constEnd(); ++p) {
+      const int x = p.key().first;
+      const int y = p.key().second;
+      QVector<QPair<int, int> > coords;
+      if (slanted) {
+        coords << qMakePair(x - 1, y) << qMakePair(x, y - 1) << qMakePair(x + 1, y - 1)
+               << qMakePair(x + 1, y) << qMakePair(x, y + 1) << qMakePair(x - 1, y + 1);
+      }
+      else {
+        coords << qMakePair(x - 1, y) << qMakePair(x - 1, y - 1) << qMakePair(x, y - 1) << qMakePair(x + 1, y - 1)
+               << qMakePair(x + 1, y) << qMakePair(x + 1, y + 1) << qMakePair(x, y + 1) << qMakePair(x - 1, y + 1);
+      }
+      QVector<QString> neighbours;
+      for (int c = 0; c < coords.size(); ++c) {
+        neighbours.append(positions.value(coords.at(c)));
+      }
+      const QString &keys = p.value();
+      for (int k = 0; k < keys.size(); ++k) {
+        mAdjacency.insert(keys.at(k).unicode(), neighbours);
+        if (k > 0)
+          mShifted.insert(keys.at(k).unicode(), true);
+        degrees += neighbours.size() - neighbours.count(QString());
+      }
+    }
+    mStartingPositions = mAdjacency.size();
+    mAverageDegree = double(degrees) / mStartingPositions;
+  }
+
+  // Returns the direction in which `to` lies as seen from `from`,
+  // or -1 if the keys aren't adjacent.
+  int direction(QChar from, QChar to, bool *shifted) const
+  {
+    const QVector<QString> &neighbours = mAdjacency.value(from.unicode());
+    for (int d = 0; d < neighbours.size(); ++d) {
+      const int k = neighbours.at(d).indexOf(to);
+      if (k >= 0) {
+        *shifted = k > 0;
+        return d;
+      }
+    }
+    return -1;
+  }
+
+  bool isShifted(QChar c) const
+  {
+    return mShifted.contains(c.unicode());
+  }
+
+  const QString &name(void) const
+  {
+    return mName;
+  }
+
+  double guessesLog10(int length, int turns, int shifted) const
+  {
+    double guesses = 0;
+    for (int i = 2; i <= length; ++i) {
+      for (int j = 1; j <= qMin(turns, i - 1); ++j) {
+        guesses += binomial(i - 1, j - 1) * mStartingPositions * std::pow(mAverageDegree, j);
+      }
+    }
+    double g = std::log10(qMax(1.0, guesses));
+    if (shifted > 0)
+      g += std::log10(variations(shifted, length - shifted));
+    return g;
+  }
+
+private:
+  QString mName;
+  QHash<ushort, QVector<QString> > mAdjacency;
+  QHash<ushort, bool> mShifted;
+  double mStartingPositions;
+  double mAverageDegree;
+};
+
+
+struct Context {
+  Context(void)
+    : referenceYear(QDate::currentDate().year())
+  {
+    graphs << KeyboardGraph("qwerty", QString::fromUtf8(QwertyLayout), true)
+           << KeyboardGraph("qwertz", QString::fromUtf8(QwertzLayout), true)
+           << KeyboardGraph("keypad", QString::fromUtf8(KeypadLayout), false);
+    addWords(CommonPasswords);
+    addWords(EnglishWords);
+    addWords(GermanWords);
+    addWords(Names);
+  }
+  void addWords(const char *const *words)
+  {
+    for (int rank = 1; *words != Q_NULLPTR; ++words, ++rank) {
+      addWord(QString::fromUtf8(*words), rank);
+    }
+  }
+  void addWord(const QString &word, int rank)
+  {
+    const QString &w = word.toLower();
+    if (w.isEmpty())
+      return;
+    QString reversed;
+    for (int i = w.size() - 1; i >= 0; --i) {
+      reversed.append(w.at(i));
+    }
+    forward.insert(w, w, rank);
+    if (reversed != w)
+      backward.insert(reversed, w, rank);
+  }
+  Trie forward;
+  Trie backward;
+  QList<KeyboardGraph> graphs;
+  int referenceYear;
+};
+
+
+// Guesses for the bases of repeats, which are parts of the password. The
+// cache is bounded and the bases are wiped before they are dropped.
+struct RepeatBaseCache {
+  static const int MaxEntries = 256;
+  struct Entry {
+    QString base;
+    double guessesLog10;
+  };
+  bool lookup(const QString &base, double &g) const
+  {
+    QHash<uint, Entry>::const_iterator e = entries.constFind(qHash(base));
+    if (e == entries.constEnd() || e->base != base)
+      return false;
+    g = e->guessesLog10;
+    return true;
+  }
+  void insert(const QString &base, double g)
+  {
+    if (entries.size() >= MaxEntries)
+      wipe();
+    Entry &e = entries[qHash(base)];
+    SecureErase(e.base);
+    e.base = base;
+    e.guessesLog10 = g;
+  }
+  void wipe(void)
+  {
+    for (QHash<uint, Entry>::iterator e = entries.begin(); e != entries.end(); ++e)
+      SecureErase(e->base);
+    entries.clear();
+  }
+  QHash<uint, Entry> entries;
+};
+
+
+struct DictionaryState {
+  int trie;
+  int node;
+  int start;
+};
+
+
+struct SpatialState {
+  SpatialState(void)
+    : direction(-1)
+    , runStart(0)
+    , turns(0)
+    , shifted(0)
+  { /* ... */ }
+  int direction;
+  int runStart;
+  int turns;
+  int shifted;
+};
+
+
+struct Optimum {
+  StrengthEstimator::Match match;
+  double logPi;
+  double logG;
+};
+
+
+struct Position {
+  Position(void)
+    : seqStart(0)
+    , seqDelta(0)
+    , digitRun(0)
+  { /* ... */ }
+  QVector<DictionaryState> dictionary;
+  QVector<SpatialState> spatial;
+  QVector<int> repeat;
+  int seqStart;
+  int seqDelta;
+  int digitRun;
+  QMap<int, Optimum> optimal;
+};
+
+
+// Evaluates a password one character at a time. Everything computed for
+// a character only depends on the characters before it, so editing the
+// end of a password only costs the work for the characters that changed.
+class Engine {
+public:
+  Engine(const Context *ctx, RepeatBaseCache *cache)
+    : ctx(ctx)
+    , cache(cache)
+  { /* ... */ }
+
+  void setPassword(const QString &pwd)
+  {
+    int common = 0;
+    while (common < pwd.size() && common < password.size() && pwd.at(common) == password.at(common))
+      ++common;
+    truncate(common);
+    append(pwd.mid(common));
+  }
+
+  void append(const QString &s)
+  {
+    for (int i = 0; i < s.size(); ++i) {
+      password.append(s.at(i));
+      positions.append(Position());
+      advance(password.size() - 1);
+    }
+  }
+
+  void truncate(int n)
+  {
+    password.truncate(n);
+    positions.resize(n);
+  }
+
+  // Overwrites the password and the matches found in it.
+  void wipe(void)
+  {
+    for (QVector<Position>::iterator p = positions.begin(); p != positions.end(); ++p) {
+      for (QMap<int, Optimum>::iterator o = p->optimal.begin(); o != p->optimal.end(); ++o) {
+        SecureErase(o->match.token);
+        SecureErase(o->match.detail);
+      }
+    }
+    SecureErase(password);
+    positions.clear();
+  }
+
+  double guessesLog10(void) const
+  {
+    if (positions.isEmpty())
+      return 0;
+    double best = -1;
+    foreach (const Optimum &o, positions.last().optimal) {
+      if (best < 0 || o.logG < best)
+        best = o.logG;
+    }
+    return best;
+  }
+
+  QList<StrengthEstimator::Match> sequence(void) const
+  {
+    QList<StrengthEstimator::Match> result;
+    if (positions.isEmpty())
+      return result;
+    const QMap<int, Optimum> &last = positions.last().optimal;
+    int l = 0;
+    double best = -1;
+    for (QMap<int, Optimum>::const_iterator o = last.constBegin(); o != last.constEnd(); ++o) {
+      if (best < 0 || o.value().logG < best) {
+        best = o.value().logG;
+        l = o.key();
+      }
+    }
+    int k = positions.size() - 1;
+    while (k >= 0 && l > 0) {
+      const StrengthEstimator::Match &m = positions.at(k).optimal.value(l).match;
+      result.prepend(m);
+      k = m.i - 1;
+      --l;
+    }
+    return result;
+  }
+
+  QString password;
+
+private:
+  void advance(int k)
+  {
+    QList<StrengthEstimator::Match> matches;
+    matchDictionary(k, matches);
+    matchSpatial(k, matches);
+    matchRepeat(k, matches);
+    matchSequence(k, matches);
+    matchDate(k, matches);
+    foreach (StrengthEstimator::Match m, matches) {
+      const double minimum = m.token.size() == 1 ? LogSubmatchSingleChar : LogSubmatchMultiChar;
+      m.guessesLog10 = qMax(m.guessesLog10, minimum);
+      if (m.i > 0) {
+        const QMap<int, Optimum> &prev = positions.at(m.i - 1).optimal;
+        for (QMap<int, Optimum>::const_iterator o = prev.constBegin(); o != prev.constEnd(); ++o) {
+          update(m, o.key() + 1);
+        }
+      }
+      else {
+        update(m, 1);
+      }
+    }
+    updateBruteforce(k);
+  }
+
+  // zxcvbn's search for the most guessable match sequence: the guesses
+  // for a sequence of l matches are l! times the product of the single
+  // guesses plus a penalty for every additional match.
+  void update(const StrengthEstimator::Match &m, int l)
+  {
+    const int k = m.j;
+    double logPi = m.guessesLog10;
+    if (l > 1)
+      logPi += positions.at(m.i - 1).optimal.value(l - 1).logPi;
+    const double logG = log10Add(logFactorial(l) + logPi, LogAdditiveMatchPenalty * (l - 1));
+    QMap<int, Optimum> &optimal = positions[k].optimal;
+    for (QMap<int, Optimum>::const_iterator o = optimal.constBegin(); o != optimal.constEnd() && o.key() <= l; ++o) {
+      if (o.value().logG <= logG)
+        return;
+    }
+    Optimum &o = optimal[l];
+    o.match = m;
+    o.logPi = logPi;
+    o.logG = logG;
+  }
+
+  StrengthEstimator::Match bruteforce(int i, int j) const
+  {
+    StrengthEstimator::Match m;
+    m.pattern = StrengthEstimator::Match::Bruteforce;
+    m.i = i;
+    m.j = j;
+    m.token = password.mid(i, j - i + 1);
+    m.guessesLog10 = qMax(double(m.token.size()), m.token.size() == 1 ? LogBruteforceSingleChar : LogBruteforceMultiChar);
+    return m;
+  }
+
+  void updateBruteforce(int k)
+  {
+    update(bruteforce(0, k), 1);
+    for (int i = 1; i <= k; ++i) {
+      const StrengthEstimator::Match &m = bruteforce(i, k);
+      const QMap<int, Optimum> &prev = positions.at(i - 1).optimal;
+      QList<int> lengths;
+      for (QMap<int, Optimum>::const_iterator o = prev.constBegin(); o != prev.constEnd(); ++o) {
+        if (o.value().match.pattern != StrengthEstimator::Match::Bruteforce)
+          lengths << o.key();
+      }
+      foreach (int l, lengths) {
+        update(m, l + 1);
+      }
+    }
+  }
+
+  void matchDictionary(int k, QList<StrengthEstimator::Match> &matches)
+  {
+    const Trie *tries[2] = { &ctx->forward, &ctx->backward };
+    QVector<DictionaryState> candidates;
+    if (k > 0)
+      candidates = positions.at(k - 1).dictionary;
+    for (int t = 0; t < 2; ++t) {
+      DictionaryState root = { t, 0, k };
+      candidates.append(root);
+    }
+    const ushort c = password.at(k).toLower().unicode();
+    QVector<DictionaryState> &active = positions[k].dictionary;
+    foreach (const DictionaryState &s, candidates) {
+      const Trie *trie = tries[s.trie];
+      QVector<ushort> letters;
+      letters << c;
+      for (const L33tSubstitution *l = L33tTable; l->sub != 0; ++l) {
+        if (c == ushort(l->sub))
+          letters << ushort(l->letter);
+      }
+      foreach (ushort letter, letters) {
+        const int next = trie->child(s.node, letter);
+        if (next < 0)
+          continue;
+        if (active.size() < MaxActiveDictionaryStates) {
+          DictionaryState n = { s.trie, next, s.start };
+          active.append(n);
+        }
+        const Trie::Node &node = trie->node(next);
+        if (node.rank > 0)
+          matches << dictionaryMatch(s.start, k, node, s.trie == 1);
+      }
+    }
+  }
+
+  StrengthEstimator::Match dictionaryMatch(int i, int j, const Trie::Node &node, bool reversed) const
+  {
+    StrengthEstimator::Match m;
+    m.pattern = StrengthEstimator::Match::Dictionary;
+    m.i = i;
+    m.j = j;
+    m.token = password.mid(i, j - i + 1);
+    m.detail = node.word;
+    double g = std::log10(double(node.rank));
+    int upper = 0;
+    int lower = 0;
+    foreach (QChar ch, m.token) {
+      if (ch.isUpper())
+        ++upper;
+      else if (ch.isLower())
+        ++lower;
+    }
+    if (upper > 0) {
+      const bool startUpper = upper == 1 && m.token.at(0).isUpper();
+      const bool endUpper = upper == 1 && m.token.at(m.token.size() - 1).isUpper();
+      g += std::log10((startUpper || endUpper || lower == 0) ? 2.0 : variations(upper, lower));
+    }
+    const QString &lowerToken = m.token.toLower();
+    const QString &word = reversed ? reversedString(node.word) : node.word;
+    QHash<QPair<ushort, ushort>, bool> subs;
+    for (int p = 0; p < lowerToken.size(); ++p) {
+      if (lowerToken.at(p) != word.at(p))
+        subs.insert(qMakePair(lowerToken.at(p).unicode(), word.at(p).unicode()), true);
+    }
+    for (QHash<QPair<ushort, ushort>, bool>::const_iterator s = subs.constBegin(); s != subs.constEnd(); ++s) {
+      const int subbed = lowerToken.count(QChar(s.key().first));
+      const int unsubbed = lowerToken.count(QChar(s.key().second));
+      g += std::log10(variations(subbed, unsubbed));
+    }
+    if (reversed)
+      g += std::log10(2.0);
+    m.guessesLog10 = g;
+    return m;
+  }
+
+  static QString reversedString(const QString &s)
+  {
+    QString r;
+    for (int i = s.size() - 1; i >= 0; --i) {
+      r.append(s.at(i));
+    }
+    return r;
+  }
+
+  void matchSpatial(int k, QList<StrengthEstimator::Match> &matches)
+  {
+    QVector<SpatialState> &states = positions[k].spatial;
+    states.resize(ctx->graphs.size());
+    for (int g = 0; g < ctx->graphs.size(); ++g) {
+      const KeyboardGraph &graph = ctx->graphs.at(g);
+      SpatialState &s = states[g];
+      s.runStart = k;
+      if (k == 0)
+        continue;
+      const SpatialState &prev = positions.at(k - 1).spatial.at(g);
+      bool shifted = false;
+      s.direction = graph.direction(password.at(k - 1), password.at(k), &shifted);
+      if (s.direction < 0) {
+        s.turns = prev.turns;
+        s.shifted = prev.shifted;
+        continue;
+      }
+      s.runStart = prev.runStart;
+      s.turns = prev.turns + ((prev.direction >= 0 && prev.direction != s.direction) ? 1 : 0);
+      s.shifted = prev.shifted + (shifted ? 1 : 0);
+      for (int i = s.runStart; i <= k - 2; ++i) {
+        StrengthEstimator::Match m;
+        m.pattern = StrengthEstimator::Match::Spatial;
+        m.i = i;
+        m.j = k;
+        m.token = password.mid(i, k - i + 1);
+        m.detail = graph.name();
+        const int turns = 1 + s.turns - positions.at(i + 1).spatial.at(g).turns;
+        const int shiftedCount = (graph.isShifted(password.at(i)) ? 1 : 0) + s.shifted - positions.at(i).spatial.at(g).shifted;
+        m.guessesLog10 = graph.guessesLog10(m.token.size(), turns, shiftedCount);
+        matches << m;
+      }
+    }
+  }
+
+  void matchRepeat(int k, QList<StrengthEstimator::Match> &matches)
+  {
+    QVector<int> &repeat = positions[k].repeat;
+    repeat.resize(k);
+    for (int p = 1; p <= k; ++p) {
+      const int before = p - 1 < positions.at(k - 1).repeat.size() ? positions.at(k - 1).repeat.at(p - 1) : 0;
+      repeat[p - 1] = password.at(k) == password.at(k - p) ? before + 1 : 0;
+    }
+    for (int l = 2; l <= k + 1; ++l) {
+      for (int p = 1; p <= l / 2; ++p) {
+        if (l % p != 0 || repeat.at(p - 1) < l - p)
+          continue;
+        StrengthEstimator::Match m;
+        m.pattern = StrengthEstimator::Match::Repeat;
+        m.i = k - l + 1;
+        m.j = k;
+        m.token = password.mid(m.i, l);
+        m.detail = m.token.left(p);
+        m.guessesLog10 = baseGuessesLog10(m.detail) + std::log10(double(l / p));
+        matches << m;
+        break;
+      }
+    }
+  }
+
+  double baseGuessesLog10(const QString &base)
+  {
+    double g;
+    if (cache->lookup(base, g))
+      return g;
+    Engine e(ctx, cache);
+    e.append(base);
+    g = e.guessesLog10();
+    e.wipe();
+    cache->insert(base, g);
+    return g;
+  }
+
+  void matchSequence(int k, QList<StrengthEstimator::Match> &matches)
+  {
+    Position &pos = positions[k];
+    pos.seqStart = k;
+    if (k == 0)
+      return;
+    const int delta = int(password.at(k).unicode()) - int(password.at(k - 1).unicode());
+    if (delta == 0 || qAbs(delta) > MaxSequenceDelta)
+      return;
+    const Position &prev = positions.at(k - 1);
+    pos.seqDelta = delta;
+    pos.seqStart = prev.seqDelta == delta ? prev.seqStart : k - 1;
+    for (int i = pos.seqStart; i <= k - 1; ++i) {
+      const int length = k - i + 1;
+      if (length < 3 && qAbs(delta) != 1)
+        continue;
+      StrengthEstimator::Match m;
+      m.pattern = StrengthEstimator::Match::Sequence;
+      m.i = i;
+      m.j = k;
+      m.token = password.mid(i, length);
+      const QChar first = m.token.at(0);
+      double base = 26;
+      if (QString("aAzZ019").contains(first))
+        base = 4;
+      else if (first.isDigit())
+        base = 10;
+      if (delta < 0)
+        base *= 2;
+      m.guessesLog10 = std::log10(base * length);
+      matches << m;
+    }
+  }
+
+  static bool mapToDayMonth(int a, int b, int *day, int *month)
+  {
+    if (a >= 1 && a <= 31 && b >= 1 && b <= 12) {
+      *day = a;
+      *month = b;
+      return true;
+    }
+    if (b >= 1 && b <= 31 && a >= 1 && a <= 12) {
+      *day = b;
+      *month = a;
+      return true;
+    }
+    return false;
+  }
+
+  static int toYear(const int *ints, int *day, int *month)
+  {
+    if (ints[1] > 31 || ints[1] <= 0)
+      return -1;
+    int over12 = 0, over31 = 0, under1 = 0;
+    for (int i = 0; i < 3; ++i) {
+      if ((ints[i] > 99 && ints[i] < DateMinYear) || ints[i] > DateMaxYear)
+        return -1;
+      if (ints[i] > 31)
+        ++over31;
+      if (ints[i] > 12)
+        ++over12;
+      if (ints[i] <= 0)
+        ++under1;
+    }
+    if (over31 >= 2 || over12 == 3 || under1 >= 2)
+      return -1;
+    const int years[2] = { ints[2], ints[0] };
+    const int rest[2][2] = { { ints[0], ints[1] }, { ints[1], ints[2] } };
+    for (int s = 0; s < 2; ++s) {
+      if (years[s] >= DateMinYear && years[s] <= DateMaxYear)
+        return mapToDayMonth(rest[s][0], rest[s][1], day, month) ? years[s] : -1;
+    }
+    for (int s = 0; s < 2; ++s) {
+      if (mapToDayMonth(rest[s][0], rest[s][1], day, month)) {
+        const int y = years[s];
+        return y > 99 ? y : (y > 50 ? 1900 + y : 2000 + y);
+      }
+    }
+    return -1;
+  }
+
+  void matchDate(int k, QList<StrengthEstimator::Match> &matches)
+  {
+    // split points for dates without separators, e.g. 1391 or 13091991
+    static const int Splits[13][3] = {
+      { 4, 1, 2 }, { 4, 2, 3 }, { 5, 1, 3 }, { 5, 2, 3 }, { 6, 1, 2 }, { 6, 2, 4 }, { 6, 4, 5 },
+      { 7, 1, 3 }, { 7, 2, 3 }, { 7, 4, 5 }, { 7, 4, 6 }, { 8, 2, 4 }, { 8, 4, 6 }
+    };
+    Position &pos = positions[k];
+    if (!password.at(k).isDigit())
+      return;
+    pos.digitRun = (k > 0 ? positions.at(k - 1).digitRun : 0) + 1;
+    if (pos.digitRun >= 4) {
+      const int year = password.mid(k - 3, 4).toInt();
+      if (year >= 1900 && year <= 2039)
+        matches << dateMatch(k - 3, k, year, YearOnly);
+    }
+    for (int length = 4; length <= qMin(8, pos.digitRun); ++length) {
+      const QString &token = password.mid(k - length + 1, length);
+      int bestYear = -1;
+      for (int s = 0; s < 13; ++s) {
+        const int *split = Splits[s];
+        if (split[0] != length)
+          continue;
+        const int ints[3] = { token.left(split[1]).toInt(), token.mid(split[1], split[2] - split[1]).toInt(), token.mid(split[2]).toInt() };
+        int day, month;
+        const int year = toYear(ints, &day, &month);
+        if (year >= 0 && (bestYear < 0 || qAbs(year - ctx->referenceYear) < qAbs(bestYear - ctx->referenceYear)))
+          bestYear = year;
+      }
+      if (bestYear >= 0)
+        matches << dateMatch(k - length + 1, k, bestYear, WithoutSeparator);
+    }
+    // dates with separators, e.g. 13.9.1991 or 1991-09-13
+    for (int length = 6; length <= qMin(10, k + 1); ++length) {
+      const QString &token = password.mid(k - length + 1, length);
+      int sep1 = -1, sep2 = -1;
+      for (int p = 0; p < token.size(); ++p) {
+        if (token.at(p).isDigit())
+          continue;
+        if (sep1 < 0)
+          sep1 = p;
+        else if (sep2 < 0)
+          sep2 = p;
+        else
+          sep2 = -2;
+      }
+      if (sep1 < 1 || sep2 < 0 || sep1 > 4 || sep2 - sep1 < 2 || sep2 - sep1 > 3 || token.size() - sep2 - 1 > 4)
+        continue;
+      if (token.at(sep1) != token.at(sep2) || !QString(" /\\_.-").contains(token.at(sep1)))
+        continue;
+      const int ints[3] = { token.left(sep1).toInt(), token.mid(sep1 + 1, sep2 - sep1 - 1).toInt(), token.mid(sep2 + 1).toInt() };
+      int day, month;
+      const int year = toYear(ints, &day, &month);
+      if (year >= 0)
+        matches << dateMatch(k - length + 1, k, year, WithSeparator);
+    }
+  }
+
+  enum DateKind {
+    YearOnly,
+    WithoutSeparator,
+    WithSeparator
+  };
+
+  StrengthEstimator::Match dateMatch(int i, int j, int year, DateKind kind) const
+  {
+    StrengthEstimator::Match m;
+    m.pattern = StrengthEstimator::Match::Date;
+    m.i = i;
+    m.j = j;
+    m.token = password.mid(i, j - i + 1);
+    m.detail = QString::number(year);
+    m.guessesLog10 = std::log10(double(qMax(qAbs(year - ctx->referenceYear), MinYearSpace)));
+    if (kind != YearOnly)
+      m.guessesLog10 += std::log10(365.0);
+    if (kind == WithSeparator)
+      m.guessesLog10 += std::log10(4.0);
+    return m;
+  }
+
+  const Context *ctx;
+  RepeatBaseCache *cache;
+  QVector<Position> positions;
+};
+
+}
+
+
+class StrengthEstimatorPrivate {
+public:
+  StrengthEstimatorPrivate(void)
+    : engine(&ctx, &cache)
+    , kdfIterations(Crypter::DomainIterations)
+    , hashRate(StrengthEstimator::DefaultAttackerHashRate)
+  { /* ... */ }
+  Context ctx;
+  RepeatBaseCache cache;
+  Engine engine;
+  int kdfIterations;
+  double hashRate;
+};
+
+
+/*!
+ * \brief StrengthEstimator::StrengthEstimator
+ *
+ * Estimates how many guesses an attacker needs to find a password, following
+ * the approach of Dropbox's zxcvbn: the password is decomposed into dictionary
+ * words (also reversed and in l33t speak), keyboard walks, repeats, sequences
+ * and dates, and the least guessable decomposition wins.
+ *
+ * The estimator works incrementally, so calling `setPassword()` on every
+ * keystroke only evaluates the characters that changed.
+ */
+StrengthEstimator::StrengthEstimator(void)
+  : d_ptr(new StrengthEstimatorPrivate)
+{
+  /* ... */
+}
+
+
+StrengthEstimator::~StrengthEstimator()
+{
+  /* ... */
+}
+
+
+/*!
+ * \brief StrengthEstimator::addUserInputs
+ *
+ * Adds words an attacker knows about the user, e.g. their name or the
+ * domains in their vault, to the dictionaries.
+ */
+void StrengthEstimator::addUserInputs(const QStringList &inputs)
+{
+  Q_D(StrengthEstimator);
+  int rank = 1;
+  foreach (QString input, inputs) {
+    d->ctx.addWord(input, rank++);
+  }
+  d->cache.wipe();
+  const QString &pwd = d->engine.password;
+  d->engine.truncate(0);
+  d->engine.append(pwd);
+}
+
+
+void StrengthEstimator::setKdfIterations(int iterations)
+{
+  Q_D(StrengthEstimator);
+  d->kdfIterations = qMax(1, iterations);
+}
+
+
+int StrengthEstimator::kdfIterations(void) const
+{
+  Q_D(const StrengthEstimator);
+  return d->kdfIterations;
+}
+
+
+void StrengthEstimator::setAttackerHashRate(double hashesPerSecond)
+{
+  Q_D(StrengthEstimator);
+  d->hashRate = qMax(1.0, hashesPerSecond);
+}
+
+
+double StrengthEstimator::attackerHashRate(void) const
+{
+  Q_D(const StrengthEstimator);
+  return d->hashRate;
+}
+
+
+void StrengthEstimator::setPassword(const QString &password)
+{
+  Q_D(StrengthEstimator);
+  d->engine.setPassword(password);
+}
+
+
+void StrengthEstimator::append(const QString &s)
+{
+  Q_D(StrengthEstimator);
+  d->engine.append(s);
+}
+
+
+void StrengthEstimator::clear(void)
+{
+  Q_D(StrengthEstimator);
+  d->engine.wipe();
+  d->cache.wipe();
+}
+
+
+QString StrengthEstimator::password(void) const
+{
+  Q_D(const StrengthEstimator);
+  return d->engine.password;
+}
+
+
+/*!
+ * \brief StrengthEstimator::guessesLog10
+ *
+ * \return decimal logarithm of the number of guesses needed to find the password
+ */
+double StrengthEstimator::guessesLog10(void) const
+{
+  Q_D(const StrengthEstimator);
+  return d->engine.guessesLog10();
+}
+
+
+/*!
+ * \brief StrengthEstimator::score
+ *
+ * \return 0 (too guessable) to 4 (very unguessable), as in zxcvbn
+ */
+int StrengthEstimator::score(void) const
+{
+  const double g = guessesLog10();
+  if (g < 3)
+    return 0;
+  if (g < 6)
+    return 1;
+  if (g < 8)
+    return 2;
+  if (g < 10)
+    return 3;
+  return 4;
+}
+
+
+/*!
+ * \brief StrengthEstimator::crackTimeLog10Seconds
+ *
+ * Every guess costs the attacker `kdfIterations()` PBKDF2 iterations, of which
+ * they can compute `attackerHashRate()` per second.
+ *
+ * \return decimal logarithm of the seconds needed to crack the password
+ */
+double StrengthEstimator::crackTimeLog10Seconds(void) const
+{
+  Q_D(const StrengthEstimator);
+  return guessesLog10() + std::log10(double(d->kdfIterations)) - std::log10(d->hashRate);
+}
+
+
+QString StrengthEstimator::crackTimeDisplay(void) const
+{
+  return displayTime(crackTimeLog10Seconds());
+}
+
+
+QList<StrengthEstimator::Match> StrengthEstimator::sequence(void) const
+{
+  Q_D(const StrengthEstimator);
+  return d->engine.sequence();
+}
+
+
+/*!
+ * \brief StrengthEstimator::estimateGuessesLog10
+ *
+ * Like `guessesLog10()`, but without user inputs. The dictionaries are loaded
+ * once and shared between calls.
+ */
+double StrengthEstimator::estimateGuessesLog10(const QString &password)
+{
+  static const Context ctx;
+  RepeatBaseCache cache;
+  Engine engine(&ctx, &cache);
+  engine.append(password);
+  const double g = engine.guessesLog10();
+  engine.wipe();
+  cache.wipe();
+  return g;
+}
+
+
+QString StrengthEstimator::displayTime(double log10Seconds)
+{
+  static const double Minute = 60;
+  static const double Hour = 60 * Minute;
+  static const double Day = 24 * Hour;
+  static const double Month = 31 * Day;
+  static const double Year = 12 * Month;
+  static const double Century = 100 * Year;
+  if (log10Seconds >= std::log10(Century))
+    return QObject::tr("centuries");
+  const double seconds = std::pow(10.0, log10Seconds);
+  if (seconds < 1)
+    return QObject::tr("less than a second");
+  if (seconds < Minute)
+    return QObject::tr("%n second(s)", "", qRound(seconds));
+  if (seconds < Hour)
+    return QObject::tr("%n minute(s)", "", qRound(seconds / Minute));
+  if (seconds < Day)
+    return QObject::tr("%n hour(s)", "", qRound(seconds / Hour));
+  if (seconds < Month)
+    return QObject::tr("%n day(s)", "", qRound(seconds / Day));
+  if (seconds < Year)
+    return QObject::tr("%n month(s)", "", qRound(seconds / Month));
+  return QObject::tr("%n year(s)", "", qRound(seconds / Year));
+}
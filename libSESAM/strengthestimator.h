@@ -0,0 +1,91 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+#ifndef __STRENGTHESTIMATOR_H_
+#define __STRENGTHESTIMATOR_H_
+
+#include <QtGlobal>
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QScopedPointer>
+
+
+class StrengthEstimatorPrivate;
+
+class StrengthEstimator
+{
+public:
+  struct Match {
+    enum Pattern {
+      Dictionary,
+      Spatial,
+      Repeat,
+      Sequence,
+      Date,
+      Bruteforce
+    };
+    Match(void)
+      : pattern(Bruteforce)
+      , i(0)
+      , j(0)
+      , guessesLog10(0)
+    { /* ... */ }
+    Pattern pattern;
+    int i;
+    int j;
+    QString token;
+    QString detail;
+    double guessesLog10;
+  };
+
+  StrengthEstimator(void);
+  ~StrengthEstimator();
+
+  void addUserInputs(const QStringList &);
+  void setKdfIterations(int);
+  int kdfIterations(void) const;
+  void setAttackerHashRate(double hashesPerSecond);
+  double attackerHashRate(void) const;
+
+  void setPassword(const QString &);
+  void append(const QString &);
+  void clear(void);
+  QString password(void) const;
+
+  double guessesLog10(void) const;
+  int score(void) const;
+  double crackTimeLog10Seconds(void) const;
+  QString crackTimeDisplay(void) const;
+  QList<Match> sequence(void) const;
+
+  static double estimateGuessesLog10(const QString &password);
+  static QString displayTime(double log10Seconds);
+
+  static const double DefaultAttackerHashRate;
+
+private:
+  QScopedPointer<StrengthEstimatorPrivate> d_ptr;
+  Q_DECLARE_PRIVATE(StrengthEstimator)
+  Q_DISABLE_COPY(StrengthEstimator)
+};
+
+#endif // __STRENGTHESTIMATOR_H_
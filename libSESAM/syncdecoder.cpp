@@ -0,0 +1,145 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "syncdecoder.h"
+#include "crypter.h"
+#include "metrics.h"
+
+#include <QObject>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QCryptographicHash>
+#include <QtConcurrent>
+
+
+class SyncDecoderPrivate {
+public:
+  SyncDecoderPrivate(void)
+    : decodeCount(0)
+  { /* ... */ }
+  ~SyncDecoderPrivate()
+  {
+    masterPassword.invalidate();
+  }
+  SecureByteArray masterPassword;
+  QHash<QByteArray, QFuture<SyncDecoder::Result> > futures;
+  int decodeCount;
+  mutable QMutex mutex;
+};
+
+
+static SyncDecoder::Result decodeThread(const SecureByteArray &masterPassword, const QByteArray &cipher)
+{
+  METRIC_TIMER("sync.decode_us");
+  SyncDecoder::Result result;
+  try {
+    result.data = Crypter::decode(masterPassword, cipher, true, result.KGK);
+    // CBC padding doesn't reliably tell a wrong password, but the garbage it yields never uncompresses
+    result.ok = !result.data.isEmpty();
+    if (!result.ok) {
+      result.errorCode = int(CryptoPP::Exception::INVALID_DATA_FORMAT);
+      result.errorString = QObject::tr("cannot decode the data");
+    }
+  }
+  catch (CryptoPP::Exception &e) {
+    result.errorCode = int(e.GetErrorType());
+    result.errorString = QString::fromUtf8(e.what());
+  }
+  return result;
+}
+
+
+/*!
+ * \brief SyncDecoder::SyncDecoder
+ *
+ * Decodes the encrypted domain lists read from sync peers in parallel.
+ * Peers usually hold the very same ciphertext, because they've all been written
+ * from the same merge. Such duplicates are decoded only once, saving
+ * the expensive key derivation.
+ *
+ * Decoded data is kept until `clear()` is called or the password changes.
+ * It lives in `SecureByteArray`s, so it's wiped when the last copy of it is dropped.
+ */
+SyncDecoder::SyncDecoder(void)
+  : d_ptr(new SyncDecoderPrivate)
+{
+  /* ... */
+}
+
+
+SyncDecoder::~SyncDecoder()
+{
+  clear();
+}
+
+
+void SyncDecoder::setPassword(const SecureByteArray &masterPassword)
+{
+  Q_D(SyncDecoder);
+  QMutexLocker locker(&d->mutex);
+  if (masterPassword != d->masterPassword) {
+    d->futures.clear();
+    d->masterPassword = masterPassword;
+  }
+}
+
+
+QFuture<SyncDecoder::Result> SyncDecoder::decode(const QByteArray &cipher)
+{
+  Q_D(SyncDecoder);
+  const QByteArray &digest = QCryptographicHash::hash(cipher, QCryptographicHash::Sha256);
+  QMutexLocker locker(&d->mutex);
+  if (d->futures.contains(digest)) {
+    METRIC_COUNTER("sync.decoder.hits").add();
+    return d->futures.value(digest);
+  }
+  METRIC_COUNTER("sync.decoder.misses").add();
+  ++d->decodeCount;
+  const QFuture<Result> &future = QtConcurrent::run(decodeThread, d->masterPassword, cipher);
+  d->futures.insert(digest, future);
+  return future;
+}
+
+
+int SyncDecoder::decodeCount(void) const
+{
+  Q_D(const SyncDecoder);
+  QMutexLocker locker(&d->mutex);
+  return d->decodeCount;
+}
+
+
+void SyncDecoder::clear(void)
+{
+  Q_D(SyncDecoder);
+  QList<QFuture<Result> > futures;
+  {
+    QMutexLocker locker(&d->mutex);
+    futures = d->futures.values();
+    d->futures.clear();
+    d->decodeCount = 0;
+  }
+  foreach (QFuture<Result> future, futures) {
+    future.waitForFinished();
+  }
+  // dropping the last reference to the futures wipes the decoded data they hold
+  futures.clear();
+}
@@ -0,0 +1,63 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef __SYNCDECODER_H_
+#define __SYNCDECODER_H_
+
+#include <QString>
+#include <QByteArray>
+#include <QFuture>
+#include <QScopedPointer>
+
+#include "securebytearray.h"
+
+
+class SyncDecoderPrivate;
+
+class SyncDecoder
+{
+public:
+  struct Result {
+    Result(void)
+      : ok(false)
+      , errorCode(0)
+    { /* ... */ }
+    bool ok;
+    SecureByteArray data;
+    SecureByteArray KGK;
+    int errorCode;
+    QString errorString;
+  };
+
+  SyncDecoder(void);
+  ~SyncDecoder();
+
+  void setPassword(const SecureByteArray &masterPassword);
+  QFuture<Result> decode(const QByteArray &cipher);
+  int decodeCount(void) const;
+  void clear(void);
+
+private:
+  QScopedPointer<SyncDecoderPrivate> d_ptr;
+  Q_DECLARE_PRIVATE(SyncDecoder)
+  Q_DISABLE_COPY(SyncDecoder)
+};
+
+#endif // __SYNCDECODER_H_
@@ -0,0 +1,119 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QMessageAuthenticationCode>
+
+#include "syncpatch.h"
+#include "crypter.h"
+
+
+const QString SyncPatch::ID = "id";
+const QString SyncPatch::DATA = "data";
+const QString SyncPatch::REVISION = "revision";
+
+
+static SecureByteArray deriveKey(const SecureByteArray &KGK, const QByteArray &purpose)
+{
+  QMessageAuthenticationCode mac(QCryptographicHash::Sha256, KGK);
+  mac.addData(purpose);
+  return mac.result();
+}
+
+
+/*!
+ * \brief SyncPatch::entryId
+ *
+ * The sync server only sees this keyed hash, never the domain name itself.
+ */
+QString SyncPatch::entryId(const SecureByteArray &KGK, const QString &domainName)
+{
+  QMessageAuthenticationCode mac(QCryptographicHash::Sha256, deriveKey(KGK, "ctSESAM delta id"));
+  mac.addData(domainName.toUtf8());
+  return QString::fromLatin1(mac.result().toHex());
+}
+
+
+/*!
+ * \brief SyncPatch::encode
+ *
+ * Encrypts a single domain entry for delta sync. Unlike `Crypter::encode()` no
+ * password based key derivation is involved: the key is derived from the KGK,
+ * so a patch costs a few hundred bytes and microseconds.
+ *
+ * \return IV + AES-256-CBC encrypted, compressed JSON representation of `ds`
+ */
+QByteArray SyncPatch::encode(const SecureByteArray &KGK, const DomainSettings &ds)
+{
+  const SecureByteArray &key = deriveKey(KGK, "ctSESAM delta key");
+  const SecureByteArray &IV = Crypter::generateIV();
+  const QByteArray &json = QJsonDocument(QJsonObject::fromVariantMap(ds.toVariantMap())).toJson(QJsonDocument::Compact);
+  return IV + Crypter::encrypt(key, IV, qCompress(json, 9), CryptoPP::StreamTransformationFilter::PKCS_PADDING);
+}
+
+
+/*!
+ * \brief SyncPatch::decode
+ * \throws CryptoPP::Exception if `patch` wasn't encrypted with the given KGK
+ */
+DomainSettings SyncPatch::decode(const SecureByteArray &KGK, const QByteArray &patch)
+{
+  if (patch.size() <= Crypter::AESBlockSize)
+    return DomainSettings();
+  const SecureByteArray &key = deriveKey(KGK, "ctSESAM delta key");
+  const SecureByteArray &IV = patch.left(Crypter::AESBlockSize);
+  const SecureByteArray &json = qUncompress(Crypter::decrypt(key, IV, patch.mid(Crypter::AESBlockSize), CryptoPP::StreamTransformationFilter::PKCS_PADDING));
+  return DomainSettings::fromVariantMap(QJsonDocument::fromJson(json).toVariant().toMap());
+}
+
+
+/*!
+ * \brief SyncPatch::encodeList
+ * \return JSON array of `{"id": ..., "data": ...}` objects ready to be posted to the sync server
+ */
+QByteArray SyncPatch::encodeList(const SecureByteArray &KGK, const DomainSettingsList &domains)
+{
+  QJsonArray patches;
+  foreach (DomainSettings ds, domains) {
+    QJsonObject o;
+    o[ID] = entryId(KGK, ds.domainName);
+    o[DATA] = QString::fromLatin1(encode(KGK, ds).toBase64());
+    patches.append(o);
+  }
+  return QJsonDocument(patches).toJson(QJsonDocument::Compact);
+}
+
+
+/*!
+ * \brief SyncPatch::decodeList
+ * \throws CryptoPP::Exception if one of the changes wasn't encrypted with the given KGK
+ */
+DomainSettingsList SyncPatch::decodeList(const SecureByteArray &KGK, const QVariantList &changes)
+{
+  DomainSettingsList domains;
+  foreach (QVariant change, changes) {
+    const DomainSettings &ds = decode(KGK, QByteArray::fromBase64(change.toMap()[DATA].toByteArray()));
+    if (!ds.domainName.isEmpty()) {
+      domains.append(ds);
+    }
+  }
+  return domains;
+}
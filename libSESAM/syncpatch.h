@@ -0,0 +1,45 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __SYNCPATCH_H_
+#define __SYNCPATCH_H_
+
+#include <QString>
+#include <QByteArray>
+#include <QVariantList>
+
+#include "securebytearray.h"
+#include "domainsettings.h"
+#include "domainsettingslist.h"
+
+class SyncPatch
+{
+public:
+  static QString entryId(const SecureByteArray &KGK, const QString &domainName);
+  static QByteArray encode(const SecureByteArray &KGK, const DomainSettings &ds);
+  static DomainSettings decode(const SecureByteArray &KGK, const QByteArray &patch);
+  static QByteArray encodeList(const SecureByteArray &KGK, const DomainSettingsList &domains);
+  static DomainSettingsList decodeList(const SecureByteArray &KGK, const QVariantList &changes);
+
+  static const QString ID;
+  static const QString DATA;
+  static const QString REVISION;
+};
+
+#endif // __SYNCPATCH_H_
@@ -0,0 +1,378 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include <QTimer>
+#include <QtMath>
+#include <QtGlobal>
+
+#include "syncscheduler.h"
+
+
+const int SyncScheduler::DefaultQuietPeriodMs = 5 * 1000;
+const int SyncScheduler::DefaultMinPollIntervalMs = 2 * 60 * 1000;
+const int SyncScheduler::DefaultMaxPollIntervalMs = 30 * 60 * 1000;
+const int SyncScheduler::DefaultRetryBaseMs = 15 * 1000;
+const int SyncScheduler::DefaultRetryMaxMs = 60 * 60 * 1000;
+const int SyncScheduler::SyncTimeoutMs = 3 * 60 * 1000;
+
+static const QString PENDING = "pending";
+static const QString FAILURES = "failures";
+
+
+static qreal randomUnit(void)
+{
+  return qreal(qrand()) / (qreal(RAND_MAX) + 1);
+}
+
+
+class SyncSchedulerPrivate {
+public:
+  SyncSchedulerPrivate(void)
+    : enabled(false)
+    , quietPeriodMs(SyncScheduler::DefaultQuietPeriodMs)
+    , minPollIntervalMs(SyncScheduler::DefaultMinPollIntervalMs)
+    , maxPollIntervalMs(SyncScheduler::DefaultMaxPollIntervalMs)
+    , pollIntervalMs(SyncScheduler::DefaultMinPollIntervalMs)
+    , retryBaseMs(SyncScheduler::DefaultRetryBaseMs)
+    , retryMaxMs(SyncScheduler::DefaultRetryMaxMs)
+    , failures(0)
+    , syncing(false)
+  {
+    pollTimer.setSingleShot(true);
+    quietTimer.setSingleShot(true);
+    syncTimer.setSingleShot(true);
+    syncTimer.setInterval(SyncScheduler::SyncTimeoutMs);
+  }
+  // spread the polls of many clients by +/-20 percent so they don't hit the server in lockstep
+  int jittered(int ms) const
+  {
+    return int(ms * (0.8 + 0.4 * randomUnit()));
+  }
+  bool enabled;
+  int quietPeriodMs;
+  int minPollIntervalMs;
+  int maxPollIntervalMs;
+  int pollIntervalMs;
+  int retryBaseMs;
+  int retryMaxMs;
+  int failures;
+  bool syncing;
+  QStringList pending;
+  QStringList inFlight;
+  QTimer pollTimer;
+  QTimer quietTimer;
+  QTimer syncTimer;
+};
+
+
+/*!
+ * \brief SyncScheduler::SyncScheduler
+ *
+ * A `SyncScheduler` decides when to sync in the background. It emits `syncDue()`
+ *
+ * - after local changes have come to rest for the quiet period,
+ * - periodically to poll for remote changes, at an interval that grows while
+ *   the peers stay unchanged and snaps back once they change,
+ * - after a failed sync, with exponentially growing, jittered delays.
+ *
+ * Local changes are kept in a queue of opaque ids until a sync carrying them
+ * has succeeded. The queue can be persisted with `toVariantMap()` and `restore()`.
+ */
+SyncScheduler::SyncScheduler(QObject *parent)
+  : QObject(parent)
+  , d_ptr(new SyncSchedulerPrivate)
+{
+  Q_D(SyncScheduler);
+  QObject::connect(&d->pollTimer, SIGNAL(timeout()), SLOT(onPollTimeout()));
+  QObject::connect(&d->quietTimer, SIGNAL(timeout()), SLOT(onQuietPeriodElapsed()));
+  QObject::connect(&d->syncTimer, SIGNAL(timeout()), SLOT(onSyncTimeout()));
+}
+
+
+SyncScheduler::~SyncScheduler()
+{
+  /* ... */
+}
+
+
+/*!
+ * \brief SyncScheduler::setEnabled
+ *
+ * The first poll after enabling is scheduled at a random point within the minimum
+ * poll interval, so that clients started at the same time don't all sync at once.
+ */
+void SyncScheduler::setEnabled(bool enabled)
+{
+  Q_D(SyncScheduler);
+  if (enabled == d->enabled)
+    return;
+  d->enabled = enabled;
+  d->syncing = false;
+  d->syncTimer.stop();
+  if (enabled) {
+    d->pollIntervalMs = d->minPollIntervalMs;
+    if (d->failures > 0) {
+      d->pollTimer.start(retryDelay(d->failures, d->retryBaseMs, d->retryMaxMs, randomUnit()));
+    }
+    else {
+      d->pollTimer.start(int(d->minPollIntervalMs * randomUnit()));
+    }
+    if (!d->pending.isEmpty()) {
+      d->quietTimer.start(d->quietPeriodMs);
+    }
+  }
+  else {
+    d->pollTimer.stop();
+    d->quietTimer.stop();
+    d->pending = d->inFlight + d->pending;
+    d->pending.removeDuplicates();
+    d->inFlight.clear();
+  }
+}
+
+
+bool SyncScheduler::isEnabled(void) const
+{
+  Q_D(const SyncScheduler);
+  return d->enabled;
+}
+
+
+void SyncScheduler::setQuietPeriod(int ms)
+{
+  Q_D(SyncScheduler);
+  d->quietPeriodMs = ms;
+}
+
+
+int SyncScheduler::quietPeriod(void) const
+{
+  Q_D(const SyncScheduler);
+  return d->quietPeriodMs;
+}
+
+
+void SyncScheduler::setPollInterval(int minMs, int maxMs)
+{
+  Q_D(SyncScheduler);
+  d->minPollIntervalMs = minMs;
+  d->maxPollIntervalMs = qMax(minMs, maxMs);
+  d->pollIntervalMs = qBound(d->minPollIntervalMs, d->pollIntervalMs, d->maxPollIntervalMs);
+}
+
+
+int SyncScheduler::pollInterval(void) const
+{
+  Q_D(const SyncScheduler);
+  return d->pollIntervalMs;
+}
+
+
+void SyncScheduler::setRetryDelay(int baseMs, int maxMs)
+{
+  Q_D(SyncScheduler);
+  d->retryBaseMs = baseMs;
+  d->retryMaxMs = qMax(baseMs, maxMs);
+}
+
+
+int SyncScheduler::failures(void) const
+{
+  Q_D(const SyncScheduler);
+  return d->failures;
+}
+
+
+bool SyncScheduler::isSyncing(void) const
+{
+  Q_D(const SyncScheduler);
+  return d->syncing;
+}
+
+
+void SyncScheduler::addPendingChange(const QString &id)
+{
+  Q_D(SyncScheduler);
+  if (!d->pending.contains(id)) {
+    d->pending << id;
+    emit pendingChangesChanged();
+  }
+  if (d->enabled) {
+    d->quietTimer.start(d->quietPeriodMs);
+  }
+}
+
+
+QStringList SyncScheduler::pendingChanges(void) const
+{
+  Q_D(const SyncScheduler);
+  QStringList all = d->inFlight + d->pending;
+  all.removeDuplicates();
+  return all;
+}
+
+
+bool SyncScheduler::hasPendingChanges(void) const
+{
+  Q_D(const SyncScheduler);
+  return !d->pending.isEmpty() || !d->inFlight.isEmpty();
+}
+
+
+QVariantMap SyncScheduler::toVariantMap(void) const
+{
+  Q_D(const SyncScheduler);
+  QVariantMap map;
+  map[PENDING] = pendingChanges();
+  map[FAILURES] = d->failures;
+  return map;
+}
+
+
+void SyncScheduler::restore(const QVariantMap &map)
+{
+  Q_D(SyncScheduler);
+  d->pending = map[PENDING].toStringList();
+  d->inFlight.clear();
+  d->failures = map[FAILURES].toInt();
+  if (d->enabled && !d->pending.isEmpty()) {
+    d->quietTimer.start(d->quietPeriodMs);
+  }
+}
+
+
+/*!
+ * \brief SyncScheduler::syncStarted
+ *
+ * Must be called when a sync triggered by `syncDue()` actually begins.
+ * Changes queued until now are considered to be carried by this sync.
+ */
+void SyncScheduler::syncStarted(void)
+{
+  Q_D(SyncScheduler);
+  d->syncing = true;
+  d->quietTimer.stop();
+  d->pollTimer.stop();
+  d->inFlight += d->pending;
+  d->inFlight.removeDuplicates();
+  d->pending.clear();
+  d->syncTimer.start();
+}
+
+
+void SyncScheduler::syncSucceeded(bool remoteChanged)
+{
+  Q_D(SyncScheduler);
+  if (!d->syncing)
+    return;
+  d->syncing = false;
+  d->syncTimer.stop();
+  // the failure count is persisted along with the queue, so resetting it is a change, too
+  const bool changed = !d->inFlight.isEmpty() || d->failures != 0;
+  d->failures = 0;
+  d->inFlight.clear();
+  if (changed) {
+    emit pendingChangesChanged();
+  }
+  d->pollIntervalMs = remoteChanged
+      ? d->minPollIntervalMs
+      : qMin(2 * d->pollIntervalMs, d->maxPollIntervalMs);
+  if (d->enabled) {
+    d->pollTimer.start(d->jittered(d->pollIntervalMs));
+    if (!d->pending.isEmpty()) {
+      d->quietTimer.start(d->quietPeriodMs);
+    }
+  }
+}
+
+
+void SyncScheduler::syncFailed(void)
+{
+  Q_D(SyncScheduler);
+  if (!d->syncing)
+    return;
+  d->syncing = false;
+  d->syncTimer.stop();
+  ++d->failures;
+  d->pending = d->inFlight + d->pending;
+  d->pending.removeDuplicates();
+  d->inFlight.clear();
+  emit pendingChangesChanged();
+  if (d->enabled) {
+    // local changes must not retry any sooner than polls do, or an offline client would hammer the server
+    d->quietTimer.stop();
+    d->pollTimer.start(retryDelay(d->failures, d->retryBaseMs, d->retryMaxMs, randomUnit()));
+  }
+}
+
+
+/*!
+ * \brief SyncScheduler::postpone
+ *
+ * Call this if a sync is due but cannot run right now, e.g. because
+ * the user is editing. The scheduler tries again after the quiet period.
+ */
+void SyncScheduler::postpone(void)
+{
+  Q_D(SyncScheduler);
+  if (d->enabled) {
+    d->pollTimer.start(d->quietPeriodMs);
+  }
+}
+
+
+/*!
+ * \brief SyncScheduler::retryDelay
+ *
+ * Exponential backoff with "equal jitter": the ceiling doubles with each failure
+ * up to `maxMs`; the delay is half the ceiling plus a random share of the other half.
+ *
+ * \param failures number of consecutive failures, starting at 1
+ * \param jitter random number in [0, 1)
+ */
+int SyncScheduler::retryDelay(int failures, int baseMs, int maxMs, qreal jitter)
+{
+  const qreal ceiling = qMin(qreal(maxMs), baseMs * qPow(2, qMax(0, failures - 1)));
+  return int(ceiling / 2 + jitter * ceiling / 2);
+}
+
+
+void SyncScheduler::onPollTimeout(void)
+{
+  Q_D(SyncScheduler);
+  if (d->enabled && !d->syncing) {
+    emit syncDue();
+  }
+}
+
+
+void SyncScheduler::onQuietPeriodElapsed(void)
+{
+  Q_D(SyncScheduler);
+  if (d->enabled && !d->syncing && d->failures == 0) {
+    emit syncDue();
+  }
+}
+
+
+void SyncScheduler::onSyncTimeout(void)
+{
+  syncFailed();
+}
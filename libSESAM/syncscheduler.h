@@ -0,0 +1,85 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef __SYNCSCHEDULER_H_
+#define __SYNCSCHEDULER_H_
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QVariantMap>
+#include <QScopedPointer>
+
+
+class SyncSchedulerPrivate;
+
+class SyncScheduler : public QObject
+{
+  Q_OBJECT
+public:
+  explicit SyncScheduler(QObject *parent = Q_NULLPTR);
+  ~SyncScheduler();
+
+  void setEnabled(bool enabled);
+  bool isEnabled(void) const;
+  void setQuietPeriod(int ms);
+  int quietPeriod(void) const;
+  void setPollInterval(int minMs, int maxMs);
+  int pollInterval(void) const;
+  void setRetryDelay(int baseMs, int maxMs);
+  int failures(void) const;
+  bool isSyncing(void) const;
+
+  void addPendingChange(const QString &id);
+  QStringList pendingChanges(void) const;
+  bool hasPendingChanges(void) const;
+  QVariantMap toVariantMap(void) const;
+  void restore(const QVariantMap &);
+
+  void syncStarted(void);
+  void syncSucceeded(bool remoteChanged);
+  void syncFailed(void);
+  void postpone(void);
+
+  static int retryDelay(int failures, int baseMs, int maxMs, qreal jitter);
+
+  static const int DefaultQuietPeriodMs;
+  static const int DefaultMinPollIntervalMs;
+  static const int DefaultMaxPollIntervalMs;
+  static const int DefaultRetryBaseMs;
+  static const int DefaultRetryMaxMs;
+  static const int SyncTimeoutMs;
+
+signals:
+  void syncDue(void);
+  void pendingChangesChanged(void);
+
+private slots:
+  void onPollTimeout(void);
+  void onQuietPeriodElapsed(void);
+  void onSyncTimeout(void);
+
+private:
+  QScopedPointer<SyncSchedulerPrivate> d_ptr;
+  Q_DECLARE_PRIVATE(SyncScheduler)
+  Q_DISABLE_COPY(SyncScheduler)
+};
+
+#endif // __SYNCSCHEDULER_H_
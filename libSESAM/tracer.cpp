@@ -0,0 +1,266 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include <QThread>
+#include <QThreadStorage>
+#include <QSharedPointer>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QAtomicInt>
+#include <QVector>
+#include <QList>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QJsonDocument>
+#include <QSaveFile>
+#include <QCoreApplication>
+
+#include "tracer.h"
+
+
+const int Tracer::MaxEventsPerThread = 1024 * 1024;
+
+
+struct TraceEvent {
+  const char *category;
+  const char *name;
+  qint64 start;
+  qint64 duration;
+};
+
+
+// Only the owning thread appends to a buffer, so its mutex is practically never
+// contended; it just keeps exports from reading a half written vector.
+struct TraceBuffer {
+  TraceBuffer(int tid, const QString &threadName)
+    : tid(tid)
+    , threadName(threadName)
+    , dropped(0)
+  { /* ... */ }
+  int tid;
+  QString threadName;
+  int dropped;
+  QMutex mutex;
+  QVector<TraceEvent> events;
+};
+
+typedef QSharedPointer<TraceBuffer> TraceBufferPtr;
+
+
+class TracerPrivate {
+public:
+  TracerPrivate(void)
+    : enabled(0)
+  {
+    clock.start();
+  }
+  TraceBuffer *buffer(void)
+  {
+    if (!localBuffer.hasLocalData()) {
+      QMutexLocker locker(&registryMutex);
+      QThread *thread = QThread::currentThread();
+      QString threadName = thread != Q_NULLPTR ? thread->objectName() : QString();
+      if (threadName.isEmpty()) {
+        threadName = (QCoreApplication::instance() != Q_NULLPTR && thread == QCoreApplication::instance()->thread())
+            ? QString("main")
+            : QString("thread %1").arg(buffers.size());
+      }
+      TraceBufferPtr buf(new TraceBuffer(buffers.size() + 1, threadName));
+      buffers.append(buf);
+      localBuffer.setLocalData(buf);
+    }
+    return localBuffer.localData().data();
+  }
+  QAtomicInt enabled;
+  QElapsedTimer clock;
+  QThreadStorage<TraceBufferPtr> localBuffer;
+  mutable QMutex registryMutex;
+  QList<TraceBufferPtr> buffers;
+};
+
+
+Tracer::Span::Span(const char *category, const char *name)
+  : mCategory(category)
+  , mName(name)
+  , mStart(-1)
+{
+  if (Tracer::instance().isEnabled()) {
+    mStart = Tracer::instance().now();
+  }
+}
+
+
+Tracer::Span::~Span()
+{
+  if (mStart >= 0) {
+    Tracer &tracer = Tracer::instance();
+    tracer.record(mCategory, mName, mStart, tracer.now() - mStart);
+  }
+}
+
+
+/*!
+ * \brief Tracer::Tracer
+ *
+ * The `Tracer` collects timed spans, each thread into a buffer of its own,
+ * and exports them in Chrome's trace event format, which can be loaded
+ * into chrome://tracing or https://ui.perfetto.dev.
+ *
+ * While tracing is disabled a span costs a single atomic load.
+ */
+Tracer::Tracer(void)
+  : d_ptr(new TracerPrivate)
+{
+  /* ... */
+}
+
+
+Tracer::~Tracer()
+{
+  /* ... */
+}
+
+
+Tracer &Tracer::instance(void)
+{
+  static Tracer tracer;
+  return tracer;
+}
+
+
+void Tracer::setEnabled(bool enabled)
+{
+  Q_D(Tracer);
+  d->enabled.store(enabled ? 1 : 0);
+}
+
+
+bool Tracer::isEnabled(void) const
+{
+  Q_D(const Tracer);
+  return d->enabled.load() != 0;
+}
+
+
+/*!
+ * \brief Tracer::now
+ *
+ * \return microseconds since the tracer was created
+ */
+qint64 Tracer::now(void) const
+{
+  Q_D(const Tracer);
+  return d->clock.nsecsElapsed() / 1000;
+}
+
+
+/*!
+ * \brief Tracer::record
+ *
+ * Records a span that has already ended. `category` and `name` must be
+ * string literals or otherwise outlive the tracer.
+ */
+void Tracer::record(const char *category, const char *name, qint64 startUs, qint64 durationUs)
+{
+  Q_D(Tracer);
+  if (!isEnabled())
+    return;
+  TraceBuffer *buf = d->buffer();
+  QMutexLocker locker(&buf->mutex);
+  if (buf->events.size() >= MaxEventsPerThread) {
+    ++buf->dropped;
+    return;
+  }
+  const TraceEvent ev = { category, name, startUs, durationUs };
+  buf->events.append(ev);
+}
+
+
+int Tracer::eventCount(void) const
+{
+  Q_D(const Tracer);
+  QMutexLocker locker(&d->registryMutex);
+  int n = 0;
+  foreach (TraceBufferPtr buf, d->buffers) {
+    QMutexLocker bufLocker(&buf->mutex);
+    n += buf->events.size();
+  }
+  return n;
+}
+
+
+void Tracer::clear(void)
+{
+  Q_D(Tracer);
+  QMutexLocker locker(&d->registryMutex);
+  foreach (TraceBufferPtr buf, d->buffers) {
+    QMutexLocker bufLocker(&buf->mutex);
+    buf->events.clear();
+    buf->dropped = 0;
+  }
+}
+
+
+QByteArray Tracer::toChromeTraceJson(void) const
+{
+  Q_D(const Tracer);
+  const qint64 pid = QCoreApplication::applicationPid();
+  QJsonArray events;
+  QMutexLocker locker(&d->registryMutex);
+  foreach (TraceBufferPtr buf, d->buffers) {
+    QMutexLocker bufLocker(&buf->mutex);
+    QJsonObject meta;
+    meta["name"] = QString("thread_name");
+    meta["ph"] = QString("M");
+    meta["pid"] = pid;
+    meta["tid"] = buf->tid;
+    QJsonObject args;
+    args["name"] = buf->threadName;
+    if (buf->dropped > 0) {
+      args["dropped"] = buf->dropped;
+    }
+    meta["args"] = args;
+    events.append(meta);
+    foreach (TraceEvent ev, buf->events) {
+      QJsonObject o;
+      o["name"] = QString::fromLatin1(ev.name);
+      o["cat"] = QString::fromLatin1(ev.category);
+      o["ph"] = QString("X");
+      o["ts"] = ev.start;
+      o["dur"] = ev.duration;
+      o["pid"] = pid;
+      o["tid"] = buf->tid;
+      events.append(o);
+    }
+  }
+  QJsonObject root;
+  root["traceEvents"] = events;
+  root["displayTimeUnit"] = QString("ms");
+  return QJsonDocument(root).toJson(QJsonDocument::Compact);
+}
+
+
+bool Tracer::writeChromeTrace(const QString &filename) const
+{
+  const QByteArray &json = toChromeTraceJson();
+  QSaveFile f(filename);
+  return f.open(QIODevice::WriteOnly) && f.write(json) == json.size() && f.commit();
+}
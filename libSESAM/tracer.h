@@ -0,0 +1,89 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef __TRACER_H_
+#define __TRACER_H_
+
+#include <QtGlobal>
+#include <QString>
+#include <QByteArray>
+#include <QScopedPointer>
+
+
+class TracerPrivate;
+
+class Tracer
+{
+public:
+  class Span {
+  public:
+    Span(const char *category, const char *name);
+    ~Span();
+  private:
+    const char *mCategory;
+    const char *mName;
+    qint64 mStart;
+    Q_DISABLE_COPY(Span)
+  };
+
+  static Tracer &instance(void);
+  void setEnabled(bool);
+  bool isEnabled(void) const;
+  void record(const char *category, const char *name, qint64 startUs, qint64 durationUs);
+  qint64 now(void) const;
+  int eventCount(void) const;
+  void clear(void);
+  QByteArray toChromeTraceJson(void) const;
+  bool writeChromeTrace(const QString &filename) const;
+
+  static const int MaxEventsPerThread;
+
+  Tracer(const Tracer &) = delete;
+  void operator=(Tracer const &) = delete;
+
+private:
+  Tracer(void);
+  ~Tracer();
+
+  QScopedPointer<TracerPrivate> d_ptr;
+  Q_DECLARE_PRIVATE(Tracer)
+};
+
+
+// Tracing is compiled in unless QTSESAM_NO_TRACING is defined,
+// in which case the macros expand to nothing.
+#define _TRACE_CONCAT2(a, b) a##b
+#define _TRACE_CONCAT(a, b) _TRACE_CONCAT2(a, b)
+
+#ifdef QTSESAM_NO_TRACING
+#define TRACE_SPAN(category, name) do {} while (false)
+#define TRACE_COMPLETE(category, name, startUs) do {} while (false)
+#define TRACE_NOW() qint64(0)
+#else
+#define TRACE_SPAN(category, name) Tracer::Span _TRACE_CONCAT(_traceSpan, __LINE__)(category, name)
+#define TRACE_COMPLETE(category, name, startUs) \
+  do { \
+    if (Tracer::instance().isEnabled()) \
+      Tracer::instance().record(category, name, startUs, Tracer::instance().now() - (startUs)); \
+  } while (false)
+#define TRACE_NOW() Tracer::instance().now()
+#endif
+
+#endif // __TRACER_H_
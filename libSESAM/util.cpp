@@ -20,6 +20,14 @@
 #include <QDebug>
 #include "util.h"
 
+#if defined(Q_OS_WIN)
+#include <Windows.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+
 
 QString fingerprintify(const QByteArray &ba) {
   const QByteArray &baHex = ba.toHex();
@@ -105,3 +113,31 @@ bool containsAny(const QString &haystack, const QString &needles) {
       return true;
   return false;
 }
+
+
+/*!
+ * \brief syncToDisk
+ *
+ * Flushes Qt's buffers and asks the operating system to write the file's data
+ * to the storage device, so that it survives a crash or power loss.
+ *
+ * \return `true` if the data has reached the device
+ */
+bool syncToDisk(QFileDevice &file)
+{
+  if (!file.flush())
+    return false;
+  const int fd = file.handle();
+  if (fd < 0)
+    return false;
+#if defined(Q_OS_WIN)
+  return FlushFileBuffers(reinterpret_cast<HANDLE>(_get_osfhandle(fd))) != 0;
+#elif defined(Q_OS_MAC)
+  // fsync() on OS X doesn't flush the drive's cache
+  return fcntl(fd, F_FULLFSYNC) == 0 || fsync(fd) == 0;
+#elif defined(Q_OS_LINUX)
+  return fdatasync(fd) == 0;
+#else
+  return fsync(fd) == 0;
+#endif
+}
@@ -26,6 +26,7 @@
 #include <QString>
 #include <QByteArray>
 #include <QVector>
+#include <QFileDevice>
 #include <qmath.h>
 
 
@@ -72,6 +73,7 @@ extern QByteArray shuffled(const QByteArray&);
 extern QString fingerprintify(const QByteArray &ba);
 extern bool containsAll(const QString &haystack, const QString &needles);
 extern bool containsAny(const QString &haystack, const QString &needles);
+extern bool syncToDisk(QFileDevice &file);
 
 #if defined(Q_CC_GNU)
 extern void SecureErase(QString str);
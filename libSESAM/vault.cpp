@@ -0,0 +1,735 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <QDebug>
+#include <QObject>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QSaveFile>
+#include <QMap>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QJsonValue>
+#include <QMessageAuthenticationCode>
+#include <QtEndian>
+
+#include "vault.h"
+#include "crypter.h"
+#include "util.h"
+#include "tracer.h"
+#include "metrics.h"
+
+
+const QByteArray Vault::Magic = QByteArray("SESAMVLT");
+const quint32 Vault::Version = 1;
+
+static const int HeaderVersionOffset = 8;
+static const int HeaderSaltOffset = 12;
+static const int HeaderCommitOffset = 44;
+static const int HeaderCommitSizeOffset = 52;
+static const int HeaderSize = 60;
+static const qint64 MinGarbageForCompaction = 64 * 1024;
+
+static const QString INDEX_DOMAINS = "domains";
+static const QString INDEX_GARBAGE = "garbage";
+static const QString INDEX_OFFSET = "offset";
+static const QString INDEX_SIZE = "size";
+static const QString INDEX_DIGEST = "digest";
+
+
+class VaultPrivate {
+public:
+  VaultPrivate(void)
+    : map(Q_NULLPTR)
+    , commitOffset(0)
+    , commitSize(0)
+    , garbage(0)
+    , appended(0)
+  { /* ... */ }
+  ~VaultPrivate()
+  {
+    KGK.invalidate();
+    vaultKey.invalidate();
+  }
+  static int kgkBlockSize(void)
+  {
+    // format flag + salt + encrypted (salt2 + IV2 + KGK) + one block of PKCS#7 padding
+    return 1 + Crypter::SaltSize + Crypter::SaltSize + Crypter::AESBlockSize + Crypter::KGKSize + Crypter::AESBlockSize;
+  }
+  QByteArray hmac(const QByteArray &data) const
+  {
+    QMessageAuthenticationCode mac(QCryptographicHash::Sha256, vaultKey);
+    mac.addData(data);
+    return mac.result();
+  }
+  QByteArray makeHeader(void) const
+  {
+    QByteArray header(HeaderSize, static_cast<char>(0));
+    uchar *h = reinterpret_cast<uchar*>(header.data());
+    memcpy(h, Vault::Magic.constData(), Vault::Magic.size());
+    qToBigEndian<quint32>(Vault::Version, h + HeaderVersionOffset);
+    memcpy(h + HeaderSaltOffset, vaultSalt.constData(), Crypter::SaltSize);
+    qToBigEndian<quint64>(quint64(commitOffset), h + HeaderCommitOffset);
+    qToBigEndian<quint64>(quint64(commitSize), h + HeaderCommitSizeOffset);
+    return header;
+  }
+  QByteArray sealRecord(const QByteArray &plain) const
+  {
+    const QByteArray &recordSalt = Crypter::generateSalt();
+    const SecureByteArray &recordIV = Crypter::generateIV();
+    const SecureByteArray &recordKey = hmac(recordSalt);
+    const SecureByteArray &compressed = qCompress(plain, 9);
+    return recordSalt + recordIV + Crypter::encrypt(recordKey, recordIV, compressed, CryptoPP::StreamTransformationFilter::PKCS_PADDING);
+  }
+  QByteArray unsealRecord(const QByteArray &record) const
+  {
+    const int headerSize = Crypter::SaltSize + Crypter::AESBlockSize;
+    if (record.size() <= headerSize)
+      return QByteArray();
+    const QByteArray &recordSalt = record.left(Crypter::SaltSize);
+    const SecureByteArray &recordIV = record.mid(Crypter::SaltSize, Crypter::AESBlockSize);
+    const SecureByteArray &recordKey = hmac(recordSalt);
+    const SecureByteArray &compressed = Crypter::decrypt(recordKey, recordIV, record.mid(headerSize), CryptoPP::StreamTransformationFilter::PKCS_PADDING);
+    return qUncompress(compressed);
+  }
+  QByteArray sealIndex(void) const
+  {
+    QJsonArray domains;
+    foreach (Vault::IndexEntry e, index) {
+      QJsonObject o;
+      o[DomainSettings::DOMAIN_NAME] = e.domainName;
+      // same format as DomainSettings::toVariantMap() to keep the milliseconds
+      if (e.createdDate.isValid()) {
+        o[DomainSettings::CDATE] = QJsonValue::fromVariant(e.createdDate);
+      }
+      if (e.modifiedDate.isValid()) {
+        o[DomainSettings::MDATE] = QJsonValue::fromVariant(e.modifiedDate);
+      }
+      if (e.deleted) {
+        o[DomainSettings::DELETED] = true;
+      }
+      if (!e.groupHierarchy.isEmpty()) {
+        o[DomainSettings::GROUP] = e.groupHierarchy;
+      }
+      if (!e.tags.isEmpty()) {
+        o[DomainSettings::TAGS] = e.tags.join(QChar('\t'));
+      }
+      o[INDEX_OFFSET] = double(e.offset);
+      o[INDEX_SIZE] = double(e.size);
+      o[INDEX_DIGEST] = QString::fromLatin1(e.digest.toBase64());
+      domains.append(o);
+    }
+    QJsonObject root;
+    root[INDEX_DOMAINS] = domains;
+    root[INDEX_GARBAGE] = double(garbage);
+    const SecureByteArray &IV = Crypter::generateIV();
+    const SecureByteArray &plain = qCompress(QJsonDocument(root).toJson(QJsonDocument::Compact), 9);
+    return IV + Crypter::encrypt(vaultKey, IV, plain, CryptoPP::StreamTransformationFilter::PKCS_PADDING);
+  }
+  bool unsealIndex(const QByteArray &sealed)
+  {
+    if (sealed.size() <= Crypter::AESBlockSize)
+      return false;
+    const SecureByteArray &IV = sealed.left(Crypter::AESBlockSize);
+    const SecureByteArray &plain = Crypter::decrypt(vaultKey, IV, sealed.mid(Crypter::AESBlockSize), CryptoPP::StreamTransformationFilter::PKCS_PADDING);
+    QJsonParseError parseError;
+    const QJsonDocument &json = QJsonDocument::fromJson(qUncompress(plain), &parseError);
+    if (parseError.error != QJsonParseError::NoError || !json.isObject())
+      return false;
+    const QJsonObject &root = json.object();
+    index.clear();
+    foreach (QJsonValue v, root[INDEX_DOMAINS].toArray()) {
+      const QJsonObject &o = v.toObject();
+      Vault::IndexEntry e;
+      static_cast<DomainIndex::Entry&>(e) = DomainIndex::Entry::fromJsonObject(o);
+      e.offset = qint64(o[INDEX_OFFSET].toDouble());
+      e.size = qint64(o[INDEX_SIZE].toDouble());
+      e.digest = QByteArray::fromBase64(o[INDEX_DIGEST].toString().toLatin1());
+      if (e.domainName.isEmpty() || e.offset < HeaderSize || e.offset + e.size > commitOffset)
+        return false;
+      index.insert(e.domainName, e);
+    }
+    garbage = qint64(root[INDEX_GARBAGE].toDouble());
+    return true;
+  }
+  QByteArray bytesAt(qint64 offset, qint64 size) const
+  {
+    if (map == Q_NULLPTR || offset < 0 || size < 0 || offset + size > file.size())
+      return QByteArray();
+    return QByteArray(reinterpret_cast<const char*>(map + offset), int(size));
+  }
+  bool remap(void)
+  {
+    unmap();
+    map = file.map(0, file.size());
+    METRIC_GAUGE("vault.file_bytes").set(file.size());
+    if (map == Q_NULLPTR) {
+      errorString = file.errorString();
+    }
+    return map != Q_NULLPTR;
+  }
+  void unmap(void)
+  {
+    if (map != Q_NULLPTR) {
+      file.unmap(map);
+      map = Q_NULLPTR;
+    }
+  }
+  qint64 append(const QByteArray &data)
+  {
+    const qint64 offset = file.size();
+    if (!file.seek(offset) || file.write(data) != data.size()) {
+      errorString = file.errorString();
+      return -1;
+    }
+    return offset;
+  }
+  bool commit(void)
+  {
+    unmap();
+    const QByteArray &sealedIndex = sealIndex();
+    const qint64 offset = append(kgkBlock + sealedIndex);
+    if (offset < 0) {
+      remap();
+      return false;
+    }
+    // the records and the commit block must be on disk before the header points to them
+    if (!syncToDisk(file)) {
+      errorString = file.errorString();
+      remap();
+      return false;
+    }
+    const qint64 previousCommitOffset = commitOffset;
+    const qint64 previousCommitSize = commitSize;
+    const qint64 previousGarbage = garbage;
+    garbage += commitSize;
+    commitOffset = offset;
+    commitSize = kgkBlock.size() + sealedIndex.size();
+    const QByteArray &header = makeHeader();
+    bool ok = file.seek(0) && file.write(header) == header.size() && syncToDisk(file);
+    if (!ok) {
+      errorString = file.errorString();
+      commitOffset = previousCommitOffset;
+      commitSize = previousCommitSize;
+      garbage = previousGarbage;
+    }
+    return remap() && ok;
+  }
+  // what a failed write must roll back to
+  struct State {
+    QMap<QString, Vault::IndexEntry> index;
+    qint64 commitOffset;
+    qint64 commitSize;
+    qint64 garbage;
+  };
+  State state(void) const
+  {
+    State s;
+    s.index = index;
+    s.commitOffset = commitOffset;
+    s.commitSize = commitSize;
+    s.garbage = garbage;
+    return s;
+  }
+  void restore(const State &s)
+  {
+    index = s.index;
+    commitOffset = s.commitOffset;
+    commitSize = s.commitSize;
+    garbage = s.garbage;
+    remap();
+  }
+  bool appendRecord(const DomainSettings &ds)
+  {
+    const SecureByteArray &plain = QJsonDocument::fromVariant(ds.toVariantMap()).toJson(QJsonDocument::Compact);
+    const QByteArray &digest = hmac(plain);
+    const bool exists = index.contains(ds.domainName);
+    if (exists && index[ds.domainName].digest == digest)
+      return true;
+    const QByteArray &record = sealRecord(plain);
+    const qint64 offset = append(record);
+    if (offset < 0)
+      return false;
+    Vault::IndexEntry &e = index[ds.domainName];
+    if (exists) {
+      garbage += e.size;
+    }
+    static_cast<DomainIndex::Entry&>(e) = DomainIndex::Entry::fromDomainSettings(ds);
+    e.offset = offset;
+    e.size = record.size();
+    e.digest = digest;
+    ++appended;
+    return true;
+  }
+  bool writeAll(const QString &filename, const QMap<QString, QByteArray> &records)
+  {
+    QSaveFile out(filename);
+    if (!out.open(QIODevice::WriteOnly)) {
+      errorString = out.errorString();
+      return false;
+    }
+    out.write(QByteArray(HeaderSize, static_cast<char>(0)));
+    qint64 pos = HeaderSize;
+    for (QMap<QString, QByteArray>::const_iterator r = records.constBegin(); r != records.constEnd(); ++r) {
+      Vault::IndexEntry &e = index[r.key()];
+      e.offset = pos;
+      e.size = r.value().size();
+      out.write(r.value());
+      pos += e.size;
+    }
+    garbage = 0;
+    const QByteArray &sealedIndex = sealIndex();
+    commitOffset = pos;
+    commitSize = kgkBlock.size() + sealedIndex.size();
+    out.write(kgkBlock);
+    out.write(sealedIndex);
+    out.seek(0);
+    out.write(makeHeader());
+    if (!out.commit()) {
+      errorString = out.errorString();
+      return false;
+    }
+    return true;
+  }
+  // writeAll() lays out the index for the new file, which only describes the
+  // file on disk once it has been committed
+  bool compact(void)
+  {
+    const State previous = state();
+    QMap<QString, QByteArray> records;
+    foreach (Vault::IndexEntry e, index) {
+      records.insert(e.domainName, bytesAt(e.offset, e.size));
+    }
+    unmap();
+    file.close();
+    bool ok = false;
+    try {
+      ok = writeAll(file.fileName(), records);
+    }
+    catch (CryptoPP::Exception &) {
+      file.open(QIODevice::ReadWrite);
+      restore(previous);
+      throw;
+    }
+    const bool reopened = file.open(QIODevice::ReadWrite);
+    if (!reopened) {
+      errorString = file.errorString();
+    }
+    if (!ok) {
+      restore(previous);
+      return false;
+    }
+    return reopened && remap();
+  }
+
+  QFile file;
+  uchar *map;
+  QByteArray vaultSalt;
+  QByteArray kgkBlock;
+  SecureByteArray KGK;
+  SecureByteArray vaultKey;
+  QMap<QString, Vault::IndexEntry> index;
+  qint64 commitOffset;
+  qint64 commitSize;
+  qint64 garbage;
+  int appended;
+  QString errorString;
+};
+
+
+/*!
+ * \brief Vault::Vault
+ *
+ * A `Vault` stores domain settings in a file of individually encrypted records.
+ *
+ * Bytes   | Description
+ * ------- | ---------------------------------------------------------------------------
+ *       8 | Magic ("SESAMVLT")
+ *       4 | Format version
+ *      32 | Vault salt
+ *       8 | Offset of the current commit block
+ *       8 | Size of the current commit block
+ *       n | Records: record salt (32) + IV (16) + AES-CBC encrypted, compressed JSON
+ *
+ * The commit block consists of the KGK encrypted with a key derived from the master password
+ * (see `Crypter::encode()`) followed by the IV and the encrypted index. The index maps each
+ * domain name to the position of its record. The vault key is derived from the KGK and the vault salt,
+ * the key of each record is an HMAC of the record salt keyed with the vault key.
+ *
+ * Saving a record appends it together with a fresh commit block and then repoints the header,
+ * so the rest of the file is never rewritten. Superseded records are dropped when the garbage
+ * outweighs the live data.
+ *
+ * A commit is durable: the appended data is synced to disk before the header is rewritten,
+ * and the header is synced before the commit is reported as successful. A crash in between
+ * leaves the header pointing to the previous commit.
+ */
+Vault::Vault(void)
+  : d_ptr(new VaultPrivate)
+{
+  /* ... */
+}
+
+
+Vault::Vault(const QString &filename)
+  : Vault()
+{
+  setFileName(filename);
+}
+
+
+Vault::~Vault()
+{
+  close();
+}
+
+
+void Vault::setFileName(const QString &filename)
+{
+  Q_D(Vault);
+  if (isOpen()) {
+    close();
+  }
+  d->file.setFileName(filename);
+}
+
+
+QString Vault::fileName(void) const
+{
+  return d_ptr->file.fileName();
+}
+
+
+bool Vault::exists(void) const
+{
+  return !d_ptr->file.fileName().isEmpty() && d_ptr->file.exists();
+}
+
+
+bool Vault::isOpen(void) const
+{
+  return d_ptr->map != Q_NULLPTR;
+}
+
+
+/*!
+ * \brief Vault::open
+ *
+ * Maps the vault file into memory and decrypts its index. The records themselves stay encrypted
+ * until requested via `Vault::read()`.
+ *
+ * Throws a `CryptoPP::Exception` if the data cannot be decrypted, e.g. because of a wrong master password.
+ *
+ * \param masterPassword The user's master password.
+ * \return `true` if the vault could be opened, otherwise `false`. See `Vault::errorString()` for the reason.
+ */
+bool Vault::open(const SecureByteArray &masterPassword)
+{
+  Q_D(Vault);
+  TRACE_SPAN("vault", "Vault::open");
+  close();
+  if (!d->file.open(QIODevice::ReadWrite)) {
+    d->errorString = d->file.errorString();
+    return false;
+  }
+  if (d->file.size() < HeaderSize || !d->remap()) {
+    d->errorString = QObject::tr("%1 is not a vault file").arg(d->file.fileName());
+    close();
+    return false;
+  }
+  if (d->bytesAt(0, Magic.size()) != Magic || qFromBigEndian<quint32>(d->map + HeaderVersionOffset) != Version) {
+    d->errorString = QObject::tr("%1 is not a vault file or has an unsupported format").arg(d->file.fileName());
+    close();
+    return false;
+  }
+  d->vaultSalt = d->bytesAt(HeaderSaltOffset, Crypter::SaltSize);
+  d->commitOffset = qint64(qFromBigEndian<quint64>(d->map + HeaderCommitOffset));
+  d->commitSize = qint64(qFromBigEndian<quint64>(d->map + HeaderCommitSizeOffset));
+  if (d->commitOffset < HeaderSize || d->commitSize <= VaultPrivate::kgkBlockSize() || d->commitOffset + d->commitSize > d->file.size()) {
+    d->errorString = QObject::tr("The vault file %1 is damaged").arg(d->file.fileName());
+    close();
+    return false;
+  }
+  d->kgkBlock = d->bytesAt(d->commitOffset, VaultPrivate::kgkBlockSize());
+  try {
+    Crypter::decode(masterPassword, d->kgkBlock, false, d->KGK);
+    d->vaultKey = Crypter::makeKeyFromPassword(d->KGK, d->vaultSalt);
+    const QByteArray &sealedIndex = d->bytesAt(d->commitOffset + d->kgkBlock.size(), d->commitSize - d->kgkBlock.size());
+    if (!d->unsealIndex(sealedIndex)) {
+      d->errorString = QObject::tr("The index of the vault file %1 is damaged").arg(d->file.fileName());
+      close();
+      return false;
+    }
+  }
+  catch (CryptoPP::Exception &) {
+    close();
+    throw;
+  }
+  return true;
+}
+
+
+/*!
+ * \brief Vault::create
+ *
+ * Writes a new vault file containing all of `domains`, replacing any existing one.
+ *
+ * \param key An AES key generated from the user's master password.
+ * \param IV AES initialization vector.
+ * \param salt The salt used to generate `key` and `IV`.
+ * \param KGK Key generation key.
+ * \param domains The domain settings to be stored.
+ * \return `true` if the vault could be written.
+ */
+bool Vault::create(const SecureByteArray &key, const SecureByteArray &IV, const QByteArray &salt, const SecureByteArray &KGK, const DomainSettingsList &domains)
+{
+  Q_D(Vault);
+  const QString filename = d->file.fileName();
+  close();
+  d->KGK = KGK;
+  d->vaultSalt = Crypter::generateSalt();
+  d->vaultKey = Crypter::makeKeyFromPassword(d->KGK, d->vaultSalt);
+  d->kgkBlock = Crypter::encode(key, IV, salt, d->KGK, QByteArray(), false);
+  QMap<QString, QByteArray> records;
+  foreach (DomainSettings ds, domains) {
+    if (ds.domainName.isEmpty())
+      continue;
+    const SecureByteArray &plain = QJsonDocument::fromVariant(ds.toVariantMap()).toJson(QJsonDocument::Compact);
+    Vault::IndexEntry e;
+    static_cast<DomainIndex::Entry&>(e) = DomainIndex::Entry::fromDomainSettings(ds);
+    e.digest = d->hmac(plain);
+    d->index.insert(e.domainName, e);
+    records.insert(e.domainName, d->sealRecord(plain));
+  }
+  QDir().mkpath(QFileInfo(filename).absolutePath());
+  if (!d->writeAll(filename, records)) {
+    close();
+    return false;
+  }
+  if (!d->file.open(QIODevice::ReadWrite)) {
+    d->errorString = d->file.errorString();
+    close();
+    return false;
+  }
+  return d->remap();
+}
+
+
+/*!
+ * \brief Vault::rekey
+ *
+ * Re-encrypts the KGK with a new key, e.g. after the master password has been changed.
+ * The records are left untouched because their keys are derived from the KGK.
+ */
+bool Vault::rekey(const SecureByteArray &key, const SecureByteArray &IV, const QByteArray &salt)
+{
+  Q_D(Vault);
+  if (!isOpen())
+    return false;
+  const QByteArray previousKGKBlock = d->kgkBlock;
+  d->kgkBlock = Crypter::encode(key, IV, salt, d->KGK, QByteArray(), false);
+  bool ok = false;
+  try {
+    ok = d->commit();
+  }
+  catch (CryptoPP::Exception &) {
+    d->kgkBlock = previousKGKBlock;
+    d->remap();
+    throw;
+  }
+  if (!ok) {
+    d->kgkBlock = previousKGKBlock;
+  }
+  return ok;
+}
+
+
+/*!
+ * \brief Vault::write
+ *
+ * Stores a single domain. Only the record of this domain and the index are written.
+ * Nothing is written at all if the domain settings haven't changed since they were stored.
+ */
+bool Vault::write(const DomainSettings &ds)
+{
+  DomainSettingsList domains;
+  domains << ds;
+  return write(domains);
+}
+
+
+/*!
+ * \brief Vault::write
+ *
+ * Stores a batch of domains with a single commit, so the index is written
+ * and the file synced to disk only once no matter how many domains have changed.
+ * If the batch fails, none of its records becomes visible, even if encrypting
+ * it throws.
+ */
+bool Vault::write(const DomainSettingsList &domains)
+{
+  Q_D(Vault);
+  TRACE_SPAN("vault", "Vault::write");
+  if (!isOpen())
+    return false;
+  METRIC_TIMER("vault.save_us");
+  const VaultPrivate::State previous = d->state();
+  d->unmap();
+  d->appended = 0;
+  bool ok = true;
+  try {
+    foreach (DomainSettings ds, domains) {
+      if (ds.domainName.isEmpty())
+        continue;
+      ok = d->appendRecord(ds);
+      if (!ok)
+        break;
+    }
+    if (ok && d->appended == 0)
+      return d->remap();
+    if (ok) {
+      ok = d->commit();
+    }
+  }
+  catch (CryptoPP::Exception &) {
+    d->restore(previous);
+    throw;
+  }
+  if (!ok) {
+    d->restore(previous);
+    return false;
+  }
+  // the batch is on disk now; a failed compaction leaves the vault as it was
+  // and is retried with the next write
+  if (d->garbage > MinGarbageForCompaction && d->garbage > d->file.size() / 2) {
+    try {
+      if (!d->compact()) {
+        qWarning() << "Vault::write(): cannot compact" << d->file.fileName() << ":" << d->errorString;
+      }
+    }
+    catch (CryptoPP::Exception &e) {
+      qWarning() << "Vault::write(): cannot compact" << d->file.fileName() << ":" << e.what();
+    }
+  }
+  return true;
+}
+
+
+bool Vault::remove(const QString &domainName)
+{
+  Q_D(Vault);
+  if (!isOpen() || !d->index.contains(domainName))
+    return false;
+  const VaultPrivate::State previous = d->state();
+  d->garbage += d->index.value(domainName).size;
+  d->index.remove(domainName);
+  bool ok = false;
+  try {
+    ok = d->commit();
+  }
+  catch (CryptoPP::Exception &) {
+    d->restore(previous);
+    throw;
+  }
+  if (!ok) {
+    d->restore(previous);
+  }
+  return ok;
+}
+
+
+/*!
+ * \brief Vault::read
+ *
+ * Decrypts the record of a single domain.
+ *
+ * \param domainName The name of the domain to be read.
+ * \return The domain settings or an empty `DomainSettings` object if the domain isn't contained in the vault.
+ */
+DomainSettings Vault::read(const QString &domainName) const
+{
+  Q_D(const Vault);
+  if (!isOpen() || !d->index.contains(domainName))
+    return DomainSettings();
+  const Vault::IndexEntry &e = d->index[domainName];
+  const SecureByteArray &plain = d->unsealRecord(d->bytesAt(e.offset, e.size));
+  QJsonParseError parseError;
+  const QJsonDocument &json = QJsonDocument::fromJson(plain, &parseError);
+  if (parseError.error != QJsonParseError::NoError) {
+    qWarning() << "Vault::read(): bad record for" << domainName << parseError.errorString();
+    return DomainSettings();
+  }
+  return DomainSettings::fromVariantMap(json.toVariant().toMap());
+}
+
+
+bool Vault::contains(const QString &domainName) const
+{
+  return d_ptr->index.contains(domainName);
+}
+
+
+QList<Vault::IndexEntry> Vault::index(void) const
+{
+  return d_ptr->index.values();
+}
+
+
+QStringList Vault::keys(void) const
+{
+  return d_ptr->index.keys();
+}
+
+
+int Vault::count(void) const
+{
+  return d_ptr->index.count();
+}
+
+
+const SecureByteArray &Vault::KGK(void) const
+{
+  return d_ptr->KGK;
+}
+
+
+void Vault::close(void)
+{
+  Q_D(Vault);
+  d->unmap();
+  if (d->file.isOpen()) {
+    d->file.close();
+  }
+  d->index.clear();
+  d->KGK.invalidate();
+  d->vaultKey.invalidate();
+  d->kgkBlock.clear();
+  d->vaultSalt.clear();
+  d->commitOffset = 0;
+  d->commitSize = 0;
+  d->garbage = 0;
+}
+
+
+QString Vault::errorString(void) const
+{
+  return d_ptr->errorString;
+}
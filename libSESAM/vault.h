@@ -0,0 +1,83 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __VAULT_H_
+#define __VAULT_H_
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QDateTime>
+#include <QList>
+#include <QScopedPointer>
+
+#include "securebytearray.h"
+#include "domainsettings.h"
+#include "domainsettingslist.h"
+#include "domainindex.h"
+
+
+class VaultPrivate;
+
+class Vault
+{
+public:
+  struct IndexEntry : public DomainIndex::Entry {
+    IndexEntry(void)
+      : offset(0)
+      , size(0)
+    { /* ... */ }
+    qint64 offset;
+    qint64 size;
+    QByteArray digest;
+  };
+
+  Vault(void);
+  explicit Vault(const QString &filename);
+  ~Vault();
+
+  void setFileName(const QString &);
+  QString fileName(void) const;
+  bool exists(void) const;
+  bool isOpen(void) const;
+  bool open(const SecureByteArray &masterPassword);
+  bool create(const SecureByteArray &key, const SecureByteArray &IV, const QByteArray &salt, const SecureByteArray &KGK, const DomainSettingsList &domains);
+  bool rekey(const SecureByteArray &key, const SecureByteArray &IV, const QByteArray &salt);
+  bool write(const DomainSettings &);
+  bool write(const DomainSettingsList &);
+  bool remove(const QString &domainName);
+  DomainSettings read(const QString &domainName) const;
+  bool contains(const QString &domainName) const;
+  QList<IndexEntry> index(void) const;
+  QStringList keys(void) const;
+  int count(void) const;
+  const SecureByteArray &KGK(void) const;
+  void close(void);
+  QString errorString(void) const;
+
+  static const QByteArray Magic;
+  static const quint32 Version;
+
+private:
+  QScopedPointer<VaultPrivate> d_ptr;
+  Q_DECLARE_PRIVATE(Vault)
+  Q_DISABLE_COPY(Vault)
+};
+
+#endif // __VAULT_H_
@@ -0,0 +1,278 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThreadStorage>
+#include <QMessageAuthenticationCode>
+#include <QtConcurrent>
+
+#include "vaultauditor.h"
+#include "password.h"
+#include "strengthestimator.h"
+#include "metrics.h"
+
+
+const int VaultAuditor::WeakScore = 3;
+
+
+namespace {
+
+// Building the estimator's dictionaries is the most expensive part of
+// evaluating a short password, so every worker thread keeps its own.
+QThreadStorage<StrengthEstimator*> threadEstimator;
+
+struct Evaluator
+{
+  Evaluator(const SecureByteArray &KGK, const SecureByteArray &auditKey, const VaultAuditor::ListedFunction &listed)
+    : KGK(KGK)
+    , auditKey(auditKey)
+    , listed(listed)
+  { /* ... */ }
+  typedef VaultAuditor::Result result_type;
+  SecureByteArray KGK;
+  SecureByteArray auditKey;
+  VaultAuditor::ListedFunction listed;
+  VaultAuditor::Result operator()(const DomainSettings &ds)
+  {
+    METRIC_TIMER("audit.entry_us");
+    VaultAuditor::Result r;
+    r.domainName = ds.domainName;
+    r.modifiedDate = ds.modifiedDate;
+    r.expiryDate = ds.expiryDate;
+    if (ds.deleted)
+      return r;
+    SecureString pwd = ds.legacyPassword;
+    if (pwd.isEmpty()) {
+      Password gpwd(ds);
+      gpwd.generate(KGK);
+      pwd = gpwd.password();
+    }
+    if (pwd.isEmpty())
+      return r;
+    QMessageAuthenticationCode mac(QCryptographicHash::Sha256, auditKey);
+    mac.addData(pwd.toUtf8());
+    r.fingerprint = mac.result();
+    if (!threadEstimator.hasLocalData()) {
+      threadEstimator.setLocalData(new StrengthEstimator);
+    }
+    StrengthEstimator *estimator = threadEstimator.localData();
+    estimator->setPassword(pwd);
+    r.guessesLog10 = estimator->guessesLog10();
+    r.weak = estimator->score() < VaultAuditor::WeakScore;
+    estimator->clear();
+    if (listed) {
+      r.listed = listed(pwd);
+    }
+    return r;
+  }
+};
+
+}
+
+
+class VaultAuditorPrivate {
+public:
+  VaultAuditorPrivate(void)
+  { /* ... */ }
+  ~VaultAuditorPrivate()
+  {
+    KGK.invalidate();
+    auditKey.invalidate();
+  }
+  SecureByteArray KGK;
+  SecureByteArray auditKey;
+  VaultAuditor::ListedFunction listed;
+  QHash<QString, VaultAuditor::Result> cache;
+};
+
+
+/*!
+ * \brief VaultAuditor::VaultAuditor
+ *
+ * A `VaultAuditor` checks the passwords of all domains for weakness,
+ * reuse, appearance in a list of leaked passwords and expiry.
+ *
+ * Passwords are compared by a keyed hash so that neither plain passwords
+ * nor unsalted hashes of them are kept around. Results are cached per domain
+ * and modification date; `outdated()` tells which domains need to be
+ * (re-)evaluated with `audit()`, so a re-audit only costs the work for the
+ * domains changed in the meantime.
+ */
+VaultAuditor::VaultAuditor(void)
+  : d_ptr(new VaultAuditorPrivate)
+{
+  /* ... */
+}
+
+
+VaultAuditor::~VaultAuditor()
+{
+  /* ... */
+}
+
+
+/*!
+ * \brief VaultAuditor::setKGK
+ *
+ * Wipes the previous KGK, the audit key derived from it and the cached
+ * results. Pass an empty KGK when the application gets locked.
+ */
+void VaultAuditor::setKGK(const SecureByteArray &KGK)
+{
+  Q_D(VaultAuditor);
+  if (KGK == d->KGK)
+    return;
+  d->KGK.invalidate();
+  d->auditKey.invalidate();
+  d->cache.clear();
+  if (KGK.isEmpty())
+    return;
+  d->KGK = KGK;
+  QMessageAuthenticationCode mac(QCryptographicHash::Sha256, KGK);
+  mac.addData(QByteArray("ctSESAM audit key"));
+  d->auditKey = mac.result();
+}
+
+
+/*!
+ * \brief VaultAuditor::setListedFunction
+ *
+ * \param listed returns `true` if a password appears in a list of leaked passwords;
+ * it's called from worker threads
+ */
+void VaultAuditor::setListedFunction(const ListedFunction &listed)
+{
+  Q_D(VaultAuditor);
+  d->listed = listed;
+  d->cache.clear();
+}
+
+
+void VaultAuditor::clearCache(void)
+{
+  Q_D(VaultAuditor);
+  d->cache.clear();
+}
+
+
+int VaultAuditor::cachedCount(void) const
+{
+  Q_D(const VaultAuditor);
+  return d->cache.count();
+}
+
+
+/*!
+ * \brief VaultAuditor::outdated
+ *
+ * Forgets the results of domains that don't exist anymore.
+ *
+ * \return names of all domains not deleted whose results are missing or older than the domain
+ */
+QStringList VaultAuditor::outdated(const QList<DomainIndex::Entry> &entries)
+{
+  Q_D(VaultAuditor);
+  QStringList names;
+  QHash<QString, VaultAuditor::Result> cache;
+  foreach (DomainIndex::Entry e, entries) {
+    if (e.deleted)
+      continue;
+    const QHash<QString, VaultAuditor::Result>::const_iterator r = d->cache.constFind(e.domainName);
+    if (r != d->cache.constEnd() && r.value().modifiedDate == e.modifiedDate) {
+      cache.insert(e.domainName, r.value());
+    }
+    else {
+      names << e.domainName;
+    }
+  }
+  d->cache = cache;
+  return names;
+}
+
+
+/*!
+ * \brief VaultAuditor::audit
+ *
+ * Evaluates `domains` in parallel. Generated passwords have to be derived
+ * from the KGK first, which dominates the time needed.
+ * Pass the results to `update()` when the future has finished.
+ */
+QFuture<VaultAuditor::Result> VaultAuditor::audit(const DomainSettingsList &domains) const
+{
+  Q_D(const VaultAuditor);
+  return QtConcurrent::mapped(domains, Evaluator(d->KGK, d->auditKey, d->listed));
+}
+
+
+void VaultAuditor::update(const QList<Result> &results)
+{
+  Q_D(VaultAuditor);
+  foreach (Result r, results) {
+    d->cache.insert(r.domainName, r);
+  }
+}
+
+
+/*!
+ * \brief VaultAuditor::findings
+ *
+ * Combines the cached results of `entries`. Only domains with at least one issue are reported.
+ */
+QList<VaultAuditor::Finding> VaultAuditor::findings(const QList<DomainIndex::Entry> &entries) const
+{
+  Q_D(const VaultAuditor);
+  METRIC_TIMER("audit.findings_us");
+  QHash<QByteArray, QStringList> byFingerprint;
+  foreach (DomainIndex::Entry e, entries) {
+    if (e.deleted)
+      continue;
+    const QByteArray &fingerprint = d->cache.value(e.domainName).fingerprint;
+    if (!fingerprint.isEmpty()) {
+      byFingerprint[fingerprint] << e.domainName;
+    }
+  }
+  QMap<QString, Finding> findings;
+  foreach (DomainIndex::Entry e, entries) {
+    if (e.deleted || !d->cache.contains(e.domainName))
+      continue;
+    const Result &r = d->cache[e.domainName];
+    Finding f;
+    f.domainName = r.domainName;
+    f.guessesLog10 = r.guessesLog10;
+    if (r.weak)
+      f.issues |= Weak;
+    if (r.listed)
+      f.issues |= Listed;
+    if (DomainSettings::expired(r.expiryDate))
+      f.issues |= Expired;
+    if (!r.fingerprint.isEmpty()) {
+      f.reusedBy = byFingerprint.value(r.fingerprint);
+      f.reusedBy.removeOne(r.domainName);
+      if (!f.reusedBy.isEmpty())
+        f.issues |= Reused;
+    }
+    if (f.issues != NoIssue) {
+      findings.insert(f.domainName, f);
+    }
+  }
+  return findings.values();
+}
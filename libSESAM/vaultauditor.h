@@ -0,0 +1,104 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef __VAULTAUDITOR_H_
+#define __VAULTAUDITOR_H_
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QDateTime>
+#include <QList>
+#include <QFuture>
+#include <QScopedPointer>
+
+#include <functional>
+
+#include "securebytearray.h"
+#include "domainsettings.h"
+#include "domainsettingslist.h"
+#include "domainindex.h"
+
+
+class VaultAuditorPrivate;
+
+class VaultAuditor
+{
+public:
+  enum Issue {
+    NoIssue = 0x00,
+    Weak = 0x01,
+    Reused = 0x02,
+    Listed = 0x04,
+    Expired = 0x08
+  };
+  Q_DECLARE_FLAGS(Issues, Issue)
+
+  struct Result {
+    Result(void)
+      : guessesLog10(0)
+      , weak(false)
+      , listed(false)
+    { /* ... */ }
+    QString domainName;
+    QDateTime modifiedDate;
+    QDateTime expiryDate;
+    QByteArray fingerprint;
+    double guessesLog10;
+    bool weak;
+    bool listed;
+  };
+
+  struct Finding {
+    Finding(void)
+      : issues(NoIssue)
+      , guessesLog10(0)
+    { /* ... */ }
+    QString domainName;
+    Issues issues;
+    QStringList reusedBy;
+    double guessesLog10;
+  };
+
+  typedef std::function<bool(const QString &password)> ListedFunction;
+
+  VaultAuditor(void);
+  ~VaultAuditor();
+
+  void setKGK(const SecureByteArray &KGK);
+  void setListedFunction(const ListedFunction &);
+  void clearCache(void);
+  int cachedCount(void) const;
+  QStringList outdated(const QList<DomainIndex::Entry> &entries);
+  QFuture<Result> audit(const DomainSettingsList &domains) const;
+  void update(const QList<Result> &results);
+  QList<Finding> findings(const QList<DomainIndex::Entry> &entries) const;
+
+  static const int WeakScore;
+
+private:
+  QScopedPointer<VaultAuditorPrivate> d_ptr;
+  Q_DECLARE_PRIVATE(VaultAuditor)
+  Q_DISABLE_COPY(VaultAuditor)
+};
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(VaultAuditor::Issues)
+
+#endif // __VAULTAUDITOR_H_
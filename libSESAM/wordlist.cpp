@@ -0,0 +1,603 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+#include <QObject>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QDateTime>
+#include <QSaveFile>
+#include <QTemporaryFile>
+#include <QDataStream>
+#include <QCryptographicHash>
+#include <QVector>
+#include <QAtomicInt>
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+#include "wordlist.h"
+#include "metrics.h"
+
+
+const int WordList::IndexStride = 64;
+
+static const quint32 IndexMagic = 0x5345574cU;
+static const quint32 IndexVersion = 2;
+static const int WriteBufferSize = 1024 * 1024;
+
+
+// Folds ASCII letters only. The lines are UTF-8, so bytes from 0x80 up are
+// parts of multi-byte sequences and must be compared as they are; letters
+// outside of ASCII therefore don't match if they differ in case.
+struct FoldTable {
+  FoldTable(void)
+  {
+    for (int c = 0; c < 256; ++c) {
+      fold[c] = (c >= 'A' && c <= 'Z')
+          ? uchar(c + 0x20)
+          : uchar(c);
+    }
+  }
+  uchar fold[256];
+};
+
+
+class WordListPrivate {
+public:
+  WordListPrivate(void)
+    : map(Q_NULLPTR)
+    , size(0)
+    , count(0)
+    , sorted(true)
+    , fromCache(false)
+    , sourceSize(-1)
+  { /* ... */ }
+  ~WordListPrivate()
+  { /* ... */ }
+  // \return length of the line starting at `pos` without its line break; `next` receives the start of the next line
+  inline int lineAt(qint64 pos, qint64 &next) const
+  {
+    const char *p = reinterpret_cast<const char*>(map) + pos;
+    const char *nl = reinterpret_cast<const char*>(memchr(p, '\n', size_t(size - pos)));
+    qint64 len = (nl != Q_NULLPTR ? nl : reinterpret_cast<const char*>(map) + size) - p;
+    next = pos + len + 1;
+    if (len > 0 && p[len - 1] == '\r')
+      --len;
+    return int(qMin(len, qint64(INT_MAX)));
+  }
+  inline const char *at(qint64 pos) const
+  {
+    return reinterpret_cast<const char*>(map) + pos;
+  }
+  bool mapFile(QFile *f);
+  bool buildIndex(void);
+  bool writeSorted(QIODevice *out);
+  bool loadIndex(void);
+  void saveIndex(void);
+  QString indexFileName(void) const;
+  QString sortedFileName(void) const;
+
+  QString filename;
+  QString cacheDir;
+  QScopedPointer<QFile> mapped;
+  const uchar *map;
+  qint64 size;
+  QVector<qint64> sparse;
+  qint64 count;
+  bool sorted;
+  bool fromCache;
+  qint64 sourceSize;
+  QDateTime sourceModified;
+  QAtomicInt aborted;
+  QString errorString;
+};
+
+
+bool WordListPrivate::mapFile(QFile *f)
+{
+  mapped.reset(f);
+  if (!mapped->open(QIODevice::ReadOnly)) {
+    errorString = mapped->errorString();
+    return false;
+  }
+  size = mapped->size();
+  if (size == 0)
+    return true;
+  map = mapped->map(0, size);
+  if (map == Q_NULLPTR) {
+    errorString = mapped->errorString();
+    return false;
+  }
+  return true;
+}
+
+
+/*!
+ * \brief WordListPrivate::buildIndex
+ *
+ * Scans the mapped file once, remembering the offset of every `IndexStride`th
+ * non-empty line and checking whether the lines are in case-insensitive order.
+ */
+bool WordListPrivate::buildIndex(void)
+{
+  sparse.clear();
+  count = 0;
+  sorted = true;
+  const char *prev = Q_NULLPTR;
+  int prevLen = 0;
+  qint64 pos = 0;
+  while (pos < size) {
+    if ((count & 0xffff) == 0 && aborted.load() != 0)
+      return false;
+    qint64 next;
+    const int len = lineAt(pos, next);
+    if (len > 0) {
+      if (count % WordList::IndexStride == 0) {
+        sparse.append(pos);
+      }
+      if (sorted && prev != Q_NULLPTR && WordList::compare(prev, prevLen, at(pos), len) > 0) {
+        sorted = false;
+      }
+      prev = at(pos);
+      prevLen = len;
+      ++count;
+    }
+    pos = next;
+  }
+  sparse.squeeze();
+  return true;
+}
+
+
+/*!
+ * \brief WordListPrivate::writeSorted
+ *
+ * Writes the lines of the mapped file to `out` in case-insensitive order,
+ * dropping empty lines and exact duplicates.
+ */
+bool WordListPrivate::writeSorted(QIODevice *out)
+{
+  QVector<qint64> lines;
+  lines.reserve(int(qMin(count, qint64(INT_MAX))));
+  qint64 pos = 0;
+  while (pos < size) {
+    qint64 next;
+    if (lineAt(pos, next) > 0) {
+      lines.append(pos);
+    }
+    pos = next;
+  }
+  if (aborted.load() != 0)
+    return false;
+  std::sort(lines.begin(), lines.end(), [this](qint64 a, qint64 b) {
+    qint64 next;
+    const int aLen = lineAt(a, next);
+    const int bLen = lineAt(b, next);
+    const int c = WordList::compare(at(a), aLen, at(b), bLen);
+    if (c != 0)
+      return c < 0;
+    const int d = memcmp(at(a), at(b), size_t(qMin(aLen, bLen)));
+    return d < 0 || (d == 0 && aLen < bLen);
+  });
+  if (aborted.load() != 0)
+    return false;
+  QByteArray buffer;
+  buffer.reserve(WriteBufferSize + 4096);
+  const char *prev = Q_NULLPTR;
+  int prevLen = 0;
+  foreach (qint64 line, lines) {
+    qint64 next;
+    const int len = lineAt(line, next);
+    if (prev != Q_NULLPTR && len == prevLen && memcmp(prev, at(line), size_t(len)) == 0)
+      continue;
+    buffer.append(at(line), len);
+    buffer.append('\n');
+    prev = at(line);
+    prevLen = len;
+    if (buffer.size() >= WriteBufferSize) {
+      if (out->write(buffer) != buffer.size())
+        return false;
+      buffer.clear();
+    }
+  }
+  return out->write(buffer) == buffer.size();
+}
+
+
+QString WordListPrivate::indexFileName(void) const
+{
+  const QByteArray &key = QCryptographicHash::hash(QFileInfo(filename).absoluteFilePath().toUtf8(), QCryptographicHash::Sha1).toHex();
+  return cacheDir + "/wordlist-" + QString::fromLatin1(key) + ".idx";
+}
+
+
+QString WordListPrivate::sortedFileName(void) const
+{
+  QString name = indexFileName();
+  name.chop(4);
+  return name + ".sorted";
+}
+
+
+bool WordListPrivate::loadIndex(void)
+{
+  if (cacheDir.isEmpty())
+    return false;
+  QFile f(indexFileName());
+  if (!f.open(QIODevice::ReadOnly))
+    return false;
+  QDataStream in(&f);
+  in.setVersion(QDataStream::Qt_5_0);
+  quint32 magic = 0;
+  quint32 version = 0;
+  qint64 cachedSourceSize = -1;
+  qint64 cachedSourceModified = 0;
+  bool cachedSorted = false;
+  qint64 mappedSize = -1;
+  qint64 cachedCount = 0;
+  qint32 stride = 0;
+  QVector<qint64> cachedSparse;
+  in >> magic >> version;
+  if (magic != IndexMagic || version != IndexVersion)
+    return false;
+  in >> cachedSourceSize >> cachedSourceModified >> cachedSorted >> mappedSize >> cachedCount >> stride >> cachedSparse;
+  if (in.status() != QDataStream::Ok || stride != WordList::IndexStride)
+    return false;
+  if (cachedSourceSize != sourceSize || cachedSourceModified != sourceModified.toMSecsSinceEpoch())
+    return false;
+  if (!mapFile(new QFile(cachedSorted ? filename : sortedFileName())) || size != mappedSize) {
+    errorString.clear();
+    return false;
+  }
+  // spot check the index against the mapped file
+  foreach (qint64 pos, cachedSparse) {
+    if (pos < 0 || pos >= size || (pos > 0 && map[pos - 1] != '\n'))
+      return false;
+  }
+  sparse = cachedSparse;
+  count = cachedCount;
+  sorted = cachedSorted;
+  fromCache = true;
+  return true;
+}
+
+
+void WordListPrivate::saveIndex(void)
+{
+  if (cacheDir.isEmpty())
+    return;
+  QDir().mkpath(cacheDir);
+  QSaveFile f(indexFileName());
+  if (!f.open(QIODevice::WriteOnly))
+    return;
+  QDataStream out(&f);
+  out.setVersion(QDataStream::Qt_5_0);
+  out << IndexMagic << IndexVersion
+      << sourceSize << sourceModified.toMSecsSinceEpoch() << sorted << size << count
+      << qint32(WordList::IndexStride) << sparse;
+  if (out.status() == QDataStream::Ok) {
+    f.commit();
+  }
+  else {
+    f.cancelWriting();
+  }
+}
+
+
+/*!
+ * \brief WordList::WordList
+ *
+ * A `WordList` answers whether a word is contained in a large, newline separated
+ * list such as a dictionary of leaked passwords. The file is memory-mapped and
+ * searched via a sparse index holding the offset of every `IndexStride`th line,
+ * so a lookup is a binary search over the index followed by a short linear scan
+ * through the mapped pages, no matter how large the list is.
+ *
+ * Lookups need the list in case-insensitive order. `open()` checks that while it
+ * builds the index; if the order doesn't hold it writes a sorted copy and searches
+ * that instead. Index and sorted copy are kept in the cache directory, if one is set,
+ * and reused as long as the list isn't modified.
+ *
+ * `open()` reads the whole list and may take long, so better call it in a worker thread.
+ * Once open, `find()` may be called from any number of threads.
+ */
+WordList::WordList(void)
+  : d_ptr(new WordListPrivate)
+{
+  /* ... */
+}
+
+
+WordList::WordList(const QString &filename)
+  : d_ptr(new WordListPrivate)
+{
+  setFileName(filename);
+}
+
+
+WordList::~WordList()
+{
+  close();
+}
+
+
+void WordList::setFileName(const QString &filename)
+{
+  Q_D(WordList);
+  d->filename = filename;
+}
+
+
+QString WordList::fileName(void) const
+{
+  Q_D(const WordList);
+  return d->filename;
+}
+
+
+void WordList::setCacheDirectory(const QString &path)
+{
+  Q_D(WordList);
+  d->cacheDir = path;
+}
+
+
+QString WordList::cacheDirectory(void) const
+{
+  Q_D(const WordList);
+  return d->cacheDir;
+}
+
+
+bool WordList::open(void)
+{
+  Q_D(WordList);
+  METRIC_TIMER("wordlist.open_us");
+  close();
+  d->aborted.store(0);
+  const QFileInfo fi(d->filename);
+  if (!fi.isFile()) {
+    d->errorString = QObject::tr("Word list %1 doesn't exist").arg(d->filename);
+    return false;
+  }
+  d->sourceSize = fi.size();
+  d->sourceModified = fi.lastModified();
+  if (d->loadIndex())
+    return true;
+  close();
+  if (!d->mapFile(new QFile(d->filename)) || !d->buildIndex()) {
+    if (d->aborted.load() != 0) {
+      d->errorString = QObject::tr("Aborted");
+    }
+    close();
+    return false;
+  }
+  if (!d->sorted) {
+    QFile *sortedFile = Q_NULLPTR;
+    bool ok = false;
+    if (d->cacheDir.isEmpty()) {
+      QTemporaryFile *tmp = new QTemporaryFile;
+      ok = tmp->open() && d->writeSorted(tmp);
+      sortedFile = tmp;
+    }
+    else {
+      QDir().mkpath(d->cacheDir);
+      QSaveFile out(d->sortedFileName());
+      ok = out.open(QIODevice::WriteOnly) && d->writeSorted(&out) && out.commit();
+      if (!ok) {
+        d->errorString = out.errorString();
+      }
+      sortedFile = new QFile(d->sortedFileName());
+    }
+    if (ok) {
+      // keeps a temporary file alive while it's mapped
+      sortedFile->close();
+      QScopedPointer<QFile> source(d->mapped.take());
+      d->map = Q_NULLPTR;
+      d->size = 0;
+      ok = d->mapFile(sortedFile) && d->buildIndex();
+    }
+    else {
+      delete sortedFile;
+    }
+    if (!ok) {
+      if (d->aborted.load() != 0) {
+        d->errorString = QObject::tr("Aborted");
+      }
+      close();
+      return false;
+    }
+    d->sorted = false;
+  }
+  d->saveIndex();
+  return true;
+}
+
+
+bool WordList::isOpen(void) const
+{
+  Q_D(const WordList);
+  return !d->mapped.isNull() && d->mapped->isOpen();
+}
+
+
+/*!
+ * \brief WordList::isStale
+ *
+ * \return `true` if the list has been modified since it was opened
+ */
+bool WordList::isStale(void) const
+{
+  Q_D(const WordList);
+  const QFileInfo fi(d->filename);
+  return fi.size() != d->sourceSize || fi.lastModified() != d->sourceModified;
+}
+
+
+/*!
+ * \brief WordList::abort
+ *
+ * Makes a running `open()` return `false` as soon as possible.
+ */
+void WordList::abort(void)
+{
+  Q_D(WordList);
+  d->aborted.store(1);
+}
+
+
+void WordList::close(void)
+{
+  Q_D(WordList);
+  if (!d->mapped.isNull() && d->map != Q_NULLPTR) {
+    d->mapped->unmap(const_cast<uchar*>(d->map));
+  }
+  d->mapped.reset();
+  d->map = Q_NULLPTR;
+  d->size = 0;
+  d->sparse.clear();
+  d->count = 0;
+  d->sorted = true;
+  d->fromCache = false;
+}
+
+
+/*!
+ * \brief WordList::find
+ *
+ * \param word The word to look up.
+ * \param cs With `Qt::CaseInsensitive` any line equal to `word` except for the case of
+ * ASCII letters matches; with `Qt::CaseSensitive` the line must be byte-wise equal to `word`.
+ * \return offset of the matching line in the searched file; -1 if `word` isn't listed
+ */
+qint64 WordList::find(const QByteArray &word, Qt::CaseSensitivity cs) const
+{
+  Q_D(const WordList);
+  if (d->sparse.isEmpty() || word.isEmpty())
+    return -1;
+  METRIC_TIMER("wordlist.lookup_us");
+  int lo = 0;
+  int hi = d->sparse.size();
+  while (lo < hi) {
+    const int mid = (lo + hi) / 2;
+    qint64 next;
+    const int len = d->lineAt(d->sparse.at(mid), next);
+    if (compare(d->at(d->sparse.at(mid)), len, word.constData(), word.size()) < 0) {
+      lo = mid + 1;
+    }
+    else {
+      hi = mid;
+    }
+  }
+  // lines equal to `word` may begin in the block before the first index entry not less than `word`
+  qint64 pos = d->sparse.at(qMax(0, lo - 1));
+  while (pos < d->size) {
+    qint64 next;
+    const int len = d->lineAt(pos, next);
+    if (len > 0) {
+      const int c = compare(d->at(pos), len, word.constData(), word.size());
+      if (c > 0)
+        break;
+      if (c == 0 && (cs == Qt::CaseInsensitive || (len == word.size() && memcmp(d->at(pos), word.constData(), size_t(len)) == 0)))
+        return pos;
+    }
+    pos = next;
+  }
+  return -1;
+}
+
+
+bool WordList::contains(const QByteArray &word, Qt::CaseSensitivity cs) const
+{
+  return find(word, cs) >= 0;
+}
+
+
+QByteArray WordList::wordAt(qint64 pos) const
+{
+  Q_D(const WordList);
+  if (pos < 0 || pos >= d->size)
+    return QByteArray();
+  qint64 next;
+  const int len = d->lineAt(pos, next);
+  return QByteArray(d->at(pos), len);
+}
+
+
+/*!
+ * \brief WordList::count
+ *
+ * \return number of non-empty lines in the searched file
+ */
+qint64 WordList::count(void) const
+{
+  Q_D(const WordList);
+  return d->count;
+}
+
+
+/*!
+ * \brief WordList::wasSorted
+ *
+ * \return `false` if the list wasn't in case-insensitive order and a sorted copy is searched instead
+ */
+bool WordList::wasSorted(void) const
+{
+  Q_D(const WordList);
+  return d->sorted;
+}
+
+
+bool WordList::indexFromCache(void) const
+{
+  Q_D(const WordList);
+  return d->fromCache;
+}
+
+
+QString WordList::errorString(void) const
+{
+  Q_D(const WordList);
+  return d->errorString;
+}
+
+
+/*!
+ * \brief WordList::compare
+ *
+ * Compares two UTF-8 strings byte by byte, ignoring the case of ASCII letters.
+ *
+ * \return a negative value if `a` sorts before `b`, a positive one if after, otherwise 0
+ */
+int WordList::compare(const char *a, int aLen, const char *b, int bLen)
+{
+  static const FoldTable table;
+  const uchar *fold = table.fold;
+  const int n = qMin(aLen, bLen);
+  for (int i = 0; i < n; ++i) {
+    const int c = int(fold[uchar(a[i])]) - int(fold[uchar(b[i])]);
+    if (c != 0)
+      return c;
+  }
+  return aLen - bLen;
+}
@@ -0,0 +1,69 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+#ifndef __WORDLIST_H_
+#define __WORDLIST_H_
+
+#include <QtGlobal>
+#include <QString>
+#include <QByteArray>
+#include <QScopedPointer>
+
+
+class WordListPrivate;
+
+class WordList
+{
+public:
+  WordList(void);
+  explicit WordList(const QString &filename);
+  ~WordList();
+
+  void setFileName(const QString &);
+  QString fileName(void) const;
+  void setCacheDirectory(const QString &);
+  QString cacheDirectory(void) const;
+
+  bool open(void);
+  bool isOpen(void) const;
+  bool isStale(void) const;
+  void abort(void);
+  void close(void);
+
+  qint64 find(const QByteArray &word, Qt::CaseSensitivity cs = Qt::CaseInsensitive) const;
+  bool contains(const QByteArray &word, Qt::CaseSensitivity cs = Qt::CaseInsensitive) const;
+  QByteArray wordAt(qint64 pos) const;
+  qint64 count(void) const;
+  bool wasSorted(void) const;
+  bool indexFromCache(void) const;
+  QString errorString(void) const;
+
+  static int compare(const char *a, int aLen, const char *b, int bLen);
+
+  static const int IndexStride;
+
+private:
+  QScopedPointer<WordListPrivate> d_ptr;
+  Q_DECLARE_PRIVATE(WordList)
+  Q_DISABLE_COPY(WordList)
+};
+
+#endif // __WORDLIST_H_
@@ -5,7 +5,11 @@
 
 #define HAVE_STRDUP 1
 
+#ifdef WITH_TESTS
+#define __STATIC
+#else
 #define __STATIC static
+#endif
 
 #define MAJOR_VERSION 1
 #define MINOR_VERSION 0
@@ -44,6 +44,7 @@ SOURCES += \
     mqrspec.c \
     qrencode.c \
     qrinput.c \
+    qrraster.c \
     qrspec.c \
     rscode.c \
     split.c
@@ -57,6 +58,7 @@ HEADERS +=\
     qrencode.h \
     qrencode_inner.h \
     qrinput.h \
+    qrraster.h \
     qrspec.h \
     rscode.h \
     split.h
@@ -26,6 +26,10 @@
 #include <string.h>
 #include <limits.h>
 #include <errno.h>
+#include <stdint.h>
+#if defined(_MSC_VER)
+# include <intrin.h>
+#endif
 
 #include "qrencode.h"
 #include "qrspec.h"
@@ -180,6 +184,12 @@ unsigned char *Mask_makeMask(int width, unsigned char *frame, int mask, QRecLeve
 }
 
 
+#ifdef WITH_TESTS
+/*
+ * Byte per module implementation of the penalty calculation. Mask_mask() uses
+ * the bit packed one below, these are kept as a reference for the tests.
+ */
+
 //static int n1;
 //static int n2;
 //static int n3;
@@ -292,39 +302,470 @@ __STATIC int Mask_evaluateSymbol(int width, unsigned char *frame)
 
   return demerit;
 }
+#endif
+
+/******************************************************************************
+ * Bit packed evaluation
+ *****************************************************************************/
+
+/*
+ * The symbol is packed into 64 bit words, module x of a line being bit x % 64
+ * of word x / 64. Every symbol is held twice, as rows and as columns, so that
+ * the vertical runs can be scanned the same way as the horizontal ones.
+ * Bits beyond the width of the symbol are always 0 in a masked symbol.
+ */
+#define MASK_WORDS ((QRSPEC_WIDTH_MAX + 63) / 64)
+
+/*
+ * All mask patterns repeat every 12 modules in both directions.
+ */
+#define MASK_PERIOD (12)
+
+typedef uint64_t MaskWord;
+
+typedef struct {
+  MaskWord rows[QRSPEC_WIDTH_MAX][MASK_WORDS];
+  MaskWord cols[QRSPEC_WIDTH_MAX][MASK_WORDS];
+} MaskBits;
+
+typedef struct {
+  int width;
+  int words;
+  MaskBits data;       ///< dark modules of the unmasked symbol
+  MaskBits fixed;      ///< modules not to be masked, including the bits beyond the width
+  MaskBits masked;     ///< symbol being evaluated
+} MaskContext;
+
+static int Mask_popcount(MaskWord v)
+{
+#if defined(__GNUC__)
+  return __builtin_popcountll(v);
+#else
+  v = v - ((v >> 1) & 0x5555555555555555ULL);
+  v = (v & 0x3333333333333333ULL) + ((v >> 2) & 0x3333333333333333ULL);
+  v = (v + (v >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+  return (int)((v * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+static int Mask_ctz(MaskWord v)
+{
+#if defined(__GNUC__)
+  return __builtin_ctzll(v);
+#elif defined(_MSC_VER) && defined(_M_X64)
+  unsigned long i;
+  _BitScanForward64(&i, v);
+  return (int)i;
+#else
+  return Mask_popcount((v & (~v + 1)) - 1);
+#endif
+}
+
+/**
+ * Mask pattern as 12 by 12 modules, bit x of tile[y] being set if module (x, y)
+ * has to be inverted. Must be kept in sync with Mask_mask0..7.
+ */
+static void Mask_makeTile(int mask, unsigned int *tile)
+{
+  int x, y, v;
+
+  for(y=0; y<MASK_PERIOD; y++) {
+    tile[y] = 0;
+    for(x=0; x<MASK_PERIOD; x++) {
+      switch(mask) {
+      case 0: v = (x+y)&1; break;
+      case 1: v = y&1; break;
+      case 2: v = x%3; break;
+      case 3: v = (x+y)%3; break;
+      case 4: v = ((y/2)+(x/3))&1; break;
+      case 5: v = ((x*y)&1)+(x*y)%3; break;
+      case 6: v = (((x*y)&1)+(x*y)%3)&1; break;
+      default: v = (((x*y)%3)+((x+y)&1))&1; break;
+      }
+      if(v == 0) tile[y] |= 1U << x;
+    }
+  }
+}
+
+/**
+ * Expand a line of a tile to a word starting at module 64 * word.
+ */
+static MaskWord Mask_tileWord(unsigned int line, int word)
+{
+  int phase = (64 * word) % MASK_PERIOD;
+
+  line = ((line >> phase) | (line << (MASK_PERIOD - phase))) & 0xfff;
+
+  return (MaskWord)line * 0x1001001001001001ULL;
+}
+
+static void Mask_setModule(MaskBits *bits, int x, int y, int v)
+{
+  MaskWord xbit = (MaskWord)1 << (x & 63);
+  MaskWord ybit = (MaskWord)1 << (y & 63);
+
+  if(v) {
+    bits->rows[y][x >> 6] |= xbit;
+    bits->cols[x][y >> 6] |= ybit;
+  } else {
+    bits->rows[y][x >> 6] &= ~xbit;
+    bits->cols[x][y >> 6] &= ~ybit;
+  }
+}
+
+/**
+ * Bit packed version of Mask_writeFormatInformation().
+ */
+static int Mask_writeFormatBits(int width, MaskBits *bits, int mask, QRecLevel level)
+{
+  unsigned int format;
+  int v;
+  int i;
+  int blacks = 0;
+
+  format = QRspec_getFormatInfo(mask, level);
+
+  for(i=0; i<8; i++) {
+    v = format & 1;
+    blacks += 2 * v;
+    Mask_setModule(bits, width - 1 - i, 8, v);
+    if(i < 6) {
+      Mask_setModule(bits, 8, i, v);
+    } else {
+      Mask_setModule(bits, 8, i + 1, v);
+    }
+    format= format >> 1;
+  }
+  for(i=0; i<7; i++) {
+    v = format & 1;
+    blacks += 2 * v;
+    Mask_setModule(bits, 8, width - 7 + i, v);
+    if(i == 0) {
+      Mask_setModule(bits, 7, 8, v);
+    } else {
+      Mask_setModule(bits, 6 - i, 8, v);
+    }
+    format= format >> 1;
+  }
+
+  return blacks;
+}
+
+/**
+ * Mask for the bits of the first n modules of a line.
+ */
+static MaskWord Mask_lowBits(int word, int n)
+{
+  n -= 64 * word;
+  if(n >= 64) return ~(MaskWord)0;
+  if(n <= 0) return 0;
+
+  return ((MaskWord)1 << n) - 1;
+}
+
+static void Mask_pack(MaskContext *ctx, const unsigned char *frame)
+{
+  int i, j, k, end;
+  int width = ctx->width;
+  const unsigned char *p;
+  MaskWord v, data, fixed;
+
+  for(i=0; i<width; i++) {
+    for(j=0; j<ctx->words; j++) {
+      end = (64 * (j + 1) < width) ? 64 : width - 64 * j;
+      // row i
+      p = frame + i * width + 64 * j;
+      data = 0;
+      fixed = ~Mask_lowBits(j, width);
+      for(k=0; k<end; k++) {
+        v = p[k];
+        data |= (v & 1) << k;
+        fixed |= ((v >> 7) & 1) << k;
+      }
+      ctx->data.rows[i][j] = data;
+      ctx->fixed.rows[i][j] = fixed;
+      // column i
+      p = frame + 64 * j * width + i;
+      data = 0;
+      fixed = ~Mask_lowBits(j, width);
+      for(k=0; k<end; k++) {
+        v = *p;
+        data |= (v & 1) << k;
+        fixed |= ((v >> 7) & 1) << k;
+        p += width;
+      }
+      ctx->data.cols[i][j] = data;
+      ctx->fixed.cols[i][j] = fixed;
+    }
+  }
+}
+
+/**
+ * Apply a mask to the packed symbol.
+ * @return number of dark modules.
+ */
+static int Mask_applyBits(MaskContext *ctx, int mask)
+{
+  unsigned int tile[MASK_PERIOD];
+  unsigned int line;
+  MaskWord patterns[2][MASK_PERIOD][MASK_WORDS];
+  int i, j, k;
+  int blacks = 0;
+
+  Mask_makeTile(mask, tile);
+  for(i=0; i<MASK_PERIOD; i++) {
+    line = 0;
+    for(k=0; k<MASK_PERIOD; k++) {
+      line |= ((tile[k] >> i) & 1) << k;
+    }
+    for(j=0; j<ctx->words; j++) {
+      patterns[0][i][j] = Mask_tileWord(tile[i], j);
+      patterns[1][i][j] = Mask_tileWord(line, j);
+    }
+  }
+  for(i=0; i<ctx->width; i++) {
+    for(j=0; j<ctx->words; j++) {
+      ctx->masked.rows[i][j] = ctx->data.rows[i][j] ^ (patterns[0][i % MASK_PERIOD][j] & ~ctx->fixed.rows[i][j]);
+      ctx->masked.cols[i][j] = ctx->data.cols[i][j] ^ (patterns[1][i % MASK_PERIOD][j] & ~ctx->fixed.cols[i][j]);
+      blacks += Mask_popcount(ctx->masked.rows[i][j]);
+    }
+  }
+
+  return blacks;
+}
+
+/**
+ * Bit packed version of Mask_calcN2().
+ */
+static int Mask_calcN2Bits(const MaskContext *ctx)
+{
+  int y, j;
+  int count = 0;
+  const MaskWord *a, *b;
+  MaskWord sa, sb, valid;
+
+  for(y=1; y<ctx->width; y++) {
+    a = ctx->masked.rows[y - 1];
+    b = ctx->masked.rows[y];
+    for(j=0; j<ctx->words; j++) {
+      // move module x - 1 to bit x
+      sa = (a[j] << 1) | (j > 0 ? a[j - 1] >> 63 : 0);
+      sb = (b[j] << 1) | (j > 0 ? b[j - 1] >> 63 : 0);
+      valid = Mask_lowBits(j, ctx->width) & ~Mask_lowBits(j, 1);
+      count += Mask_popcount(((a[j] & b[j] & sa & sb) | ~(a[j] | b[j] | sa | sb)) & valid);
+    }
+  }
+
+  return count * N2;
+}
+
+/**
+ * Line of bits with bit x taken from bit x + k of the given line.
+ */
+static void Mask_shiftDown(int words, const MaskWord *line, int k, MaskWord *shifted)
+{
+  int j;
+
+  for(j=0; j<words; j++) {
+    shifted[j] = (line[j] >> k) | (j + 1 < words ? line[j + 1] << (64 - k) : 0);
+  }
+}
+
+/**
+ * Penalty for runs of five or more equally colored modules. A run of n
+ * modules contains n - 4 windows of five equally colored modules, so the
+ * penalty of N1 + (n - 5) per run is found by counting windows and runs.
+ */
+static int Mask_calcN1Bits(int width, int words, const MaskWord *line)
+{
+  int j, k;
+  int windows = 0;
+  int runs = 0;
+  MaskWord same[MASK_WORDS], shifted[MASK_WORDS], window[MASK_WORDS];
+
+  // bit x is set if module x equals module x + 1
+  Mask_shiftDown(words, line, 1, shifted);
+  for(j=0; j<words; j++) {
+    same[j] = ~(line[j] ^ shifted[j]);
+    window[j] = same[j] & Mask_lowBits(j, width - 4);
+  }
+  // bit x is set if modules x..x+4 are equal
+  for(k=1; k<4; k++) {
+    Mask_shiftDown(words, same, k, shifted);
+    for(j=0; j<words; j++) {
+      window[j] &= shifted[j];
+    }
+  }
+  for(j=0; j<words; j++) {
+    windows += Mask_popcount(window[j]);
+    // the first window of each run
+    runs += Mask_popcount(window[j] & ~((window[j] << 1) | (j > 0 ? window[j - 1] >> 63 : 0)));
+  }
+
+  return runs * N1 + windows - runs;
+}
+
+/**
+ * The N3 part of Mask_calcN1N3().
+ */
+static int Mask_calcN3(int length, int *runLength)
+{
+  int i;
+  int demerit = 0;
+  int fact;
+
+  for(i=3; i<length-2; i+=2) {
+    if((runLength[i] % 3) == 0) {
+      fact = runLength[i] / 3;
+      if(runLength[i-2] == fact &&
+         runLength[i-1] == fact &&
+         runLength[i+1] == fact &&
+         runLength[i+2] == fact) {
+        if(i == 3 || runLength[i-3] >= 4 * fact) {
+          demerit += N3;
+        } else if(i+4 >= length || runLength[i+3] >= 4 * fact) {
+          demerit += N3;
+        }
+      }
+    }
+  }
+
+  return demerit;
+}
+
+/**
+ * Bit packed version of Mask_calcRunLength().
+ */
+static int Mask_calcRunLengthBits(int width, int words, const MaskWord *line, int *runLength)
+{
+  int head;
+  int j, x;
+  int prev = 0;
+  MaskWord edges;
+
+  if(line[0] & 1) {
+    runLength[0] = -1;
+    head = 1;
+  } else {
+    head = 0;
+  }
+  for(j=0; j<words; j++) {
+    // bit x is set if module x differs from module x - 1
+    edges = line[j] ^ ((line[j] << 1) | (j > 0 ? line[j - 1] >> 63 : 0));
+    edges &= Mask_lowBits(j, width) & ~Mask_lowBits(j, 1);
+    while(edges) {
+      x = 64 * j + Mask_ctz(edges);
+      runLength[head++] = x - prev;
+      prev = x;
+      edges &= edges - 1;
+    }
+  }
+  runLength[head] = width - prev;
+
+  return head + 1;
+}
+
+static int Mask_evaluateBits(const MaskContext *ctx)
+{
+  int i;
+  int demerit = 0;
+  int runLength[QRSPEC_WIDTH_MAX + 1];
+  int length;
+
+  demerit += Mask_calcN2Bits(ctx);
+
+  for(i=0; i<ctx->width; i++) {
+    demerit += Mask_calcN1Bits(ctx->width, ctx->words, ctx->masked.rows[i]);
+    length = Mask_calcRunLengthBits(ctx->width, ctx->words, ctx->masked.rows[i], runLength);
+    demerit += Mask_calcN3(length, runLength);
+    demerit += Mask_calcN1Bits(ctx->width, ctx->words, ctx->masked.cols[i]);
+    length = Mask_calcRunLengthBits(ctx->width, ctx->words, ctx->masked.cols[i], runLength);
+    demerit += Mask_calcN3(length, runLength);
+  }
+
+  return demerit;
+}
 
 unsigned char *Mask_mask(int width, unsigned char *frame, QRecLevel level)
 {
   int i;
-  unsigned char *mask, *bestMask;
+  MaskContext *ctx;
+  int bestMask = -1;
   int minDemerit = INT_MAX;
   int blacks;
   int bratio;
   int demerit;
   int w2 = width * width;
 
-  mask = (unsigned char *)malloc(w2);
-  if(mask == NULL) return NULL;
-  bestMask = NULL;
+  if(width <= 0 || width > QRSPEC_WIDTH_MAX) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  ctx = (MaskContext *)malloc(sizeof(MaskContext));
+  if(ctx == NULL) return NULL;
+  ctx->width = width;
+  ctx->words = (width + 63) / 64;
+  Mask_pack(ctx, frame);
 
   for(i=0; i<maskNum; i++) {
-    //		n1 = n2 = n3 = n4 = 0;
-    demerit = 0;
-    blacks = maskMakers[i](width, frame, mask);
-    blacks += Mask_writeFormatInformation(width, mask, i, level);
+    blacks = Mask_applyBits(ctx, i);
+    blacks += Mask_writeFormatBits(width, &ctx->masked, i, level);
     bratio = (200 * blacks + w2) / w2 / 2; /* (int)(100*blacks/w2+0.5) */
     demerit = (abs(bratio - 50) / 5) * N4;
-    //		n4 = demerit;
-    demerit += Mask_evaluateSymbol(width, mask);
-    //		printf("(%d,%d,%d,%d)=%d\n", n1, n2, n3 ,n4, demerit);
+    demerit += Mask_evaluateBits(ctx);
     if(demerit < minDemerit) {
       minDemerit = demerit;
-      free(bestMask);
-      bestMask = mask;
-      mask = (unsigned char *)malloc(w2);
-      if(mask == NULL) break;
+      bestMask = i;
     }
   }
-  free(mask);
-  return bestMask;
+  free(ctx);
+
+  return Mask_makeMask(width, frame, bestMask, level);
 }
+
+#ifdef WITH_TESTS
+/*
+ * Score all masks of a frame bit packed and byte per module.
+ * @return number of masks for which the dark modules or the demerit differ.
+ *         On error, -1 is returned, and errno is set to indicate the error.
+ */
+int Mask_checkBits(int width, unsigned char *frame, QRecLevel level)
+{
+  int i;
+  MaskContext *ctx;
+  unsigned char *masked;
+  int blacks, blacksBits;
+  int mismatches = 0;
+
+  if(width <= 0 || width > QRSPEC_WIDTH_MAX) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  ctx = (MaskContext *)malloc(sizeof(MaskContext));
+  if(ctx == NULL) return -1;
+  masked = (unsigned char *)malloc(width * width);
+  if(masked == NULL) {
+    free(ctx);
+    return -1;
+  }
+  ctx->width = width;
+  ctx->words = (width + 63) / 64;
+  Mask_pack(ctx, frame);
+
+  for(i=0; i<maskNum; i++) {
+    blacks = maskMakers[i](width, frame, masked);
+    blacks += Mask_writeFormatInformation(width, masked, i, level);
+    blacksBits = Mask_applyBits(ctx, i);
+    blacksBits += Mask_writeFormatBits(width, &ctx->masked, i, level);
+    if(blacks != blacksBits || Mask_evaluateSymbol(width, masked) != Mask_evaluateBits(ctx)) {
+      mismatches++;
+    }
+  }
+  free(masked);
+  free(ctx);
+
+  return mismatches;
+}
+#endif
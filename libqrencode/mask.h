@@ -32,6 +32,7 @@ extern int Mask_calcRunLength(int width, unsigned char *frame, int dir, int *run
 extern int Mask_evaluateSymbol(int width, unsigned char *frame);
 extern int Mask_writeFormatInformation(int width, unsigned char *frame, int mask, QRecLevel level);
 extern unsigned char *Mask_makeMaskedFrame(int width, unsigned char *frame, int mask);
+extern int Mask_checkBits(int width, unsigned char *frame, QRecLevel level);
 #endif
 
 #endif /* __MASK_H__ */
@@ -0,0 +1,223 @@
+/*
+ * qrencode - QR Code encoder
+ *
+ * Rasterizing and vectorizing symbols.
+ * Copyright (C) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+
+#include "qrencode.h"
+#include "qrraster.h"
+
+/**
+ * Find the end of the run of modules starting at x that have the same color
+ * as the module at x.
+ * @return index of the first module not belonging to the run.
+ */
+static int QRraster_runEnd(const unsigned char *row, int width, int x)
+{
+  unsigned char dark = row[x] & 1;
+
+  while(x < width && (row[x] & 1) == dark) x++;
+
+  return x;
+}
+
+/**
+ * Set the bits from..to-1 in a row of MSB first packed pixels.
+ */
+static void QRraster_setBits(unsigned char *row, int from, int to)
+{
+  int first = from >> 3;
+  int last = (to - 1) >> 3;
+  unsigned char head = (unsigned char)(0xff >> (from & 7));
+  unsigned char tail = (unsigned char)(0xff << (7 - ((to - 1) & 7)));
+
+  if(first == last) {
+    row[first] |= head & tail;
+  } else {
+    row[first] |= head;
+    memset(row + first + 1, 0xff, last - first - 1);
+    row[last] |= tail;
+  }
+}
+
+int QRraster_size(const QRcode *qrcode, int moduleSize, int margin)
+{
+  int modules;
+
+  if(qrcode == NULL || qrcode->width <= 0 || moduleSize <= 0 || margin < 0) {
+    errno = EINVAL;
+    return -1;
+  }
+  if(margin > (INT_MAX - qrcode->width) / 2) {
+    errno = ERANGE;
+    return -1;
+  }
+  modules = qrcode->width + 2 * margin;
+  if(modules > INT_MAX / moduleSize) {
+    errno = ERANGE;
+    return -1;
+  }
+
+  return modules * moduleSize;
+}
+
+/**
+ * Check the arguments of the raster renderers.
+ * @return width of the image in pixels or -1 on error.
+ */
+static int QRraster_checkRaster(const QRcode *qrcode, int moduleSize, int margin, const unsigned char *buffer, int stride, int bitsPerPixel)
+{
+  int size;
+
+  size = QRraster_size(qrcode, moduleSize, margin);
+  if(size < 0) return -1;
+  if(buffer == NULL || stride < size / 8 * bitsPerPixel + (size % 8 * bitsPerPixel + 7) / 8) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  return size;
+}
+
+int QRraster_renderGray8(const QRcode *qrcode, int moduleSize, int margin, unsigned char *buffer, int stride)
+{
+  int size, x, y, end, i;
+  const unsigned char *row;
+  unsigned char *line;
+  int offset;
+
+  size = QRraster_checkRaster(qrcode, moduleSize, margin, buffer, stride, 8);
+  if(size < 0) return -1;
+
+  offset = margin * moduleSize;
+  for(i=0; i<offset; i++) {
+    memset(buffer + (size_t)i * stride, 0xff, size);
+    memset(buffer + (size_t)(size - 1 - i) * stride, 0xff, size);
+  }
+  row = qrcode->data;
+  line = buffer + (size_t)offset * stride;
+  for(y=0; y<qrcode->width; y++) {
+    memset(line, 0xff, offset);
+    for(x=0; x<qrcode->width; x=end) {
+      end = QRraster_runEnd(row, qrcode->width, x);
+      memset(line + offset + x * moduleSize, (row[x] & 1) ? 0x00 : 0xff, (end - x) * moduleSize);
+    }
+    memset(line + size - offset, 0xff, offset);
+    for(i=1; i<moduleSize; i++) {
+      memcpy(line + (size_t)i * stride, line, size);
+    }
+    row += qrcode->width;
+    line += (size_t)moduleSize * stride;
+  }
+
+  return 0;
+}
+
+int QRraster_renderMono(const QRcode *qrcode, int moduleSize, int margin, unsigned char *buffer, int stride)
+{
+  int size, bytes, x, y, end, i;
+  const unsigned char *row;
+  unsigned char *line;
+  int offset;
+
+  size = QRraster_checkRaster(qrcode, moduleSize, margin, buffer, stride, 1);
+  if(size < 0) return -1;
+
+  bytes = (size + 7) / 8;
+  offset = margin * moduleSize;
+  for(i=0; i<offset; i++) {
+    memset(buffer + (size_t)i * stride, 0, bytes);
+    memset(buffer + (size_t)(size - 1 - i) * stride, 0, bytes);
+  }
+  row = qrcode->data;
+  line = buffer + (size_t)offset * stride;
+  for(y=0; y<qrcode->width; y++) {
+    memset(line, 0, bytes);
+    for(x=0; x<qrcode->width; x=end) {
+      end = QRraster_runEnd(row, qrcode->width, x);
+      if(row[x] & 1) {
+        QRraster_setBits(line, offset + x * moduleSize, offset + end * moduleSize);
+      }
+    }
+    for(i=1; i<moduleSize; i++) {
+      memcpy(line + (size_t)i * stride, line, bytes);
+    }
+    row += qrcode->width;
+    line += (size_t)moduleSize * stride;
+  }
+
+  return 0;
+}
+
+char *QRraster_svg(const QRcode *qrcode, int moduleSize, int margin)
+{
+  static const char header[] =
+    "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+    "<svg xmlns=\"http://www.w3.org/2000/svg\" version=\"1.1\" width=\"%d\" height=\"%d\" viewBox=\"0 0 %d %d\" shape-rendering=\"crispEdges\">\n"
+    "<rect width=\"%d\" height=\"%d\" fill=\"#fff\"/>\n"
+    "<path fill=\"#000\" d=\"";
+  static const char footer[] = "\"/>\n</svg>\n";
+  /* "M" x " " y "h" n "v1h-" n "z" with at most 10 digits per number */
+  static const int maxRunLength = 4 * 10 + 8;
+  int size, modules, runs, x, y, end;
+  const unsigned char *row;
+  size_t capacity;
+  char *svg, *p;
+
+  size = QRraster_size(qrcode, moduleSize, margin);
+  if(size < 0) return NULL;
+  modules = size / moduleSize;
+
+  runs = 0;
+  row = qrcode->data;
+  for(y=0; y<qrcode->width; y++) {
+    for(x=0; x<qrcode->width; x=end) {
+      end = QRraster_runEnd(row, qrcode->width, x);
+      if(row[x] & 1) runs++;
+    }
+    row += qrcode->width;
+  }
+
+  capacity = sizeof(header) + 6 * 10 + (size_t)runs * maxRunLength + sizeof(footer);
+  svg = (char *)malloc(capacity);
+  if(svg == NULL) return NULL;
+
+  p = svg + sprintf(svg, header, size, size, modules, modules, modules, modules);
+  row = qrcode->data;
+  for(y=0; y<qrcode->width; y++) {
+    for(x=0; x<qrcode->width; x=end) {
+      end = QRraster_runEnd(row, qrcode->width, x);
+      if(row[x] & 1) {
+        p += sprintf(p, "M%d %dh%dv1h-%dz", margin + x, margin + y, end - x, end - x);
+      }
+    }
+    row += qrcode->width;
+  }
+  strcpy(p, footer);
+
+  return svg;
+}
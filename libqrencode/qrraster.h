@@ -0,0 +1,104 @@
+/*
+ * qrencode - QR Code encoder
+ *
+ * Rasterizing and vectorizing symbols.
+ * Copyright (C) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/** \file qrraster.h
+ * Renders a QRcode into caller supplied pixel buffers or into SVG.
+ *
+ * The renderers only read the symbol and write to the given buffer, so they
+ * are thread safe and need neither a window system nor a paint device. Every
+ * row of modules is rasterized once as runs of equally colored modules and
+ * then copied to the remaining pixel rows of that module row.
+ *
+ * All functions take the size of a module in pixels and the width of the
+ * quiet zone around the symbol in modules.
+ */
+
+#ifndef __QRRASTER_H__
+#define __QRRASTER_H__
+
+#include "qrencode.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/**
+ * Calculate the width (and height) of the rendered symbol.
+ * @param qrcode symbol to be rendered.
+ * @param moduleSize width of a module in pixels. Must be positive.
+ * @param margin width of the quiet zone in modules. Must not be negative.
+ * @return width of the image in pixels. On error, -1 is returned, and errno is
+ *         set to indicate the error.
+ * @throw EINVAL invalid arguments.
+ * @throw ERANGE the image would be too large.
+ */
+extern int QRraster_size(const QRcode *qrcode, int moduleSize, int margin);
+
+/**
+ * Render a symbol into an 8 bit grayscale buffer, i.e. one byte per pixel with
+ * dark modules as 0x00 and light modules as 0xff.
+ * @param qrcode symbol to be rendered.
+ * @param moduleSize width of a module in pixels.
+ * @param margin width of the quiet zone in modules.
+ * @param buffer image buffer of at least QRraster_size() rows of stride bytes.
+ * @param stride distance between two rows of the image buffer in bytes.
+ * @return 0 on success. On error, -1 is returned, and errno is set to indicate
+ *         the error.
+ * @throw EINVAL invalid arguments or stride too small.
+ * @throw ERANGE the image would be too large.
+ */
+extern int QRraster_renderGray8(const QRcode *qrcode, int moduleSize, int margin, unsigned char *buffer, int stride);
+
+/**
+ * Render a symbol into a 1 bit per pixel buffer. Pixels are packed starting
+ * with the most significant bit of a byte. A set bit denotes a dark module,
+ * a cleared bit a light one.
+ * @param qrcode symbol to be rendered.
+ * @param moduleSize width of a module in pixels.
+ * @param margin width of the quiet zone in modules.
+ * @param buffer image buffer of at least QRraster_size() rows of stride bytes.
+ * @param stride distance between two rows of the image buffer in bytes.
+ * @return 0 on success. On error, -1 is returned, and errno is set to indicate
+ *         the error.
+ * @throw EINVAL invalid arguments or stride too small.
+ * @throw ERANGE the image would be too large.
+ */
+extern int QRraster_renderMono(const QRcode *qrcode, int moduleSize, int margin, unsigned char *buffer, int stride);
+
+/**
+ * Render a symbol as an SVG document. Dark modules are merged into horizontal
+ * runs which are emitted as a single path.
+ * @param qrcode symbol to be rendered.
+ * @param moduleSize width of a module in the user unit of the document.
+ * @param margin width of the quiet zone in modules.
+ * @return NUL terminated SVG document. The caller must free() it. On error,
+ *         NULL is returned, and errno is set to indicate the error.
+ * @throw EINVAL invalid arguments.
+ * @throw ERANGE the image would be too large.
+ * @throw ENOMEM unable to allocate memory.
+ */
+extern char *QRraster_svg(const QRcode *qrcode, int moduleSize, int margin);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* __QRRASTER_H__ */
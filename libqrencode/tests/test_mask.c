@@ -0,0 +1,150 @@
+/*
+ * qrencode - QR Code encoder
+ *
+ * Checks of the bit packed mask evaluation.
+ * Copyright (C) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Build and run from the libqrencode directory with
+ *
+ *   cc -O2 -DHAVE_CONFIG_H -DWITH_TESTS -I. -o test_mask tests/test_mask.c \
+ *     bitstream.c mask.c mmask.c mqrspec.c qrencode.c qrinput.c qrspec.c rscode.c split.c
+ *   ./test_mask
+ *
+ * 1. Every mask of random frames of all versions and levels is scored by
+ *    Mask_mask()'s bit packed evaluation and by Mask_evaluateSymbol(); the
+ *    dark modules and the demerits must agree.
+ * 2. A fixed corpus of 8 bit, numeric and alphanumeric data is encoded and
+ *    the symbols are hashed. The hash must match the one of the byte per
+ *    module implementation, i.e. the same masks must be chosen.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../qrencode.h"
+#include "../qrspec.h"
+#include "../mask.h"
+
+#define FRAMES_PER_VERSION 30
+#define CORPUS_SIZE 4000
+#define CORPUS_HASH 0x517435687d55c24fULL
+
+static unsigned int seed;
+
+/* Same sequence on every platform, unlike rand(). */
+static int random15(void)
+{
+  seed = seed * 1103515245u + 12345u;
+  return (int)((seed >> 16) & 0x7fff);
+}
+
+static double now(void)
+{
+  return (double)clock() / CLOCKS_PER_SEC;
+}
+
+static int test_checkBits(void)
+{
+  int version, i, width, mismatches;
+  int checked = 0, failed = 0;
+  unsigned char *frame;
+
+  seed = 7;
+  for(version=1; version<=QRSPEC_VERSION_MAX; version++) {
+    width = QRspec_getWidth(version);
+    for(i=0; i<FRAMES_PER_VERSION; i++) {
+      int j;
+      frame = QRspec_newFrame(version);
+      if(frame == NULL) {
+        perror("QRspec_newFrame");
+        return 1;
+      }
+      for(j=0; j<width * width; j++) {
+        if(!(frame[j] & 0x80)) frame[j] = (frame[j] & ~1) | (random15() & 1);
+      }
+      mismatches = Mask_checkBits(width, frame, (QRecLevel)(i % 4));
+      if(mismatches != 0) {
+        printf("version %d, frame %d: %d masks differ\n", version, i, mismatches);
+        failed++;
+      }
+      checked++;
+      free(frame);
+    }
+  }
+  printf("mask evaluation: %d frames, %d failed\n", checked, failed);
+
+  return failed != 0;
+}
+
+static unsigned long long fnv1a(const unsigned char *p, int n, unsigned long long h)
+{
+  int i;
+
+  for(i=0; i<n; i++) {
+    h ^= p[i];
+    h *= 1099511628211ULL;
+  }
+
+  return h;
+}
+
+static int test_corpus(void)
+{
+  static const char digits[] = "0123456789";
+  static const char alnum[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ $%*+-./:";
+  unsigned char data[2900];
+  unsigned long long hash = 14695981039346656037ULL;
+  int i, j, n, kind;
+  int count = 0;
+  QRcode *qrcode;
+  double t;
+
+  seed = 42;
+  t = now();
+  for(i=0; i<CORPUS_SIZE; i++) {
+    n = 1 + random15() % (i % 10 == 0 ? 2900 : 300);
+    kind = random15() % 3;
+    for(j=0; j<n; j++) {
+      data[j] = kind == 0 ? (unsigned char)random15() : kind == 1 ? digits[random15() % 10] : alnum[random15() % 45];
+    }
+    qrcode = QRcode_encodeData(n, data, 0, (QRecLevel)(i % 4));
+    if(qrcode == NULL) continue;
+    hash = fnv1a(qrcode->data, qrcode->width * qrcode->width, hash) ^ (unsigned long long)qrcode->version;
+    count++;
+    QRcode_free(qrcode);
+  }
+  printf("corpus: %d symbols in %.2f s, hash %016llx\n", count, now() - t, hash);
+  if(hash != CORPUS_HASH) {
+    printf("corpus: expected hash %016llx\n", CORPUS_HASH);
+    return 1;
+  }
+
+  return 0;
+}
+
+int main(void)
+{
+  int failed = 0;
+
+  failed += test_checkBits();
+  failed += test_corpus();
+
+  return failed != 0;
+}